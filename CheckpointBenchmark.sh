@@ -0,0 +1,35 @@
+#!/bin/bash
+# Copyright 2019 the MPLB team. All rights reserved.
+# Use of this source code is governed by a BSD-style
+# license that can be found in the LICENSE file.
+# Usage: Compare the cost of the checkpoints with and without ASYNCIO
+# ./CheckpointBenchmark.sh [number of ranks on a socket]
+# The 3D lid-driven cavity is run without checkpoints ("nocheckpoint"), with
+# the synchronous checkpoints, and with the checkpoints written by the
+# background thread of ASYNCIO=1, on a single core and on the cores of a
+# socket. The wall time and the checkpoint lines are printed while the full
+# output is kept in checkpoint_<mode>_<ranks>.log.
+
+socketRanks=${1:-$(lscpu | awk -F: '/Core\(s\) per socket/{print $2+0}')}
+for mode in off sync async
+do
+    flags=""
+    args=""
+    if [ "$mode" == "async" ]; then
+        flags="ASYNCIO=1"
+    fi
+    if [ "$mode" == "off" ]; then
+        args="nocheckpoint"
+    fi
+    # rebuild as the targets do not depend on the flags
+    make -B lbm3d_dev_seq lbm3d_dev_mpi MAINCPP=lbm3d_cavity.cpp $flags ||
+        exit 1
+    echo "Running the cavity with the checkpoints $mode on 1 core"
+    ./lbm3d_dev_seq $args > checkpoint_${mode}_1.log
+    grep -E "Total Wall time|checkpoints written" checkpoint_${mode}_1.log
+    echo "Running the cavity with the checkpoints $mode on $socketRanks cores"
+    mpirun -np $socketRanks --bind-to core --map-by socket \
+        ./lbm3d_dev_mpi $args > checkpoint_${mode}_$socketRanks.log
+    grep -E "Total Wall time|checkpoints written|Warning" \
+        checkpoint_${mode}_$socketRanks.log
+done
@@ -0,0 +1,38 @@
+#!/bin/bash
+# Copyright 2019 the MPLB team. All rights reserved.
+# Use of this source code is governed by a BSD-style
+# license that can be found in the LICENSE file.
+# Usage: Compare the AoS and SoA layouts of the distribution functions
+# ./LayoutBenchmark.sh [number of ranks on a socket]
+# The D2Q9 and D3Q19 lid-driven cavities are built with the default layout,
+# where the populations of a node are together (AoS), and with SOA=1, where
+# each population is contiguous in x (SoA). Each build runs on a single core
+# and on the cores of a socket, and the MLUPS lines are printed while the
+# full output is kept in layout_<case>_<layout>_<ranks>.log.
+
+socketRanks=${1:-$(lscpu | awk -F: '/Core\(s\) per socket/{print $2+0}')}
+for layout in aos soa
+do
+    flags=""
+    if [ "$layout" == "soa" ]; then
+        flags="SOA=1"
+    fi
+    for case in 2d 3d
+    do
+        mainCpp=lbm3d_cavity.cpp
+        if [ "$case" == "2d" ]; then
+            mainCpp=lbm2d_hilemms.cpp
+        fi
+        # rebuild as the targets do not depend on the flags
+        make -B lbm${case}_dev_seq lbm${case}_dev_mpi MAINCPP=$mainCpp \
+            $flags || exit 1
+        echo "Running the $case cavity with the $layout layout on 1 core"
+        ./lbm${case}_dev_seq > layout_${case}_${layout}_1.log
+        grep -E "MLUPS" layout_${case}_${layout}_1.log
+        echo "Running the $case cavity with the $layout layout on" \
+            "$socketRanks cores"
+        mpirun -np $socketRanks --bind-to core --map-by socket \
+            ./lbm${case}_dev_mpi > layout_${case}_${layout}_$socketRanks.log
+        grep -E "MLUPS" layout_${case}_${layout}_$socketRanks.log
+    done
+done
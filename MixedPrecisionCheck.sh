@@ -0,0 +1,50 @@
+#!/bin/bash
+# Copyright 2019 the MPLB team. All rights reserved.
+# Use of this source code is governed by a BSD-style
+# license that can be found in the LICENSE file.
+# Usage: Compare the mixed precision with the double precision
+# ./MixedPrecisionCheck.sh
+# The 3D lid-driven cavity is built and run with and without MIXEDPRECISION,
+# each in its own directory mixed_<precision>. The macroscopic variables of
+# the last step written by both runs are compared by h5diff, and the number
+# of the differing values and the maximum absolute difference are printed.
+# The full output is kept in mixed_<precision>/run.log.
+
+for precision in double single
+do
+    flags=""
+    if [ "$precision" == "single" ]; then
+        flags="MIXEDPRECISION=1"
+    fi
+    # rebuild as the target does not depend on the flags
+    make -B lbm3d_dev_seq MAINCPP=lbm3d_cavity.cpp $flags || exit 1
+    rm -rf mixed_$precision
+    mkdir mixed_$precision
+    echo "Running the cavity in $precision precision"
+    (cd mixed_$precision && ../lbm3d_dev_seq > run.log) || exit 1
+    grep -E "MLUPS" mixed_$precision/run.log
+done
+# the runs may converge at different steps
+step=$(comm -12 \
+    <(ls mixed_double | sed -n 's/.*_Block_0_\([0-9]*\)\.h5/\1/p' | sort) \
+    <(ls mixed_single | sed -n 's/.*_Block_0_\([0-9]*\)\.h5/\1/p' | sort) |
+    sort -n | tail -1)
+if [ -z "$step" ]; then
+    echo "The two runs have no output step in common"
+    exit 1
+fi
+result=3D_lid_Driven_cavity_Block_0_$step.h5
+echo "Comparing the macroscopic variables at the step $step"
+h5diff mixed_double/$result mixed_single/$result /Block_0/MacroVars_0 \
+    /Block_0/MacroVars_0 | awk '
+    /^\[/ {
+        diff = $NF < 0 ? -$NF : $NF
+        if (diff > maxDiff) {
+            maxDiff = diff
+        }
+        num++
+    }
+    END {
+        printf "MacroVars_0: %d values differ, the maximum difference is %g\n",
+            num, maxDiff
+    }'
@@ -0,0 +1,76 @@
+#!/bin/bash
+# Copyright 2019 the MPLB team. All rights reserved.
+# Use of this source code is governed by a BSD-style
+# license that can be found in the LICENSE file.
+# Usage: Compare a restart from the moments of f with an exact restart
+# ./MomentRestartCheck.sh [step]
+# The 3D lid-driven cavity is run from the start twice, writing the exact
+# checkpoints in moment_exact and, with the "moments" argument, the
+# compressed ones in moment_compressed. The checkpoint of the step, 1000 by
+# default, of each run is copied with the case file into
+# moment_restart_<checkpoint>, where the cavity is restarted from it. The
+# macroscopic variables of the last step written by both restarts are
+# compared by h5diff, and those of the restart from the moments are also
+# compared with the uninterrupted run. The number of the differing values
+# and the maximum absolute difference are printed. The full output is kept
+# in moment_<run>/run.log.
+
+step=${1:-1000}
+case=3D_lid_Driven_cavity
+make -B lbm3d_dev_seq MAINCPP=lbm3d_cavity.cpp || exit 1
+for checkpoint in exact compressed
+do
+    flags=""
+    if [ "$checkpoint" == "compressed" ]; then
+        flags="moments"
+    fi
+    rm -rf moment_$checkpoint moment_restart_$checkpoint
+    mkdir moment_$checkpoint moment_restart_$checkpoint
+    echo "Running the cavity with the $checkpoint checkpoints"
+    (cd moment_$checkpoint && ../lbm3d_dev_seq $flags > run.log) || exit 1
+    grep -E "The f rebuilt from the moments at step $step " \
+        moment_$checkpoint/run.log
+    for file in ${case}_Block_0_$step.h5 ${case}_Block_0_static.h5 \
+        ${case}_case.h5
+    do
+        cp moment_$checkpoint/$file moment_restart_$checkpoint/ || exit 1
+    done
+    echo "Restarting the cavity from the $checkpoint checkpoint of the" \
+        "step $step"
+    (cd moment_restart_$checkpoint &&
+        ../lbm3d_dev_seq restart $step > run.log) || exit 1
+    grep -E "Restarted from step" moment_restart_$checkpoint/run.log
+done
+# the restarts may converge at different steps
+last=$(comm -12 \
+    <(ls moment_restart_exact | sed -n 's/.*_Block_0_\([0-9]*\)\.h5/\1/p' |
+        sort) \
+    <(ls moment_restart_compressed |
+        sed -n 's/.*_Block_0_\([0-9]*\)\.h5/\1/p' | sort) |
+    sort -n | tail -1)
+if [ -z "$last" ] || [ "$last" -le "$step" ]; then
+    echo "The two restarts have no output step in common after $step"
+    exit 1
+fi
+result=${case}_Block_0_$last.h5
+echo "Comparing the macroscopic variables at the step $last"
+for reference in moment_restart_exact moment_exact
+do
+    if [ ! -f $reference/$result ]; then
+        continue
+    fi
+    h5diff $reference/$result moment_restart_compressed/$result \
+        /Block_0/MacroVars_0 /Block_0/MacroVars_0 |
+        awk -v reference=$reference '
+        /^\[/ {
+            diff = $NF < 0 ? -$NF : $NF
+            if (diff > maxDiff) {
+                maxDiff = diff
+            }
+            num++
+        }
+        END {
+            printf "MacroVars_0 against %s: %d values differ, the maximum " \
+                "difference is %g\n", reference, num, maxDiff
+        }'
+done
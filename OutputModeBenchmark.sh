@@ -0,0 +1,38 @@
+#!/bin/bash
+# Copyright 2019 the MPLB team. All rights reserved.
+# Use of this source code is governed by a BSD-style
+# license that can be found in the LICENSE file.
+# Usage: Compare the I/O bandwidth of the output modes
+# ./OutputModeBenchmark.sh [number of ranks]
+# The 3D lid-driven cavity is run by mpirun with the per-block files, the
+# shared file and the time-series file (see SetOutputMode), each in its own
+# directory output_<mode>. The mean bandwidth of the checkpoints is printed,
+# where the static output is excluded, while the full output is kept in
+# output_<mode>/run.log.
+
+ranks=${1:-$(nproc)}
+make lbm3d_dev_mpi MAINCPP=lbm3d_cavity.cpp || exit 1
+for mode in block shared series
+do
+    args=""
+    if [ "$mode" != "block" ]; then
+        args=$mode
+    fi
+    rm -rf output_$mode
+    mkdir output_$mode
+    echo "Running the cavity with the $mode output on $ranks ranks"
+    (cd output_$mode && mpirun -np $ranks ../lbm3d_dev_mpi $args > run.log) ||
+        exit 1
+    awk -v mode=$mode '
+        /^Output [0-9]+: .* MB\/s/ {
+            megaBytes += $3
+            seconds += $7
+            num++
+        }
+        END {
+            if (seconds > 0) {
+                printf "%s: %d outputs, %.2f MB in %f seconds, %.2f MB/s\n",
+                    mode, num, megaBytes, seconds, megaBytes / seconds
+            }
+        }' output_$mode/run.log
+done
@@ -0,0 +1,37 @@
+#!/bin/bash
+# Copyright 2019 the MPLB team. All rights reserved.
+# Use of this source code is governed by a BSD-style
+# license that can be found in the LICENSE file.
+# Usage: Check the periodic halo against the full halos
+# ./PeriodicCheck.sh [porosity] [number of ranks]
+# The packed bed, periodic along z, is run with SetPeriodicHalo, which only
+# transfers the populations entering the block, and with the full halos of
+# SetBlockPeriodicity. The distribution functions and the macroscopic
+# variables written at the last step must be bitwise identical, i.e., h5diff
+# reports no differences. The full output is kept in periodic_<mode>.log.
+
+porosity=${1:-0.5}
+ranks=${2:-2}
+result=3D_porous_sphere_bed_Block_0_1000.h5
+make -B lbm3d_dev_mpi MAINCPP=lbm3d_porous.cpp || exit 1
+for mode in periodic fullhalo
+do
+    echo "Running the packed bed with the $mode mode on $ranks ranks"
+    mpirun -np $ranks ./lbm3d_dev_mpi $porosity $mode > periodic_${mode}.log \
+        || exit 1
+    grep -E "Periodic halo|MLUPS" periodic_${mode}.log
+    mv $result periodic_${mode}.h5
+done
+status=0
+for dat in f_0 MacroVars_0
+do
+    if h5diff periodic_periodic.h5 periodic_fullhalo.h5 /Block_0/$dat \
+        /Block_0/$dat
+    then
+        echo "$dat: the periodic halo and the full halos are identical"
+    else
+        echo "$dat: the periodic halo and the full halos differ"
+        status=1
+    fi
+done
+exit $status
@@ -0,0 +1,59 @@
+#!/bin/bash
+# Copyright 2019 the MPLB team. All rights reserved.
+# Use of this source code is governed by a BSD-style
+# license that can be found in the LICENSE file.
+# Usage: Check a restart against an uninterrupted run
+# ./RestartCheck.sh [step]
+# The 3D lid-driven cavity is run from the start in restart_full, and the
+# checkpoint of the step, 1000 by default, is copied with the case file into
+# restart_part, where the cavity is restarted from it with the "restart"
+# argument. The distribution functions and the macroscopic variables of the
+# last step written by both runs must be identical, i.e., h5diff reports no
+# differences, and the setup times of the cold start and the restart are
+# printed. The full output is kept in restart_<run>/run.log.
+
+step=${1:-1000}
+case=3D_lid_Driven_cavity
+make -B lbm3d_dev_seq MAINCPP=lbm3d_cavity.cpp || exit 1
+rm -rf restart_full restart_part
+mkdir restart_full restart_part
+echo "Running the cavity from the start"
+(cd restart_full && ../lbm3d_dev_seq > run.log) || exit 1
+for file in ${case}_Block_0_$step.h5 ${case}_Block_0_static.h5 ${case}_case.h5
+do
+    cp restart_full/$file restart_part/ || exit 1
+done
+echo "Restarting the cavity from the step $step"
+(cd restart_part && ../lbm3d_dev_seq restart $step > run.log) || exit 1
+for run in full part
+do
+    echo "restart_$run:"
+    grep -E "Restarted from step|The setup took" restart_$run/run.log
+done
+# the last step written after the checkpoint by both runs
+last=$(comm -12 \
+    <(ls restart_full | sed -n 's/.*_Block_0_\([0-9]*\)\.h5/\1/p' | sort) \
+    <(ls restart_part | sed -n 's/.*_Block_0_\([0-9]*\)\.h5/\1/p' | sort) |
+    sort -n | tail -1)
+if [ -z "$last" ] || [ "$last" -le "$step" ]; then
+    echo "The restart has written no step after $step"
+    exit 1
+fi
+result=${case}_Block_0_$last.h5
+echo "Comparing the step $last"
+status=0
+for dat in f_0 MacroVars_0
+do
+    if h5diff -q restart_full/$result restart_part/$result /Block_0/$dat \
+        /Block_0/$dat
+    then
+        echo "$dat: the restarted and the uninterrupted runs are identical"
+    else
+        num=$(h5diff restart_full/$result restart_part/$result \
+            /Block_0/$dat /Block_0/$dat | grep -c '^\[')
+        echo "$dat: $num values differ between the restarted and the" \
+            "uninterrupted runs"
+        status=1
+    fi
+done
+exit $status
@@ -0,0 +1,37 @@
+#!/bin/bash
+# Copyright 2019 the MPLB team. All rights reserved.
+# Use of this source code is governed by a BSD-style
+# license that can be found in the LICENSE file.
+# Usage: Check the sparse execution against the dense one
+# ./SparseCheck.sh [porosity]
+# The porous sphere bed is run with and without the "sparse" argument, and
+# the distribution functions and the macroscopic variables written at the
+# last step must be identical, i.e., h5diff reports no differences. The full
+# output is kept in sparse_<mode>.log.
+
+porosity=${1:-0.5}
+result=3D_porous_sphere_bed_Block_0_1000.h5
+make -B lbm3d_dev_seq MAINCPP=lbm3d_porous.cpp || exit 1
+for mode in dense sparse
+do
+    flags="$porosity"
+    if [ "$mode" == "sparse" ]; then
+        flags="$porosity sparse"
+    fi
+    echo "Running the porous sphere bed with the $mode execution"
+    ./lbm3d_dev_seq $flags > sparse_${mode}.log || exit 1
+    grep -E "Sparse execution|MLUPS" sparse_${mode}.log
+    mv $result sparse_${mode}.h5
+done
+status=0
+for dat in f_0 MacroVars_0
+do
+    if h5diff sparse_dense.h5 sparse_sparse.h5 /Block_0/$dat /Block_0/$dat
+    then
+        echo "$dat: the sparse and dense executions are identical"
+    else
+        echo "$dat: the sparse and dense executions differ"
+        status=1
+    fi
+done
+exit $status
@@ -47,6 +47,26 @@ const int BoundaryHaloNum() { return boundaryHaloPt; }
 void SetBoundaryHaloNum(const int boundaryHaloNum) {
     boundaryHaloPt = boundaryHaloNum;
 }
+int BNDRYGEOMETRY[NUMBNDRYGEOM]{
+    VG_IP,       VG_IM,       VG_JP,       VG_JM,       VG_KP,
+    VG_KM,       VG_IPJP_I,   VG_IPJM_I,   VG_IMJP_I,   VG_IMJM_I,
+    VG_IPJP_O,   VG_IPJM_O,   VG_IMJP_O,   VG_IMJM_O,   VG_IPKP_I,
+    VG_IPKM_I,   VG_IMKP_I,   VG_IMKM_I,   VG_JPKP_I,   VG_JPKM_I,
+    VG_JMKP_I,   VG_JMKM_I,   VG_IPKP_O,   VG_IPKM_O,   VG_IMKP_O,
+    VG_IMKM_O,   VG_JPKP_O,   VG_JPKM_O,   VG_JMKP_O,   VG_JMKM_O,
+    VG_IPJPKP_I, VG_IPJPKM_I, VG_IPJMKP_I, VG_IPJMKM_I, VG_IMJPKP_I,
+    VG_IMJPKM_I, VG_IMJMKP_I, VG_IMJMKM_I, VG_IPJPKP_O, VG_IPJPKM_O,
+    VG_IPJMKP_O, VG_IPJMKM_O, VG_IMJPKP_O, VG_IMJPKM_O, VG_IMJMKP_O,
+    VG_IMJMKM_O};
+int VERTEXTYPES[NUMVERTEXTYPES]{
+    Vertex_Fluid,               Vertex_ImmersedSolid,
+    Vertex_Boundary,            Vertex_ExtrapolPressure1ST,
+    Vertex_ExtrapolPressure2ND, Vertex_Periodic,
+    Vertex_BounceBackWall,      Vertex_FreeFlux,
+    Vertex_ZouHeVelocity,       Vertex_EQMDiffuseRefl,
+    Vertex_BoundaryCorner};
+int* BNDRYDVNUM{nullptr};
+int* BNDRYDV{nullptr};
 BndryDvType FindBdyDvType(const VertexGeometryTypes vg,
                           const Real* discreteVelocity) {
     Real cx = discreteVelocity[0];
@@ -942,4 +962,43 @@ void BoundaryNormal3D(const VertexGeometryTypes vg, int* unitNormal) {
         }
     }
 }
+
+void SetupBndryDvTables() {
+    const int numDvType{3};
+    if (nullptr == BNDRYDVNUM) {
+        BNDRYDVNUM = new int[NUMBNDRYGEOM * numDvType * NUMCOMPONENTS];
+    }
+    if (nullptr == BNDRYDV) {
+        BNDRYDV = new int[NUMBNDRYGEOM * numDvType * NUMXI];
+    }
+    for (int geomIdx = 0; geomIdx < NUMBNDRYGEOM; geomIdx++) {
+        const VertexGeometryTypes vg{
+            (VertexGeometryTypes)BNDRYGEOMETRY[geomIdx]};
+        for (int compoIdx = 0; compoIdx < NUMCOMPONENTS; compoIdx++) {
+            const int xiStart{COMPOINDEX[2 * compoIdx]};
+            for (int dvIdx = 0; dvIdx < numDvType; dvIdx++) {
+                BNDRYDVNUM[(geomIdx * numDvType + dvIdx) * NUMCOMPONENTS +
+                           compoIdx] = 0;
+            }
+            for (int xiIdx = xiStart; xiIdx <= COMPOINDEX[2 * compoIdx + 1];
+                 xiIdx++) {
+                const BndryDvType bdt{
+                    2 == LATTDIM ? FindBdyDvType(vg, &XI[xiIdx * LATTDIM])
+                                 : FindBdyDvType3D(vg, &XI[xiIdx * LATTDIM])};
+                if (BndryDv_Invalid != bdt) {
+                    const int row{geomIdx * numDvType + bdt - 1};
+                    int& num{BNDRYDVNUM[row * NUMCOMPONENTS + compoIdx]};
+                    BNDRYDV[row * NUMXI + xiStart + num] = xiIdx;
+                    num++;
+                }
+            }
+        }
+    }
+    ops_decl_const("BNDRYGEOMETRY", NUMBNDRYGEOM, "int", BNDRYGEOMETRY);
+    ops_decl_const("VERTEXTYPES", NUMVERTEXTYPES, "int", VERTEXTYPES);
+    ops_decl_const("BNDRYDVNUM", NUMBNDRYGEOM * numDvType * NUMCOMPONENTS,
+                   "int", BNDRYDVNUM);
+    ops_decl_const("BNDRYDV", NUMBNDRYGEOM * numDvType * NUMXI, "int",
+                   BNDRYDV);
+}
 #include "boundary_kernel.h"
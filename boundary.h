@@ -63,19 +63,110 @@ BndryDvType FindBdyDvType3D(const VertexGeometryTypes vg,
  */
 BndryDvType FindBdyDvType(const VertexGeometryTypes vg,
                           const Real* discreteVelocity);
+/*!
+ * The number of geometry types in BNDRYGEOMETRY
+ */
+const int NUMBNDRYGEOM{46};
+/*!
+ * The geometry types for which the discrete velocities are classified in
+ * advance, where the surfaces are put first as the most common ones
+ */
+extern int BNDRYGEOMETRY[NUMBNDRYGEOM];
+/*!
+ * The number of each type of discrete velocities for a geometry and a
+ * component, at (geomIdx*3+dvType-1)*NUMCOMPONENTS+compoIdx
+ */
+extern int* BNDRYDVNUM;
+/*!
+ * The indices of each type of discrete velocities for a geometry, the list of
+ * a component starts at (geomIdx*3+dvType-1)*NUMXI+COMPOINDEX[2*compoIdx]
+ */
+extern int* BNDRYDV;
+/*!
+ * Classify the discrete velocities by FindBdyDvType(3D) for each geometry type
+ * in BNDRYGEOMETRY, so that the boundary kernels iterate over the lists
+ * rather than classifying each velocity at each step.
+ * Called by DefineComponents.
+ */
+void SetupBndryDvTables();
+inline int BndryDvNum(const int geomIdx, const BndryDvType dvType,
+                      const int compoIdx) {
+    return geomIdx < 0
+               ? 0
+               : BNDRYDVNUM[(geomIdx * 3 + dvType - 1) * NUMCOMPONENTS +
+                            compoIdx];
+}
+inline const int* BndryDvList(const int geomIdx, const BndryDvType dvType,
+                              const int xiStart) {
+    return geomIdx < 0 ? BNDRYDV
+                       : &BNDRYDV[(geomIdx * 3 + dvType - 1) * NUMXI + xiStart];
+}
+/*!
+ * The number of vertex types in VERTEXTYPES
+ */
+const int NUMVERTEXTYPES{11};
+/*!
+ * The vertex types which can be packed into g_NodeFlag
+ */
+extern int VERTEXTYPES[NUMVERTEXTYPES];
+/*!
+ * The layout of a g_NodeFlag element, i.e., a node and a component
+ * Bits 0-3: the position of the vertex type in VERTEXTYPES
+ * Bits 4-9: one plus the position of the geometry property in BNDRYGEOMETRY,
+ * zero for the other geometry properties, e.g., VG_Fluid
+ * Bit 10: the node is collided, e.g., the fluid and ZouHe nodes
+ * Bit 11: the populations parallel to the boundary are streamed, e.g., the
+ * EQMDiffuseRefl and periodic nodes
+ * Bit 12: all the populations are streamed from the neighbours, i.e., a fluid
+ * node
+ */
+enum NodeFlagBits {
+    NodeFlag_TypeMask = 0xF,
+    NodeFlag_GeomShift = 4,
+    NodeFlag_GeomMask = 0x3F,
+    NodeFlag_Collide = 1 << 10,
+    NodeFlag_StreamParallel = 1 << 11,
+    NodeFlag_Bulk = 1 << 12
+};
+inline VertexTypes FlagVertexType(const short flag) {
+    return (VertexTypes)VERTEXTYPES[flag & NodeFlag_TypeMask];
+}
+inline bool IsVertexType(const short flag, const VertexTypes vt) {
+    return vt == FlagVertexType(flag);
+}
+/*!
+ * @return the position in BNDRYGEOMETRY, -1 if it is not a boundary geometry
+ */
+inline int FlagGeometryIndex(const short flag) {
+    return ((flag >> NodeFlag_GeomShift) & NodeFlag_GeomMask) - 1;
+}
+inline VertexGeometryTypes FlagGeometry(const short flag) {
+    const int geomIdx{FlagGeometryIndex(flag)};
+    return geomIdx < 0 ? VG_Fluid
+                       : (VertexGeometryTypes)BNDRYGEOMETRY[geomIdx];
+}
 #ifdef OPS_2D
+/*!
+ * @brief Pack g_NodeType and g_GeometryProperty into g_NodeFlag
+ * @param nodeType the vertex type of each component
+ * @param geometryProperty e.g., corner types
+ * @param nodeFlag see NodeFlagBits
+ */
+void KerPackNodeFlag(const int* nodeType, const int* geometryProperty,
+                     short* nodeFlag);
 // CutCell block boundary condition
 /*!
  * @brief  Equilibrium diffuse reflection boundary condition
  * @param givenMacroVars  specified velocity
- * @param nodeType if the current node is set to be EDR node
- * @param geometryProperty e.g., corner types
+ * @param nodeFlag the vertex type and the geometry, see NodeFlagBits
  * @param f distribution function
+ * @param componentId the component
+ * @param fLayout DistributionLayout of f, which alternates in the AA pattern
  * see Meng, Gu Emerson, Peng and Zhang, https://arxiv.org/abs/1803.00390.
  */
-void KerCutCellEQMDiffuseRefl(const Real* givenMacroVars, const int* nodeType,
-                              const int* geometryProperty, Real* f,
-                              const int* componentId);
+void KerCutCellEQMDiffuseRefl(const Real* givenMacroVars,
+                              const short* nodeFlag, Real* f,
+                              const int* componentId, const int* fLayout);
 void KerCutCellPeriodic(const int* nodeType, const int* geometryProperty,
                         Real* f);
 /*!
@@ -113,31 +204,39 @@ void KerCutCellEmbeddedBoundary(const int* nodeType,
 
 #endif /* OPS_2D  */
 #ifdef OPS_3D
+/*!
+ * @brief Pack g_NodeType and g_GeometryProperty into g_NodeFlag
+ * @param nodeType the vertex type of each component
+ * @param geometryProperty e.g., corner types
+ * @param nodeFlag see NodeFlagBits
+ */
+void KerPackNodeFlag3D(const int* nodeType, const int* geometryProperty,
+                       short* nodeFlag);
 // CutCell block boundary condition
 /*!
  * @brief First order extrapolation pressure flow boundary:3D
  * @param givenBoundaryVars specified pressure
- * @param nodeType if the current node is set to be pressure flow boundary node
- * @param geometryProperty e.g., corner types
+ * @param nodeFlag if the current node is set to be pressure flow boundary
+ * node, and its geometry property, e.g., corner types
  * @param f distribution
  */
 void KerCutCellExtrapolPressure1ST3D(const Real* givenBoundaryVars,
-                                     const int* nodeType,
-                                     const int* geometryProperty, Real* f);
+                                     const short* nodeFlag, FReal* f);
 /*!
  * @brief  Equilibrium diffuse reflection boundary condition: 3D
  * @param givenMacroVars  specified velocity
- * @param nodeType if the current node is set to be EDR node
- * @param geometryProperty e.g., corner types
+ * @param nodeFlag if the current node is set to be EDR node, and its geometry
+ * property, e.g., corner types
  * @param f distribution function
+ * @param componentId the component
+ * @param fLayout DistributionLayout of f, see KerCutCellEQMDiffuseRefl
  */
-void KerCutCellEQMDiffuseRefl3D(Real* f, const int* nodeType,
-                                const int* geometryProperty,
+void KerCutCellEQMDiffuseRefl3D(FReal* f, const short* nodeFlag,
                                 const Real* givenMacroVars,
-                                const int* componentId);
+                                const int* componentId, const int* fLayout);
 
-void KerCutCellPeriodic3D(Real* f, const int* nodeType,
-                          const int* geometryProperty, const int* componentId);
+void KerCutCellPeriodic3D(FReal* f, const short* nodeFlag,
+                          const int* componentId);
 #endif /* OPS_3D*/
 
 const int BoundaryHaloNum();
@@ -40,8 +40,70 @@
 // As we are using update-halo method for the discretisation,
 // we need to deal with halo points when treating boundary
 
+/*
+ * The g_NodeFlag element of a component from its vertex type and the code of
+ * its geometry property, i.e., one plus its position in BNDRYGEOMETRY
+ */
+inline short PackNodeFlag(const int vt, const int geomCode,
+                          const int compoIdx) {
+    int typeCode{-1};
+    for (int typeIdx = 0; typeIdx < NUMVERTEXTYPES; typeIdx++) {
+        if (vt == VERTEXTYPES[typeIdx]) {
+            typeCode = typeIdx;
+            break;
+        }
+    }
+#ifdef CPU
+    if (typeCode < 0) {
+        ops_printf(
+            "Error! The vertex type %i of the component %i cannot be "
+            "packed into g_NodeFlag!\n",
+            vt, compoIdx);
+        assert(typeCode >= 0);
+    }
+#endif
+    int flag{typeCode | (geomCode << NodeFlag_GeomShift)};
+    // the same vertex types as tested by the collision and stream
+    // kernels before the flags were packed
+    if (vt == Vertex_Fluid || vt == Vertex_ZouHeVelocity ||
+        vt == Vertex_EQMDiffuseRefl || vt == Vertex_ExtrapolPressure1ST ||
+        vt == Vertex_Periodic) {
+        flag |= NodeFlag_Collide;
+    }
+    if (vt == Vertex_EQMDiffuseRefl || vt == Vertex_ExtrapolPressure1ST ||
+        vt == Vertex_Periodic) {
+        flag |= NodeFlag_StreamParallel;
+    }
+    if (vt >= Vertex_Fluid && vt < Vertex_Boundary) {
+        flag |= NodeFlag_Bulk;
+    }
+    return (short)flag;
+}
+
+/*
+ * The code of a geometry property packed into g_NodeFlag, i.e., one plus its
+ * position in BNDRYGEOMETRY, or zero for the other geometry properties
+ */
+inline int GeometryCode(const int vg) {
+    for (int geomIdx = 0; geomIdx < NUMBNDRYGEOM; geomIdx++) {
+        if (vg == BNDRYGEOMETRY[geomIdx]) {
+            return geomIdx + 1;
+        }
+    }
+    return 0;
+}
+
 // Boundary conditions for two-dimensional problems
 #ifdef OPS_2D
+void KerPackNodeFlag(const int *nodeType, const int *geometryProperty,
+                     short *nodeFlag) {
+    const int geomCode{GeometryCode(geometryProperty[OPS_ACC1(0, 0)])};
+    for (int compoIdx = 0; compoIdx < NUMCOMPONENTS; compoIdx++) {
+        nodeFlag[OPS_ACC_MD2(compoIdx, 0, 0)] = PackNodeFlag(
+            nodeType[OPS_ACC_MD0(compoIdx, 0, 0)], geomCode, compoIdx);
+    }
+}
+
 void KerCutCellZeroFlux(const int *nodeType, const int *geometryProperty,
                         Real *f) {
     VertexTypes vt = (VertexTypes)nodeType[OPS_ACC0(0, 0)];
@@ -772,75 +834,73 @@ void KerCutCellBounceBack(const int *nodeType, const int *geometryProperty,
     }
 }
 
-void KerCutCellEQMDiffuseRefl(const Real *givenMacroVars, const int *nodeType,
-                              const int *geometryProperty, Real *f,
-                              const int *componentId) {
+void KerCutCellEQMDiffuseRefl(const Real *givenMacroVars,
+                              const short *nodeFlag, Real *f,
+                              const int *componentId, const int *fLayout) {
     // This kernel is suitable for a single-speed lattice
     // but only for the second-order expansion at this moment
     // Therefore, the equilibrium function order is fixed at 2
     const int equilibriumOrder{2};
-    VertexTypes vt = (VertexTypes)nodeType[OPS_ACC1(0, 0)];
-    if (vt == Vertex_EQMDiffuseRefl) {
-        VertexGeometryTypes vg =
-            (VertexGeometryTypes)geometryProperty[OPS_ACC2(0, 0)];
+    // under Layout_AASwapped, f_i of this node is stored at (OPP[i],x-c_i)
+    const bool swapped{Layout_AASwapped == *fLayout};
+    // for (int compoIdx = 0; compoIdx < NUMCOMPONENTS; compoIdx++) {
+    const int compoIdx{*componentId};
+    const short flag{nodeFlag[OPS_ACC_MD1(compoIdx, 0, 0)]};
+    if (IsVertexType(flag, Vertex_EQMDiffuseRefl)) {
         Real u = givenMacroVars[1];
         Real v = givenMacroVars[2];
-        // for (int compoIdx = 0; compoIdx < NUMCOMPONENTS; compoIdx++) {
-        const int compoIdx{*componentId};
-        int numOutgoing{0};
-        int numIncoming{0};
-        int numParallel{0};
-        int *outgoing = new int[COMPOINDEX[2 * compoIdx + 1] -
-                                COMPOINDEX[2 * compoIdx] + 1];
-        int *incoming = new int[COMPOINDEX[2 * compoIdx + 1] -
-                                COMPOINDEX[2 * compoIdx] + 1];
-        int *parallel = new int[COMPOINDEX[2 * compoIdx + 1] -
-                                COMPOINDEX[2 * compoIdx] + 1];
+        // the discrete velocities are classified in advance, see
+        // SetupBndryDvTables, and the geometry is packed into the node flag
+        const int xiStart{COMPOINDEX[2 * compoIdx]};
+        const int geomIdx{FlagGeometryIndex(flag)};
+        const int numIncoming{BndryDvNum(geomIdx, BndryDv_Incoming, compoIdx)};
+        const int numOutgoing{BndryDvNum(geomIdx, BndryDv_Outgoing, compoIdx)};
+        const int numParallel{BndryDvNum(geomIdx, BndryDv_Parallel, compoIdx)};
+        const int *incoming{BndryDvList(geomIdx, BndryDv_Incoming, xiStart)};
+        const int *outgoing{BndryDvList(geomIdx, BndryDv_Outgoing, xiStart)};
+        const int *parallel{BndryDvList(geomIdx, BndryDv_Parallel, xiStart)};
         Real rhoIncoming{0};
         Real rhoParallel{0};
         Real deltaRho{0};
-        for (int xiIdx = COMPOINDEX[2 * compoIdx];
-             xiIdx <= COMPOINDEX[2 * compoIdx + 1]; xiIdx++) {
-            BndryDvType bdt = FindBdyDvType(vg, &XI[xiIdx * LATTDIM]);
-            switch (bdt) {
-                case BndryDv_Incoming: {
-                    incoming[numIncoming] = xiIdx;
-                    rhoIncoming += f[OPS_ACC_MD3(xiIdx, 0, 0)];
-                    numIncoming++;
-                } break;
-                case BndryDv_Outgoing: {
-                    outgoing[numOutgoing] = xiIdx;
-                    Real cx{CS * XI[xiIdx * LATTDIM]};
-                    Real cy{CS * XI[xiIdx * LATTDIM + 1]};
-                    deltaRho += (2 * WEIGHTS[xiIdx]) * (cx * u + cy * v);
-                    numOutgoing++;
-                } break;
-                case BndryDv_Parallel: {
-                    parallel[numParallel] = xiIdx;
-                    rhoParallel +=
-                        CalcBGKFeq(xiIdx, 1, u, v, 1, equilibriumOrder);
-                    numParallel++;
-                } break;
-                default:
-                    break;
-            }
+        for (int idx = 0; idx < numIncoming; idx++) {
+            const int xiIdx{incoming[idx]};
+            const int cxi{(int)XI[xiIdx * LATTDIM]};
+            const int cyi{(int)XI[xiIdx * LATTDIM + 1]};
+            rhoIncoming += swapped ? f[OPS_ACC_MD3(OPP[xiIdx], -cxi, -cyi)]
+                                   : f[OPS_ACC_MD3(xiIdx, 0, 0)];
+        }
+        for (int idx = 0; idx < numOutgoing; idx++) {
+            const int xiIdx{outgoing[idx]};
+            Real cx{CS * XI[xiIdx * LATTDIM]};
+            Real cy{CS * XI[xiIdx * LATTDIM + 1]};
+            deltaRho += (2 * WEIGHTS[xiIdx]) * (cx * u + cy * v);
+        }
+        for (int idx = 0; idx < numParallel; idx++) {
+            rhoParallel +=
+                CalcBGKFeq(parallel[idx], 1, u, v, 1, equilibriumOrder);
         }
         Real rhoWall = 2 * rhoIncoming / (1 - deltaRho - rhoParallel);
         for (int idx = 0; idx < numParallel; idx++) {
-            f[OPS_ACC_MD3(parallel[idx], 0, 0)] =
-                CalcBGKFeq(parallel[idx], rhoWall, u, v, 1, equilibriumOrder);
+            const int xiIdx{parallel[idx]};
+            const int cxi{(int)XI[xiIdx * LATTDIM]};
+            const int cyi{(int)XI[xiIdx * LATTDIM + 1]};
+            const int pos{swapped ? OPS_ACC_MD3(OPP[xiIdx], -cxi, -cyi)
+                                  : OPS_ACC_MD3(xiIdx, 0, 0)};
+            f[pos] = CalcBGKFeq(xiIdx, rhoWall, u, v, 1, equilibriumOrder);
         }
         for (int idx = 0; idx < numOutgoing; idx++) {
             int xiIdx = outgoing[idx];
             Real cx{CS * XI[xiIdx * LATTDIM]};
             Real cy{CS * XI[xiIdx * LATTDIM + 1]};
-            f[OPS_ACC_MD3(xiIdx, 0, 0)] =
-                f[OPS_ACC_MD3(OPP[xiIdx], 0, 0)] +
-                2 * rhoWall * WEIGHTS[xiIdx] * (cx * u + cy * v);
+            const int cxi{(int)XI[xiIdx * LATTDIM]};
+            const int cyi{(int)XI[xiIdx * LATTDIM + 1]};
+            // f_OPP[i] of this node is at (i,x+c_i) under Layout_AASwapped
+            const int pos{swapped ? OPS_ACC_MD3(OPP[xiIdx], -cxi, -cyi)
+                                  : OPS_ACC_MD3(xiIdx, 0, 0)};
+            const int oppPos{swapped ? OPS_ACC_MD3(xiIdx, cxi, cyi)
+                                     : OPS_ACC_MD3(OPP[xiIdx], 0, 0)};
+            f[pos] = f[oppPos] + 2 * rhoWall * WEIGHTS[xiIdx] * (cx * u + cy * v);
         }
-        delete[] outgoing;
-        delete[] incoming;
-        delete[] parallel;
         //}
     } else {
 #ifdef debug
@@ -1198,13 +1258,21 @@ void KerCutCellZouHeVelocity(const Real *givenMacroVars, const int *nodeType,
 #endif
 // Boundary conditions for three-dimensional problems
 #ifdef OPS_3D
+void KerPackNodeFlag3D(const int *nodeType, const int *geometryProperty,
+                       short *nodeFlag) {
+    const int geomCode{GeometryCode(geometryProperty[OPS_ACC1(0, 0, 0)])};
+    for (int compoIdx = 0; compoIdx < NUMCOMPONENTS; compoIdx++) {
+        nodeFlag[OPS_ACC_MD2(compoIdx, 0, 0, 0)] = PackNodeFlag(
+            nodeType[OPS_ACC_MD0(compoIdx, 0, 0, 0)], geomCode, compoIdx);
+    }
+}
+
 void KerCutCellExtrapolPressure1ST3D(const Real *givenBoundaryVars,
-                                     const int *nodeType,
-                                     const int *geometryProperty, Real *f) {
-    VertexTypes vt = (VertexTypes)nodeType[OPS_ACC1(0, 0, 0)];
+                                     const short *nodeFlag, FReal *f) {
+    const short flag{nodeFlag[OPS_ACC1(0, 0, 0)]};
+    VertexTypes vt = FlagVertexType(flag);
     if (vt == Vertex_ExtrapolPressure1ST) {
-        VertexGeometryTypes vg =
-            (VertexGeometryTypes)geometryProperty[OPS_ACC2(0, 0, 0)];
+        VertexGeometryTypes vg = FlagGeometry(flag);
         Real rhoGiven = givenBoundaryVars[0];
         Real rho = 0;
         for (int xiIdx = 0; xiIdx < NUMXI; xiIdx++) {
@@ -1214,328 +1282,329 @@ void KerCutCellExtrapolPressure1ST3D(const Real *givenBoundaryVars,
             switch (vg) {
                 case VG_IP: {
                     if (cx > 0) {
-                        f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                            f[OPS_ACC_MD3(xiIdx, 1, 0, 0)];
+                        f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                            f[OPS_ACC_MD2(xiIdx, 1, 0, 0)];
                     }
                 } break;
                 case VG_IM: {
                     if (cx < 0) {
-                        f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                            f[OPS_ACC_MD3(xiIdx, -1, 0, 0)];
+                        f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                            f[OPS_ACC_MD2(xiIdx, -1, 0, 0)];
                     }
                 } break;
                 case VG_JP: {
                     if (cy > 0) {
-                        f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                            f[OPS_ACC_MD3(xiIdx, 0, 1, 0)];
+                        f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                            f[OPS_ACC_MD2(xiIdx, 0, 1, 0)];
                     }
                 } break;
                 case VG_JM: {
                     if (cy < 0) {
-                        f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                            f[OPS_ACC_MD3(xiIdx, 0, -1, 0)];
+                        f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                            f[OPS_ACC_MD2(xiIdx, 0, -1, 0)];
                     }
                 } break;
                 case VG_KP: {
                     if (cz > 0) {
-                        f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 1)];
+                        f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 1)];
                     }
                 } break;
                 case VG_KM: {
                     if (cz < 0) {
-                        f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, -1)];
+                        f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, -1)];
                     }
                 } break;
                 case VG_IPJP_I: {
                     if ((cx >= 0 && cy > 0) || (cx > 0 && cy == 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, 1, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 1, 0, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, 1, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 1, 0, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(1, 0, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 1, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(1, 0, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 1, 0)];
                         }
                     }
                 } break;
                 case VG_IPJM_I: {
                     if ((cx >= 0 && cy < 0) || (cx > 0 && cy == 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, -1, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 1, 0, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, -1, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 1, 0, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(1, 0, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, -1, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(1, 0, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, -1, 0)];
                         }
                     }
                 } break;
                 case VG_IMJP_I: {
                     if ((cx <= 0 && cy > 0) || (cx < 0 && cy == 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, 1, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, -1, 0, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, 1, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, -1, 0, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(-1, 0, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 1, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(-1, 0, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 1, 0)];
                         }
                     }
                 } break;
                 case VG_IMJM_I: {
                     if ((cx <= 0 && cy < 0) || (cx < 0 && cy == 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, -1, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, -1, 0, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, -1, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, -1, 0, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(-1, 0, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, -1, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(-1, 0, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, -1, 0)];
                         }
                     }
                 } break;
                 case VG_IPKP_I: {
                     if ((cx >= 0 && cz > 0) || (cx > 0 && cz == 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, 0, 1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 1, 0, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, 0, 1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 1, 0, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(1, 0, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 0, 1)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(1, 0, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 0, 1)];
                         }
                     }
                 } break;
                 case VG_IPKM_I: {
                     if ((cx >= 0 && cz < 0) || (cx > 0 && cz == 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, 0, -1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 1, 0, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, 0, -1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 1, 0, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(1, 0, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 0, -1)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(1, 0, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 0, -1)];
                         }
                     }
                 } break;
                 case VG_IMKP_I: {
                     if ((cx <= 0 && cz > 0) || (cx < 0 && cz == 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, 0, 1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, -1, 0, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, 0, 1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, -1, 0, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(-1, 0, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 0, 1)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(-1, 0, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 0, 1)];
                         }
                     }
                 } break;
                 case VG_IMKM_I: {
                     if ((cx <= 0 && cz < 0) || (cx < 0 && cz == 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, 0, -1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, -1, 0, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, 0, -1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, -1, 0, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(-1, 0, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 0, -1)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(-1, 0, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 0, -1)];
                         }
                     }
                 } break;
                 case VG_JPKP_I: {
                     if ((cy >= 0 && cz > 0) || (cy > 0 && cz == 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, 0, 1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 1, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, 0, 1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 1, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(0, 1, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 0, 1)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, 1, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 0, 1)];
                         }
                     }
                 } break;
                 case VG_JPKM_I: {
                     if ((cy >= 0 && cz < 0) || (cy > 0 && cz == 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, 0, -1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 1, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, 0, -1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 1, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(0, 1, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 0, -1)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, 1, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 0, -1)];
                         }
                     }
                 } break;
                 case VG_JMKP_I: {
                     if ((cy <= 0 && cz > 0) || (cy < 0 && cz == 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, 0, 1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, -1, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, 0, 1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, -1, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(0, -1, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 0, 1)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, -1, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 0, 1)];
                         }
                     }
                 } break;
                 case VG_JMKM_I: {
                     if ((cy <= 0 && cz < 0) || (cy < 0 && cz == 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, 0, -1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, -1, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, 0, -1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, -1, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(0, -1, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 0, -1)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, -1, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 0, -1)];
                         }
                     }
                 } break;
                 case VG_IPJPKP_I: {
                     if ((cx >= 0 && cy >= 0 && cz >= 0) &&
                         (cx != 0 || cy != 0 || cz != 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, 1, 1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 1, 0, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, 1, 1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 1, 0, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(1, 0, 1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 1, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(1, 0, 1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 1, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(1, 1, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 0, 1)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(1, 1, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 0, 1)];
                         }
                     }
                 } break;
                 case VG_IPJPKM_I: {
                     if ((cx >= 0 && cy >= 0 && cz <= 0) &&
                         (cx != 0 || cy != 0 || cz != 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, 1, -1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 1, 0, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, 1, -1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 1, 0, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(1, 0, -1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 1, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(1, 0, -1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 1, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(1, 1, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 0, -1)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(1, 1, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 0, -1)];
                         }
                     }
                 } break;
                 case VG_IPJMKP_I: {
                     if ((cx >= 0 && cy <= 0 && cz >= 0) &&
                         (cx != 0 || cy != 0 || cz != 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, -1, 1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 1, 0, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, -1, 1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 1, 0, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(1, 0, 1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, -1, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(1, 0, 1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, -1, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(1, -1, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 0, 1)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(1, -1, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 0, 1)];
                         }
                     }
                 } break;
                 case VG_IPJMKM_I: {
                     if ((cx >= 0 && cy <= 0 && cz <= 0) &&
                         (cx != 0 || cy != 0 || cz != 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, -1, -1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 1, 0, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, -1, -1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 1, 0, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(1, 0, -1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, -1, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(1, 0, -1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, -1, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(1, -1, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 0, -1)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(1, -1, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 0, -1)];
                         }
                     }
                 } break;
                 case VG_IMJPKP_I: {
                     if ((cx <= 0 && cy >= 0 && cz >= 0) &&
                         (cx != 0 || cy != 0 || cz != 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, 1, 1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, -1, 0, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, 1, 1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, -1, 0, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(-1, 0, 1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 1, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(-1, 0, 1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 1, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(-1, 1, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 0, 1)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(-1, 1, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 0, 1)];
                         }
                     }
                 } break;
                 case VG_IMJPKM_I: {
                     if ((cx <= 0 && cy >= 0 && cz <= 0) &&
                         (cx != 0 || cy != 0 || cz != 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, 1, -1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, -1, 0, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, 1, -1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, -1, 0, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(-1, 0, -1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 1, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(-1, 0, -1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 1, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(-1, 1, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 0, -1)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(-1, 1, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 0, -1)];
                         }
                     }
                 } break;
                 case VG_IMJMKP_I: {
                     if ((cx <= 0 && cy <= 0 && cz >= 0) &&
                         (cx != 0 || cy != 0 || cz != 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, -1, 1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, -1, 0, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, -1, 1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, -1, 0, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(-1, 0, 1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, -1, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(-1, 0, 1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, -1, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(-1, -1, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 0, 1)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(-1, -1, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 0, 1)];
                         }
                     }
                 } break;
                 case VG_IMJMKM_I: {
                     if ((cx <= 0 && cy <= 0 && cz <= 0) &&
                         (cx != 0 || cy != 0 || cz != 0)) {
-                        if (vt == nodeType[OPS_ACC1(0, -1, -1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, -1, 0, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(0, -1, -1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, -1, 0, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(-1, 0, -1)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, -1, 0)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(-1, 0, -1)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, -1, 0)];
                         }
-                        if (vt == nodeType[OPS_ACC1(-1, -1, 0)]) {
-                            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] =
-                                f[OPS_ACC_MD3(xiIdx, 0, 0, -1)];
+                        if (IsVertexType(nodeFlag[OPS_ACC1(-1, -1, 0)], vt)) {
+                            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] =
+                                f[OPS_ACC_MD2(xiIdx, 0, 0, -1)];
                         }
                     }
                 } break;
                 default:
                     break;
             }
-            rho += f[OPS_ACC_MD3(xiIdx, 0, 0, 0)];
+            rho += f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] + FOffset(xiIdx);
         }
         Real ratio = rhoGiven / rho;
         for (int xiIdx = 0; xiIdx < NUMXI; xiIdx++) {
-            f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] *= ratio;
+            const Real fi{f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] + FOffset(xiIdx)};
+            f[OPS_ACC_MD2(xiIdx, 0, 0, 0)] = fi * ratio - FOffset(xiIdx);
         }
 
     } else {
@@ -1547,19 +1616,19 @@ void KerCutCellExtrapolPressure1ST3D(const Real *givenBoundaryVars,
     }
 }
 
-void KerCutCellEQMDiffuseRefl3D(Real *f, const int *nodeType,
-                                const int *geometryProperty,
+void KerCutCellEQMDiffuseRefl3D(FReal *f, const short *nodeFlag,
                                 const Real *givenMacroVars,
-                                const int *componentId) {
+                                const int *componentId, const int *fLayout) {
     // This kernel is suitable for any single-speed lattice
     // but only for the second-order expansion at this moment
     // Therefore, the equilibrium function order is fixed at 2
     const int equilibriumOrder{2};
+    // under Layout_AASwapped, f_i of this node is stored at (OPP[i],x-c_i)
+    const bool swapped{Layout_AASwapped == *fLayout};
     const int compoIdx{*componentId};
-    VertexTypes vt = (VertexTypes)nodeType[OPS_ACC_MD1(compoIdx, 0, 0, 0)];
+    const short flag{nodeFlag[OPS_ACC_MD1(compoIdx, 0, 0, 0)]};
+    VertexTypes vt = FlagVertexType(flag);
     if (vt == Vertex_EQMDiffuseRefl) {
-        VertexGeometryTypes vg =
-            (VertexGeometryTypes)geometryProperty[OPS_ACC2(0, 0, 0)];
         Real u = givenMacroVars[1];
         Real v = givenMacroVars[2];
         Real w = givenMacroVars[3];
@@ -1568,50 +1637,44 @@ void KerCutCellEQMDiffuseRefl3D(Real *f, const int *nodeType,
         ops_printf(
             "KerCutCellEQMDiffuseRefl3D: We received the following "
             "conditions for the surface %i:\n",
-            geometryProperty[OPS_ACC2(0, 0, 0)]);
+            FlagGeometry(flag));
         ops_printf("U=%f, V=%f, W=%f for the component %i\n", u, v, w,
                    compoIdx);
 #endif
 #endif
-        int numOutgoing{0};
-        int numIncoming{0};
-        int numParallel{0};
-        int *outgoing = new int[COMPOINDEX[2 * compoIdx + 1] -
-                                COMPOINDEX[2 * compoIdx] + 1];
-        int *incoming = new int[COMPOINDEX[2 * compoIdx + 1] -
-                                COMPOINDEX[2 * compoIdx] + 1];
-        int *parallel = new int[COMPOINDEX[2 * compoIdx + 1] -
-                                COMPOINDEX[2 * compoIdx] + 1];
+        // the discrete velocities are classified in advance, see
+        // SetupBndryDvTables
+        const int xiStart{COMPOINDEX[2 * compoIdx]};
+        const int geomIdx{FlagGeometryIndex(flag)};
+        const int numIncoming{BndryDvNum(geomIdx, BndryDv_Incoming, compoIdx)};
+        const int numOutgoing{BndryDvNum(geomIdx, BndryDv_Outgoing, compoIdx)};
+        const int numParallel{BndryDvNum(geomIdx, BndryDv_Parallel, compoIdx)};
+        const int *incoming{BndryDvList(geomIdx, BndryDv_Incoming, xiStart)};
+        const int *outgoing{BndryDvList(geomIdx, BndryDv_Outgoing, xiStart)};
+        const int *parallel{BndryDvList(geomIdx, BndryDv_Parallel, xiStart)};
         Real rhoIncoming{0};
         Real rhoParallel{0};
         Real deltaRho{0};
-        for (int xiIdx = COMPOINDEX[2 * compoIdx];
-             xiIdx <= COMPOINDEX[2 * compoIdx + 1]; xiIdx++) {
+        for (int idx = 0; idx < numIncoming; idx++) {
+            const int xiIdx{incoming[idx]};
+            const int cxi{(int)XI[xiIdx * LATTDIM]};
+            const int cyi{(int)XI[xiIdx * LATTDIM + 1]};
+            const int czi{(int)XI[xiIdx * LATTDIM + 2]};
+            rhoIncoming +=
+                FOffset(xiIdx) +
+                (swapped ? f[OPS_ACC_MD0(OPP[xiIdx], -cxi, -cyi, -czi)]
+                         : f[OPS_ACC_MD0(xiIdx, 0, 0, 0)]);
+        }
+        for (int idx = 0; idx < numOutgoing; idx++) {
+            const int xiIdx{outgoing[idx]};
             Real cx{CS * XI[xiIdx * LATTDIM]};
             Real cy{CS * XI[xiIdx * LATTDIM + 1]};
             Real cz{CS * XI[xiIdx * LATTDIM + 2]};
-            BndryDvType bdt = FindBdyDvType3D(vg, &XI[xiIdx * LATTDIM]);
-            switch (bdt) {
-                case BndryDv_Incoming: {
-                    incoming[numIncoming] = xiIdx;
-                    rhoIncoming += f[OPS_ACC_MD0(xiIdx, 0, 0, 0)];
-                    numIncoming++;
-                } break;
-                case BndryDv_Outgoing: {
-                    outgoing[numOutgoing] = xiIdx;
-                    deltaRho +=
-                        (2 * WEIGHTS[xiIdx]) * (cx * u + cy * v + cz * w);
-                    numOutgoing++;
-                } break;
-                case BndryDv_Parallel: {
-                    parallel[numParallel] = xiIdx;
-                    rhoParallel +=
-                        CalcBGKFeq(xiIdx, 1, u, v, w, 1, equilibriumOrder);
-                    numParallel++;
-                } break;
-                default:
-                    break;
-            }
+            deltaRho += (2 * WEIGHTS[xiIdx]) * (cx * u + cy * v + cz * w);
+        }
+        for (int idx = 0; idx < numParallel; idx++) {
+            rhoParallel +=
+                CalcBGKFeq(parallel[idx], 1, u, v, w, 1, equilibriumOrder);
         }
         Real rhoWall = 2 * rhoIncoming / (1 - deltaRho - rhoParallel);
 #ifdef CPU
@@ -1620,19 +1683,36 @@ void KerCutCellEQMDiffuseRefl3D(Real *f, const int *nodeType,
 #endif
 #endif
         for (int idx = 0; idx < numParallel; idx++) {
-            f[OPS_ACC_MD0(parallel[idx], 0, 0, 0)] = CalcBGKFeq(
-                parallel[idx], rhoWall, u, v, w, 1, equilibriumOrder);
+            const int xiIdx{parallel[idx]};
+            const int cxi{(int)XI[xiIdx * LATTDIM]};
+            const int cyi{(int)XI[xiIdx * LATTDIM + 1]};
+            const int czi{(int)XI[xiIdx * LATTDIM + 2]};
+            const int pos{swapped
+                              ? OPS_ACC_MD0(OPP[xiIdx], -cxi, -cyi, -czi)
+                              : OPS_ACC_MD0(xiIdx, 0, 0, 0)};
+            f[pos] =
+                CalcBGKFeq(xiIdx, rhoWall, u, v, w, 1, equilibriumOrder) -
+                FOffset(xiIdx);
         }
         for (int idx = 0; idx < numOutgoing; idx++) {
             int xiIdx = outgoing[idx];
             Real cx{CS * XI[xiIdx * LATTDIM]};
             Real cy{CS * XI[xiIdx * LATTDIM + 1]};
             Real cz{CS * XI[xiIdx * LATTDIM + 2]};
-            f[OPS_ACC_MD0(xiIdx, 0, 0, 0)] =
-                f[OPS_ACC_MD0(OPP[xiIdx], 0, 0, 0)] +
-                2 * rhoWall * WEIGHTS[xiIdx] * (cx * u + cy * v + cz * w);
+            const int cxi{(int)XI[xiIdx * LATTDIM]};
+            const int cyi{(int)XI[xiIdx * LATTDIM + 1]};
+            const int czi{(int)XI[xiIdx * LATTDIM + 2]};
+            // f_OPP[i] of this node is at (i,x+c_i) under Layout_AASwapped
+            const int pos{swapped
+                              ? OPS_ACC_MD0(OPP[xiIdx], -cxi, -cyi, -czi)
+                              : OPS_ACC_MD0(xiIdx, 0, 0, 0)};
+            const int oppPos{swapped ? OPS_ACC_MD0(xiIdx, cxi, cyi, czi)
+                                     : OPS_ACC_MD0(OPP[xiIdx], 0, 0, 0)};
+            // the offsets of i and OPP[i] cancel, see FOffset
+            f[pos] = f[oppPos] +
+                     2 * rhoWall * WEIGHTS[xiIdx] * (cx * u + cy * v + cz * w);
 #ifdef CPU
-            const Real res{f[OPS_ACC_MD0(xiIdx, 0, 0, 0)]};
+            const Real res{f[pos] + FOffset(xiIdx)};
             if (isnan(res) || res <= 0 || isinf(res)) {
                 ops_printf(
                     "Error! Distribution function %f becomes "
@@ -1643,9 +1723,6 @@ void KerCutCellEQMDiffuseRefl3D(Real *f, const int *nodeType,
             }
 #endif
         }
-        delete[] outgoing;
-        delete[] incoming;
-        delete[] parallel;
         //}
     } else {
 #ifdef CPU
@@ -1658,15 +1735,15 @@ void KerCutCellEQMDiffuseRefl3D(Real *f, const int *nodeType,
     }
 }
 
-void KerCutCellPeriodic3D(Real *f, const int *nodeType,
-                          const int *geometryProperty, const int *componentId) {
+void KerCutCellPeriodic3D(FReal *f, const short *nodeFlag,
+                          const int *componentId) {
     const int compoId{*componentId};
-    VertexTypes vt = (VertexTypes)nodeType[OPS_ACC_MD1(compoId, 0, 0, 0)];
+    const short flag{nodeFlag[OPS_ACC_MD1(compoId, 0, 0, 0)]};
+    VertexTypes vt = FlagVertexType(flag);
     const int xiStartPos{COMPOINDEX[2 * compoId]};
     const int xiEndPos{COMPOINDEX[2 * compoId + 1]};
     if (vt == Vertex_Periodic) {
-        VertexGeometryTypes vg =
-            (VertexGeometryTypes)geometryProperty[OPS_ACC2(0, 0, 0)];
+        VertexGeometryTypes vg = FlagGeometry(flag);
         switch (vg) {
             case VG_IP:
                 for (int xiIndex = xiStartPos; xiIndex <= xiEndPos; xiIndex++) {
@@ -1707,7 +1784,7 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                 // There are only inner corners for block boundaries
             case VG_IPJP_I: {
                 // VG_IP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, 1, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 1, 0)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1715,7 +1792,7 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_JP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 1, 0, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 1, 0, 0)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1725,7 +1802,8 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
             } break;
             case VG_IPJM_I: {
                 // VG_IP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, -1, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, -1, 0)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1733,7 +1811,7 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_JM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 1, 0, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 1, 0, 0)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1743,7 +1821,7 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
             } break;
             case VG_IMJP_I: {
                 // VG_IM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, 1, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 1, 0)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1751,7 +1829,8 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_JP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, -1, 0, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, -1, 0, 0)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1761,7 +1840,8 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
             } break;
             case VG_IMJM_I: {
                 // VG_IM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, -1, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, -1, 0)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1769,7 +1849,8 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_JM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, -1, 0, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, -1, 0, 0)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1780,7 +1861,7 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
 
             case VG_IPKP_I: {
                 // VG_IP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, 1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, 1)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1788,7 +1869,7 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_KP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 1, 0, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 1, 0, 0)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1798,7 +1879,8 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
             } break;
             case VG_IPKM_I: {
                 // VG_IP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, -1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, -1)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1806,7 +1888,7 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_KM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 1, 0, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 1, 0, 0)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1816,7 +1898,7 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
             } break;
             case VG_IMKP_I: {
                 // VG_IM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, 1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, 1)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1824,7 +1906,8 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_KP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, -1, 0, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, -1, 0, 0)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1834,7 +1917,8 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
             } break;
             case VG_IMKM_I: {
                 // VG_IM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, -1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, -1)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1842,7 +1926,8 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_KM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, -1, 0, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, -1, 0, 0)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1852,7 +1937,7 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
             } break;
             case VG_JPKP_I: {
                 // VG_JP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, 1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, 1)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1860,7 +1945,7 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_KP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, 1, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 1, 0)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1870,7 +1955,8 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
             } break;
             case VG_JPKM_I: {
                 // VG_JP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, -1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, -1)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1878,7 +1964,7 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_KM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, 1, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 1, 0)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1888,7 +1974,7 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
             } break;
             case VG_JMKP_I: {
                 // VG_JM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, 1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, 1)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1896,7 +1982,8 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_KP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, -1, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, -1, 0)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1906,7 +1993,8 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
             } break;
             case VG_JMKM_I: {
                 // VG_JM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, -1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, -1)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1914,7 +2002,8 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_KM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, -1, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, -1, 0)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1924,8 +2013,8 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
             } break;
             case VG_IPJPKP_I: {
                 // VG_IP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, 1, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, 1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 1, 0)], vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, 1)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1933,8 +2022,8 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_JP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 1, 0, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, 1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 1, 0, 0)], vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, 1)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1942,8 +2031,8 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_KP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 1, 0, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 1, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 1, 0, 0)], vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 1, 0)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1953,8 +2042,9 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
             } break;
             case VG_IPJPKM_I: {
                 // VG_IP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, 1, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, -1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 1, 0)], vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, -1)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1962,8 +2052,9 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_JP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 1, 0, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, -1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 1, 0, 0)], vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, -1)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1971,8 +2062,8 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_KM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 1, 0, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 1, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 1, 0, 0)], vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 1, 0)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1982,8 +2073,9 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
             } break;
             case VG_IPJMKP_I: {
                 // VG_IP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, -1, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, 1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, -1, 0)],
+                                 vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, 1)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -1991,8 +2083,8 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_JM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 1, 0, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, 1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 1, 0, 0)], vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, 1)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -2000,8 +2092,9 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_KP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 1, 0, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, -1, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 1, 0, 0)], vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, -1, 0)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -2011,8 +2104,10 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
             } break;
             case VG_IPJMKM_I: {
                 // VG_IP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, -1, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, -1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, -1, 0)],
+                                 vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, -1)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -2020,8 +2115,9 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_JM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 1, 0, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, -1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 1, 0, 0)], vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, -1)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -2029,8 +2125,9 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_KM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 1, 0, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, -1, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 1, 0, 0)], vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, -1, 0)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -2040,8 +2137,8 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
             } break;
             case VG_IMJPKP_I: {
                 // VG_IM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, 1, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, 1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 1, 0)], vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, 1)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -2049,8 +2146,9 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_JP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, -1, 0, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, 1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, -1, 0, 0)],
+                                 vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, 1)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -2058,8 +2156,9 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_KP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, -1, 0, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 1, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, -1, 0, 0)],
+                                 vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 1, 0)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -2069,8 +2168,9 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
             } break;
             case VG_IMJPKM_I: {
                 // VG_IM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, 1, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, -1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 1, 0)], vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, -1)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -2078,8 +2178,10 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_JP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, -1, 0, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, -1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, -1, 0, 0)],
+                                 vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, -1)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -2087,8 +2189,9 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_KM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, -1, 0, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 1, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, -1, 0, 0)],
+                                 vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 1, 0)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -2098,8 +2201,9 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
             } break;
             case VG_IMJMKP_I: {
                 // VG_IM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, -1, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, 1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, -1, 0)],
+                                 vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, 1)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -2107,8 +2211,9 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_JM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, -1, 0, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, 1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, -1, 0, 0)],
+                                 vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, 1)], vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -2116,8 +2221,10 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_KP
-                if (vt == nodeType[OPS_ACC_MD1(compoId, -1, 0, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, -1, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, -1, 0, 0)],
+                                 vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, -1, 0)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -2128,8 +2235,10 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
             } break;
             case VG_IMJMKM_I: {
                 // VG_IM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, 0, -1, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, -1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, -1, 0)],
+                                 vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, -1)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -2137,8 +2246,10 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_JM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, -1, 0, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, 0, -1)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, -1, 0, 0)],
+                                 vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, 0, -1)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -2146,8 +2257,10 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
                     }
                 }
                 // VG_KM
-                if (vt == nodeType[OPS_ACC_MD1(compoId, -1, 0, 0)] &&
-                    vt == nodeType[OPS_ACC_MD1(compoId, 0, -1, 0)]) {
+                if (IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, -1, 0, 0)],
+                                 vt) &&
+                    IsVertexType(nodeFlag[OPS_ACC_MD1(compoId, 0, -1, 0)],
+                                 vt)) {
                     for (int xiIndex = xiStartPos; xiIndex <= xiEndPos;
                          xiIndex++) {
                         f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
@@ -2162,13 +2275,14 @@ void KerCutCellPeriodic3D(Real *f, const int *nodeType,
         for (int xiIndex = xiStartPos; xiIndex <= xiEndPos; xiIndex++) {
             f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] =
                 f[OPS_ACC_MD0(xiIndex, -1, 0, 0)];
-            const Real res{f[OPS_ACC_MD0(xiIndex, 0, 0, 0)]};
+            const Real res{f[OPS_ACC_MD0(xiIndex, 0, 0, 0)] +
+                           FOffset(xiIndex)};
             if (isnan(res) || res <= 0 || isinf(res)) {
                 ops_printf(
                     "Error! Distribution function %f becomes "
                     "invalid for the component %i at the lattice "
                     "%i\n at the surface %i\n",
-                    res, compoId, xiIndex, geometryProperty[OPS_ACC2(0, 0, 0)]);
+                    res, compoId, xiIndex, vg);
                 assert(!(isnan(res) || res <= 0 || isinf(res)));
             }
         }
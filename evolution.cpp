@@ -60,13 +60,24 @@ void UpdateTau() {
                                  LOCALSTENCIL, "double", OPS_READ),
                      ops_arg_dat(g_Tau[blockIndex], NUMCOMPONENTS, LOCALSTENCIL,
                                  "double", OPS_RW));
+        CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(int) +
+                        (NUMMACROVAR + 2 * NUMCOMPONENTS) * sizeof(Real));
     }
 }
 
 void Collision() {
+    // the kernel specialised for the lattice if available
+    auto collide = KerCollide;
+    switch (SpecialisedLattice()) {
+        case Lattice_D2Q9:
+            collide = KerCollideLattice<LatticeD2Q9>;
+            break;
+        default:
+            break;
+    }
     for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
         int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
-        ops_par_loop(KerCollide, "KerCollide", g_Block[blockIndex], SPACEDIM,
+        ops_par_loop(collide, "KerCollide", g_Block[blockIndex], SPACEDIM,
                      iterRng, ops_arg_gbl(pTimeStep(), 1, "double", OPS_READ),
                      ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
                                  LOCALSTENCIL, "int", OPS_READ),
@@ -80,13 +91,102 @@ void Collision() {
                                  "double", OPS_READ),
                      ops_arg_dat(g_fStage[blockIndex], NUMXI, LOCALSTENCIL,
                                  "double", OPS_WRITE));
+        CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(int) +
+                        (4 * NUMXI + NUMCOMPONENTS) * sizeof(Real));
+    }
+}
+
+void CollisionOnTheFly() {
+    for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+        int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
+        ops_par_loop(KerCollideOnTheFly, "KerCollideOnTheFly",
+                     g_Block[blockIndex], SPACEDIM, iterRng,
+                     ops_arg_gbl(pTimeStep(), 1, "double", OPS_READ),
+                     ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
+                                 LOCALSTENCIL, "int", OPS_READ),
+                     ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL, "double",
+                                 OPS_READ),
+                     ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
+                                 LOCALSTENCIL, "double", OPS_READ),
+                     ops_arg_dat(g_Tau[blockIndex], NUMCOMPONENTS, LOCALSTENCIL,
+                                 "double", OPS_READ),
+                     ops_arg_dat(g_fStage[blockIndex], NUMXI, LOCALSTENCIL,
+                                 "double", OPS_WRITE));
+        CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(int) +
+                        (2 * NUMXI + NUMMACROVAR + NUMCOMPONENTS) *
+                            sizeof(Real));
+    }
+}
+
+void CollisionFused() {
+    for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+        int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
+        ops_par_loop(KerCollideFused, "KerCollideFused", g_Block[blockIndex],
+                     SPACEDIM, iterRng,
+                     ops_arg_gbl(pTimeStep(), 1, "double", OPS_READ),
+                     ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
+                                 LOCALSTENCIL, "int", OPS_READ),
+                     ops_arg_gbl(TauRef(), NUMCOMPONENTS, "double", OPS_READ),
+                     ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL, "double",
+                                 OPS_READ),
+                     ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
+                                 LOCALSTENCIL, "double", OPS_RW),
+                     ops_arg_dat(g_fStage[blockIndex], NUMXI, LOCALSTENCIL,
+                                 "double", OPS_WRITE));
+        CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(int) +
+                        (2 * NUMXI + 2 * NUMMACROVAR) * sizeof(Real));
+    }
+}
+
+void CollisionAAEven() {
+    for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+        int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
+        ops_par_loop(KerCollideAAEven, "KerCollideAAEven", g_Block[blockIndex],
+                     SPACEDIM, iterRng,
+                     ops_arg_gbl(pTimeStep(), 1, "double", OPS_READ),
+                     ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
+                                 LOCALSTENCIL, "int", OPS_READ),
+                     ops_arg_gbl(TauRef(), NUMCOMPONENTS, "double", OPS_READ),
+                     ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL, "double",
+                                 OPS_RW),
+                     ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
+                                 LOCALSTENCIL, "double", OPS_RW));
+        CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(int) +
+                        (2 * NUMXI + 2 * NUMMACROVAR) * sizeof(Real));
+    }
+}
+
+void StreamCollideAAOdd() {
+    for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+        int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
+        ops_par_loop(KerStreamCollideAAOdd, "KerStreamCollideAAOdd",
+                     g_Block[blockIndex], SPACEDIM, iterRng,
+                     ops_arg_gbl(pTimeStep(), 1, "double", OPS_READ),
+                     ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
+                                 LOCALSTENCIL, "int", OPS_READ),
+                     ops_arg_gbl(TauRef(), NUMCOMPONENTS, "double", OPS_READ),
+                     ops_arg_dat(g_f[blockIndex], NUMXI, ONEPTLATTICESTENCIL,
+                                 "double", OPS_RW),
+                     ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
+                                 LOCALSTENCIL, "double", OPS_RW));
+        CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(int) +
+                        (2 * NUMXI + 2 * NUMMACROVAR) * sizeof(Real));
     }
 }
 
 void Stream() {
+    // the kernel specialised for the lattice if available
+    auto stream = KerStream;
+    switch (SpecialisedLattice()) {
+        case Lattice_D2Q9:
+            stream = KerStreamLattice<LatticeD2Q9>;
+            break;
+        default:
+            break;
+    }
     for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
         int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
-        ops_par_loop(KerStream, "KerStream", g_Block[blockIndex], SPACEDIM,
+        ops_par_loop(stream, "KerStream", g_Block[blockIndex], SPACEDIM,
                      iterRng,
                      ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
                                  LOCALSTENCIL, "int", OPS_READ),
@@ -96,6 +196,8 @@ void Stream() {
                                  ONEPTLATTICESTENCIL, "double", OPS_READ),
                      ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL, "double",
                                  OPS_RW));
+        CountBytesMoved(iterRng, (NUMCOMPONENTS + 1) * sizeof(int) +
+                        3 * NUMXI * sizeof(Real));
     }
 }
 
@@ -110,13 +212,26 @@ void UpdateMacroVars() {
                                  OPS_READ),
                      ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
                                  LOCALSTENCIL, "double", OPS_RW));
+        CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(int) +
+                        (NUMXI + 2 * NUMMACROVAR) * sizeof(Real));
     }
 }
 
 void UpdateFeqandBodyforce() {
+    // the kernel specialised for the lattice if available
+    auto calcFeq = KerCalcFeq;
+    if (IsothermalModel()) {
+        switch (SpecialisedLattice()) {
+            case Lattice_D2Q9:
+                calcFeq = KerCalcFeqLattice<LatticeD2Q9>;
+                break;
+            default:
+                break;
+        }
+    }
     for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
         int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
-        ops_par_loop(KerCalcFeq, "KerCalcPolyFeq", g_Block[blockIndex],
+        ops_par_loop(calcFeq, "KerCalcPolyFeq", g_Block[blockIndex],
                      SPACEDIM, iterRng,
                      ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
                                  LOCALSTENCIL, "int", OPS_READ),
@@ -124,6 +239,8 @@ void UpdateFeqandBodyforce() {
                                  LOCALSTENCIL, "double", OPS_READ),
                      ops_arg_dat(g_feq[blockIndex], NUMXI, LOCALSTENCIL,
                                  "double", OPS_RW));
+        CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(int) +
+                        (NUMMACROVAR + 2 * NUMXI) * sizeof(Real));
         // force term to be added
     }
 }
@@ -132,6 +249,13 @@ void TreatDomainBoundary(const int blockIndex, const int componentID,
                          const Real* givenVars, int* range,
                          const VertexTypes boundaryType)
 {
+    const int fLayout{FLayout()};
+    if (Layout_AASwapped == fLayout && Vertex_EQMDiffuseRefl != boundaryType) {
+        ops_printf(
+            "Error! Only the EQMDiffuseRefl boundary condition is supported "
+            "by the AA stream-collision scheme at this moment!\n");
+        assert(Vertex_EQMDiffuseRefl == boundaryType);
+    }
     switch (boundaryType) {
         case Vertex_ExtrapolPressure1ST: {
             ops_par_loop(
@@ -173,17 +297,30 @@ void TreatDomainBoundary(const int blockIndex, const int componentID,
                             "double", OPS_RW));
         } break;
         case Vertex_EQMDiffuseRefl: {
-            ops_par_loop(
-                KerCutCellEQMDiffuseRefl, "KerCutCellEQMDiffuseRefl",
-                g_Block[blockIndex], SPACEDIM, range,
-                ops_arg_gbl(givenVars, NUMMACROVAR, "double", OPS_READ),
-                ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS, LOCALSTENCIL,
-                            "int", OPS_READ),
-                ops_arg_dat(g_GeometryProperty[blockIndex], 1, LOCALSTENCIL,
-                            "int", OPS_READ),
-                ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL, "double",
-                            OPS_RW),
-                ops_arg_gbl(&componentID, 1, "int", OPS_READ));
+            if (Layout_AASwapped == fLayout) {
+                // f of a boundary node is spread over its neighbours
+                ops_par_loop(
+                    KerCutCellEQMDiffuseRefl, "KerCutCellEQMDiffuseRefl",
+                    g_Block[blockIndex], SPACEDIM, range,
+                    ops_arg_gbl(givenVars, NUMMACROVAR, "double", OPS_READ),
+                    ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                LOCALSTENCIL, "short", OPS_READ),
+                    ops_arg_dat(g_f[blockIndex], NUMXI, ONEPTLATTICESTENCIL,
+                                "double", OPS_RW),
+                    ops_arg_gbl(&componentID, 1, "int", OPS_READ),
+                    ops_arg_gbl(&fLayout, 1, "int", OPS_READ));
+            } else {
+                ops_par_loop(
+                    KerCutCellEQMDiffuseRefl, "KerCutCellEQMDiffuseRefl",
+                    g_Block[blockIndex], SPACEDIM, range,
+                    ops_arg_gbl(givenVars, NUMMACROVAR, "double", OPS_READ),
+                    ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                LOCALSTENCIL, "short", OPS_READ),
+                    ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL,
+                                "double", OPS_RW),
+                    ops_arg_gbl(&componentID, 1, "int", OPS_READ),
+                    ops_arg_gbl(&fLayout, 1, "int", OPS_READ));
+            }
         } break;
         case Vertex_FreeFlux: {
             ops_par_loop(KerCutCellZeroFlux, "KerCutCellZeroFlux",
@@ -212,19 +349,64 @@ void TreatDomainBoundary(const int blockIndex, const int componentID,
 
 void TreatEmbeddedBoundary() {
     for (int blockIdx = 0; blockIdx < BlockNum(); blockIdx++) {
-        int* iterRng = BlockIterRng(blockIdx, IterRngBulk());
-        ops_par_loop(
-            KerCutCellEmbeddedBoundary, "KerCutCellImmersedBoundary",
-            g_Block[blockIdx], SPACEDIM, iterRng,
-            ops_arg_dat(g_NodeType[blockIdx], NUMCOMPONENTS, LOCALSTENCIL,
-                        "int", OPS_READ),
-            ops_arg_dat(g_GeometryProperty[blockIdx], 1, LOCALSTENCIL, "int",
-                        OPS_READ),
-            ops_arg_dat(g_f[blockIdx], NUMXI, LOCALSTENCIL, "double", OPS_RW));
+        // only the rows of surface nodes found by HandleImmersedSolid
+        for (auto& typeRng : EmbeddedBoundaryRng(blockIdx)) {
+            if (Layout_AASwapped == FLayout()) {
+                ops_printf(
+                    "Error! The embedded boundary is not supported by the AA "
+                    "stream-collision scheme at this moment!\n");
+                assert(Layout_Natural == FLayout());
+            }
+            std::vector<int>& rowRng = typeRng.second;
+            for (int rngIdx = 0; rngIdx < (int)rowRng.size();
+                 rngIdx += 2 * SPACEDIM) {
+                int* iterRng = &rowRng[rngIdx];
+                ops_par_loop(KerCutCellEmbeddedBoundary,
+                             "KerCutCellImmersedBoundary", g_Block[blockIdx],
+                             SPACEDIM, iterRng,
+                             ops_arg_dat(g_NodeType[blockIdx], NUMCOMPONENTS,
+                                         LOCALSTENCIL, "int", OPS_READ),
+                             ops_arg_dat(g_GeometryProperty[blockIdx], 1,
+                                         LOCALSTENCIL, "int", OPS_READ),
+                             ops_arg_dat(g_f[blockIdx], NUMXI, LOCALSTENCIL,
+                                         "double", OPS_RW));
+                CountBytesMoved(iterRng, (NUMCOMPONENTS + 1) * sizeof(int) +
+                                             2 * NUMXI * sizeof(Real));
+            }
+        }
     }
 }
 //TODO This function needs to be improved for different initialisation scheme
+void PackNodeFlags() {
+    for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+        int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
+        ops_par_loop(KerPackNodeFlag, "KerPackNodeFlag", g_Block[blockIndex],
+                     SPACEDIM, iterRng,
+                     ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
+                                 LOCALSTENCIL, "int", OPS_READ),
+                     ops_arg_dat(g_GeometryProperty[blockIndex], 1,
+                                 LOCALSTENCIL, "int", OPS_READ),
+                     ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                 LOCALSTENCIL, "short", OPS_WRITE));
+    }
+}
+
 void InitialiseSolution() {
+    if (FeqOnTheFly()) {
+        // g_feq is not available so the equilibrium goes to g_f directly
+        for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+            int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
+            ops_par_loop(KerCalcFeq, "KerCalcPolyFeq", g_Block[blockIndex],
+                         SPACEDIM, iterRng,
+                         ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
+                                     LOCALSTENCIL, "int", OPS_READ),
+                         ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
+                                     LOCALSTENCIL, "double", OPS_READ),
+                         ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL,
+                                     "double", OPS_RW));
+        }
+        return;
+    }
     UpdateFeqandBodyforce();
     for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
         int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
@@ -246,54 +428,24 @@ void CopyDistribution(const ops_dat* fSrc, ops_dat* fDest) {
                                  "double", OPS_READ),
                      ops_arg_dat(fDest[blockIndex], NUMXI, LOCALSTENCIL,
                                  "double", OPS_WRITE));
+        CountBytesMoved(iterRng, 2 * NUMXI * sizeof(Real));
     }
 }
 
 void CalcResidualError() {
-    for (int macroVarIdx = 0; macroVarIdx < MacroVarsNum(); macroVarIdx++) {
-        for (int blockIdx = 0; blockIdx < BlockNum(); blockIdx++) {
-            int* iterRng = BlockIterRng(blockIdx, IterRngWhole());
-            ops_par_loop(KerCalcMacroVarSquareofDifference,
-                         "KerCalcMacroVarSquareofDifference", g_Block[blockIdx],
-                         SPACEDIM, iterRng,
-                         ops_arg_dat(g_MacroVars[blockIdx], NUMMACROVAR,
-                                     LOCALSTENCIL, "double", OPS_READ),
-                         ops_arg_dat(g_MacroVarsCopy[blockIdx], NUMMACROVAR,
-                                     LOCALSTENCIL, "double", OPS_READ),
-                         ops_arg_gbl(&macroVarIdx, 1, "int", OPS_READ),
-                         ops_arg_reduce(g_ResidualErrorHandle[macroVarIdx], 1,
-                                        "double", OPS_INC));
-        }
-    }
-    for (int macroVarIdx = 0; macroVarIdx < MacroVarsNum(); macroVarIdx++) {
-        ops_reduction_result(g_ResidualErrorHandle[macroVarIdx],
-                             (double*)&g_ResidualError[2 * macroVarIdx]);
-    }
+    // all the variables are reduced by one sweep and one reduction handle
     for (int blockIdx = 0; blockIdx < BlockNum(); blockIdx++) {
         int* iterRng = BlockIterRng(blockIdx, IterRngWhole());
-        ops_par_loop(KerCopyMacroVars, "KerCopyMacroVars", g_Block[blockIdx],
-                     SPACEDIM, iterRng,
+        ops_par_loop(KerCalcMacroVarResidual, "KerCalcMacroVarResidual",
+                     g_Block[blockIdx], SPACEDIM, iterRng,
                      ops_arg_dat(g_MacroVars[blockIdx], NUMMACROVAR,
                                  LOCALSTENCIL, "double", OPS_READ),
                      ops_arg_dat(g_MacroVarsCopy[blockIdx], NUMMACROVAR,
-                                 LOCALSTENCIL, "double", OPS_RW));
-    }
-    for (int macroVarIdx = 0; macroVarIdx < MacroVarsNum(); macroVarIdx++) {
-        for (int blockIdx = 0; blockIdx < BlockNum(); blockIdx++) {
-            int* iterRng = BlockIterRng(blockIdx, IterRngWhole());
-            ops_par_loop(KerCalcMacroVarSquare, "KerCalcMacroVarSquare",
-                         g_Block[blockIdx], SPACEDIM, iterRng,
-                         ops_arg_dat(g_MacroVars[blockIdx], NUMMACROVAR,
-                                     LOCALSTENCIL, "double", OPS_READ),
-                         ops_arg_gbl(&macroVarIdx, 1, "int", OPS_READ),
-                         ops_arg_reduce(g_ResidualErrorHandle[macroVarIdx], 1,
-                                        "double", OPS_INC));
-        }
-    }
-    for (int macroVarIdx = 0; macroVarIdx < MacroVarsNum(); macroVarIdx++) {
-        ops_reduction_result(g_ResidualErrorHandle[macroVarIdx],
-                             (double*)&g_ResidualError[2 * macroVarIdx + 1]);
+                                 LOCALSTENCIL, "double", OPS_RW),
+                     ops_arg_reduce(g_ResidualErrorHandle, 2 * NUMMACROVAR,
+                                    "double", OPS_INC));
     }
+    ops_reduction_result(g_ResidualErrorHandle, (double*)g_ResidualError);
 }
 
 void ForwardEuler() {
@@ -333,8 +485,8 @@ void ForwardEuler() {
     }
 }
 
-void DispResidualError(const int iter, const Real checkPeriod) {
-    ops_printf("##########Residual Error at %i time step##########\n", iter);
+void DispResidualError(const long iter, const Real checkPeriod) {
+    ops_printf("##########Residual Error at %li time step##########\n", iter);
     for (int macroVarIdx = 0; macroVarIdx < MacroVarsNum(); macroVarIdx++) {
         Real residualError = g_ResidualError[2 * macroVarIdx] /
                              g_ResidualError[2 * macroVarIdx + 1] /
@@ -348,20 +500,43 @@ void DispResidualError(const int iter, const Real checkPeriod) {
 //TODO Shall we introduce debug information mechanism similar to 3D version?
 void StreamCollision() {
     UpdateMacroVars();
-    CopyDistribution(g_f, g_fStage);
-    UpdateFeqandBodyforce();
-    UpdateTau();
-    Collision();
+    if (FeqOnTheFly()) {
+        UpdateTau();
+        CollisionOnTheFly();
+    } else {
+        UpdateFeqandBodyforce();
+        UpdateTau();
+        Collision();
+    }
+    TransferPopulationHalos();
     Stream();
     ImplementBoundaryConditions();
 }
 
+void StreamCollisionFused() {
+    CollisionFused();
+    TransferPopulationHalos();
+    Stream();
+    ImplementBoundaryConditions();
+}
+
+void StreamCollisionAA() {
+    if (Layout_Natural == FLayout()) {
+        CollisionAAEven();
+        SetFLayout(Layout_AASwapped);
+    } else {
+        StreamCollideAAOdd();
+        SetFLayout(Layout_Natural);
+    }
+    ImplementBoundaryConditions();
+}
+
 void TimeMarching() {
     UpdateMacroVars();
     UpdateFeqandBodyforce();
     UpdateTau();
     ForwardEuler();
     //ops_halo_transfer(HaloGroups);
-    ImplementBoundary();
+    ImplementBoundaryConditions();
 }
 #endif /* OPS_2D */
\ No newline at end of file
@@ -60,21 +60,49 @@
 // Routines for the stream-collision scheme.
 void Stream();
 void Collision();
+/*!
+ * Collision with the equilibrium calculated on the fly
+ */
+void CollisionOnTheFly();
 void CalcResidualError();
 /*!
  * Routine for completing one full time step
  */
 void StreamCollision();
+/*!
+ * Routine for completing one full time step with the fused collision kernel
+ */
+void CollisionFused();
+void StreamCollisionFused();
+/*!
+ * Routine for completing one full time step with the AA pattern, see
+ * StreamCollisionAA3D
+ */
+void CollisionAAEven();
+void StreamCollideAAOdd();
+void StreamCollisionAA();
 // Routines for the general finite-difference scheme.
 void UpdateBoundary();
 void TimeMarching();
 // Common routines
 void InitialiseSolution();
+/*!
+ * Pack g_NodeType and g_GeometryProperty into g_NodeFlag, so that the
+ * boundary kernels index the classified discrete velocities by the packed
+ * geometry rather than searching BNDRYGEOMETRY at each step. Called again by
+ * Iterate as the node types may be changed after the initialisation.
+ */
+void PackNodeFlags();
 void UpdateMacroVars();
 void UpdateTau();
 void UpdateFeqandBodyforce();
 void CopyDistribution(const ops_dat *fSrc, ops_dat *fDest);
-void DispResidualError(const int iter, const Real timePeriod);
+void DispResidualError(const long iter, const Real timePeriod);
+/*!
+ * Treat the surface of embedded bodies, only at the nodes recorded by
+ * HandleImmersedSolid
+ */
+void TreatEmbeddedBoundary();
 void TreatDomainBoundary(const int blockIndex, const int componentID,
                          const Real *givenVars, int *range,
                          const VertexTypes boundaryType);
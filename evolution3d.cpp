@@ -50,104 +50,314 @@
 #ifdef OPS_3D
 void UpdateTau3D() {
     for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
-        int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
-        ops_par_loop(KerCalcTau3D, "KerCalcTau3D", g_Block[blockIndex],
-                     SPACEDIM, iterRng,
-                     ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
-                                 LOCALSTENCIL, "int", OPS_READ),
-                     ops_arg_gbl(TauRef(), NUMCOMPONENTS, "double", OPS_READ),
-                     ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
-                                 LOCALSTENCIL, "double", OPS_READ),
-                     ops_arg_dat(g_Tau[blockIndex], NUMCOMPONENTS, LOCALSTENCIL,
-                                 "double", OPS_RW));
+        for (int rngIdx = 0; rngIdx < ActiveRngNum(blockIndex); rngIdx++) {
+            int* iterRng = ActiveRng(blockIndex, rngIdx);
+            ops_par_loop(KerCalcTau3D, "KerCalcTau3D", g_Block[blockIndex],
+                         SPACEDIM, iterRng,
+                         ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                     LOCALSTENCIL, "short", OPS_READ),
+                         ops_arg_gbl(TauRef(), NUMCOMPONENTS, "double",
+                                     OPS_READ),
+                         ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
+                                     LOCALSTENCIL, "double", OPS_READ),
+                         ops_arg_dat(g_Tau[blockIndex], NUMCOMPONENTS,
+                                     LOCALSTENCIL, "double", OPS_RW));
+            CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(short) +
+                            (NUMMACROVAR + 2 * NUMCOMPONENTS) * sizeof(Real));
+        }
     }
 }
 
 void Collision3D() {
+    // the kernel specialised for the lattice if available
+    auto collide = KerCollide3D;
+    switch (SpecialisedLattice()) {
+        case Lattice_D3Q15:
+            collide = KerCollideLattice3D<LatticeD3Q15>;
+            break;
+        case Lattice_D3Q19:
+            collide = KerCollideLattice3D<LatticeD3Q19>;
+            break;
+        default:
+            break;
+    }
     for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
-        int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
-        ops_par_loop(KerCollide3D, "KerCollide3D", g_Block[blockIndex],
-                     SPACEDIM, iterRng,
-                     ops_arg_gbl(pTimeStep(), 1, "double", OPS_READ),
-                     ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
-                                 LOCALSTENCIL, "int", OPS_READ),
-                     ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL, "double",
-                                 OPS_READ),
-                     ops_arg_dat(g_feq[blockIndex], NUMXI, LOCALSTENCIL,
-                                 "double", OPS_READ),
-                     ops_arg_dat(g_Tau[blockIndex], NUMCOMPONENTS, LOCALSTENCIL,
-                                 "double", OPS_READ),
-                     ops_arg_dat(g_Bodyforce[blockIndex], NUMXI, LOCALSTENCIL,
-                                 "double", OPS_READ),
-                     ops_arg_dat(g_fStage[blockIndex], NUMXI, LOCALSTENCIL,
-                                 "double", OPS_WRITE));
+        for (int rngIdx = 0; rngIdx < ActiveRngNum(blockIndex); rngIdx++) {
+            int* iterRng = ActiveRng(blockIndex, rngIdx);
+            ops_par_loop(collide, "KerCollide3D", g_Block[blockIndex],
+                         SPACEDIM, iterRng,
+                         ops_arg_gbl(pTimeStep(), 1, "double", OPS_READ),
+                         ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                     LOCALSTENCIL, "short", OPS_READ),
+                         ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL,
+                                     FRealC, OPS_READ),
+                         ops_arg_dat(g_feq[blockIndex], NUMXI, LOCALSTENCIL,
+                                     FRealC, OPS_READ),
+                         ops_arg_dat(g_Tau[blockIndex], NUMCOMPONENTS,
+                                     LOCALSTENCIL, "double", OPS_READ),
+                         ops_arg_dat(g_Bodyforce[blockIndex], NUMXI,
+                                     LOCALSTENCIL, "double", OPS_READ),
+                         ops_arg_dat(g_fStage[blockIndex], NUMXI,
+                                     LOCALSTENCIL, FRealC, OPS_WRITE));
+            CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(short) +
+                            3 * NUMXI * sizeof(FReal) +
+                            (NUMXI + NUMCOMPONENTS) * sizeof(Real));
+        }
+    }
+}
+
+void CollisionOnTheFly3D() {
+    for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+        for (int rngIdx = 0; rngIdx < ActiveRngNum(blockIndex); rngIdx++) {
+            int* iterRng = ActiveRng(blockIndex, rngIdx);
+            ops_par_loop(KerCollideOnTheFly3D, "KerCollideOnTheFly3D",
+                         g_Block[blockIndex], SPACEDIM, iterRng,
+                         ops_arg_gbl(pTimeStep(), 1, "double", OPS_READ),
+                         ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                     LOCALSTENCIL, "short", OPS_READ),
+                         ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL,
+                                     FRealC, OPS_READ),
+                         ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
+                                     LOCALSTENCIL, "double", OPS_READ),
+                         ops_arg_dat(g_Tau[blockIndex], NUMCOMPONENTS,
+                                     LOCALSTENCIL, "double", OPS_READ),
+                         ops_arg_dat(g_fStage[blockIndex], NUMXI,
+                                     LOCALSTENCIL, FRealC, OPS_WRITE));
+            CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(short) +
+                            2 * NUMXI * sizeof(FReal) +
+                            (NUMMACROVAR + NUMCOMPONENTS) * sizeof(Real));
+        }
+    }
+}
+
+void CollisionFused3D() {
+    for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+        for (int rngIdx = 0; rngIdx < ActiveRngNum(blockIndex); rngIdx++) {
+            int* iterRng = ActiveRng(blockIndex, rngIdx);
+            ops_par_loop(KerCollideFused3D, "KerCollideFused3D",
+                         g_Block[blockIndex], SPACEDIM, iterRng,
+                         ops_arg_gbl(pTimeStep(), 1, "double", OPS_READ),
+                         ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                     LOCALSTENCIL, "short", OPS_READ),
+                         ops_arg_gbl(TauRef(), NUMCOMPONENTS, "double",
+                                     OPS_READ),
+                         ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL,
+                                     FRealC, OPS_READ),
+                         ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
+                                     LOCALSTENCIL, "double", OPS_RW),
+                         ops_arg_dat(g_fStage[blockIndex], NUMXI,
+                                     LOCALSTENCIL, FRealC, OPS_WRITE));
+            CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(short) +
+                            2 * NUMXI * sizeof(FReal) +
+                            2 * NUMMACROVAR * sizeof(Real));
+        }
+    }
+}
+
+void CollisionAAEven3D() {
+    for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+        for (int rngIdx = 0; rngIdx < ActiveRngNum(blockIndex); rngIdx++) {
+            int* iterRng = ActiveRng(blockIndex, rngIdx);
+            ops_par_loop(KerCollideAAEven3D, "KerCollideAAEven3D",
+                         g_Block[blockIndex], SPACEDIM, iterRng,
+                         ops_arg_gbl(pTimeStep(), 1, "double", OPS_READ),
+                         ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                     LOCALSTENCIL, "short", OPS_READ),
+                         ops_arg_gbl(TauRef(), NUMCOMPONENTS, "double",
+                                     OPS_READ),
+                         ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL,
+                                     FRealC, OPS_RW),
+                         ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
+                                     LOCALSTENCIL, "double", OPS_RW));
+            CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(short) +
+                            2 * NUMXI * sizeof(FReal) +
+                            2 * NUMMACROVAR * sizeof(Real));
+        }
+    }
+}
+
+void StreamCollideAAOdd3D() {
+    for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+        for (int rngIdx = 0; rngIdx < ActiveRngNum(blockIndex); rngIdx++) {
+            int* iterRng = ActiveRng(blockIndex, rngIdx);
+            ops_par_loop(KerStreamCollideAAOdd3D, "KerStreamCollideAAOdd3D",
+                         g_Block[blockIndex], SPACEDIM, iterRng,
+                         ops_arg_gbl(pTimeStep(), 1, "double", OPS_READ),
+                         ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                     LOCALSTENCIL, "short", OPS_READ),
+                         ops_arg_gbl(TauRef(), NUMCOMPONENTS, "double",
+                                     OPS_READ),
+                         ops_arg_dat(g_f[blockIndex], NUMXI,
+                                     ONEPTLATTICESTENCIL, FRealC, OPS_RW),
+                         ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
+                                     LOCALSTENCIL, "double", OPS_RW));
+            CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(short) +
+                            2 * NUMXI * sizeof(FReal) +
+                            2 * NUMMACROVAR * sizeof(Real));
+        }
     }
 }
 
 void Stream3D() {
+    // the kernels specialised for the lattice if available
+    auto stream = KerStream3D;
+    auto streamBulk = KerStreamBulk3D;
+    switch (SpecialisedLattice()) {
+        case Lattice_D3Q15:
+            stream = KerStreamLattice3D<LatticeD3Q15>;
+            streamBulk = KerStreamBulkLattice3D<LatticeD3Q15>;
+            break;
+        case Lattice_D3Q19:
+            stream = KerStreamLattice3D<LatticeD3Q19>;
+            streamBulk = KerStreamBulkLattice3D<LatticeD3Q19>;
+            break;
+        default:
+            break;
+    }
     for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
-        int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
-        ops_par_loop(KerStream3D, "KerStream3D", g_Block[blockIndex], SPACEDIM,
-                     iterRng,
-                     ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
-                                 LOCALSTENCIL, "int", OPS_READ),
-                     ops_arg_dat(g_GeometryProperty[blockIndex], 1,
-                                 LOCALSTENCIL, "int", OPS_READ),
-                     ops_arg_dat(g_fStage[blockIndex], NUMXI,
-                                 ONEPTLATTICESTENCIL, "double", OPS_READ),
-                     ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL, "double",
-                                 OPS_RW));
+        if (!StreamRngReady()) {
+            for (int rngIdx = 0; rngIdx < ActiveRngNum(blockIndex);
+                 rngIdx++) {
+                int* iterRng = ActiveRng(blockIndex, rngIdx);
+                ops_par_loop(stream, "KerStream3D", g_Block[blockIndex],
+                             SPACEDIM, iterRng,
+                             ops_arg_dat(g_StreamMask[blockIndex],
+                                         NUMCOMPONENTS, LOCALSTENCIL, "int",
+                                         OPS_READ),
+                             ops_arg_dat(g_fStage[blockIndex], NUMXI,
+                                         ONEPTLATTICESTENCIL, FRealC, OPS_READ),
+                             ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL,
+                                         FRealC, OPS_RW));
+                CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(int) +
+                                3 * NUMXI * sizeof(FReal));
+            }
+            continue;
+        }
+        // the tiles of bulk fluid nodes need neither the mask nor the old f
+        for (int rngIdx = 0; rngIdx < StreamRngNum(blockIndex, true);
+             rngIdx++) {
+            int* iterRng = StreamRng(blockIndex, true, rngIdx);
+            ops_par_loop(streamBulk, "KerStreamBulk3D", g_Block[blockIndex],
+                         SPACEDIM, iterRng,
+                         ops_arg_dat(g_fStage[blockIndex], NUMXI,
+                                     ONEPTLATTICESTENCIL, FRealC, OPS_READ),
+                         ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL,
+                                     FRealC, OPS_WRITE));
+            CountBytesMoved(iterRng, 2 * NUMXI * sizeof(FReal));
+        }
+        for (int rngIdx = 0; rngIdx < StreamRngNum(blockIndex, false);
+             rngIdx++) {
+            int* iterRng = StreamRng(blockIndex, false, rngIdx);
+            ops_par_loop(stream, "KerStream3D", g_Block[blockIndex], SPACEDIM,
+                         iterRng,
+                         ops_arg_dat(g_StreamMask[blockIndex], NUMCOMPONENTS,
+                                     LOCALSTENCIL, "int", OPS_READ),
+                         ops_arg_dat(g_fStage[blockIndex], NUMXI,
+                                     ONEPTLATTICESTENCIL, FRealC, OPS_READ),
+                         ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL,
+                                     FRealC, OPS_RW));
+            CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(int) +
+                            3 * NUMXI * sizeof(FReal));
+        }
     }
 }
 
 void UpdateMacroVars3D() {
+    // the kernel specialised for the lattice if available
+    auto calcMacroVars = KerCalcMacroVars3D;
+    if (IsothermalModel()) {
+        switch (SpecialisedLattice()) {
+            case Lattice_D3Q15:
+                calcMacroVars = KerCalcMacroVarsLattice3D<LatticeD3Q15>;
+                break;
+            case Lattice_D3Q19:
+                calcMacroVars = KerCalcMacroVarsLattice3D<LatticeD3Q19>;
+                break;
+            default:
+                break;
+        }
+    }
     for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
-        int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
-        ops_par_loop(KerCalcMacroVars3D, "KerCalcMacroVars3D",
-                     g_Block[blockIndex], SPACEDIM, iterRng,
-                     ops_arg_gbl(pTimeStep(), 1, "double", OPS_READ),
-                     ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
-                                 LOCALSTENCIL, "int", OPS_READ),
-                     ops_arg_dat(g_CoordinateXYZ[blockIndex], SPACEDIM,
-                                 LOCALSTENCIL, "double", OPS_READ),
-                     ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL, "double",
-                                 OPS_READ),
-                     ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
-                                 LOCALSTENCIL, "double", OPS_RW));
+        for (int rngIdx = 0; rngIdx < ActiveRngNum(blockIndex); rngIdx++) {
+            int* iterRng = ActiveRng(blockIndex, rngIdx);
+            ops_par_loop(calcMacroVars, "KerCalcMacroVars3D",
+                         g_Block[blockIndex], SPACEDIM, iterRng,
+                         ops_arg_gbl(pTimeStep(), 1, "double", OPS_READ),
+                         ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                     LOCALSTENCIL, "short", OPS_READ),
+                         ops_arg_dat(g_CoordinateXYZ[blockIndex], SPACEDIM,
+                                     LOCALSTENCIL, "double", OPS_READ),
+                         ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL,
+                                     FRealC, OPS_READ),
+                         ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
+                                     LOCALSTENCIL, "double", OPS_RW));
+            CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(short) +
+                            NUMXI * sizeof(FReal) +
+                            (SPACEDIM + 2 * NUMMACROVAR) * sizeof(Real));
+        }
     }
 }
 
 void UpdateFeqandBodyforce3D() {
+    // the kernel specialised for the lattice if available
+    auto calcFeq = KerCalcFeq3D;
+    if (IsothermalModel()) {
+        switch (SpecialisedLattice()) {
+            case Lattice_D3Q15:
+                calcFeq = KerCalcFeqLattice3D<LatticeD3Q15>;
+                break;
+            case Lattice_D3Q19:
+                calcFeq = KerCalcFeqLattice3D<LatticeD3Q19>;
+                break;
+            default:
+                break;
+        }
+    }
     for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
-        int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
-        ops_par_loop(KerCalcFeq3D, "KerCalcFeq3D", g_Block[blockIndex],
-                     SPACEDIM, iterRng,
-                     ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
-                                 LOCALSTENCIL, "int", OPS_READ),
-                     ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
-                                 LOCALSTENCIL, "double", OPS_READ),
-                     ops_arg_dat(g_feq[blockIndex], NUMXI, LOCALSTENCIL,
-                                 "double", OPS_RW));
+        for (int rngIdx = 0; rngIdx < ActiveRngNum(blockIndex); rngIdx++) {
+            int* iterRng = ActiveRng(blockIndex, rngIdx);
+            ops_par_loop(calcFeq, "KerCalcFeq3D", g_Block[blockIndex],
+                         SPACEDIM, iterRng,
+                         ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                     LOCALSTENCIL, "short", OPS_READ),
+                         ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
+                                     LOCALSTENCIL, "double", OPS_READ),
+                         ops_arg_dat(g_feq[blockIndex], NUMXI, LOCALSTENCIL,
+                                     FRealC, OPS_RW));
+            CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(short) +
+                            2 * NUMXI * sizeof(FReal) +
+                            NUMMACROVAR * sizeof(Real));
 
-        // time is not used in the current force
-        Real* timeF{0};
-        ops_par_loop(KerCalcBodyForce3D, "KerCalcBodyForce3D",
-                     g_Block[blockIndex], SPACEDIM, iterRng,
-                     ops_arg_gbl(&timeF, 1, "double", OPS_READ),
-                     ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
-                                 LOCALSTENCIL, "int", OPS_READ),
-                     ops_arg_dat(g_CoordinateXYZ[blockIndex], SPACEDIM,
-                                 LOCALSTENCIL, "double", OPS_READ),
-                     ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
-                                 LOCALSTENCIL, "double", OPS_READ),
-                     ops_arg_dat(g_Bodyforce[blockIndex], NUMXI, LOCALSTENCIL,
-                                 "double", OPS_RW));
+            // time is not used in the current force
+            Real* timeF{0};
+            ops_par_loop(KerCalcBodyForce3D, "KerCalcBodyForce3D",
+                         g_Block[blockIndex], SPACEDIM, iterRng,
+                         ops_arg_gbl(&timeF, 1, "double", OPS_READ),
+                         ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                     LOCALSTENCIL, "short", OPS_READ),
+                         ops_arg_dat(g_CoordinateXYZ[blockIndex], SPACEDIM,
+                                     LOCALSTENCIL, "double", OPS_READ),
+                         ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
+                                     LOCALSTENCIL, "double", OPS_READ),
+                         ops_arg_dat(g_Bodyforce[blockIndex], NUMXI,
+                                     LOCALSTENCIL, "double", OPS_RW));
+            CountBytesMoved(iterRng, NUMCOMPONENTS * sizeof(short) +
+                            (SPACEDIM + NUMMACROVAR + 2 * NUMXI) *
+                                sizeof(Real));
+        }
     }
 }
 
 void TreatBlockBoundary3D(const int blockIndex, const int componentID,
                           const Real* givenVars, int* range,
                           const VertexTypes boundaryType) {
+    const int fLayout{FLayout()};
+    if (Layout_AASwapped == fLayout && Vertex_EQMDiffuseRefl != boundaryType) {
+        ops_printf(
+            "Error! Only the EQMDiffuseRefl boundary condition is supported "
+            "by the AA stream-collision scheme at this moment!\n");
+        assert(Vertex_EQMDiffuseRefl == boundaryType);
+    }
     switch (boundaryType) {
         case Vertex_ExtrapolPressure1ST: {
             ops_par_loop(
@@ -155,35 +365,44 @@ void TreatBlockBoundary3D(const int blockIndex, const int componentID,
                 "KerCutCellExtrapolPressure1ST3D", g_Block[blockIndex],
                 SPACEDIM, range,
                 ops_arg_gbl(givenVars, NUMMACROVAR, "double", OPS_READ),
-                ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
-                            ONEPTREGULARSTENCIL, "int", OPS_READ),
-                ops_arg_dat(g_GeometryProperty[blockIndex], 1, LOCALSTENCIL,
-                            "int", OPS_READ),
+                ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                            ONEPTREGULARSTENCIL, "short", OPS_READ),
                 ops_arg_dat(g_f[blockIndex], NUMXI, ONEPTREGULARSTENCIL,
-                            "double", OPS_RW));
+                            FRealC, OPS_RW));
         } break;
         case Vertex_EQMDiffuseRefl: {
-            ops_par_loop(
-                KerCutCellEQMDiffuseRefl3D, "KerCutCellEQMDiffuseRefl3D",
-                g_Block[blockIndex], SPACEDIM, range,
-                ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL, "double",
-                            OPS_RW),
-                ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS, LOCALSTENCIL,
-                            "int", OPS_READ),
-                ops_arg_dat(g_GeometryProperty[blockIndex], 1, LOCALSTENCIL,
-                            "int", OPS_READ),
-                ops_arg_gbl(givenVars, NUMMACROVAR, "double", OPS_READ),
-                ops_arg_gbl(&componentID, 1, "int", OPS_READ));
+            if (Layout_AASwapped == fLayout) {
+                // f of a boundary node is spread over its neighbours
+                ops_par_loop(
+                    KerCutCellEQMDiffuseRefl3D, "KerCutCellEQMDiffuseRefl3D",
+                    g_Block[blockIndex], SPACEDIM, range,
+                    ops_arg_dat(g_f[blockIndex], NUMXI, ONEPTLATTICESTENCIL,
+                                FRealC, OPS_RW),
+                    ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                LOCALSTENCIL, "short", OPS_READ),
+                    ops_arg_gbl(givenVars, NUMMACROVAR, "double", OPS_READ),
+                    ops_arg_gbl(&componentID, 1, "int", OPS_READ),
+                    ops_arg_gbl(&fLayout, 1, "int", OPS_READ));
+            } else {
+                ops_par_loop(
+                    KerCutCellEQMDiffuseRefl3D, "KerCutCellEQMDiffuseRefl3D",
+                    g_Block[blockIndex], SPACEDIM, range,
+                    ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL,
+                                FRealC, OPS_RW),
+                    ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                LOCALSTENCIL, "short", OPS_READ),
+                    ops_arg_gbl(givenVars, NUMMACROVAR, "double", OPS_READ),
+                    ops_arg_gbl(&componentID, 1, "int", OPS_READ),
+                    ops_arg_gbl(&fLayout, 1, "int", OPS_READ));
+            }
         } break;
         case Vertex_Periodic: {
             ops_par_loop(KerCutCellPeriodic3D, "KerCutCellPeriodic3D",
                          g_Block[blockIndex], SPACEDIM, range,
                          ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL,
-                                     "double", OPS_RW),
-                         ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
-                                     LOCALSTENCIL, "int", OPS_READ),
-                         ops_arg_dat(g_GeometryProperty[blockIndex], 1,
-                                     LOCALSTENCIL, "int", OPS_READ),
+                                     FRealC, OPS_RW),
+                         ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                     LOCALSTENCIL, "short", OPS_READ),
                          ops_arg_gbl(&componentID, 1, "int", OPS_READ));
         } break;
         default:
@@ -191,9 +410,108 @@ void TreatBlockBoundary3D(const int blockIndex, const int componentID,
     }
 }
 
+void PackNodeFlags3D() {
+    for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+        int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
+        ops_par_loop(KerPackNodeFlag3D, "KerPackNodeFlag3D",
+                     g_Block[blockIndex], SPACEDIM, iterRng,
+                     ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
+                                 LOCALSTENCIL, "int", OPS_READ),
+                     ops_arg_dat(g_GeometryProperty[blockIndex], 1,
+                                 LOCALSTENCIL, "int", OPS_READ),
+                     ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                 LOCALSTENCIL, "short", OPS_WRITE));
+        ops_par_loop(KerSetStreamMask3D, "KerSetStreamMask3D",
+                     g_Block[blockIndex], SPACEDIM, iterRng,
+                     ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                 LOCALSTENCIL, "short", OPS_READ),
+                     ops_arg_dat(g_StreamMask[blockIndex], NUMCOMPONENTS,
+                                 LOCALSTENCIL, "int", OPS_WRITE));
+    }
+    // the node properties do not change, so the halo nodes of the temporal
+    // blocking only need them once
+    if (nullptr != NodePropertyHaloGroup()) {
+        ops_halo_transfer(NodePropertyHaloGroup());
+    }
+    SetupStreamRng3D();
+}
+
+void SetupStreamRng3D(const int tileSize) {
+    for (int compoIdx = 0; compoIdx < NUMCOMPONENTS; compoIdx++) {
+        const int popNum{COMPOINDEX[2 * compoIdx + 1] -
+                         COMPOINDEX[2 * compoIdx] + 1};
+        if (popNum >= 8 * (int)sizeof(int)) {
+            ops_printf(
+                "Error! The %i populations of the component %i do not fit "
+                "into the stream mask!\n",
+                popNum, compoIdx);
+            assert(popNum < 8 * (int)sizeof(int));
+        }
+    }
+    for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+        // IterRngWhole starts from zero so that idx/tileSize is the tile
+        int* wholeRng = BlockIterRng(blockIndex, IterRngWhole());
+        int tileSz{tileSize};
+        int tileNum[3];
+        int totalTileNum{1};
+        for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+            tileNum[cordIdx] = (wholeRng[2 * cordIdx + 1] -
+                                wholeRng[2 * cordIdx] + tileSize - 1) /
+                               tileSize;
+            totalTileNum *= tileNum[cordIdx];
+        }
+        ops_reduction streamTileHandle = ops_decl_reduction_handle(
+            2 * totalTileNum * sizeof(int), "int", "StreamTile");
+        ops_par_loop(KerFindStreamTile3D, "KerFindStreamTile3D",
+                     g_Block[blockIndex], SPACEDIM, wholeRng,
+                     ops_arg_gbl(&tileSz, 1, "int", OPS_READ),
+                     ops_arg_gbl(tileNum, SPACEDIM, "int", OPS_READ),
+                     ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                 LOCALSTENCIL, "short", OPS_READ),
+                     ops_arg_idx(),
+                     ops_arg_reduce(streamTileHandle, 2 * totalTileNum,
+                                    "int", OPS_MAX));
+        std::vector<int> streamTile(2 * totalTileNum);
+        ops_reduction_result(streamTileHandle, streamTile.data());
+        // the tiles of solid nodes alone are skipped
+        std::vector<bool> isBulk(totalTileNum);
+        std::vector<bool> isMasked(totalTileNum);
+        for (int tileIdx = 0; tileIdx < totalTileNum; tileIdx++) {
+            const bool isActive{streamTile[2 * tileIdx] > 0};
+            const bool hasBoundary{streamTile[2 * tileIdx + 1] > 0};
+            isBulk[tileIdx] = isActive && !hasBoundary;
+            isMasked[tileIdx] = isActive && hasBoundary;
+        }
+        SetStreamRng(blockIndex,
+                     TileRuns(wholeRng, tileSize, tileNum, isBulk),
+                     TileRuns(wholeRng, tileSize, tileNum, isMasked));
+#if DebugLevel >= 1
+        ops_printf("Block %i: %i bulk and %i masked ranges of stream tiles\n",
+                   blockIndex, StreamRngNum(blockIndex, true),
+                   StreamRngNum(blockIndex, false));
+#endif
+    }
+}
+
 void InitialiseSolution3D() {
-    UpdateFeqandBodyforce3D();
-    CopyDistribution3D(g_feq, g_f);
+    PackNodeFlags3D();
+    if (FeqOnTheFly()) {
+        // g_feq is not available so the equilibrium goes to g_f directly
+        for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+            int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
+            ops_par_loop(KerCalcFeq3D, "KerCalcFeq3D", g_Block[blockIndex],
+                         SPACEDIM, iterRng,
+                         ops_arg_dat(g_NodeFlag[blockIndex], NUMCOMPONENTS,
+                                     LOCALSTENCIL, "short", OPS_READ),
+                         ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
+                                     LOCALSTENCIL, "double", OPS_READ),
+                         ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL,
+                                     FRealC, OPS_RW));
+        }
+    } else {
+        UpdateFeqandBodyforce3D();
+        CopyDistribution3D(g_feq, g_f);
+    }
 }
 
 void CopyDistribution3D(const ops_dat* fSrc, ops_dat* fDest) {
@@ -202,61 +520,82 @@ void CopyDistribution3D(const ops_dat* fSrc, ops_dat* fDest) {
         ops_par_loop(KerCopyf, "KerCopyf", g_Block[blockIndex], SPACEDIM,
                      iterRng,
                      ops_arg_dat(fSrc[blockIndex], NUMXI, LOCALSTENCIL,
-                                 "double", OPS_READ),
+                                 FRealC, OPS_READ),
                      ops_arg_dat(fDest[blockIndex], NUMXI, LOCALSTENCIL,
-                                 "double", OPS_WRITE));
+                                 FRealC, OPS_WRITE));
+        CountBytesMoved(iterRng, 2 * NUMXI * sizeof(FReal));
     }
 }
 
-void CalcResidualError3D() {
-    for (int macroVarIdx = 0; macroVarIdx < MacroVarsNum(); macroVarIdx++) {
-        for (int blockIdx = 0; blockIdx < BlockNum(); blockIdx++) {
-            int* iterRng = BlockIterRng(blockIdx, IterRngWhole());
-            ops_par_loop(KerCalcMacroVarSquareofDifference,
-                         "KerCalcMacroVarSquareofDifference", g_Block[blockIdx],
-                         SPACEDIM, iterRng,
-                         ops_arg_dat(g_MacroVars[blockIdx], NUMMACROVAR,
-                                     LOCALSTENCIL, "double", OPS_READ),
-                         ops_arg_dat(g_MacroVarsCopy[blockIdx], NUMMACROVAR,
-                                     LOCALSTENCIL, "double", OPS_READ),
-                         ops_arg_gbl(&macroVarIdx, 1, "int", OPS_READ),
-                         ops_arg_reduce(g_ResidualErrorHandle[macroVarIdx], 1,
-                                        "double", OPS_INC));
-        }
+void CalcfMoments3D(const long timeStep) {
+    const int period{OutputPeriod(Output_fMoments)};
+    if (nullptr == g_fMoments || period <= 0 || 0 != timeStep % period) {
+        return;
     }
-    for (int macroVarIdx = 0; macroVarIdx < MacroVarsNum(); macroVarIdx++) {
-        ops_reduction_result(g_ResidualErrorHandle[macroVarIdx],
-                             (double*)&g_ResidualError[2 * macroVarIdx]);
+    const int fLayout{FLayout()};
+    for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+        int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
+        ops_par_loop(KerCalcfMoments3D, "KerCalcfMoments3D",
+                     g_Block[blockIndex], SPACEDIM, iterRng,
+                     ops_arg_gbl(&fLayout, 1, "int", OPS_READ),
+                     ops_arg_dat(g_f[blockIndex], NUMXI, ONEPTLATTICESTENCIL,
+                                 FRealC, OPS_READ),
+                     ops_arg_dat(g_fMoments[blockIndex],
+                                 NUMCOMPONENTS * FMomentNum, LOCALSTENCIL,
+                                 "double", OPS_WRITE),
+                     ops_arg_reduce(g_fMomentsErrorHandle, 3, "double",
+                                    OPS_INC));
+    }
+    double error[3];
+    ops_reduction_result(g_fMomentsErrorHandle, error);
+    ops_printf(
+        "The f rebuilt from the moments at step %li differs by %e relative to "
+        "f and %e relative to its non-equilibrium part\n",
+        timeStep, sqrt(error[0] / error[2]), sqrt(error[0] / error[1]));
+}
+
+void RebuildDistribution3D() {
+    for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+        int* iterRng = BlockIterRng(blockIndex, IterRngWhole());
+        ops_par_loop(KerRebuildf3D, "KerRebuildf3D", g_Block[blockIndex],
+                     SPACEDIM, iterRng,
+                     ops_arg_dat(g_fMoments[blockIndex],
+                                 NUMCOMPONENTS * FMomentNum, LOCALSTENCIL,
+                                 "double", OPS_READ),
+                     ops_arg_dat(g_f[blockIndex], NUMXI, LOCALSTENCIL, FRealC,
+                                 OPS_WRITE));
+        if (RestartMacroVarsFromMoments()) {
+            ops_par_loop(KerRebuildMacroVars3D, "KerRebuildMacroVars3D",
+                         g_Block[blockIndex], SPACEDIM, iterRng,
+                         ops_arg_dat(g_fMoments[blockIndex],
+                                     NUMCOMPONENTS * FMomentNum, LOCALSTENCIL,
+                                     "double", OPS_READ),
+                         ops_arg_dat(g_MacroVars[blockIndex], NUMMACROVAR,
+                                     LOCALSTENCIL, "double", OPS_WRITE));
+        }
     }
+    // the AA pattern continues from either layout
+    SetFLayout(Layout_Natural);
+}
+
+void CalcResidualError3D() {
+    // all the variables are reduced by one sweep and one reduction handle
     for (int blockIdx = 0; blockIdx < BlockNum(); blockIdx++) {
         int* iterRng = BlockIterRng(blockIdx, IterRngWhole());
-        ops_par_loop(KerCopyMacroVars, "KerCopyMacroVars3D", g_Block[blockIdx],
-                     SPACEDIM, iterRng,
+        ops_par_loop(KerCalcMacroVarResidual, "KerCalcMacroVarResidual3D",
+                     g_Block[blockIdx], SPACEDIM, iterRng,
                      ops_arg_dat(g_MacroVars[blockIdx], NUMMACROVAR,
                                  LOCALSTENCIL, "double", OPS_READ),
                      ops_arg_dat(g_MacroVarsCopy[blockIdx], NUMMACROVAR,
-                                 LOCALSTENCIL, "double", OPS_RW));
-    }
-    for (int macroVarIdx = 0; macroVarIdx < MacroVarsNum(); macroVarIdx++) {
-        for (int blockIdx = 0; blockIdx < BlockNum(); blockIdx++) {
-            int* iterRng = BlockIterRng(blockIdx, IterRngWhole());
-            ops_par_loop(KerCalcMacroVarSquare, "KerCalcMacroVarSquare3D",
-                         g_Block[blockIdx], SPACEDIM, iterRng,
-                         ops_arg_dat(g_MacroVars[blockIdx], NUMMACROVAR,
-                                     LOCALSTENCIL, "double", OPS_READ),
-                         ops_arg_gbl(&macroVarIdx, 1, "int", OPS_READ),
-                         ops_arg_reduce(g_ResidualErrorHandle[macroVarIdx], 1,
-                                        "double", OPS_INC));
-        }
-    }
-    for (int macroVarIdx = 0; macroVarIdx < MacroVarsNum(); macroVarIdx++) {
-        ops_reduction_result(g_ResidualErrorHandle[macroVarIdx],
-                             (double*)&g_ResidualError[2 * macroVarIdx + 1]);
+                                 LOCALSTENCIL, "double", OPS_RW),
+                     ops_arg_reduce(g_ResidualErrorHandle, 2 * NUMMACROVAR,
+                                    "double", OPS_INC));
     }
+    ops_reduction_result(g_ResidualErrorHandle, (double*)g_ResidualError);
 }
 
-void DispResidualError3D(const int iter, const Real checkPeriod) {
-    ops_printf("##########Residual Error at %i time step##########\n", iter);
+void DispResidualError3D(const long iter, const Real checkPeriod) {
+    ops_printf("##########Residual Error at %li time step##########\n", iter);
     for (int macroVarIdx = 0; macroVarIdx < MacroVarsNum(); macroVarIdx++) {
         Real residualError = g_ResidualError[2 * macroVarIdx] /
                              g_ResidualError[2 * macroVarIdx + 1] /
@@ -267,6 +606,8 @@ void DispResidualError3D(const int iter, const Real checkPeriod) {
 }
 
 void StreamCollision3D() {
+    // the halo layers still valid in a cycle of the temporal blocking
+    SetIterRngExtension(CollisionExtension());
 #if DebugLevel >= 1
     ops_printf("Calculating the macroscopic variables...\n");
 #endif
@@ -276,11 +617,14 @@ void StreamCollision3D() {
     // Real Ratio{TotalMass/TotalMeshSize()};
     // NormaliseF(&Ratio);
     // UpdateMacroVars();
-    CopyDistribution3D(g_f, g_fStage);
+    if (!FeqOnTheFly()) {
 #if DebugLevel >= 1
-    ops_printf("Calculating the equilibrium function and the body force term...\n");
+        ops_printf(
+            "Calculating the equilibrium function and the body force "
+            "term...\n");
 #endif
-    UpdateFeqandBodyforce3D();
+        UpdateFeqandBodyforce3D();
+    }
 #if DebugLevel >= 1
     ops_printf("Calculating the relaxation time...\n");
 #endif
@@ -288,16 +632,76 @@ void StreamCollision3D() {
 #if DebugLevel >= 1
     ops_printf("Colliding...\n");
 #endif
-    Collision3D();
+    if (FeqOnTheFly()) {
+        CollisionOnTheFly3D();
+    } else {
+        Collision3D();
+    }
+    // the halos are only exchanged at the first step of a cycle of the
+    // temporal blocking
+    if (0 == TemporalSubstep()) {
+#if DebugLevel >= 1
+        ops_printf("Updating the halos...\n");
+#endif
+        TransferPopulationHalos();
+    }
+#if DebugLevel >= 1
+    ops_printf("Streaming...\n");
+#endif
+    SetIterRngExtension(StreamExtension());
+    Stream3D();
+#if DebugLevel >= 1
+    ops_printf("Implementing the boundary conditions...\n");
+#endif
+    ImplementBoundaryConditions();
+    SetIterRngExtension(0);
+    NextTemporalSubstep();
+}
+
+void StreamCollisionFused3D() {
+    SetIterRngExtension(CollisionExtension());
+#if DebugLevel >= 1
+    ops_printf("Colliding with the fused kernel...\n");
+#endif
+    CollisionFused3D();
+    if (0 == TemporalSubstep()) {
+#if DebugLevel >= 1
+        ops_printf("Updating the halos...\n");
+#endif
+        TransferPopulationHalos();
+    }
 #if DebugLevel >= 1
     ops_printf("Streaming...\n");
 #endif
+    SetIterRngExtension(StreamExtension());
     Stream3D();
 #if DebugLevel >= 1
-    ops_printf("Updating the halos...\n");
+    ops_printf("Implementing the boundary conditions...\n");
 #endif
+    ImplementBoundaryConditions();
+    SetIterRngExtension(0);
+    NextTemporalSubstep();
+}
+
+void StreamCollisionAA3D() {
     if (nullptr != HaloGroup()) {
-        ops_halo_transfer(HaloGroup());
+        ops_printf(
+            "Error! The AA stream-collision scheme does not support halo "
+            "transfers at this moment!\n");
+        assert(nullptr == HaloGroup());
+    }
+    if (Layout_Natural == FLayout()) {
+#if DebugLevel >= 1
+        ops_printf("Colliding with the AA even-step kernel...\n");
+#endif
+        CollisionAAEven3D();
+        SetFLayout(Layout_AASwapped);
+    } else {
+#if DebugLevel >= 1
+        ops_printf("Streaming and colliding with the AA odd-step kernel...\n");
+#endif
+        StreamCollideAAOdd3D();
+        SetFLayout(Layout_Natural);
     }
 #if DebugLevel >= 1
     ops_printf("Implementing the boundary conditions...\n");
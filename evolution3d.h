@@ -65,6 +65,17 @@
  * Overall wrap for stream-collision scheme
  */
 void StreamCollision3D();
+/*!
+ * Stream-collision scheme with two sweeps per step: a fused collision which
+ * also updates the macroscopic variables, and the stream.
+ */
+void StreamCollisionFused3D();
+/*!
+ * Stream-collision scheme with the AA pattern, which works on g_f alone and
+ * alternates between an even step (local collision) and an odd step (stream,
+ * collide and stream), see DistributionLayout. One sweep per step.
+ */
+void StreamCollisionAA3D();
 /*!
  * Ops_par_loop for the stream step
  */
@@ -73,6 +84,23 @@ void Stream3D();
  * Ops_par_loop for the collision step
  */
 void Collision3D();
+/*!
+ * Ops_par_loop for the collision step with the equilibrium and body force
+ * calculated on the fly
+ */
+void CollisionOnTheFly3D();
+/*!
+ * Ops_par_loop for the fused collision step
+ */
+void CollisionFused3D();
+/*!
+ * Ops_par_loop for the even step of the AA pattern
+ */
+void CollisionAAEven3D();
+/*!
+ * Ops_par_loop for the odd step of the AA pattern
+ */
+void StreamCollideAAOdd3D();
 
 // Common routines
 /*!
@@ -81,15 +109,40 @@ void Collision3D();
 void CalcResidualError3D();
 
 void InitialiseSolution3D();
+/*!
+ * Pack g_NodeType and g_GeometryProperty into g_NodeFlag, which is read by the
+ * kernels of a time step, and set g_StreamMask and the stream ranges from it.
+ * Called by InitialiseSolution3D and again by Iterate as the node types may be
+ * changed after the initialisation, e.g., by EmbeddedBody.
+ */
+void PackNodeFlags3D();
+/*!
+ * Split the blocks into tiles of tileSize^3 nodes for the stream step, so that
+ * the tiles of bulk fluid nodes are streamed by a kernel without the mask and
+ * the other tiles with non-solid nodes by the masked kernel, see StreamRng
+ */
+void SetupStreamRng3D(const int tileSize = 8);
 /*!
  * Mainly for a steady simulation
  */
-void DispResidualError3D(const int iter, const Real timePeriod);
+void DispResidualError3D(const long iter, const Real timePeriod);
 
 void UpdateMacroVars3D();
 void UpdateTau3D();
 void UpdateFeqandBodyforce3D();
 void CopyDistribution3D(const ops_dat* fSrc, ops_dat* fDest);
+/*!
+ * Calculate g_fMoments if Output_fMoments is written at timeStep, and print
+ * how much of f and of its non-equilibrium part the regularised distribution
+ * rebuilt from them misses, i.e., the accuracy lost by restarting from them
+ * rather than from f
+ */
+void CalcfMoments3D(const long timeStep);
+/*!
+ * Rebuild g_f at its natural position from g_fMoments when restarting, and
+ * g_MacroVars if the checkpoint skips them
+ */
+void RebuildDistribution3D();
 
 void TreatBlockBoundary3D(const int blockIndex, const int componentID,
                           const Real* givenVars, int* range,
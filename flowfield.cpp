@@ -38,6 +38,23 @@
  */
 
 #include "flowfield.h"
+#include <hdf5.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#ifdef OPS_MPI
+#include <mpi.h>
+#endif
+// The writer thread only calls HDF5, as OPS is not thread-safe, and the MPI
+// build writes by its own communicator, see StartCheckpointWriter
+#ifdef ASYNC_CHECKPOINT
+#define CHECKPOINT_THREAD
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#endif
 std::string CASENAME;
 int BLOCKNUM{1};
 /*!
@@ -55,8 +72,13 @@ ops_dat* g_feq{nullptr};
 ops_dat* g_MacroVars{nullptr};
 ops_dat* g_MacroVarsCopy{nullptr};
 Real* g_ResidualError{nullptr};
-ops_reduction* g_ResidualErrorHandle{nullptr};
+ops_reduction g_ResidualErrorHandle{nullptr};
 ops_dat* g_Bodyforce{nullptr};
+/*!
+ * FEQONTHEFLY: if true, the equilibrium and the body force are calculated
+ * inside the collision kernel, and g_feq and g_Bodyforce are not allocated.
+ */
+bool FEQONTHEFLY{false};
 /*!
  * DT: time step
  */
@@ -70,6 +92,8 @@ Real* TAUREF{nullptr};
 ops_dat* g_Tau{nullptr};
 ops_dat* g_DiscreteConvectionTerm{nullptr};
 ops_dat* g_CoordinateXYZ{nullptr};
+ops_dat* g_fMoments{nullptr};
+ops_reduction g_fMomentsErrorHandle{nullptr};
 /*!
  *metrics for 2D: 0 xi_x 1 xi_y  2 eta_x  3 eta_y
  *metrics for 3D:
@@ -77,6 +101,8 @@ ops_dat* g_CoordinateXYZ{nullptr};
 ops_dat* g_Metrics{nullptr};
 ops_dat* g_NodeType{nullptr};
 ops_dat* g_GeometryProperty{nullptr};
+ops_dat* g_NodeFlag{nullptr};
+ops_dat* g_StreamMask{nullptr};
 /*!
  * Total number of halo relation.
  */
@@ -89,6 +115,28 @@ ops_halo* HaloRelations{nullptr};
  * Formal collection of halo relations
  */
 ops_halo_group HaloGroups;
+/*!
+ * The periodic halos transferring only the populations crossing the faces,
+ * see SetPeriodicHalo
+ */
+std::vector<PopulationHalo> PopulationHaloList;
+/*!
+ * The face of a block connected to the face of a neighbour block, see
+ * DefineBlockConnection. Every connection is stored in both directions.
+ */
+struct BlockConnection {
+    int blockIndex;
+    int axis;
+    int side;
+    int neighbour;
+    int neighbourAxis;
+    int neighbourSide;
+    // the dir of ops_decl_halo: the axis of the neighbour (1-based, negative
+    // if reversed) matched to each axis of the block
+    int orientation[MAXDIM];
+};
+std::vector<BlockConnection> BlockConnectionList;
+std::vector<bool> BlockPeriodicity;
 
 int* BlockIterRngWhole{nullptr};
 int* BlockIterRngJmin{nullptr};
@@ -98,25 +146,321 @@ int* BlockIterRngImax{nullptr};
 int* BlockIterRngKmax{nullptr};
 int* BlockIterRngKmin{nullptr};
 int* BlockIterRngBulk{nullptr};
+/*!
+ * The whole block extended into the halos by ITERRNGEXTENSION layers at the
+ * faces connected to other blocks, see SetIterRngExtension
+ */
+int* BlockIterRngExtended{nullptr};
+int ITERRNGEXTENSION{0};
+/*!
+ * The number of steps per halo exchange in the temporal blocking mode, 0 if it
+ * is to be chosen by DefineVariables, and the step within the current cycle
+ */
+int TEMPORALBLOCKING{1};
+int TEMPORALSUBSTEP{0};
+/*!
+ * The halos of g_NodeFlag and g_StreamMask between connected blocks, which are
+ * only needed by the temporal blocking mode
+ */
+std::vector<ops_halo> NodePropertyHaloRelations;
+ops_halo_group NodePropertyHalos{nullptr};
+/*!
+ * The ranges of surface nodes of embedded bodies, see EmbeddedBoundaryRng
+ */
+std::vector<std::map<int, std::vector<int>>> BlockEmbeddedBoundaryRng;
+/*!
+ * The ranges of tiles containing non-solid nodes, see ActiveRng
+ */
+std::vector<std::vector<int>> BlockActiveRng;
+/*!
+ * The ranges of tiles for the stream step, see StreamRng
+ */
+std::vector<std::vector<int>> BlockBulkStreamRng;
+std::vector<std::vector<int>> BlockMaskedStreamRng;
+/*!
+ * The output period of each field, see SetOutputPeriod. By default, f and the
+ * macroscopic variables are written at every checkpoint, the coordinates and
+ * the node property only once, and the others, which can be recovered from f
+ * and the macroscopic variables, are not written.
+ */
+std::vector<int> OUTPUTPERIOD{1, OutputPeriod_Never, OutputPeriod_Once,
+                              1, OutputPeriod_Never, OutputPeriod_Never,
+                              OutputPeriod_Never, OutputPeriod_Once,
+                              OutputPeriod_Once,  OutputPeriod_Never};
+/*!
+ * If the period of the macroscopic variables is set, which a compressed
+ * checkpoint otherwise skips, see OutputFields
+ */
+bool MacroVarsPeriodSet{false};
+bool StaticOutputWritten{false};
+/*!
+ * The output mode, and the chunk size, the alignment threshold and the
+ * alignment of the shared file, see SetOutputMode and SetSharedFileLayout
+ */
+OutputMode OUTPUTMODE{OutputMode_BlockFiles};
+std::vector<int> SHAREDFILECHUNK;
+long SHAREDFILEALIGNTHRESHOLD{0};
+long SHAREDFILEALIGNMENT{0};
+/*!
+ * The time step of the static output, see WriteOutput
+ */
+const long StaticOutputStep{-1};
+/*!
+ * The time-series file, which is kept open between the outputs, whether it
+ * has been opened in this run, and the step and the time of each slice, see
+ * AppendSeriesFile
+ */
+hid_t SeriesFile{-1};
+bool SeriesFileOpened{false};
+std::vector<long> SeriesSteps;
+std::vector<double> SeriesTimes;
+/*!
+ * The chunk size of the Step and the Time datasets of the time-series file
+ */
+const hsize_t SeriesValueChunk{1024};
+/*!
+ * The step of the checkpoint to restart from, or -1 for a cold start, its
+ * format, its slice in the time-series file, if f and the macroscopic
+ * variables are rebuilt from the moments of f, if the macroscopic variables
+ * are computed from f, the first step to run, and the time when the case was
+ * defined, see RestartFromCheckpoint
+ */
+long RESTARTSTEP{-1};
+OutputMode RESTARTMODE{OutputMode_BlockFiles};
+bool RESTARTFROMOPSFILES{false};
+long RESTARTSLICE{-1};
+bool RESTARTFROMMOMENTS{false};
+bool RESTARTMACROVARSFROMMOMENTS{false};
+bool RESTARTMACROVARSFROMF{false};
+long STARTSTEP{0};
+double SETUPSTARTTIME{0};
+/*!
+ * The fields read from a checkpoint, where the others are either computed
+ * from them or set again by the case, e.g., Tau and the boundary conditions
+ */
+const std::vector<OutputField> RestartFields{
+    Output_f, Output_MacroVars, Output_NodeType, Output_GeometryProperty,
+    Output_CoordinateXYZ, Output_fMoments};
+/*!
+ * The checkpoints written so far, and the time that the solver spent on them,
+ * i.e., on staging them and waiting for a free slot, see WriteCheckpointAsync
+ */
+int CheckpointNum{0};
+double CheckpointTime{0};
+double CheckpointWaitTime{0};
+/*!
+ * The part of a dat owned by this rank in host memory, where the components
+ * of a node are together, and its hyperslab in the dataset of DatasetDims,
+ * so that it can be written by HDF5 alone, see FetchOutputPart
+ */
+struct OutputPart {
+    std::string name;
+    std::string type;
+    hsize_t dims[4];
+    hsize_t chunk[4];
+    hsize_t start[4];
+    hsize_t count[4];
+    // false with a zero count if the rank owns no part
+    bool owned{false};
+    std::vector<char> data;
+};
+#ifdef CHECKPOINT_THREAD
+/*!
+ * The background checkpoint writer
+ * A checkpoint fetches the written dats into the host buffers of one of
+ * CHECKPOINTSLOTNUM staging slots and queues the slot. The writer thread then
+ * writes the queued slots into the HDF5 files in order and frees them. As OPS
+ * is not thread-safe, the thread only calls HDF5. The solver only waits when
+ * all the slots are still queued, which bounds the staging memory.
+ */
+const int CHECKPOINTSLOTNUM{2};
+struct CheckpointSlot {
+    long timeStep{0};
+    // the owned parts of the fields, parts[fieldIdx * BLOCKNUM + blockIndex],
+    // whose buffers are reused by the later checkpoints staged into the slot
+    std::vector<OutputPart> parts;
+};
+std::vector<CheckpointSlot> CheckpointSlots;
+std::deque<int> QueuedCheckpointSlots;
+std::deque<int> FreeCheckpointSlots;
+std::mutex CheckpointMutex;
+std::condition_variable CheckpointCondition;
+std::thread CheckpointWriter;
+bool CheckpointWriterStop{false};
+// if the writer thread prints the reports, i.e., on the root rank
+bool CheckpointWriterRoot{false};
+#endif
+/*!
+ * The per-block files are written by OPS, with the halos, unless they are
+ * written by the checkpoint writer thread, which cannot call OPS and writes
+ * the nodes without halos by HDF5 as the shared file, see WriteBlockPartFiles
+ */
+#ifdef CHECKPOINT_THREAD
+const bool BlockFilesByOps{false};
+#else
+const bool BlockFilesByOps{true};
+#endif
+#ifdef OPS_MPI
+/*!
+ * The communicator of the output files, which is a duplicate of
+ * MPI_COMM_WORLD while the checkpoint writer thread runs, so that its
+ * collective calls are not mixed up with those of the solver
+ */
+MPI_Comm OutputComm{MPI_COMM_WORLD};
+#endif
 /*!
  * The size of each block, i.e., each domain
  */
 int* BLOCKSIZE{nullptr};
+/*!
+ * Estimated bytes moved by the ops_par_loop calls of the time stepping
+ */
+long long BYTESMOVED{0};
 
-const int HaloPtNum() { return std::max(SchemeHaloNum(), BoundaryHaloNum()); }
+const int HaloPtNum() {
+    return std::max(std::max(SchemeHaloNum(), BoundaryHaloNum()),
+                    TEMPORALBLOCKING);
+}
 
-void DefineCase(std::string caseName, const int spaceDim) {
+void DefineCase(std::string caseName, const int spaceDim,
+                const bool feqOnTheFly) {
+    double ct;
+    ops_timers(&ct, &SETUPSTARTTIME);
     SetCaseName(caseName);
     SPACEDIM = spaceDim;
+    FEQONTHEFLY = feqOnTheFly;
+    if (FEQONTHEFLY) {
+        ops_printf(
+            "The equilibrium and body force will be calculated on the fly "
+            "without being stored!\n");
+    }
+}
+
+void SetDerivedIterRng(const int blockIndex, const int* size) {
+    int* extended{BlockIterRng(blockIndex, BlockIterRngExtended)};
+    for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+        extended[2 * cordIdx] = 0;
+        extended[2 * cordIdx + 1] = size[cordIdx];
+    }
+}
+
+/*!
+ * Choose the layout of the ops_dats with several components, e.g., g_f.
+ * With OPS_SOA, each component is contiguous in x, i.e., population-major, so
+ * that the compiler can vectorise a kernel over the neighbouring nodes rather
+ * than over the populations of one node. It must be set before any of these
+ * ops_dats is declared, as the OPS_ACC_MD macros use a single layout.
+ */
+void SetDatLayout() {
+#ifdef OPS_SOA
+    OPS_soa = 1;
+#endif
+}
+
+/*
+ * If the file exists and is readable
+ */
+bool FileExists(const std::string& fileName) {
+    return std::ifstream(fileName).good();
+}
+
+/*
+ * Stop with an error if an HDF5 call returned a negative id or status. It
+ * prints by printf rather than ops_printf, as the checkpoint writer thread
+ * does not call OPS.
+ */
+hid_t CheckHdf5(const hid_t id, const char* call, const std::string& name) {
+    if (id < 0) {
+        std::printf("Error! %s failed for %s!\n", call, name.c_str());
+        assert(id >= 0);
+    }
+    return id;
+}
+
+/*
+ * If the dataset, or the link to it, exists in the file
+ */
+bool DatasetExists(const std::string& fileName, const std::string& path) {
+    hid_t file{CheckHdf5(
+        H5Fopen(fileName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT), "H5Fopen",
+        fileName)};
+    const bool exists{H5Lexists(file, path.c_str(), H5P_DEFAULT) > 0};
+    H5Fclose(file);
+    return exists;
+}
+
+/*
+ * If a restart cannot continue without reading the field from the checkpoint,
+ * i.e., f or its moments, and the fields that are not set again by the case,
+ * while the macroscopic variables are computed from f when they are missing
+ */
+bool RestartFieldRequired(const OutputField field) {
+    switch (field) {
+        case Output_f:
+            return !RESTARTFROMMOMENTS;
+        case Output_fMoments:
+            return RESTARTFROMMOMENTS;
+        case Output_NodeType:
+        case Output_GeometryProperty:
+        case Output_CoordinateXYZ:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ * Stop with an error if a field needed to restart is not in the checkpoint,
+ * rather than continuing from an uninitialised dat
+ */
+void CheckRestartField(const OutputField field, const bool found,
+                       const std::string& path, const std::string& fileName) {
+    if (!found && RestartFieldRequired(field)) {
+        ops_printf("Error! %s, which is needed to restart, is not in %s!\n",
+                   path.c_str(), fileName.c_str());
+        assert(found);
+    }
+}
+
+/*
+ * Declare a dat of DefineVariables, or read it from the block file of the
+ * checkpoint when restarting from one, see RestartFromCheckpoint
+ */
+template <typename T>
+ops_dat DeclRestartableDat(const OutputField field, const int blockIndex,
+                           const int dim, int* size, int* base, int* d_m,
+                           int* d_p, T* data, const char* type,
+                           const std::string& name) {
+    if (RESTARTSTEP >= 0 && RESTARTFROMOPSFILES) {
+        const std::string fileName{
+            OutputFileName(blockIndex, std::to_string(RESTARTSTEP))};
+        const std::string path{"Block_" + std::to_string(blockIndex) + "/" +
+                               name};
+        const bool found{DatasetExists(fileName, path)};
+        CheckRestartField(field, found, path, fileName);
+        if (found) {
+            return ops_decl_dat_hdf5(g_Block[blockIndex], dim, type,
+                                     name.c_str(), fileName.c_str());
+        }
+    }
+    return ops_decl_dat(g_Block[blockIndex], dim, size, base, d_m, d_p, data,
+                        type, name.c_str());
 }
 
+
 void DefineVariables() {
+    SetDatLayout();
     void* temp = NULL;
     g_Block = new ops_block[BLOCKNUM];
     g_f = new ops_dat[BLOCKNUM];
-    g_Bodyforce = new ops_dat[BLOCKNUM];
-    g_fStage = new ops_dat[BLOCKNUM];
-    g_feq = new ops_dat[BLOCKNUM];
+    // the AA pattern streams in place so that g_fStage is not needed
+    if (Scheme_StreamCollisionAA != Scheme()) {
+        g_fStage = new ops_dat[BLOCKNUM];
+    }
+    if (!FEQONTHEFLY) {
+        g_Bodyforce = new ops_dat[BLOCKNUM];
+        g_feq = new ops_dat[BLOCKNUM];
+    }
     g_MacroVars = new ops_dat[BLOCKNUM];
     g_Tau = new ops_dat[BLOCKNUM];
     g_CoordinateXYZ = new ops_dat[BLOCKNUM];
@@ -130,13 +474,14 @@ void DefineVariables() {
         BlockIterRngKmin = new int[BLOCKNUM * 2 * SPACEDIM];
     }
     BlockIterRngBulk = new int[BLOCKNUM * 2 * SPACEDIM];
+    BlockIterRngExtended = new int[BLOCKNUM * 2 * SPACEDIM];
     // if steady flow
     g_MacroVarsCopy = new ops_dat[BLOCKNUM];
-    g_ResidualErrorHandle = new ops_reduction[MacroVarsNum()];
     g_ResidualError = new Real[2 * MacroVarsNum()];
     // end if steady flow
 
 
+    ChooseTemporalBlocking();
     int haloDepth{HaloPtNum()};
     HALODEPTH = HaloPtNum();
 
@@ -168,6 +513,14 @@ void DefineVariables() {
     // if cutting cell method
     g_NodeType = new ops_dat[BLOCKNUM];
     g_GeometryProperty = new ops_dat[BLOCKNUM];
+    g_NodeFlag = new ops_dat[BLOCKNUM];
+#ifdef OPS_3D
+    g_StreamMask = new ops_dat[BLOCKNUM];
+    if (OutputPeriod_Never != OUTPUTPERIOD[Output_fMoments] ||
+        RESTARTFROMMOMENTS) {
+        g_fMoments = new ops_dat[BLOCKNUM];
+    }
+#endif
     for (int blockIndex = 0; blockIndex < BLOCKNUM; blockIndex++) {
         std::string label(std::to_string(blockIndex));
         std::string blockName("Block_" + label);
@@ -188,6 +541,7 @@ void DefineVariables() {
         BlockIterRngWhole[blockIndex * 2 * SPACEDIM + 2] = 0;
         BlockIterRngWhole[blockIndex * 2 * SPACEDIM + 3] = size[1];
 
+        SetDerivedIterRng(blockIndex, size);
         BlockIterRngBulk[blockIndex * 2 * SPACEDIM] = 1;
         BlockIterRngBulk[blockIndex * 2 * SPACEDIM + 1] = size[0] - 1;
         BlockIterRngBulk[blockIndex * 2 * SPACEDIM + 2] = 1;
@@ -250,58 +604,111 @@ void DefineVariables() {
         std::string dataName("f_");
         dataName += label;
         g_f[blockIndex] =
-            ops_decl_dat(g_Block[blockIndex], NUMXI, size, base, d_m, d_p,
-                         (Real*)temp, RealC, dataName.c_str());
-        dataName = "feq_" + label;
-        g_feq[blockIndex] =
-            ops_decl_dat(g_Block[blockIndex], NUMXI, size, base, d_m, d_p,
-                         (Real*)temp, RealC, dataName.c_str());
-        dataName = "fStage_" + label;
-        g_fStage[blockIndex] =
-            ops_decl_dat(g_Block[blockIndex], NUMXI, size, base, d_m, d_p,
-                         (Real*)temp, RealC, dataName.c_str());
-        dataName = "Bodyforce_" + label;
-        g_Bodyforce[blockIndex] =
-            ops_decl_dat(g_Block[blockIndex], NUMXI, size, base, d_m, d_p,
-                         (Real*)temp, RealC, dataName.c_str());
+            DeclRestartableDat(Output_f, blockIndex, NUMXI, size, base, d_m,
+                               d_p, (FReal*)temp, FRealC, dataName);
+        if (nullptr != g_fStage) {
+            dataName = "fStage_" + label;
+            g_fStage[blockIndex] =
+                ops_decl_dat(g_Block[blockIndex], NUMXI, size, base, d_m, d_p,
+                             (FReal*)temp, FRealC, dataName.c_str());
+        }
+        if (!FEQONTHEFLY) {
+            dataName = "feq_" + label;
+            g_feq[blockIndex] =
+                ops_decl_dat(g_Block[blockIndex], NUMXI, size, base, d_m, d_p,
+                             (FReal*)temp, FRealC, dataName.c_str());
+            dataName = "Bodyforce_" + label;
+            g_Bodyforce[blockIndex] =
+                ops_decl_dat(g_Block[blockIndex], NUMXI, size, base, d_m, d_p,
+                             (Real*)temp, RealC, dataName.c_str());
+        }
         dataName = "MacroVars_" + label;
-        g_MacroVars[blockIndex] =
-            ops_decl_dat(g_Block[blockIndex], NUMMACROVAR, size, base, d_m, d_p,
-                         (Real*)temp, RealC, dataName.c_str());
+        g_MacroVars[blockIndex] = DeclRestartableDat(
+            Output_MacroVars, blockIndex, NUMMACROVAR, size, base, d_m, d_p,
+            (Real*)temp, RealC, dataName);
         dataName = "Tau_" + label;
         g_Tau[blockIndex] =
             ops_decl_dat(g_Block[blockIndex], NUMCOMPONENTS, size, base, d_m,
                          d_p, (Real*)temp, RealC, dataName.c_str());
         dataName = "Nodetype_" + label;
         // problem specific -- cut cell method
-        g_NodeType[blockIndex] =
+        g_NodeType[blockIndex] = DeclRestartableDat(
+            Output_NodeType, blockIndex, NUMCOMPONENTS, size, base, d_m, d_p,
+            (int*)temp, "int", dataName);
+        dataName = "GeometryProperty_" + label;
+        g_GeometryProperty[blockIndex] = DeclRestartableDat(
+            Output_GeometryProperty, blockIndex, 1, size, base, d_m, d_p,
+            (int*)temp, "int", dataName);
+        dataName = "NodeFlag_" + label;
+        g_NodeFlag[blockIndex] =
+            ops_decl_dat(g_Block[blockIndex], NUMCOMPONENTS, size, base, d_m,
+                         d_p, (short*)temp, "short", dataName.c_str());
+#ifdef OPS_3D
+        dataName = "StreamMask_" + label;
+        g_StreamMask[blockIndex] =
             ops_decl_dat(g_Block[blockIndex], NUMCOMPONENTS, size, base, d_m,
                          d_p, (int*)temp, "int", dataName.c_str());
-        dataName = "GeometryProperty_" + label;
-        g_GeometryProperty[blockIndex] =
-            ops_decl_dat(g_Block[blockIndex], 1, size, base, d_m, d_p,
-                         (int*)temp, "int", dataName.c_str());
+#endif
         dataName = "CoordinateXYZ_" + label;
-        g_CoordinateXYZ[blockIndex] =
-            ops_decl_dat(g_Block[blockIndex], SPACEDIM, size, base, d_m, d_p,
-                         (Real*)temp, RealC, dataName.c_str());
+        g_CoordinateXYZ[blockIndex] = DeclRestartableDat(
+            Output_CoordinateXYZ, blockIndex, SPACEDIM, size, base, d_m, d_p,
+            (Real*)temp, RealC, dataName);
         // if steady flow
         // in the future, we may consider to add an option for the "if"
         dataName = "MacroVars_Copy" + label;
         g_MacroVarsCopy[blockIndex] =
             ops_decl_dat(g_Block[blockIndex], NUMMACROVAR, size, base, d_m, d_p,
                          (Real*)temp, RealC, dataName.c_str());
-        for (int localIdx = 0; localIdx < MacroVarsNum(); localIdx++) {
-            g_ResidualErrorHandle[localIdx] = ops_decl_reduction_handle(
-                // this is double
-                sizeof(double), "double", MacroVarName()[localIdx].c_str());
-        }
         // end if steady flow
+#ifdef OPS_3D
+        if (nullptr != g_fMoments) {
+            dataName = "fMoments_" + label;
+            g_fMoments[blockIndex] = DeclRestartableDat(
+                Output_fMoments, blockIndex, NUMCOMPONENTS * FMomentNum, size,
+                base, d_m, d_p, (Real*)temp, RealC, dataName);
+        }
+#endif
         delete[] size;
     }
+    if (nullptr != g_fMoments) {
+        g_fMomentsErrorHandle = ops_decl_reduction_handle(
+            3 * sizeof(double), "double", "fMomentsError");
+    }
+    // if steady flow
+    g_ResidualErrorHandle = ops_decl_reduction_handle(
+        // this is double
+        2 * MacroVarsNum() * sizeof(double), "double", "ResidualError");
+    // end if steady flow
     delete[] d_p;
     delete[] d_m;
     delete[] base;
+    DispMemoryPerNode();
+}
+
+void DispMemoryPerNode() {
+    int numfArray{1};
+    if (nullptr != g_fStage) {
+        numfArray++;
+    }
+    if (nullptr != g_feq) {
+        numfArray++;
+    }
+    if (nullptr != g_Bodyforce) {
+        numfArray++;
+    }
+    const long fBytes{numfArray * NUMXI * (long)sizeof(Real)};
+    // g_MacroVars, g_MacroVarsCopy, g_Tau, g_CoordinateXYZ, g_NodeType and
+    // g_GeometryProperty
+    long otherBytes{
+        (2 * NUMMACROVAR + NUMCOMPONENTS + SPACEDIM) * (long)sizeof(Real) +
+        (NUMCOMPONENTS + 1) * (long)sizeof(int)};
+    if (nullptr != g_fMoments) {
+        otherBytes += NUMCOMPONENTS * FMomentNum * (long)sizeof(Real);
+    }
+    ops_printf(
+        "Memory per node: %li bytes, including %li bytes for %i distribution "
+        "arrays of %i velocities\n",
+        fBytes + otherBytes, fBytes, numfArray, NUMXI);
 }
 
 /*!
@@ -309,12 +716,18 @@ void DefineVariables() {
  * This function can be used for both 2D and 3D cases
  */
 void DefineVariablesFromHDF5() {
+    SetDatLayout();
     void* temp = NULL;
     g_Block = new ops_block[BLOCKNUM];
     g_f = new ops_dat[BLOCKNUM];
-    g_Bodyforce = new ops_dat[BLOCKNUM];
-    g_fStage = new ops_dat[BLOCKNUM];
-    g_feq = new ops_dat[BLOCKNUM];
+    // the AA pattern streams in place so that g_fStage is not needed
+    if (Scheme_StreamCollisionAA != Scheme()) {
+        g_fStage = new ops_dat[BLOCKNUM];
+    }
+    if (!FEQONTHEFLY) {
+        g_Bodyforce = new ops_dat[BLOCKNUM];
+        g_feq = new ops_dat[BLOCKNUM];
+    }
     g_MacroVars = new ops_dat[BLOCKNUM];
     g_Tau = new ops_dat[BLOCKNUM];
     g_CoordinateXYZ = new ops_dat[BLOCKNUM];
@@ -328,9 +741,9 @@ void DefineVariablesFromHDF5() {
         BlockIterRngKmin = new int[BLOCKNUM * 2 * SPACEDIM];
     }
     BlockIterRngBulk = new int[BLOCKNUM * 2 * SPACEDIM];
+    BlockIterRngExtended = new int[BLOCKNUM * 2 * SPACEDIM];
     // if steady flow
     g_MacroVarsCopy = new ops_dat[BLOCKNUM];
-    g_ResidualErrorHandle = new ops_reduction[MacroVarsNum()];
     g_ResidualError = new Real[2 * MacroVarsNum()];
     // end if steady flow
     int haloDepth = HaloDepth();
@@ -354,6 +767,10 @@ void DefineVariablesFromHDF5() {
     // if cutting cell method
     g_NodeType = new ops_dat[BLOCKNUM];
     g_GeometryProperty = new ops_dat[BLOCKNUM];
+#ifdef OPS_3D
+    g_NodeFlag = new ops_dat[BLOCKNUM];
+    g_StreamMask = new ops_dat[BLOCKNUM];
+#endif
     for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
         std::string label(std::to_string(blockIndex));
         std::string blockName("Block_" + label);
@@ -371,6 +788,7 @@ void DefineVariablesFromHDF5() {
         BlockIterRngWhole[blockIndex * 2 * SPACEDIM + 1] = size[0];
         BlockIterRngWhole[blockIndex * 2 * SPACEDIM + 2] = 0;
         BlockIterRngWhole[blockIndex * 2 * SPACEDIM + 3] = size[1];
+        SetDerivedIterRng(blockIndex, size);
         BlockIterRngBulk[blockIndex * 2 * SPACEDIM] = 1;
         BlockIterRngBulk[blockIndex * 2 * SPACEDIM + 1] = size[0] - 1;
         BlockIterRngBulk[blockIndex * 2 * SPACEDIM + 2] = 1;
@@ -421,19 +839,23 @@ void DefineVariablesFromHDF5() {
         dataName += label;
         g_f[blockIndex] =
             ops_decl_dat(g_Block[blockIndex], NUMXI, size, base, d_m, d_p,
-                         (Real*)temp, RealC, dataName.c_str());
-        dataName = "feq_" + label;
-        g_feq[blockIndex] =
-            ops_decl_dat(g_Block[blockIndex], NUMXI, size, base, d_m, d_p,
-                         (Real*)temp, RealC, dataName.c_str());
-        dataName = "fStage_" + label;
-        g_fStage[blockIndex] =
-            ops_decl_dat(g_Block[blockIndex], NUMXI, size, base, d_m, d_p,
-                         (Real*)temp, RealC, dataName.c_str());
-        dataName = "Bodyforce_" + label;
-        g_Bodyforce[blockIndex] =
-            ops_decl_dat(g_Block[blockIndex], NUMXI, size, base, d_m, d_p,
-                         (Real*)temp, RealC, dataName.c_str());
+                         (FReal*)temp, FRealC, dataName.c_str());
+        if (nullptr != g_fStage) {
+            dataName = "fStage_" + label;
+            g_fStage[blockIndex] =
+                ops_decl_dat(g_Block[blockIndex], NUMXI, size, base, d_m, d_p,
+                             (FReal*)temp, FRealC, dataName.c_str());
+        }
+        if (!FEQONTHEFLY) {
+            dataName = "feq_" + label;
+            g_feq[blockIndex] =
+                ops_decl_dat(g_Block[blockIndex], NUMXI, size, base, d_m, d_p,
+                             (FReal*)temp, FRealC, dataName.c_str());
+            dataName = "Bodyforce_" + label;
+            g_Bodyforce[blockIndex] =
+                ops_decl_dat(g_Block[blockIndex], NUMXI, size, base, d_m, d_p,
+                             (Real*)temp, RealC, dataName.c_str());
+        }
         dataName = "MacroVars_" + label;
         g_MacroVars[blockIndex] =
             ops_decl_dat_hdf5(g_Block[blockIndex], NUMMACROVAR, "double",
@@ -449,6 +871,17 @@ void DefineVariablesFromHDF5() {
         dataName = "GeometryProperty_" + label;
         g_GeometryProperty[blockIndex] = ops_decl_dat_hdf5(
             g_Block[blockIndex], 1, "int", dataName.c_str(), fileName.c_str());
+#ifdef OPS_3D
+        // packed again by PackNodeFlags3D so they are not saved
+        dataName = "NodeFlag_" + label;
+        g_NodeFlag[blockIndex] =
+            ops_decl_dat(g_Block[blockIndex], NUMCOMPONENTS, size, base, d_m,
+                         d_p, (short*)temp, "short", dataName.c_str());
+        dataName = "StreamMask_" + label;
+        g_StreamMask[blockIndex] =
+            ops_decl_dat(g_Block[blockIndex], NUMCOMPONENTS, size, base, d_m,
+                         d_p, (int*)temp, "int", dataName.c_str());
+#endif
         dataName = "CoordinateXYZ_" + label;
         g_CoordinateXYZ[blockIndex] =
             ops_decl_dat_hdf5(g_Block[blockIndex], SPACEDIM, RealC,
@@ -459,198 +892,31 @@ void DefineVariablesFromHDF5() {
         g_MacroVarsCopy[blockIndex] =
             ops_decl_dat(g_Block[blockIndex], NUMMACROVAR, size, base, d_m, d_p,
                          (Real*)temp, RealC, dataName.c_str());
-        for (int localIdx = 0; localIdx < MacroVarsNum(); localIdx++) {
-            g_ResidualErrorHandle[localIdx] = ops_decl_reduction_handle(
-                // this is double
-                sizeof(double), "double", MacroVarName()[localIdx].c_str());
-        }
         // end if steady flow
         delete[] size;
     }
+    // if steady flow
+    g_ResidualErrorHandle = ops_decl_reduction_handle(
+        // this is double
+        2 * MacroVarsNum() * sizeof(double), "double", "ResidualError");
+    // end if steady flow
     delete[] d_p;
     delete[] d_m;
     delete[] base;
+    DispMemoryPerNode();
 }
 /*!
- * Manually define the halo relation between blocks.
- * When using
+ * Define the halo relations: the periodic halos set by SetPeriodicHalo and
+ * the halos between the blocks connected by DefineBlockConnection.
  */
 void DefineHaloTransfer() {
-    /*! @brief Defining the halo relationship
-     *  @details Currently we need to manually define them,
-     *  will be modified to read CGNF format in the future
-     **/
-    //     HaloRelationNum = 8;
-    //     HaloRelations = new ops_halo[HaloRelationNum];
-    //     int haloDepth = HaloDepth();
-    //     int d_p[2] =
-    //     { haloDepth, haloDepth }; //max halo depths for the dat in the
-    //     positive
-    //     direction
-    //     int d_m[2] =
-    //     { -haloDepth, -haloDepth }; //max halo depths for the dat in the
-    //     negative direction
-    //     int nx = BlockSize ( 0 ) [0];
-    //     int ny = BlockSize ( 0 ) [0];
-    //     int dir[] =
-    //     { 1, 2 };
-    //     {
-    //         int halo_iter[] =
-    //         { 1, ny[0] + d_p[1] - d_m[1] };
-    //         int base_from[] =
-    //         { 0, d_m[1] };
-    //         int base_to[] =
-    //         { nx, d_m[1] };
-    //         HaloRelations[0] = ops_decl_halo ( g_f[0], g_f[0], halo_iter,
-    //         base_from,
-    //                                      base_to, dir, dir );
-    //         base_from[0] = nx - 1; // need to be changed
-    //         base_to[0] = d_m[0];
-    //         HaloRelations[1] = ops_decl_halo ( g_f[0], g_f[0], halo_iter,
-    //         base_from,
-    //                                      base_to, dir, dir );
-    //     }
-    //     {
-    //         int halo_iter[] =
-    //         { nx + d_p[0] - d_m[0], 1 };
-    //         int base_from[] =
-    //         { d_m[0], 0 };
-    //         int base_to[] =
-    //         { d_m[0], ny };
-    //         HaloRelations[2] = ops_decl_halo ( g_f[0], g_f[0], halo_iter,
-    //         base_from,
-    //                                      base_to, dir, dir );
-    //         base_from[1] = ny - 1; //need to be changed
-    //         base_to[1] = d_m[1];
-    //         HaloRelations[3] = ops_decl_halo ( g_f[0], g_f[0], halo_iter,
-    //         base_from,
-    //                                      base_to, dir, dir );
-    //     }
-    //     // corner points
-    //     {
-    //         //
-    //         int halo_iter[] =
-    //         { 1, 1 };
-    //         int base_from[] =
-    //         { 0, 0 };
-    //         int base_to[] =
-    //         { nx, ny };
-    //         HaloRelations[4] = ops_decl_halo ( g_f[0], g_f[0], halo_iter,
-    //         base_from,
-    //                                      base_to, dir, dir );
-    //         base_from[0] = nx - 1; // need to be changed
-    //         base_from[1] = ny - 1;
-    //         base_to[0] = d_m[0];
-    //         base_to[1] = d_m[1];
-    //         HaloRelations[5] = ops_decl_halo ( g_f[0], g_f[0], halo_iter,
-    //         base_from,
-    //                                      base_to, dir, dir );
-    //     }
-    //     {
-    //         //
-    //         int halo_iter[] =
-    //         { 1, 1 };
-    //         int base_from[] =
-    //         { 0, ny - 1 };
-    //         int base_to[] =
-    //         { nx, d_m[1] };
-    //         HaloRelations[6] = ops_decl_halo ( g_f[0], g_f[0], halo_iter,
-    //         base_from,
-    //                                      base_to, dir, dir );
-    //         base_from[0] = nx - 1; // need to be changed
-    //         base_from[1] = 0;
-    //         base_to[0] = d_m[0];
-    //         base_to[1] = ny;
-    //         HaloRelations[7] = ops_decl_halo ( g_f[0], g_f[0], halo_iter,
-    //         base_from,
-    //                                      base_to, dir, dir );
-    //     }
-    //     HaloGroups = ops_decl_halo_group ( HaloRelationNum,
-    //     HaloRelations );
-
-    HaloRelationNum = 2;
-    HaloRelations = new ops_halo[HaloRelationNum];
-    int haloDepth = HaloDepth();
-    // max halo depths for the dat in the positive direction
-    int d_p[2] = {haloDepth, haloDepth};
-    // max halo depths for the dat in the negative direction
-    int d_m[2] = {-haloDepth, -haloDepth};
-    // The domain size in the Block 0
-    int nx = BlockSize(0)[0];
-    int ny = BlockSize(0)[1];
-    int dir[] = {1, 2};
-    {
-        int halo_iter[] = {nx + d_p[0] - d_m[0], 1};
-        int base_from[] = {d_m[0], 0};
-        int base_to[] = {d_m[0], ny};
-        HaloRelations[0] = ops_decl_halo(g_f[0], g_f[0], halo_iter, base_from,
-                                         base_to, dir, dir);
-        base_from[1] = ny - 1;  // need to be changed
-        base_to[1] = d_m[1];
-        HaloRelations[1] = ops_decl_halo(g_f[0], g_f[0], halo_iter, base_from,
-                                         base_to, dir, dir);
-    }
-
-    HaloGroups = ops_decl_halo_group(HaloRelationNum, HaloRelations);
+    DefinePopulationHalos();
+    DefineBlockHalos();
 }
 
 void DefineHaloTransfer3D() {
-    // This is a hard coded version
-    // could be used as an example for user-defined routines.
-    // HaloRelationNum = 6;
-    // HaloRelations = new ops_halo[HaloRelationNum];
-    // int haloDepth = HaloDepth();
-    // max halo depths for the dat in the positive direction
-    // int d_p[3] = {haloDepth, haloDepth, haloDepth};
-    // // max halo depths for the dat in the negative direction
-    // int d_m[3] = {-haloDepth, -haloDepth, -haloDepth};
-    // The domain size in the Block 0
-    // int nx = BlockSize(0)[0];
-    // int ny = BlockSize(0)[1];
-    // int nz = BlockSize(0)[2];
-    // {
-    //     // Template for the periodic pair (front-back)
-    //     int dir[] = {1, 2, 3};
-    //     int halo_iter[] = {nx + d_p[0] - d_m[0], ny + d_p[0] - d_m[0], 1};
-    //     int base_from[] = {d_m[0], d_m[0], 0};
-    //     int base_to[] = {d_m[0], d_m[0], nz};
-    //     HaloRelations[0] = ops_decl_halo(g_f[0], g_f[0], halo_iter, base_from,
-    //                                      base_to, dir, dir);
-    //     base_from[2] = nz - 1;
-    //     base_to[2] = d_m[1];
-    //     HaloRelations[1] = ops_decl_halo(g_f[0], g_f[0], halo_iter, base_from,
-    //                                      base_to, dir, dir);
-    // }
-
-    // {
-    //     // Template for the periodic pair (left-right)
-    //     int dir[] = {1, 2, 3};
-    //     int halo_iter[] = {1, ny + d_p[0] - d_m[0], nz + d_p[0] - d_m[0]};
-    //     int base_from[] = {0, d_m[0], d_m[0]};
-    //     int base_to[] = {nx, d_m[0], d_m[0]};
-    //     HaloRelations[2] = ops_decl_halo(g_f[0], g_f[0], halo_iter, base_from,
-    //                                      base_to, dir, dir);
-    //     base_from[0] = nx - 1;  // need to be changed
-    //     base_to[0] = d_m[1];
-    //     HaloRelations[3] = ops_decl_halo(g_f[0], g_f[0], halo_iter, base_from,
-    //                                      base_to, dir, dir);
-    // }
-
-    // {
-    //     // Template for the periodic pair (top-bottom)
-    //     int dir[] = {1, 2, 3};
-    //     int halo_iter[] = {nx + d_p[0] - d_m[0], 1 , nz + d_p[0] - d_m[0]};
-    //     int base_from[] = {d_m[0], 0, d_m[0]};
-    //     int base_to[] = {d_m[0], ny, d_m[0]};
-    //     HaloRelations[4] = ops_decl_halo(g_f[0], g_f[0], halo_iter, base_from,
-    //                                      base_to, dir, dir);
-    //     base_from[1] = ny - 1;  // need to be changed
-    //     base_to[1] = d_m[1];
-    //     HaloRelations[5] = ops_decl_halo(g_f[0], g_f[0], halo_iter, base_from,
-    //                                      base_to, dir, dir);
-    // }
-
-    // HaloGroups = ops_decl_halo_group(HaloRelationNum, HaloRelations);
+    DefinePopulationHalos();
+    DefineBlockHalos();
 }
 /*
  * We need a name to specify which file to input
@@ -680,9 +946,17 @@ void WriteDistributionsToHdf5(const long timeStep) {
         std::string fileName = CASENAME + "_" + blockName + ".h5";
         ops_fetch_block_hdf5_file(g_Block[blockIndex], fileName.c_str());
         ops_fetch_dat_hdf5_file(g_f[blockIndex], fileName.c_str());
-        ops_fetch_dat_hdf5_file(g_feq[blockIndex], fileName.c_str());
-        ops_fetch_dat_hdf5_file(g_fStage[blockIndex], fileName.c_str());
-        ops_fetch_dat_hdf5_file(g_Bodyforce[blockIndex], fileName.c_str());
+        if (nullptr != g_fStage) {
+            ops_fetch_dat_hdf5_file(g_fStage[blockIndex], fileName.c_str());
+        }
+        // g_feq and g_Bodyforce do not exist if they are calculated on the
+        // fly, and they can be recovered from the macroscopic variables
+        if (nullptr != g_feq) {
+            ops_fetch_dat_hdf5_file(g_feq[blockIndex], fileName.c_str());
+        }
+        if (nullptr != g_Bodyforce) {
+            ops_fetch_dat_hdf5_file(g_Bodyforce[blockIndex], fileName.c_str());
+        }
     }
 }
 
@@ -700,87 +974,2113 @@ void WriteNodePropertyToHdf5(const long timeStep) {
     }
 }
 
-void DefineHaloTransferFromHdf5() {}
+std::string OutputFileName(const int blockIndex, const std::string& suffix) {
+    return CASENAME + "_Block_" + std::to_string(blockIndex) + "_" + suffix +
+           ".h5";
+}
+
+ops_dat* OutputFieldDats(const OutputField field) {
+    switch (field) {
+        case Output_MacroVars:
+            return g_MacroVars;
+        case Output_Tau:
+            return g_Tau;
+        case Output_CoordinateXYZ:
+            return g_CoordinateXYZ;
+        case Output_f:
+            return g_f;
+        case Output_fStage:
+            return g_fStage;
+        case Output_feq:
+            return g_feq;
+        case Output_Bodyforce:
+            return g_Bodyforce;
+        case Output_GeometryProperty:
+            return g_GeometryProperty;
+        case Output_NodeType:
+            return g_NodeType;
+        case Output_fMoments:
+            return g_fMoments;
+        default:
+            return nullptr;
+    }
+}
+
+void SetOutputPeriod(const OutputField field, const int period) {
+    if (period < OutputPeriod_Once) {
+        ops_printf("Error: the output period %i of the field %i is invalid!\n",
+                   period, field);
+        assert(period >= OutputPeriod_Once);
+    }
+    OUTPUTPERIOD.at(field) = period;
+    if (Output_MacroVars == field) {
+        MacroVarsPeriodSet = true;
+    }
+}
+
+int OutputPeriod(const OutputField field) { return OUTPUTPERIOD.at(field); }
+
 /*
- * Importing geometry from an external HDF5 file
+ * If the macroscopic variables are only densities and velocities, which the
+ * moments of f keep, so that a compressed checkpoint does not need them
  */
-void SetupFlowfieldfromHdf5() {
-    CASENAME = "Cavity3D";  // Input parameter
-    SPACEDIM = 3;
-    BLOCKNUM = 1;  // Input parameter
-    BLOCKSIZE = new int[BLOCKNUM * SPACEDIM];
-    BLOCKSIZE[0] = 101;  // Input parameters
-    BLOCKSIZE[1] = 101;  // Input parameters
-    BLOCKSIZE[2] = 3;    // Input parameters
+bool MacroVarsInMoments() {
+    if (3 != SPACEDIM) {
+        return false;
+    }
+    for (int macroVarIdx = 0; macroVarIdx < MacroVarsNum(); macroVarIdx++) {
+        if (VARIABLETYPE[macroVarIdx] > Variable_W) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    TAUREF = new Real[ComponentNum()];
-    TAUREF[0] = 0.001;  // Input parameters
-    // All above parameters should be written down by the python script
-    Real minDx{1. / 100};  // Input parameters at this moment
-    Real minDy{1. / 100};  // Input parameters at this moment
-    // DT = 0.01 * fmin(minDx, minDy) / MaximumSpeed();  // finite difference
-    // scheme
-    // DT = 0.0001414;
-    // DT = fmin(fmin(minDx, minDy) / MaximumSpeed(),
-    //              0.5 * TAUREF[0]);  // finite difference scheme
-    DT = minDx / SoundSpeed();  // stream-collision
-    HALODEPTH = HaloPtNum();
-    ops_printf("%s\n", "Starting to allocate...");
-    DefineVariablesFromHDF5();
-    DefineHaloTransfer3D();
-    // above calls must be before the ops_partition call
-    ops_partition((char*)"LBM");
+/*
+ * The allocated fields to be written into the files of timeStep
+ */
+std::vector<OutputField> OutputFields(const long timeStep) {
+    // a compressed checkpoint skips the macroscopic variables by default, as
+    // they are rebuilt from the moments of f when restarting
+    const bool skipMacroVars{
+        !MacroVarsPeriodSet && OutputPeriod_Never == OUTPUTPERIOD[Output_f] &&
+        OUTPUTPERIOD[Output_fMoments] > 0 && MacroVarsInMoments()};
+    std::vector<OutputField> fields;
+    for (int field = 0; field < OutputFieldNum; field++) {
+        const int period{OUTPUTPERIOD[field]};
+        if (Output_MacroVars == field && skipMacroVars) {
+            continue;
+        }
+        if (period > 0 && (timeStep % period) == 0 &&
+            nullptr != OutputFieldDats((OutputField)field)) {
+            fields.push_back((OutputField)field);
+        }
+    }
+    return fields;
 }
 
-const std::string CaseName() { return CASENAME; }
-void SetCaseName(const std::string caseName) { CASENAME = caseName; }
-void setCaseName(const char* caseName) {
-    std::string tmp(caseName);
-    CASENAME = tmp;
+/*
+ * The allocated fields that are written only once
+ */
+std::vector<OutputField> StaticOutputFields() {
+    std::vector<OutputField> fields;
+    for (int field = 0; field < OutputFieldNum; field++) {
+        if (OutputPeriod_Once == OUTPUTPERIOD[field] &&
+            nullptr != OutputFieldDats((OutputField)field)) {
+            fields.push_back((OutputField)field);
+        }
+    }
+    return fields;
 }
 
-const int BlockNum() { return BLOCKNUM; }
-const int SpaceDim() { return SPACEDIM; }
-const int HaloDepth() { return HALODEPTH; }
+/*
+ * Link the static fields of the block into the file of a time step, so that a
+ * reader finds them in every file, e.g., ReadOPSDataHDF53D in PostProcess.py.
+ * OPS reopens a file that exists, e.g., when a case is run again or restarted,
+ * so that a link written before is replaced.
+ */
+void LinkStaticOutput(const std::string& fileName, const int blockIndex) {
+    const std::vector<OutputField> fields{StaticOutputFields()};
+    if (fields.empty() || !ops_is_root()) {
+        return;
+    }
+    const std::string staticFile{OutputFileName(blockIndex, "static")};
+    // a relative link is resolved against the directory of fileName
+    const std::string target{staticFile.substr(staticFile.rfind('/') + 1)};
+    const std::string group{"Block_" + std::to_string(blockIndex) + "/"};
+    hid_t file{CheckHdf5(
+        H5Fopen(fileName.c_str(), H5F_ACC_RDWR, H5P_DEFAULT), "H5Fopen",
+        fileName)};
+    for (const OutputField field : fields) {
+        const std::string path{group +
+                               OutputFieldDats(field)[blockIndex]->name};
+        if (H5Lexists(file, path.c_str(), H5P_DEFAULT) > 0) {
+            CheckHdf5(H5Ldelete(file, path.c_str(), H5P_DEFAULT), "H5Ldelete",
+                      path);
+        }
+        CheckHdf5(H5Lcreate_external(target.c_str(), path.c_str(), file,
+                                     path.c_str(), H5P_DEFAULT, H5P_DEFAULT),
+                  "H5Lcreate_external", path);
+    }
+    H5Fclose(file);
+}
 
-void SetHaloDepth(const int haloDepth) { HALODEPTH = haloDepth; }
-void SetHaloRelationNum(const int haloRelationNum) {
-    HaloRelationNum = haloRelationNum;
+void SetOutputMode(const OutputMode mode) {
+    // the writer thread finishes the files of the previous mode
+    StopCheckpointWriter();
+    CloseOutputFiles();
+    OUTPUTMODE = mode;
+    // the static fields are written again in the new mode
+    StaticOutputWritten = false;
 }
 
-void DestroyFlowfield() {
-    FreeArrayMemory(g_f);
-    FreeArrayMemory(g_fStage);
-    FreeArrayMemory(g_feq);
-    FreeArrayMemory(g_Bodyforce);
-    FreeArrayMemory(g_Block);
-    FreeArrayMemory(g_MacroVars);
-    FreeArrayMemory(g_Tau);
-    FreeArrayMemory(TAUREF);
-    FreeArrayMemory(g_CoordinateXYZ);
-    if (HaloRelationNum > 0) FreeArrayMemory(HaloRelations);
-    FreeArrayMemory(g_NodeType);
-    FreeArrayMemory(g_GeometryProperty);
-    FreeArrayMemory(BlockIterRngWhole);
-    FreeArrayMemory(BlockIterRngBulk);
-    FreeArrayMemory(BlockIterRngImax);
-    FreeArrayMemory(BlockIterRngImin);
-    FreeArrayMemory(BlockIterRngJmax);
-    FreeArrayMemory(BlockIterRngJmin);
-    FreeArrayMemory(BLOCKSIZE);
-    // if steady flow
-    FreeArrayMemory(g_MacroVarsCopy);
-    FreeArrayMemory(g_ResidualErrorHandle);
-    FreeArrayMemory(g_ResidualError);
-    if (3 == SPACEDIM) {
-        FreeArrayMemory(BlockIterRngKmax);
-        FreeArrayMemory(BlockIterRngKmin);
+void SetSharedFileLayout(const std::vector<int>& chunkSize,
+                         const long alignThreshold, const long alignment) {
+    if (!chunkSize.empty() && SPACEDIM != (int)chunkSize.size()) {
+        ops_printf("Error: the chunk size must have %i elements!\n", SPACEDIM);
+        assert(SPACEDIM == (int)chunkSize.size());
     }
-    // end if steady flow
-    // delete[] halos;
+    SHAREDFILECHUNK = chunkSize;
+    SHAREDFILEALIGNTHRESHOLD = alignThreshold;
+    SHAREDFILEALIGNMENT = alignment;
 }
 
-const ops_halo_group HaloGroup() { return HaloGroups; }
+std::string SharedOutputFileName(const std::string& suffix) {
+    return CASENAME + "_" + suffix + ".h5";
+}
+
+/*
+ * The HDF5 type, the XDMF type and the size in bytes of the type of a dat
+ */
+hid_t Hdf5Type(const std::string& type) {
+    if ("int" == type) {
+        return H5T_NATIVE_INT;
+    }
+    if ("short" == type) {
+        return H5T_NATIVE_SHORT;
+    }
+    if ("float" == type) {
+        return H5T_NATIVE_FLOAT;
+    }
+    return H5T_NATIVE_DOUBLE;
+}
+
+std::string XdmfType(const std::string& type) {
+    if ("int" == type || "short" == type) {
+        return "Int";
+    }
+    return "Float";
+}
+
+int TypeSize(const std::string& type) {
+    if ("int" == type) {
+        return sizeof(int);
+    }
+    if ("short" == type) {
+        return sizeof(short);
+    }
+    if ("float" == type) {
+        return sizeof(float);
+    }
+    return sizeof(double);
+}
+
+/*
+ * Write the fields into the per-block files written by OPS, see
+ * BlockFilesByOps, and return the bytes of the nodes without halos, i.e., the
+ * same payload as the shared file, although OPS writes the halos as well
+ */
+long WriteBlockFiles(const long timeStep,
+                     const std::vector<OutputField>& fields) {
+    long bytes{0};
+    const std::string suffix{StaticOutputStep == timeStep
+                                 ? "static"
+                                 : std::to_string(timeStep)};
+    for (int blockIndex = 0; blockIndex < BLOCKNUM; blockIndex++) {
+        std::string fileName{OutputFileName(blockIndex, suffix)};
+        ops_fetch_block_hdf5_file(g_Block[blockIndex], fileName.c_str());
+        long nodeNum{1};
+        for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+            nodeNum *= BlockSize(blockIndex)[cordIdx];
+        }
+        for (int fieldIdx = 0; fieldIdx < (int)fields.size(); fieldIdx++) {
+            const ops_dat dat{OutputFieldDats(fields[fieldIdx])[blockIndex]};
+            ops_fetch_dat_hdf5_file(dat, fileName.c_str());
+            bytes += nodeNum * dat->dim * TypeSize(dat->type);
+        }
+        if (StaticOutputStep != timeStep) {
+            LinkStaticOutput(fileName, blockIndex);
+        }
+    }
+    return bytes;
+}
+
+/*
+ * The dimensions and the chunk size of the (nz, ny, nx, dim) dataset of a dat,
+ * i.e., (ny, nx, dim) in 2D, for the nodes of the block without halos
+ */
+void DatasetDims(const int blockIndex, const ops_dat dat, hsize_t* dims,
+                 hsize_t* chunk) {
+    for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+        const int axis{SPACEDIM - 1 - cordIdx};
+        dims[axis] = BlockSize(blockIndex)[cordIdx];
+        chunk[axis] = dims[axis];
+        if (!SHAREDFILECHUNK.empty() && SHAREDFILECHUNK[cordIdx] > 0) {
+            chunk[axis] =
+                std::min(dims[axis], (hsize_t)SHAREDFILECHUNK[cordIdx]);
+        }
+    }
+    dims[SPACEDIM] = dat->dim;
+    chunk[SPACEDIM] = dat->dim;
+}
+
+/*
+ * Set the hyperslab of the part of a dat owned by this rank in the dataset of
+ * DatasetDims, and return its number of nodes, 0 if the rank owns no part
+ */
+long OwnedPart(const ops_dat dat, hsize_t* start, hsize_t* count) {
+    for (int axis = 0; axis < SPACEDIM; axis++) {
+        start[axis] = 0;
+        count[axis] = 0;
+    }
+    start[SPACEDIM] = 0;
+    count[SPACEDIM] = dat->dim;
+    if (ops_dat_get_local_npartitions(dat) <= 0) {
+        return 0;
+    }
+    int disp[3]{0, 0, 0};
+    int sizes[3]{1, 1, 1};
+    ops_dat_get_extents(dat, 0, disp, sizes);
+    long nodeNum{1};
+    for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+        start[SPACEDIM - 1 - cordIdx] = disp[cordIdx];
+        count[SPACEDIM - 1 - cordIdx] = sizes[cordIdx];
+        nodeNum *= sizes[cordIdx];
+    }
+    return nodeNum;
+}
+
+/*
+ * Convert the data between the layout of a dat and the dataset, where the
+ * components of a node are together, i.e., only needed by the SoA layout
+ */
+void TransposeComponents(std::vector<char>& data, const ops_dat dat,
+                         const long nodeNum, const bool toDataset) {
+#ifdef OPS_SOA
+    const int typeSize{TypeSize(dat->type)};
+    const std::vector<char> copy(data);
+    for (long nodeIdx = 0; nodeIdx < nodeNum; nodeIdx++) {
+        for (int compoIdx = 0; compoIdx < dat->dim; compoIdx++) {
+            long soaPos{(compoIdx * nodeNum + nodeIdx) * typeSize};
+            long aosPos{(nodeIdx * dat->dim + compoIdx) * typeSize};
+            if (!toDataset) {
+                std::swap(soaPos, aosPos);
+            }
+            std::copy_n(copy.begin() + soaPos, typeSize,
+                        data.begin() + aosPos);
+        }
+    }
+#endif
+}
+
+/*
+ * Fetch the part of a dat owned by this rank into part, whose buffer is
+ * reused if it is large enough
+ */
+void FetchOutputPart(const int blockIndex, const ops_dat dat,
+                     OutputPart& part) {
+    part.name = dat->name;
+    part.type = dat->type;
+    DatasetDims(blockIndex, dat, part.dims, part.chunk);
+    const long nodeNum{OwnedPart(dat, part.start, part.count)};
+    part.owned = nodeNum > 0;
+    part.data.resize(nodeNum * dat->dim * TypeSize(dat->type));
+    if (part.owned) {
+        ops_dat_fetch_data(dat, 0, part.data.data());
+        // the fetched data keep the layout of the dat
+        TransposeComponents(part.data, dat, nodeNum, true);
+    }
+}
+
+/*
+ * Fetch the owned parts of the fields into
+ * parts[fieldIdx * BLOCKNUM + blockIndex]
+ */
+void FetchOutputParts(const std::vector<OutputField>& fields,
+                      std::vector<OutputPart>& parts) {
+    parts.resize(fields.size() * BLOCKNUM);
+    for (int fieldIdx = 0; fieldIdx < (int)fields.size(); fieldIdx++) {
+        for (int blockIndex = 0; blockIndex < BLOCKNUM; blockIndex++) {
+            FetchOutputPart(blockIndex,
+                            OutputFieldDats(fields[fieldIdx])[blockIndex],
+                            parts[fieldIdx * BLOCKNUM + blockIndex]);
+        }
+    }
+}
+
+/*
+ * Write an owned part into the hyperslab of fileSpace, where every rank takes
+ * part in the collective write even if it owns no part
+ */
+void WriteOwnedPart(const hid_t dataset, const hid_t fileSpace,
+                    const OutputPart& part, const int rank,
+                    const hsize_t* start, const hsize_t* count,
+                    const hid_t dxpl) {
+    hid_t memSpace{
+        CheckHdf5(H5Screate_simple(rank, count, NULL), "H5Screate_simple",
+                  part.name)};
+    if (part.owned) {
+        H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, start, NULL, count,
+                            NULL);
+    } else {
+        H5Sselect_none(fileSpace);
+        H5Sselect_none(memSpace);
+    }
+    CheckHdf5(H5Dwrite(dataset, Hdf5Type(part.type), memSpace, fileSpace,
+                       dxpl, part.data.data()),
+              "H5Dwrite", part.name);
+    H5Sclose(memSpace);
+}
+
+/*
+ * Write an owned part into the dataset of the same name in group, so that
+ * each rank writes the hyperslab of its own part, and return the bytes
+ * written
+ */
+long WriteSharedDataset(const hid_t group, const OutputPart& part,
+                        const hid_t dxpl) {
+    const int rank{SPACEDIM + 1};
+    hid_t fileSpace{
+        CheckHdf5(H5Screate_simple(rank, part.dims, NULL), "H5Screate_simple",
+                  part.name)};
+    hid_t dcpl{H5Pcreate(H5P_DATASET_CREATE)};
+    if (!SHAREDFILECHUNK.empty()) {
+        CheckHdf5(H5Pset_chunk(dcpl, rank, part.chunk), "H5Pset_chunk",
+                  part.name);
+    }
+    hid_t dataset{CheckHdf5(
+        H5Dcreate2(group, part.name.c_str(), Hdf5Type(part.type), fileSpace,
+                   H5P_DEFAULT, dcpl, H5P_DEFAULT),
+        "H5Dcreate2", part.name)};
+    WriteOwnedPart(dataset, fileSpace, part, rank, part.start, part.count,
+                   dxpl);
+    H5Dclose(dataset);
+    H5Pclose(dcpl);
+    H5Sclose(fileSpace);
+    long bytes{TypeSize(part.type)};
+    for (int axis = 0; axis < rank; axis++) {
+        bytes *= part.dims[axis];
+    }
+    return bytes;
+}
+
+/*
+ * Write the XDMF description of the shared file of timeStep, so that it can
+ * be opened by visualisation tools, e.g., ParaView, directly
+ */
+void WriteXdmf(const long timeStep, const std::vector<OutputField>& fields) {
+    if (!ops_is_root()) {
+        return;
+    }
+    std::vector<OutputField> allFields{fields};
+    for (const OutputField field : StaticOutputFields()) {
+        allFields.push_back(field);
+    }
+    const std::string fileName{SharedOutputFileName(std::to_string(timeStep))};
+    const std::string h5Name{fileName.substr(fileName.rfind('/') + 1)};
+    std::ofstream xdmf(fileName.substr(0, fileName.size() - 3) + ".xmf");
+    xdmf << "<?xml version=\"1.0\" ?>\n"
+         << "<Xdmf Version=\"2.0\">\n<Domain>\n"
+         << "<Grid Name=\"" << CASENAME
+         << "\" GridType=\"Collection\" CollectionType=\"Spatial\">\n"
+         << "<Time Value=\"" << timeStep * TimeStep() << "\"/>\n";
+    const bool hasCoordinates{
+        std::find(allFields.begin(), allFields.end(), Output_CoordinateXYZ) !=
+        allFields.end()};
+    for (int blockIndex = 0; blockIndex < BLOCKNUM; blockIndex++) {
+        const std::string group{h5Name + ":/Block_" +
+                                std::to_string(blockIndex) + "/"};
+        std::string nodeDims;
+        for (int cordIdx = SPACEDIM - 1; cordIdx >= 0; cordIdx--) {
+            nodeDims += std::to_string(BlockSize(blockIndex)[cordIdx]) +
+                        (cordIdx > 0 ? " " : "");
+        }
+        const std::string dimName{std::to_string(SPACEDIM) + "D"};
+        xdmf << "<Grid Name=\"Block_" << blockIndex
+             << "\" GridType=\"Uniform\">\n";
+        if (hasCoordinates) {
+            const ops_dat xyz{g_CoordinateXYZ[blockIndex]};
+            xdmf << "<Topology TopologyType=\"" << dimName
+                 << "SMesh\" Dimensions=\"" << nodeDims << "\"/>\n"
+                 << "<Geometry GeometryType=\""
+                 << (3 == SPACEDIM ? "XYZ" : "XY") << "\">\n"
+                 << "<DataItem Dimensions=\"" << nodeDims << " " << SPACEDIM
+                 << "\" NumberType=\"Float\" Precision=\""
+                 << TypeSize(xyz->type) << "\" Format=\"HDF\">" << group
+                 << xyz->name << "</DataItem>\n</Geometry>\n";
+        } else {
+            const std::string zeros{3 == SPACEDIM ? "0 0 0" : "0 0"};
+            const std::string ones{3 == SPACEDIM ? "1 1 1" : "1 1"};
+            xdmf << "<Topology TopologyType=\"" << dimName
+                 << "CoRectMesh\" Dimensions=\"" << nodeDims << "\"/>\n"
+                 << "<Geometry GeometryType=\"ORIGIN_DXDYDZ\">\n"
+                 << "<DataItem Dimensions=\"" << SPACEDIM
+                 << "\" Format=\"XML\">" << zeros << "</DataItem>\n"
+                 << "<DataItem Dimensions=\"" << SPACEDIM
+                 << "\" Format=\"XML\">" << ones << "</DataItem>\n"
+                 << "</Geometry>\n";
+        }
+        for (const OutputField field : allFields) {
+            if (Output_CoordinateXYZ == field) {
+                continue;
+            }
+            const ops_dat dat{OutputFieldDats(field)[blockIndex]};
+            for (int compoIdx = 0; compoIdx < dat->dim; compoIdx++) {
+                std::string name{dat->name};
+                if (Output_MacroVars == field) {
+                    name = MacroVarName().at(compoIdx) + "_" +
+                           std::to_string(blockIndex);
+                } else if (dat->dim > 1) {
+                    name += "_" + std::to_string(compoIdx);
+                }
+                // select the component by a hyperslab of the dataset
+                xdmf << "<Attribute Name=\"" << name
+                     << "\" AttributeType=\"Scalar\" Center=\"Node\">\n"
+                     << "<DataItem ItemType=\"HyperSlab\" Dimensions=\""
+                     << nodeDims << " 1\">\n"
+                     << "<DataItem Dimensions=\"3 " << SPACEDIM + 1
+                     << "\" Format=\"XML\">" << (3 == SPACEDIM ? "0 " : "")
+                     << "0 0 " << compoIdx << (3 == SPACEDIM ? " 1" : "")
+                     << " 1 1 1 " << nodeDims << " 1</DataItem>\n"
+                     << "<DataItem Dimensions=\"" << nodeDims << " "
+                     << dat->dim << "\" NumberType=\"" << XdmfType(dat->type)
+                     << "\" Precision=\"" << TypeSize(dat->type)
+                     << "\" Format=\"HDF\">" << group << dat->name
+                     << "</DataItem>\n</DataItem>\n</Attribute>\n";
+            }
+        }
+        xdmf << "</Grid>\n";
+    }
+    xdmf << "</Grid>\n</Domain>\n</Xdmf>\n";
+}
+
+/*
+ * Replace an attribute of an HDF5 object, e.g., a file, by an array of values
+ */
+template <typename T>
+void WriteAttribute(const hid_t object, const char* name, const hid_t type,
+                    const std::vector<T>& values) {
+    if (H5Aexists(object, name) > 0) {
+        H5Adelete(object, name);
+    }
+    const hsize_t size{values.size()};
+    hid_t space{
+        CheckHdf5(H5Screate_simple(1, &size, NULL), "H5Screate_simple", name)};
+    hid_t attribute{CheckHdf5(
+        H5Acreate2(object, name, type, space, H5P_DEFAULT, H5P_DEFAULT),
+        "H5Acreate2", name)};
+    CheckHdf5(H5Awrite(attribute, type, values.data()), "H5Awrite", name);
+    H5Aclose(attribute);
+    H5Sclose(space);
+}
+
+/*
+ * Read an attribute of an HDF5 object as an array of values
+ */
+template <typename T>
+std::vector<T> ReadAttribute(const hid_t object, const char* name,
+                             const hid_t type) {
+    hid_t attribute{
+        CheckHdf5(H5Aopen(object, name, H5P_DEFAULT), "H5Aopen", name)};
+    hid_t space{H5Aget_space(attribute)};
+    std::vector<T> values(H5Sget_simple_extent_npoints(space));
+    CheckHdf5(H5Aread(attribute, type, values.data()), "H5Aread", name);
+    H5Sclose(space);
+    H5Aclose(attribute);
+    return values;
+}
+
+/*
+ * The access property list of the files written by HDF5, i.e., collective
+ * over OutputComm under MPI
+ */
+hid_t OutputFileAccess() {
+    hid_t fapl{H5Pcreate(H5P_FILE_ACCESS)};
+#ifdef OPS_MPI
+    H5Pset_fapl_mpio(fapl, OutputComm, MPI_INFO_NULL);
+#endif
+    if (SHAREDFILEALIGNMENT > 1) {
+        H5Pset_alignment(fapl, SHAREDFILEALIGNTHRESHOLD, SHAREDFILEALIGNMENT);
+    }
+    return fapl;
+}
+
+/*
+ * Write the owned parts of the fields of the blocks [firstBlock, lastBlock)
+ * into fileName by the collective I/O of parallel HDF5, link the static fields
+ * in staticFile into it, and return the bytes written
+ */
+long WritePartFile(const long timeStep, const std::string& fileName,
+                   const std::string& staticFile, const int firstBlock,
+                   const int lastBlock, const std::vector<OutputPart>& parts) {
+    hid_t fapl{OutputFileAccess()};
+    hid_t file{
+        CheckHdf5(H5Fcreate(fileName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, fapl),
+                  "H5Fcreate", fileName)};
+    H5Pclose(fapl);
+    hid_t dxpl{H5Pcreate(H5P_DATASET_XFER)};
+#ifdef OPS_MPI
+    H5Pset_dxpl_mpio(dxpl, H5FD_MPIO_COLLECTIVE);
+#endif
+    std::vector<OutputField> staticFields;
+    if (StaticOutputStep != timeStep) {
+        staticFields = StaticOutputFields();
+    }
+    const std::string target{staticFile.substr(staticFile.rfind('/') + 1)};
+    long bytes{0};
+    for (int blockIndex = firstBlock; blockIndex < lastBlock; blockIndex++) {
+        const std::string groupName{"Block_" + std::to_string(blockIndex)};
+        hid_t group{CheckHdf5(H5Gcreate2(file, groupName.c_str(),
+                                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT),
+                              "H5Gcreate2", groupName)};
+        for (int partIdx = blockIndex; partIdx < (int)parts.size();
+             partIdx += BLOCKNUM) {
+            bytes += WriteSharedDataset(group, parts[partIdx], dxpl);
+        }
+        for (const OutputField field : staticFields) {
+            const char* name{OutputFieldDats(field)[blockIndex]->name};
+            const std::string path{"/" + groupName + "/" + name};
+            CheckHdf5(H5Lcreate_external(target.c_str(), path.c_str(), group,
+                                         name, H5P_DEFAULT, H5P_DEFAULT),
+                      "H5Lcreate_external", path);
+        }
+        H5Gclose(group);
+    }
+    // the nodes are written without halos, unlike the files of OPS, which a
+    // restart tells by this attribute, see SetRestart
+    WriteAttribute(file, "HaloDepth", H5T_NATIVE_INT, std::vector<int>{0});
+    H5Pclose(dxpl);
+    H5Fclose(file);
+    return bytes;
+}
+
+/*
+ * Write the owned parts of the fields of all the blocks into a single file,
+ * and return the bytes written
+ */
+long WriteSharedFile(const long timeStep,
+                     const std::vector<OutputPart>& parts) {
+    const std::string fileName{SharedOutputFileName(
+        StaticOutputStep == timeStep ? "static" : std::to_string(timeStep))};
+    return WritePartFile(timeStep, fileName, SharedOutputFileName("static"), 0,
+                         BLOCKNUM, parts);
+}
+
+/*
+ * Write the owned parts of the fields into a file for each block, which is
+ * named as those of OPS but keeps the nodes without halos, see
+ * BlockFilesByOps, and return the bytes written
+ */
+long WriteBlockPartFiles(const long timeStep,
+                         const std::vector<OutputPart>& parts) {
+    const std::string suffix{StaticOutputStep == timeStep
+                                 ? "static"
+                                 : std::to_string(timeStep)};
+    long bytes{0};
+    for (int blockIndex = 0; blockIndex < BLOCKNUM; blockIndex++) {
+        bytes += WritePartFile(timeStep, OutputFileName(blockIndex, suffix),
+                               OutputFileName(blockIndex, "static"),
+                               blockIndex, blockIndex + 1, parts);
+    }
+    return bytes;
+}
+
+/*
+ * If this rank is the root of the output files, which the checkpoint writer
+ * thread can also call, as it does not call OPS
+ */
+bool OutputRoot() {
+#ifdef OPS_MPI
+    int rank{0};
+    MPI_Comm_rank(OutputComm, &rank);
+    return 0 == rank;
+#else
+    return true;
+#endif
+}
+
+/*
+ * Write a value at index of a 1-D dataset of the time-series file, which is
+ * created with an unlimited dimension at the first value and extended to
+ * index + 1 values, e.g., the step of each slice. Every rank takes part in
+ * the collective write but only the root writes the value.
+ */
+void WriteSeriesValue(const char* name, const hid_t type, const void* value,
+                      const hsize_t index, const hid_t dxpl) {
+    const hsize_t size{index + 1};
+    hid_t dataset;
+    if (H5Lexists(SeriesFile, name, H5P_DEFAULT) > 0) {
+        dataset = CheckHdf5(H5Dopen2(SeriesFile, name, H5P_DEFAULT),
+                            "H5Dopen2", name);
+        CheckHdf5(H5Dset_extent(dataset, &size), "H5Dset_extent", name);
+    } else {
+        const hsize_t maxSize{H5S_UNLIMITED};
+        hid_t space{CheckHdf5(H5Screate_simple(1, &size, &maxSize),
+                              "H5Screate_simple", name)};
+        hid_t dcpl{H5Pcreate(H5P_DATASET_CREATE)};
+        CheckHdf5(H5Pset_chunk(dcpl, 1, &SeriesValueChunk), "H5Pset_chunk",
+                  name);
+        dataset = CheckHdf5(H5Dcreate2(SeriesFile, name, type, space,
+                                       H5P_DEFAULT, dcpl, H5P_DEFAULT),
+                            "H5Dcreate2", name);
+        H5Pclose(dcpl);
+        H5Sclose(space);
+    }
+    hid_t fileSpace{CheckHdf5(H5Dget_space(dataset), "H5Dget_space", name)};
+    const hsize_t count{1};
+    hid_t memSpace{
+        CheckHdf5(H5Screate_simple(1, &count, NULL), "H5Screate_simple", name)};
+    if (OutputRoot()) {
+        H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, &index, NULL, &count,
+                            NULL);
+    } else {
+        H5Sselect_none(fileSpace);
+        H5Sselect_none(memSpace);
+    }
+    CheckHdf5(H5Dwrite(dataset, type, memSpace, fileSpace, dxpl, value),
+              "H5Dwrite", name);
+    H5Sclose(memSpace);
+    H5Sclose(fileSpace);
+    H5Dclose(dataset);
+}
+
+/*
+ * Read the values of a 1-D dataset of a file, e.g., the step of each slice of
+ * the time-series file, which are empty if there is no such dataset
+ */
+template <typename T>
+std::vector<T> ReadSeriesValues(const hid_t file, const char* name,
+                                const hid_t type) {
+    std::vector<T> values;
+    if (H5Lexists(file, name, H5P_DEFAULT) <= 0) {
+        return values;
+    }
+    hid_t dataset{
+        CheckHdf5(H5Dopen2(file, name, H5P_DEFAULT), "H5Dopen2", name)};
+    hid_t space{CheckHdf5(H5Dget_space(dataset), "H5Dget_space", name)};
+    values.resize(H5Sget_simple_extent_npoints(space));
+    if (!values.empty()) {
+        CheckHdf5(H5Dread(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                          values.data()),
+                  "H5Dread", name);
+    }
+    H5Sclose(space);
+    H5Dclose(dataset);
+    return values;
+}
+
+/*
+ * Reload the step and the time of each slice of the reopened time-series file,
+ * and drop the slices after the checkpoint of a restart, which are written
+ * again
+ */
+void ReloadSeriesSteps(const bool restart) {
+    SeriesSteps =
+        ReadSeriesValues<long>(SeriesFile, "Step", H5T_NATIVE_LONG);
+    SeriesTimes =
+        ReadSeriesValues<double>(SeriesFile, "Time", H5T_NATIVE_DOUBLE);
+    hsize_t sliceNum{SeriesSteps.size()};
+    if (restart) {
+        sliceNum = std::upper_bound(SeriesSteps.begin(), SeriesSteps.end(),
+                                    RESTARTSTEP) -
+                   SeriesSteps.begin();
+    }
+    if (sliceNum == SeriesSteps.size()) {
+        return;
+    }
+    for (int blockIndex = 0; blockIndex < BLOCKNUM; blockIndex++) {
+        const std::string groupName{"Block_" + std::to_string(blockIndex)};
+        hid_t group{
+            CheckHdf5(H5Gopen2(SeriesFile, groupName.c_str(), H5P_DEFAULT),
+                      "H5Gopen2", groupName)};
+        for (int field = 0; field < OutputFieldNum; field++) {
+            const ops_dat* dats{OutputFieldDats((OutputField)field)};
+            // the static fields are links without a time dimension
+            if (nullptr == dats || OutputPeriod_Once == OUTPUTPERIOD[field] ||
+                H5Lexists(group, dats[blockIndex]->name, H5P_DEFAULT) <= 0) {
+                continue;
+            }
+            const char* name{dats[blockIndex]->name};
+            hid_t dataset{CheckHdf5(H5Dopen2(group, name, H5P_DEFAULT),
+                                    "H5Dopen2", name)};
+            hid_t fileSpace{
+                CheckHdf5(H5Dget_space(dataset), "H5Dget_space", name)};
+            hsize_t dims[5];
+            if (SPACEDIM + 2 == H5Sget_simple_extent_ndims(fileSpace)) {
+                H5Sget_simple_extent_dims(fileSpace, dims, NULL);
+                dims[0] = std::min(dims[0], sliceNum);
+                CheckHdf5(H5Dset_extent(dataset, dims), "H5Dset_extent",
+                          name);
+            }
+            H5Sclose(fileSpace);
+            H5Dclose(dataset);
+        }
+        H5Gclose(group);
+    }
+    for (const char* name : {"Step", "Time"}) {
+        hid_t dataset{CheckHdf5(H5Dopen2(SeriesFile, name, H5P_DEFAULT),
+                                "H5Dopen2", name)};
+        CheckHdf5(H5Dset_extent(dataset, &sliceNum), "H5Dset_extent", name);
+        H5Dclose(dataset);
+    }
+    SeriesSteps.resize(sliceNum);
+    SeriesTimes.resize(sliceNum);
+    H5Fflush(SeriesFile, H5F_SCOPE_GLOBAL);
+}
+
+/*
+ * Open the time-series file, create the group of each block, and link the
+ * static fields into the groups. The file is reopened rather than created
+ * again by a later Iterate and by a restart, which keeps the slices up to its
+ * checkpoint.
+ */
+void OpenSeriesFile() {
+    hid_t fapl{OutputFileAccess()};
+    const std::string fileName{SharedOutputFileName("series")};
+    const bool restart{!SeriesFileOpened && RESTARTSTEP >= 0};
+    if (FileExists(fileName) && (SeriesFileOpened || restart)) {
+        SeriesFile = CheckHdf5(
+            H5Fopen(fileName.c_str(), H5F_ACC_RDWR, fapl), "H5Fopen", fileName);
+        H5Pclose(fapl);
+        SeriesFileOpened = true;
+        ReloadSeriesSteps(restart);
+        return;
+    }
+    SeriesFile =
+        CheckHdf5(H5Fcreate(fileName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, fapl),
+                  "H5Fcreate", fileName);
+    H5Pclose(fapl);
+    SeriesFileOpened = true;
+    const std::string staticFile{SharedOutputFileName("static")};
+    const std::string target{staticFile.substr(staticFile.rfind('/') + 1)};
+    for (int blockIndex = 0; blockIndex < BLOCKNUM; blockIndex++) {
+        const std::string groupName{"Block_" + std::to_string(blockIndex)};
+        hid_t group{CheckHdf5(H5Gcreate2(SeriesFile, groupName.c_str(),
+                                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT),
+                              "H5Gcreate2", groupName)};
+        for (const OutputField field : StaticOutputFields()) {
+            const char* name{OutputFieldDats(field)[blockIndex]->name};
+            const std::string path{"/" + groupName + "/" + name};
+            CheckHdf5(H5Lcreate_external(target.c_str(), path.c_str(), group,
+                                         name, H5P_DEFAULT, H5P_DEFAULT),
+                      "H5Lcreate_external", path);
+        }
+        H5Gclose(group);
+    }
+    SeriesSteps.clear();
+    SeriesTimes.clear();
+}
+
+/*
+ * Append an owned part as the slice of the (time, nz, ny, nx, dim) dataset,
+ * which is created at the first slice with an unlimited time dimension, and
+ * return the bytes written
+ */
+long AppendSeriesDataset(const hid_t group, const OutputPart& part,
+                         const hsize_t slice, const hid_t dxpl) {
+    const int rank{SPACEDIM + 2};
+    hsize_t dims[5], maxDims[5], chunk[5], start[5], count[5];
+    for (int axis = 1; axis < rank; axis++) {
+        dims[axis] = part.dims[axis - 1];
+        maxDims[axis] = dims[axis];
+        chunk[axis] = part.chunk[axis - 1];
+        start[axis] = part.start[axis - 1];
+        count[axis] = part.count[axis - 1];
+    }
+    // a slice is a whole number of chunks, so that a region is read over time
+    // without reading the other parts of the block
+    chunk[0] = 1;
+    maxDims[0] = H5S_UNLIMITED;
+    dims[0] = slice + 1;
+    start[0] = slice;
+    count[0] = part.owned ? 1 : 0;
+    // the chunk cache holds the chunks of the owned part of the slice, so that
+    // a chunk is written once rather than evicted before it is complete, and
+    // the complete chunks are evicted first
+    size_t cacheBytes{(size_t)TypeSize(part.type)};
+    for (int axis = 1; axis < rank; axis++) {
+        const hsize_t first{start[axis] / chunk[axis] * chunk[axis]};
+        const hsize_t last{std::min(
+            dims[axis], (start[axis] + count[axis] + chunk[axis] - 1) /
+                            chunk[axis] * chunk[axis])};
+        cacheBytes *= last - first;
+    }
+    hid_t dapl{H5Pcreate(H5P_DATASET_ACCESS)};
+    CheckHdf5(H5Pset_chunk_cache(dapl, H5D_CHUNK_CACHE_NSLOTS_DEFAULT,
+                                 cacheBytes, 1.0),
+              "H5Pset_chunk_cache", part.name);
+    const char* name{part.name.c_str()};
+    hid_t dataset;
+    if (H5Lexists(group, name, H5P_DEFAULT) > 0) {
+        dataset = CheckHdf5(H5Dopen2(group, name, dapl), "H5Dopen2",
+                            part.name);
+        CheckHdf5(H5Dset_extent(dataset, dims), "H5Dset_extent", part.name);
+    } else {
+        hid_t space{CheckHdf5(H5Screate_simple(rank, dims, maxDims),
+                              "H5Screate_simple", part.name)};
+        hid_t dcpl{H5Pcreate(H5P_DATASET_CREATE)};
+        CheckHdf5(H5Pset_chunk(dcpl, rank, chunk), "H5Pset_chunk", part.name);
+        dataset = CheckHdf5(H5Dcreate2(group, name, Hdf5Type(part.type), space,
+                                       H5P_DEFAULT, dcpl, dapl),
+                            "H5Dcreate2", part.name);
+        H5Pclose(dcpl);
+        H5Sclose(space);
+    }
+    H5Pclose(dapl);
+    hid_t fileSpace{
+        CheckHdf5(H5Dget_space(dataset), "H5Dget_space", part.name)};
+    WriteOwnedPart(dataset, fileSpace, part, rank, start, count, dxpl);
+    H5Sclose(fileSpace);
+    H5Dclose(dataset);
+    long bytes{TypeSize(part.type)};
+    for (int axis = 1; axis < rank; axis++) {
+        bytes *= dims[axis];
+    }
+    return bytes;
+}
+
+/*
+ * Append the owned parts of the fields to the time-series file, and return
+ * the bytes written
+ */
+long AppendSeriesFile(const long timeStep,
+                      const std::vector<OutputPart>& parts) {
+    if (SeriesFile < 0) {
+        OpenSeriesFile();
+    }
+    const hsize_t slice{SeriesSteps.size()};
+    hid_t dxpl{H5Pcreate(H5P_DATASET_XFER)};
+#ifdef OPS_MPI
+    H5Pset_dxpl_mpio(dxpl, H5FD_MPIO_COLLECTIVE);
+#endif
+    long bytes{0};
+    for (int blockIndex = 0; blockIndex < BLOCKNUM; blockIndex++) {
+        const std::string groupName{"Block_" + std::to_string(blockIndex)};
+        hid_t group{
+            CheckHdf5(H5Gopen2(SeriesFile, groupName.c_str(), H5P_DEFAULT),
+                      "H5Gopen2", groupName)};
+        for (int partIdx = blockIndex; partIdx < (int)parts.size();
+             partIdx += BLOCKNUM) {
+            bytes += AppendSeriesDataset(group, parts[partIdx], slice, dxpl);
+        }
+        H5Gclose(group);
+    }
+    // the step and the time of each slice, where a field with a longer output
+    // period than the others keeps the fill value in the skipped slices
+    SeriesSteps.push_back(timeStep);
+    SeriesTimes.push_back(timeStep * TimeStep());
+    WriteSeriesValue("Step", H5T_NATIVE_LONG, &SeriesSteps.back(), slice,
+                     dxpl);
+    WriteSeriesValue("Time", H5T_NATIVE_DOUBLE, &SeriesTimes.back(), slice,
+                     dxpl);
+    H5Pclose(dxpl);
+    // the file stays open but it is readable after each output
+    H5Fflush(SeriesFile, H5F_SCOPE_GLOBAL);
+    return bytes;
+}
+
+void CloseOutputFiles() {
+    if (SeriesFile >= 0) {
+        H5Fclose(SeriesFile);
+        SeriesFile = -1;
+    }
+}
+
+std::string CaseInfoFileName() { return CASENAME + "_case.h5"; }
+
+/*
+ * Write the block sizes and the model constants that are needed to restart,
+ * see RestartFromCheckpoint
+ */
+void WriteCaseInfo() {
+    if (!ops_is_root()) {
+        return;
+    }
+    hid_t file{CheckHdf5(H5Fcreate(CaseInfoFileName().c_str(), H5F_ACC_TRUNC,
+                                   H5P_DEFAULT, H5P_DEFAULT),
+                         "H5Fcreate", CaseInfoFileName())};
+    const std::vector<int> blockSize(BLOCKSIZE,
+                                     BLOCKSIZE + BLOCKNUM * SPACEDIM);
+    WriteAttribute(file, "SpaceDim", H5T_NATIVE_INT,
+                   std::vector<int>{SPACEDIM});
+    WriteAttribute(file, "XiNum", H5T_NATIVE_INT, std::vector<int>{NUMXI});
+    WriteAttribute(file, "BlockNum", H5T_NATIVE_INT,
+                   std::vector<int>{BLOCKNUM});
+    WriteAttribute(file, "BlockSize", H5T_NATIVE_INT, blockSize);
+    if (nullptr != TAUREF) {
+        WriteAttribute(file, "TauRef", H5T_NATIVE_DOUBLE,
+                       std::vector<double>(TAUREF, TAUREF + SizeofTau()));
+    }
+    WriteAttribute(file, "TimeStep", H5T_NATIVE_DOUBLE,
+                   std::vector<double>{TimeStep()});
+    H5Fclose(file);
+}
+
+/*
+ * The file of the checkpoint to restart from, which keeps the block
+ */
+std::string RestartFileName(const int blockIndex) {
+    switch (RESTARTMODE) {
+        case OutputMode_SharedFile:
+            return SharedOutputFileName(std::to_string(RESTARTSTEP));
+        case OutputMode_TimeSeries:
+            return SharedOutputFileName("series");
+        default:
+            return OutputFileName(blockIndex, std::to_string(RESTARTSTEP));
+    }
+}
+
+void SetRestart(const long step) {
+    if (!FileExists(CaseInfoFileName())) {
+        ops_printf("Error! %s is not found for restarting!\n",
+                   CaseInfoFileName().c_str());
+        assert(FileExists(CaseInfoFileName()));
+    }
+    hid_t file{CheckHdf5(H5Fopen(CaseInfoFileName().c_str(), H5F_ACC_RDONLY,
+                                 H5P_DEFAULT),
+                         "H5Fopen", CaseInfoFileName())};
+    const int spaceDim{
+        ReadAttribute<int>(file, "SpaceDim", H5T_NATIVE_INT).at(0)};
+    const int xiNum{ReadAttribute<int>(file, "XiNum", H5T_NATIVE_INT).at(0)};
+    if (spaceDim != SPACEDIM || xiNum != NUMXI) {
+        ops_printf(
+            "Error! The checkpoint has %i dimensions and %i velocities but the "
+            "case defines %i and %i!\n",
+            spaceDim, xiNum, SPACEDIM, NUMXI);
+        assert(spaceDim == SPACEDIM && xiNum == NUMXI);
+    }
+    SetBlockNum(ReadAttribute<int>(file, "BlockNum", H5T_NATIVE_INT).at(0));
+    SetBlockSize(ReadAttribute<int>(file, "BlockSize", H5T_NATIVE_INT));
+    if (H5Aexists(file, "TauRef") > 0) {
+        const std::vector<double> tauRef{
+            ReadAttribute<double>(file, "TauRef", H5T_NATIVE_DOUBLE)};
+        SetTauRef(std::vector<Real>(tauRef.begin(), tauRef.end()));
+    }
+    SetTimeStep(
+        ReadAttribute<double>(file, "TimeStep", H5T_NATIVE_DOUBLE).at(0));
+    H5Fclose(file);
+    // the format of the checkpoint is found from the files written
+    RESTARTSTEP = step;
+    RESTARTSLICE = -1;
+    RESTARTFROMOPSFILES = false;
+    const std::string blockFile{OutputFileName(0, std::to_string(step))};
+    if (FileExists(blockFile)) {
+        RESTARTMODE = OutputMode_BlockFiles;
+        // the files written by HDF5 rather than OPS keep no halos, see
+        // WriteBlockPartFiles
+        file = CheckHdf5(
+            H5Fopen(blockFile.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT), "H5Fopen",
+            blockFile);
+        RESTARTFROMOPSFILES = H5Aexists(file, "HaloDepth") <= 0;
+        H5Fclose(file);
+    } else if (FileExists(SharedOutputFileName(std::to_string(step)))) {
+        RESTARTMODE = OutputMode_SharedFile;
+    } else if (FileExists(SharedOutputFileName("series"))) {
+        RESTARTMODE = OutputMode_TimeSeries;
+        file = CheckHdf5(H5Fopen(SharedOutputFileName("series").c_str(),
+                                 H5F_ACC_RDONLY, H5P_DEFAULT),
+                         "H5Fopen", SharedOutputFileName("series"));
+        const std::vector<long> steps{
+            ReadSeriesValues<long>(file, "Step", H5T_NATIVE_LONG)};
+        H5Fclose(file);
+        const auto slice = std::find(steps.begin(), steps.end(), step);
+        if (slice != steps.end()) {
+            RESTARTSLICE = slice - steps.begin();
+        }
+    }
+    if (OutputMode_TimeSeries == RESTARTMODE && RESTARTSLICE < 0) {
+        ops_printf("Error! The checkpoint of step %li is not found!\n", step);
+        assert(RESTARTSLICE >= 0);
+    }
+    // a compressed checkpoint keeps the moments of f rather than f
+    const bool hasF{DatasetExists(RestartFileName(0), "Block_0/f_0")};
+    RESTARTFROMMOMENTS =
+        !hasF && DatasetExists(RestartFileName(0), "Block_0/fMoments_0");
+    if (!hasF && !RESTARTFROMMOMENTS) {
+        ops_printf("Error! Neither f nor its moments are in %s!\n",
+                   RestartFileName(0).c_str());
+        assert(hasF || RESTARTFROMMOMENTS);
+    }
+#ifdef OPS_2D
+    if (RESTARTFROMMOMENTS) {
+        ops_printf(
+            "Error! Restarting from the moments of f is only implemented in "
+            "3D!\n");
+        assert(!RESTARTFROMMOMENTS);
+    }
+#endif
+    // the macroscopic variables skipped by a compressed checkpoint, unless
+    // the model has others than the densities and the velocities
+    RESTARTMACROVARSFROMMOMENTS =
+        RESTARTFROMMOMENTS && MacroVarsInMoments() &&
+        !DatasetExists(RestartFileName(0), "Block_0/MacroVars_0");
+    // otherwise, the macroscopic variables missing from the checkpoint are
+    // computed from f by Iterate
+    RESTARTMACROVARSFROMF =
+        !RESTARTMACROVARSFROMMOMENTS &&
+        !DatasetExists(RestartFileName(0), "Block_0/MacroVars_0");
+    // the next step after the checkpoint
+    STARTSTEP = step + 1;
+}
+
+/*
+ * Read the part of a dat owned by this rank from the dataset in group, i.e.,
+ * from its slice if it is a time-series dataset, so that only the nodes
+ * without halos are set
+ */
+void ReadOwnedPart(const hid_t group, const ops_dat dat, const long slice,
+                   const hid_t dxpl) {
+    hid_t dataset{CheckHdf5(H5Dopen2(group, dat->name, H5P_DEFAULT),
+                            "H5Dopen2", dat->name)};
+    hid_t fileSpace{
+        CheckHdf5(H5Dget_space(dataset), "H5Dget_space", dat->name)};
+    // the static fields linked into the time-series file have no time
+    // dimension
+    const int offset{
+        SPACEDIM + 2 == H5Sget_simple_extent_ndims(fileSpace) ? 1 : 0};
+    const int rank{SPACEDIM + 1 + offset};
+    hsize_t start[5], count[5];
+    const long nodeNum{OwnedPart(dat, start + offset, count + offset)};
+    if (offset > 0) {
+        start[0] = slice;
+        count[0] = nodeNum > 0 ? 1 : 0;
+    }
+    std::vector<char> data(nodeNum * dat->dim * TypeSize(dat->type));
+    hid_t memSpace{H5Screate_simple(rank, count, NULL)};
+    if (nodeNum > 0) {
+        H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, start, NULL, count,
+                            NULL);
+    } else {
+        H5Sselect_none(fileSpace);
+        H5Sselect_none(memSpace);
+    }
+    CheckHdf5(H5Dread(dataset, Hdf5Type(dat->type), memSpace, fileSpace, dxpl,
+                      data.data()),
+              "H5Dread", dat->name);
+    H5Sclose(memSpace);
+    H5Sclose(fileSpace);
+    H5Dclose(dataset);
+    if (nodeNum > 0) {
+        TransposeComponents(data, dat, nodeNum, false);
+        ops_dat_set_data(dat, 0, data.data());
+    }
+}
+
+void ReadRestartData() {
+    if (RESTARTSTEP < 0 || RESTARTFROMOPSFILES) {
+        return;
+    }
+    hid_t dxpl{H5Pcreate(H5P_DATASET_XFER)};
+#ifdef OPS_MPI
+    H5Pset_dxpl_mpio(dxpl, H5FD_MPIO_COLLECTIVE);
+#endif
+    std::string fileName;
+    hid_t file{-1};
+    for (int blockIndex = 0; blockIndex < BLOCKNUM; blockIndex++) {
+        // the per-block files have a file for each block
+        if (RestartFileName(blockIndex) != fileName) {
+            if (file >= 0) {
+                H5Fclose(file);
+            }
+            fileName = RestartFileName(blockIndex);
+            hid_t fapl{H5Pcreate(H5P_FILE_ACCESS)};
+#ifdef OPS_MPI
+            H5Pset_fapl_mpio(fapl, MPI_COMM_WORLD, MPI_INFO_NULL);
+#endif
+            file = CheckHdf5(H5Fopen(fileName.c_str(), H5F_ACC_RDONLY, fapl),
+                             "H5Fopen", fileName);
+            H5Pclose(fapl);
+        }
+        const std::string groupName{"Block_" + std::to_string(blockIndex)};
+        hid_t group{CheckHdf5(H5Gopen2(file, groupName.c_str(), H5P_DEFAULT),
+                              "H5Gopen2", groupName)};
+        for (const OutputField field : RestartFields) {
+            if (nullptr == OutputFieldDats(field)) {
+                continue;
+            }
+            const ops_dat dat{OutputFieldDats(field)[blockIndex]};
+            const bool found{H5Lexists(group, dat->name, H5P_DEFAULT) > 0};
+            CheckRestartField(field, found, groupName + "/" + dat->name,
+                              fileName);
+            if (found) {
+                ReadOwnedPart(group, dat, RESTARTSLICE, dxpl);
+            }
+        }
+        H5Gclose(group);
+    }
+    H5Pclose(dxpl);
+    H5Fclose(file);
+}
+
+long RestartStep() { return RESTARTSTEP; }
+
+OutputMode RestartMode() { return RESTARTMODE; }
+
+bool RestartFromOpsFiles() { return RESTARTFROMOPSFILES; }
+
+bool RestartFromMoments() { return RESTARTFROMMOMENTS; }
+
+bool RestartMacroVarsFromMoments() { return RESTARTMACROVARSFROMMOMENTS; }
+
+bool RestartMacroVarsFromF() { return RESTARTMACROVARSFROMF; }
+
+long StartStep() { return STARTSTEP; }
+
+double SetupTime() {
+    double ct, et;
+    ops_timers(&ct, &et);
+    return et - SETUPSTARTTIME;
+}
+
+/*
+ * Write the owned parts of the fields by the output mode, which only calls
+ * HDF5, and return the bytes written
+ */
+long WriteOutputParts(const long timeStep,
+                      const std::vector<OutputPart>& parts) {
+    if (OutputMode_BlockFiles == OUTPUTMODE) {
+        return WriteBlockPartFiles(timeStep, parts);
+    }
+    if (OutputMode_TimeSeries == OUTPUTMODE && StaticOutputStep != timeStep) {
+        return AppendSeriesFile(timeStep, parts);
+    }
+    return WriteSharedFile(timeStep, parts);
+}
+
+/*
+ * The line reporting the size, the time and the bandwidth of an output
+ */
+std::string OutputReport(const long timeStep, const long bytes,
+                         const double seconds) {
+    const std::string step{StaticOutputStep == timeStep
+                               ? "static"
+                               : std::to_string(timeStep)};
+    const double megaBytes{bytes / 1e6};
+    char report[256];
+    snprintf(report, sizeof(report),
+             "Output %s: %.2f MB written in %f seconds, %.2f MB/s\n",
+             step.c_str(), megaBytes, seconds, megaBytes / seconds);
+    return report;
+}
+
+/*
+ * Write the fields by the output mode and report the bandwidth
+ */
+void WriteOutput(const long timeStep, const std::vector<OutputField>& fields) {
+    double ct0, ct1, et0, et1;
+    ops_timers(&ct0, &et0);
+    long bytes{0};
+    if (OutputMode_BlockFiles == OUTPUTMODE && BlockFilesByOps) {
+        bytes = WriteBlockFiles(timeStep, fields);
+    } else {
+        std::vector<OutputPart> parts;
+        FetchOutputParts(fields, parts);
+        bytes = WriteOutputParts(timeStep, parts);
+        if (OutputMode_SharedFile == OUTPUTMODE &&
+            StaticOutputStep != timeStep) {
+            WriteXdmf(timeStep, fields);
+        }
+    }
+    ops_timers(&ct1, &et1);
+    ops_printf("%s", OutputReport(timeStep, bytes, et1 - et0).c_str());
+}
+
+void WriteStaticOutput() {
+    if (StaticOutputWritten) {
+        return;
+    }
+    WriteCaseInfo();
+    const std::vector<OutputField> fields{StaticOutputFields()};
+    if (!fields.empty()) {
+        WriteOutput(StaticOutputStep, fields);
+    }
+    StaticOutputWritten = true;
+}
+
+void WriteCheckpoint(const long timeStep) {
+    WriteStaticOutput();
+    const std::vector<OutputField> fields{OutputFields(timeStep)};
+    if (fields.empty()) {
+        return;
+    }
+    WriteOutput(timeStep, fields);
+}
+
+#ifdef CHECKPOINT_THREAD
+/*
+ * The loop of the writer thread, which only touches the queued slots, i.e.,
+ * the solver does not access the buffers being written, and only calls HDF5
+ */
+void WriteQueuedCheckpoints() {
+    while (true) {
+        int slotIdx;
+        {
+            std::unique_lock<std::mutex> lock(CheckpointMutex);
+            CheckpointCondition.wait(lock, [] {
+                return CheckpointWriterStop || !QueuedCheckpointSlots.empty();
+            });
+            if (QueuedCheckpointSlots.empty()) {
+                return;
+            }
+            slotIdx = QueuedCheckpointSlots.front();
+        }
+        const CheckpointSlot& slot = CheckpointSlots[slotIdx];
+        const auto start = std::chrono::steady_clock::now();
+        const long bytes{WriteOutputParts(slot.timeStep, slot.parts)};
+        const std::chrono::duration<double> seconds{
+            std::chrono::steady_clock::now() - start};
+        if (CheckpointWriterRoot) {
+            const std::string report{
+                OutputReport(slot.timeStep, bytes, seconds.count())};
+            std::printf("%s", report.c_str());
+        }
+        {
+            std::lock_guard<std::mutex> lock(CheckpointMutex);
+            QueuedCheckpointSlots.pop_front();
+            FreeCheckpointSlots.push_back(slotIdx);
+        }
+        CheckpointCondition.notify_all();
+    }
+}
+
+/*
+ * If the writer thread can run, i.e., if MPI allows the threads of a rank to
+ * call it concurrently, which needs MPI_Init_thread with MPI_THREAD_MULTIPLE
+ * before ops_init, e.g., in lbm3d_cavity.cpp
+ */
+bool CheckpointThreadSupported() {
+#ifdef OPS_MPI
+    static bool warned{false};
+    int provided{MPI_THREAD_SINGLE};
+    MPI_Query_thread(&provided);
+    if (MPI_THREAD_MULTIPLE != provided && !warned) {
+        ops_printf(
+            "Warning! MPI does not provide MPI_THREAD_MULTIPLE, so that the "
+            "checkpoints are written synchronously!\n");
+        warned = true;
+    }
+    return MPI_THREAD_MULTIPLE == provided;
+#else
+    return true;
+#endif
+}
+
+void StartCheckpointWriter() {
+    // the files opened by the solver thread are reopened by the writer
+    CloseOutputFiles();
+#ifdef OPS_MPI
+    MPI_Comm_dup(MPI_COMM_WORLD, &OutputComm);
+#endif
+    CheckpointWriterRoot = ops_is_root();
+    CheckpointSlots.resize(CHECKPOINTSLOTNUM);
+    for (int slotIdx = 0; slotIdx < CHECKPOINTSLOTNUM; slotIdx++) {
+        FreeCheckpointSlots.push_back(slotIdx);
+    }
+    CheckpointWriterStop = false;
+    CheckpointWriter = std::thread(WriteQueuedCheckpoints);
+}
+
+/*
+ * Fetch the fields of timeStep into a free slot and queue it for the writer
+ * thread
+ */
+void QueueCheckpoint(const long timeStep) {
+    // the static fields are written once before the writer thread starts
+    WriteStaticOutput();
+    const std::vector<OutputField> fields{OutputFields(timeStep)};
+    if (fields.empty()) {
+        return;
+    }
+    if (!CheckpointWriter.joinable()) {
+        StartCheckpointWriter();
+    }
+    int slotIdx;
+    {
+        double waitCt0, waitCt1, waitEt0, waitEt1;
+        ops_timers(&waitCt0, &waitEt0);
+        std::unique_lock<std::mutex> lock(CheckpointMutex);
+        CheckpointCondition.wait(lock,
+                                 [] { return !FreeCheckpointSlots.empty(); });
+        slotIdx = FreeCheckpointSlots.front();
+        FreeCheckpointSlots.pop_front();
+        ops_timers(&waitCt1, &waitEt1);
+        CheckpointWaitTime += waitEt1 - waitEt0;
+    }
+    // the slot is free, so the writer does not touch its buffers
+    CheckpointSlot& slot = CheckpointSlots[slotIdx];
+    slot.timeStep = timeStep;
+    FetchOutputParts(fields, slot.parts);
+    if (OutputMode_SharedFile == OUTPUTMODE) {
+        WriteXdmf(timeStep, fields);
+    }
+    {
+        std::lock_guard<std::mutex> lock(CheckpointMutex);
+        QueuedCheckpointSlots.push_back(slotIdx);
+    }
+    CheckpointCondition.notify_all();
+}
+#endif  // CHECKPOINT_THREAD
+
+/*
+ * Wait until the queued checkpoints are written, stop the writer thread, and
+ * close the files that it opened, where the time is spent on waiting
+ */
+void StopCheckpointWriter() {
+#ifdef CHECKPOINT_THREAD
+    if (!CheckpointWriter.joinable()) {
+        return;
+    }
+    double ct0, ct1, et0, et1;
+    ops_timers(&ct0, &et0);
+    {
+        std::lock_guard<std::mutex> lock(CheckpointMutex);
+        CheckpointWriterStop = true;
+    }
+    CheckpointCondition.notify_all();
+    CheckpointWriter.join();
+    // which frees the host buffers of the slots
+    CheckpointSlots.clear();
+    FreeCheckpointSlots.clear();
+    CloseOutputFiles();
+#ifdef OPS_MPI
+    MPI_Comm_free(&OutputComm);
+    OutputComm = MPI_COMM_WORLD;
+#endif
+    ops_timers(&ct1, &et1);
+    CheckpointTime += et1 - et0;
+    CheckpointWaitTime += et1 - et0;
+#endif  // CHECKPOINT_THREAD
+}
+
+void WriteCheckpointAsync(const long timeStep) {
+    double ct0, ct1, et0, et1;
+    ops_timers(&ct0, &et0);
+#ifdef CHECKPOINT_THREAD
+    if (CheckpointThreadSupported()) {
+        QueueCheckpoint(timeStep);
+    } else {
+        WriteCheckpoint(timeStep);
+    }
+#else
+    WriteCheckpoint(timeStep);
+#endif  // CHECKPOINT_THREAD
+    ops_timers(&ct1, &et1);
+    CheckpointTime += et1 - et0;
+    CheckpointNum++;
+}
+
+void FlushCheckpoints() {
+    StopCheckpointWriter();
+    if (CheckpointNum > 0) {
+        ops_printf(
+            "%i checkpoints written, the solver spent %f seconds on them, "
+            "%f seconds of which waiting for the writer\n",
+            CheckpointNum, CheckpointTime, CheckpointWaitTime);
+    }
+    CheckpointNum = 0;
+    CheckpointTime = 0;
+    CheckpointWaitTime = 0;
+    CloseOutputFiles();
+}
+
+void DefineHaloTransferFromHdf5() {}
+/*
+ * Importing geometry from an external HDF5 file
+ */
+void SetupFlowfieldfromHdf5() {
+    CASENAME = "Cavity3D";  // Input parameter
+    SPACEDIM = 3;
+    BLOCKNUM = 1;  // Input parameter
+    BLOCKSIZE = new int[BLOCKNUM * SPACEDIM];
+    BLOCKSIZE[0] = 101;  // Input parameters
+    BLOCKSIZE[1] = 101;  // Input parameters
+    BLOCKSIZE[2] = 3;    // Input parameters
+
+    TAUREF = new Real[ComponentNum()];
+    TAUREF[0] = 0.001;  // Input parameters
+    // All above parameters should be written down by the python script
+    Real minDx{1. / 100};  // Input parameters at this moment
+    Real minDy{1. / 100};  // Input parameters at this moment
+    // DT = 0.01 * fmin(minDx, minDy) / MaximumSpeed();  // finite difference
+    // scheme
+    // DT = 0.0001414;
+    // DT = fmin(fmin(minDx, minDy) / MaximumSpeed(),
+    //              0.5 * TAUREF[0]);  // finite difference scheme
+    DT = minDx / SoundSpeed();  // stream-collision
+    HALODEPTH = HaloPtNum();
+    ops_printf("%s\n", "Starting to allocate...");
+    DefineVariablesFromHDF5();
+    DefineHaloTransfer3D();
+    // above calls must be before the ops_partition call
+    ops_partition((char*)"LBM");
+}
+
+const std::string CaseName() { return CASENAME; }
+void SetCaseName(const std::string caseName) { CASENAME = caseName; }
+void setCaseName(const char* caseName) {
+    std::string tmp(caseName);
+    CASENAME = tmp;
+}
+
+const int BlockNum() { return BLOCKNUM; }
+const int SpaceDim() { return SPACEDIM; }
+const int HaloDepth() { return HALODEPTH; }
+
+void SetHaloDepth(const int haloDepth) { HALODEPTH = haloDepth; }
+void SetHaloRelationNum(const int haloRelationNum) {
+    HaloRelationNum = haloRelationNum;
+}
+
+void DestroyFlowfield() {
+    FreeArrayMemory(g_f);
+    FreeArrayMemory(g_fStage);
+    FreeArrayMemory(g_feq);
+    FreeArrayMemory(g_Bodyforce);
+    FreeArrayMemory(g_Block);
+    FreeArrayMemory(g_MacroVars);
+    FreeArrayMemory(g_fMoments);
+    FreeArrayMemory(g_Tau);
+    FreeArrayMemory(TAUREF);
+    FreeArrayMemory(g_CoordinateXYZ);
+    if (HaloRelationNum > 0) FreeArrayMemory(HaloRelations);
+    for (PopulationHalo& halo : PopulationHaloList) {
+        FreeArrayMemory(halo.haloRelations);
+    }
+    PopulationHaloList.clear();
+    BlockConnectionList.clear();
+    BlockPeriodicity.clear();
+    FreeArrayMemory(g_NodeType);
+    FreeArrayMemory(g_GeometryProperty);
+    FreeArrayMemory(g_NodeFlag);
+    FreeArrayMemory(g_StreamMask);
+    BlockEmbeddedBoundaryRng.clear();
+    BlockActiveRng.clear();
+    BlockBulkStreamRng.clear();
+    BlockMaskedStreamRng.clear();
+    StaticOutputWritten = false;
+    FreeArrayMemory(BlockIterRngWhole);
+    FreeArrayMemory(BlockIterRngBulk);
+    FreeArrayMemory(BlockIterRngExtended);
+    NodePropertyHaloRelations.clear();
+    NodePropertyHalos = nullptr;
+    FreeArrayMemory(BlockIterRngImax);
+    FreeArrayMemory(BlockIterRngImin);
+    FreeArrayMemory(BlockIterRngJmax);
+    FreeArrayMemory(BlockIterRngJmin);
+    FreeArrayMemory(BLOCKSIZE);
+    // if steady flow
+    FreeArrayMemory(g_MacroVarsCopy);
+    FreeArrayMemory(g_ResidualError);
+    if (3 == SPACEDIM) {
+        FreeArrayMemory(BlockIterRngKmax);
+        FreeArrayMemory(BlockIterRngKmin);
+    }
+    // end if steady flow
+    // delete[] halos;
+}
+
+const ops_halo_group HaloGroup() { return HaloGroups; }
+
+std::vector<PopulationHalo>& PopulationHalos() { return PopulationHaloList; }
+
+void SetPeriodicHalo(const int blockIndex, const int axis) {
+    PopulationHalo halo;
+    halo.blockIndex = blockIndex;
+    halo.axis = axis;
+    halo.fPacked = nullptr;
+    halo.haloRelations = nullptr;
+    halo.haloGroup = nullptr;
+    PopulationHaloList.push_back(halo);
+}
+
+/*!
+ * Derive the populations crossing each face from XI and declare the packed
+ * arrays and their halos for the periodic halos set by SetPeriodicHalo.
+ * It is called by DefineHaloTransfer(3D) before ops_partition.
+ */
+void DefinePopulationHalos() {
+    if (PopulationHaloList.empty()) {
+        return;
+    }
+    if (TEMPORALBLOCKING > 1) {
+        ops_printf(
+            "Error! The temporal blocking needs the full halos given by "
+            "SetBlockPeriodicity rather than SetPeriodicHalo!\n");
+        assert(TEMPORALBLOCKING <= 1);
+    }
+    if (nullptr == g_fStage) {
+        ops_printf(
+            "Error! The periodic halos are only supported by the schemes "
+            "using g_fStage at this moment!\n");
+        assert(nullptr != g_fStage);
+    }
+    const int haloDepth{HaloDepth()};
+    if (haloDepth < 1) {
+        ops_printf("Error! The periodic halos need a halo depth of one!\n");
+        assert(haloDepth >= 1);
+    }
+    // the halos are transferred axis by axis so that the corners are correct
+    std::sort(PopulationHaloList.begin(), PopulationHaloList.end(),
+              [](const PopulationHalo& a, const PopulationHalo& b) {
+                  return a.blockIndex < b.blockIndex ||
+                         (a.blockIndex == b.blockIndex && a.axis < b.axis);
+              });
+    int d_p[MAXDIM];
+    int d_m[MAXDIM];
+    int base[MAXDIM];
+    for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+        d_p[cordIdx] = haloDepth;
+        d_m[cordIdx] = -haloDepth;
+        base[cordIdx] = 0;
+    }
+    void* temp = NULL;
+    for (PopulationHalo& halo : PopulationHaloList) {
+        const int blockIndex{halo.blockIndex};
+        const int axis{halo.axis};
+        if (blockIndex < 0 || blockIndex >= BlockNum() || axis < 0 ||
+            axis >= SPACEDIM) {
+            ops_printf("Error! There is no axis %i of block %i!\n", axis,
+                       blockIndex);
+            assert(blockIndex >= 0 && blockIndex < BlockNum());
+            assert(axis >= 0 && axis < SPACEDIM);
+        }
+        halo.lowFacePop.clear();
+        halo.highFacePop.clear();
+        for (int xiIdx = 0; xiIdx < NUMXI; xiIdx++) {
+            const Real c{XI[xiIdx * LATTDIM + axis]};
+            if (c > 0) {
+                halo.lowFacePop.push_back(xiIdx);
+            }
+            if (c < 0) {
+                halo.highFacePop.push_back(xiIdx);
+            }
+        }
+        const int packedNum{(int)std::max(halo.lowFacePop.size(),
+                                          halo.highFacePop.size())};
+        int size[MAXDIM];
+        for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+            size[cordIdx] = BlockSize(blockIndex)[cordIdx];
+        }
+        if (size[axis] < 2) {
+            ops_printf(
+                "Error! The periodic axis %i of block %i needs two nodes at "
+                "least!\n",
+                axis, blockIndex);
+            assert(size[axis] >= 2);
+        }
+        std::string dataName("fPacked_" + std::to_string(blockIndex) + "_" +
+                             std::to_string(axis));
+        halo.fPacked =
+            ops_decl_dat(g_Block[blockIndex], packedNum, size, base, d_m, d_p,
+                         (FReal*)temp, FRealC, dataName.c_str());
+        // one layer at the face, including the halos of the other axes
+        int haloIter[MAXDIM];
+        int baseFrom[MAXDIM];
+        int baseTo[MAXDIM];
+        int dir[MAXDIM];
+        for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+            haloIter[cordIdx] = size[cordIdx] + d_p[cordIdx] - d_m[cordIdx];
+            baseFrom[cordIdx] = d_m[cordIdx];
+            baseTo[cordIdx] = d_m[cordIdx];
+            dir[cordIdx] = cordIdx + 1;
+        }
+        haloIter[axis] = 1;
+        halo.haloRelations = new ops_halo[2];
+        baseFrom[axis] = size[axis] - 1;
+        baseTo[axis] = -1;
+        halo.haloRelations[0] = ops_decl_halo(
+            halo.fPacked, halo.fPacked, haloIter, baseFrom, baseTo, dir, dir);
+        baseFrom[axis] = 0;
+        baseTo[axis] = size[axis];
+        halo.haloRelations[1] = ops_decl_halo(
+            halo.fPacked, halo.fPacked, haloIter, baseFrom, baseTo, dir, dir);
+        halo.haloGroup = ops_decl_halo_group(2, halo.haloRelations);
+        ops_printf(
+            "Periodic halo along the axis %i of block %i: %i and %i of %i "
+            "populations cross the two faces\n",
+            axis, blockIndex, (int)halo.lowFacePop.size(),
+            (int)halo.highFacePop.size(), NUMXI);
+    }
+}
+
+/*!
+ * Index mapping from a block to another: x[axis[i]] = sign[i] * x_i + shift[i]
+ */
+struct BlockIndexMap {
+    int axis[MAXDIM];
+    int sign[MAXDIM];
+    int shift[MAXDIM];
+};
+
+void SurfaceAxisSide(const BoundarySurface surface, int* axis, int* side) {
+    switch (surface) {
+        case BoundarySurface_Left:
+            *axis = 0;
+            *side = 0;
+            break;
+        case BoundarySurface_Right:
+            *axis = 0;
+            *side = 1;
+            break;
+        case BoundarySurface_Bottom:
+            *axis = 1;
+            *side = 0;
+            break;
+        case BoundarySurface_Top:
+            *axis = 1;
+            *side = 1;
+            break;
+        case BoundarySurface_Back:
+            *axis = 2;
+            *side = 0;
+            break;
+        case BoundarySurface_Front:
+            *axis = 2;
+            *side = 1;
+            break;
+    }
+}
+
+const BlockConnection* FindBlockConnection(const int blockIndex,
+                                           const int axis, const int side) {
+    for (const BlockConnection& connection : BlockConnectionList) {
+        if (connection.blockIndex == blockIndex && connection.axis == axis &&
+            connection.side == side) {
+            return &connection;
+        }
+    }
+    return nullptr;
+}
+
+void AddBlockConnection(const int blockIndex, const int axis, const int side,
+                        const int neighbour, const int neighbourAxis,
+                        const int neighbourSide, const int* orientation) {
+    if (nullptr != FindBlockConnection(blockIndex, axis, side) ||
+        nullptr != FindBlockConnection(neighbour, neighbourAxis,
+                                       neighbourSide)) {
+        ops_printf(
+            "Error! The face %i-%i of block %i or the face %i-%i of block %i "
+            "has been connected!\n",
+            axis, side, blockIndex, neighbourAxis, neighbourSide, neighbour);
+        assert(nullptr == FindBlockConnection(blockIndex, axis, side));
+        assert(nullptr ==
+               FindBlockConnection(neighbour, neighbourAxis, neighbourSide));
+    }
+    BlockConnection connection;
+    connection.blockIndex = blockIndex;
+    connection.axis = axis;
+    connection.side = side;
+    connection.neighbour = neighbour;
+    connection.neighbourAxis = neighbourAxis;
+    connection.neighbourSide = neighbourSide;
+    BlockConnection inverse;
+    inverse.blockIndex = neighbour;
+    inverse.axis = neighbourAxis;
+    inverse.side = neighbourSide;
+    inverse.neighbour = blockIndex;
+    inverse.neighbourAxis = axis;
+    inverse.neighbourSide = side;
+    for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+        const int dir{orientation[cordIdx]};
+        connection.orientation[cordIdx] = dir;
+        inverse.orientation[std::abs(dir) - 1] =
+            (dir > 0 ? 1 : -1) * (cordIdx + 1);
+    }
+    BlockConnectionList.push_back(connection);
+    // a block connected to itself, e.g., a periodic block, appears once for
+    // each face
+    BlockConnectionList.push_back(inverse);
+}
+
+void DefineBlockConnection(const int blockIndex, const BoundarySurface surface,
+                           const int neighbour,
+                           const BoundarySurface neighbourSurface,
+                           const std::vector<int>& orientation) {
+    int axis{0};
+    int side{0};
+    int neighbourAxis{0};
+    int neighbourSide{0};
+    SurfaceAxisSide(surface, &axis, &side);
+    SurfaceAxisSide(neighbourSurface, &neighbourAxis, &neighbourSide);
+    int dir[MAXDIM];
+    for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+        dir[cordIdx] = orientation.empty() ? cordIdx + 1 : orientation[cordIdx];
+    }
+    // the sign of the normal axis follows from the two faces
+    dir[axis] = neighbourAxis + 1;
+    bool isPermutation{orientation.empty() ||
+                       (int)orientation.size() == SPACEDIM};
+    for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+        for (int otherIdx = 0; otherIdx < cordIdx; otherIdx++) {
+            if (std::abs(dir[cordIdx]) == std::abs(dir[otherIdx])) {
+                isPermutation = false;
+            }
+        }
+        if (std::abs(dir[cordIdx]) < 1 || std::abs(dir[cordIdx]) > SPACEDIM) {
+            isPermutation = false;
+        }
+    }
+    if (!isPermutation) {
+        ops_printf(
+            "Error! The orientation between block %i and %i shall map the "
+            "normal axis to the normal axis and the others one to one!\n",
+            blockIndex, neighbour);
+        assert(isPermutation);
+    }
+    AddBlockConnection(blockIndex, axis, side, neighbour, neighbourAxis,
+                       neighbourSide, dir);
+}
+
+void SetBlockPeriodicity(const std::vector<bool>& periodic) {
+    BlockPeriodicity = periodic;
+}
+
+/*!
+ * Connect the high face of the last block of each chain of blocks along a
+ * periodic axis to the low face of the first block of the chain.
+ */
+void ConnectPeriodicBlocks() {
+    const int identity[]{1, 2, 3};
+    for (int axis = 0; axis < (int)BlockPeriodicity.size(); axis++) {
+        if (!BlockPeriodicity[axis]) {
+            continue;
+        }
+        for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+            if (nullptr != FindBlockConnection(blockIndex, axis, 1)) {
+                continue;
+            }
+            int first{blockIndex};
+            for (int chainIdx = 0; chainIdx < BlockNum(); chainIdx++) {
+                const BlockConnection* connection{
+                    FindBlockConnection(first, axis, 0)};
+                if (nullptr == connection) {
+                    break;
+                }
+                if (connection->neighbourAxis != axis ||
+                    connection->neighbourSide != 1) {
+                    ops_printf(
+                        "Error! The blocks along the periodic axis %i need "
+                        "to be connected high face to low face!\n",
+                        axis);
+                    assert(connection->neighbourAxis == axis &&
+                           connection->neighbourSide == 1);
+                }
+                first = connection->neighbour;
+            }
+            AddBlockConnection(blockIndex, axis, 1, first, axis, 0, identity);
+        }
+    }
+}
+
+/*!
+ * The index mapping from a block to its neighbour through a connection. The
+ * blocks do not overlap, e.g., the node next to the high face of a block is
+ * followed by the first node of the neighbour.
+ */
+BlockIndexMap ConnectionIndexMap(const BlockConnection& connection) {
+    const int* size{BlockSize(connection.blockIndex)};
+    const int* neighbourSize{BlockSize(connection.neighbour)};
+    BlockIndexMap map;
+    for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+        const int dir{connection.orientation[cordIdx]};
+        const int neighbourAxis{std::abs(dir) - 1};
+        map.axis[cordIdx] = neighbourAxis;
+        if (cordIdx == connection.axis) {
+            // the normal axis
+            const int sideCase{2 * connection.side + connection.neighbourSide};
+            switch (sideCase) {
+                case 0:  // low to low
+                    map.sign[cordIdx] = -1;
+                    map.shift[cordIdx] = -1;
+                    break;
+                case 1:  // low to high
+                    map.sign[cordIdx] = 1;
+                    map.shift[cordIdx] = neighbourSize[neighbourAxis];
+                    break;
+                case 2:  // high to low
+                    map.sign[cordIdx] = 1;
+                    map.shift[cordIdx] = -size[cordIdx];
+                    break;
+                default:  // high to high
+                    map.sign[cordIdx] = -1;
+                    map.shift[cordIdx] =
+                        size[cordIdx] + neighbourSize[neighbourAxis] - 1;
+            }
+        } else {
+            if (size[cordIdx] != neighbourSize[neighbourAxis]) {
+                ops_printf(
+                    "Error! The faces connecting block %i and %i are of "
+                    "different sizes!\n",
+                    connection.blockIndex, connection.neighbour);
+                assert(size[cordIdx] == neighbourSize[neighbourAxis]);
+            }
+            map.sign[cordIdx] = dir > 0 ? 1 : -1;
+            map.shift[cordIdx] = dir > 0 ? 0 : size[cordIdx] - 1;
+        }
+    }
+    return map;
+}
+
+/*!
+ * Find the block from which the halo of a block at offset (-1, 0 or 1 for
+ * each axis) is copied, by crossing the faces of the nonzero axes in turn.
+ * Return false if the halo is outside the connected blocks.
+ */
+bool FindHaloSource(const int blockIndex, const int* offset, int* source,
+                    BlockIndexMap* map) {
+    std::vector<int> crossedAxes;
+    for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+        if (0 != offset[cordIdx]) {
+            crossedAxes.push_back(cordIdx);
+        }
+    }
+    // an edge or a corner may be reached only in some orders if the blocks
+    // do not meet as a regular grid
+    do {
+        BlockIndexMap path;
+        for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+            path.axis[cordIdx] = cordIdx;
+            path.sign[cordIdx] = 1;
+            path.shift[cordIdx] = 0;
+        }
+        int current{blockIndex};
+        bool isFound{true};
+        for (const int axis : crossedAxes) {
+            const int side{offset[axis] * path.sign[axis] > 0 ? 1 : 0};
+            const BlockConnection* connection{
+                FindBlockConnection(current, path.axis[axis], side)};
+            if (nullptr == connection) {
+                isFound = false;
+                break;
+            }
+            const BlockIndexMap step{ConnectionIndexMap(*connection)};
+            for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+                const int stepAxis{path.axis[cordIdx]};
+                path.axis[cordIdx] = step.axis[stepAxis];
+                path.shift[cordIdx] =
+                    step.sign[stepAxis] * path.shift[cordIdx] +
+                    step.shift[stepAxis];
+                path.sign[cordIdx] *= step.sign[stepAxis];
+            }
+            current = connection->neighbour;
+        }
+        if (isFound) {
+            *source = current;
+            *map = path;
+            return true;
+        }
+    } while (std::next_permutation(crossedAxes.begin(), crossedAxes.end()));
+    return false;
+}
+
+/*!
+ * Generate the face, edge and corner halos of g_fStage between the blocks
+ * connected by DefineBlockConnection and SetBlockPeriodicity.
+ * It is called by DefineHaloTransfer(3D) before ops_partition.
+ */
+void DefineBlockHalos() {
+    ConnectPeriodicBlocks();
+    // A face is either connected or has a periodic halo of its own block,
+    // as both would fill the same halo of g_fStage.
+    for (const PopulationHalo& halo : PopulationHaloList) {
+        for (int side = 0; side < 2; side++) {
+            if (nullptr !=
+                FindBlockConnection(halo.blockIndex, halo.axis, side)) {
+                ops_printf(
+                    "Error! The face %i-%i of block %i has both a periodic "
+                    "halo and a connection, use either SetPeriodicHalo or "
+                    "SetBlockPeriodicity/DefineBlockConnection!\n",
+                    halo.axis, side, halo.blockIndex);
+                assert(nullptr ==
+                       FindBlockConnection(halo.blockIndex, halo.axis, side));
+            }
+        }
+    }
+    if (BlockConnectionList.empty()) {
+        return;
+    }
+    if (nullptr == g_fStage) {
+        ops_printf(
+            "Error! The halos between blocks are only supported by the "
+            "schemes using g_fStage at this moment!\n");
+        assert(nullptr != g_fStage);
+    }
+    const int haloDepth{HaloDepth()};
+    int neighbourNum{1};
+    for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+        neighbourNum *= 3;
+    }
+    std::vector<ops_halo> halos;
+    for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+        const int* size{BlockSize(blockIndex)};
+        for (int neighbourIdx = 0; neighbourIdx < neighbourNum;
+             neighbourIdx++) {
+            // -1, 0 or 1 along each axis, where 0 means the block itself
+            int offset[MAXDIM];
+            int code{neighbourIdx};
+            bool isBlock{true};
+            for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+                offset[cordIdx] = code % 3 - 1;
+                code /= 3;
+                isBlock = isBlock && (0 == offset[cordIdx]);
+            }
+            int source{0};
+            BlockIndexMap map;
+            if (isBlock || !FindHaloSource(blockIndex, offset, &source, &map)) {
+                continue;
+            }
+            int haloIter[MAXDIM];
+            int baseFrom[MAXDIM];
+            int baseTo[MAXDIM];
+            int dirFrom[MAXDIM];
+            int dirTo[MAXDIM];
+            for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+                if (0 == offset[cordIdx]) {
+                    haloIter[cordIdx] = size[cordIdx];
+                    baseTo[cordIdx] = 0;
+                } else {
+                    haloIter[cordIdx] = haloDepth;
+                    baseTo[cordIdx] =
+                        offset[cordIdx] < 0 ? -haloDepth : size[cordIdx];
+                }
+                dirTo[cordIdx] = cordIdx + 1;
+                baseFrom[map.axis[cordIdx]] =
+                    map.sign[cordIdx] * baseTo[cordIdx] + map.shift[cordIdx];
+                dirFrom[cordIdx] = map.sign[cordIdx] * (map.axis[cordIdx] + 1);
+            }
+            halos.push_back(ops_decl_halo(g_fStage[source],
+                                          g_fStage[blockIndex], haloIter,
+                                          baseFrom, baseTo, dirFrom, dirTo));
+            if (TEMPORALBLOCKING > 1) {
+                // the halo nodes are also collided and streamed
+                NodePropertyHaloRelations.push_back(ops_decl_halo(
+                    g_NodeFlag[source], g_NodeFlag[blockIndex], haloIter,
+                    baseFrom, baseTo, dirFrom, dirTo));
+                NodePropertyHaloRelations.push_back(ops_decl_halo(
+                    g_StreamMask[source], g_StreamMask[blockIndex], haloIter,
+                    baseFrom, baseTo, dirFrom, dirTo));
+            }
+        }
+    }
+    HaloRelationNum = halos.size();
+    HaloRelations = new ops_halo[HaloRelationNum];
+    std::copy(halos.begin(), halos.end(), HaloRelations);
+    HaloGroups = ops_decl_halo_group(HaloRelationNum, HaloRelations);
+    ops_printf(
+        "%i halos of the faces, edges and corners are defined between the "
+        "blocks\n",
+        HaloRelationNum);
+    if (!NodePropertyHaloRelations.empty()) {
+        NodePropertyHalos =
+            ops_decl_halo_group(NodePropertyHaloRelations.size(),
+                                NodePropertyHaloRelations.data());
+    }
+}
+
+void SetTemporalBlocking(const int stepNum) {
+    if (stepNum < 0 || (2 == SPACEDIM && 1 != stepNum)) {
+        ops_printf(
+            "Error! The temporal blocking needs a non-negative number of "
+            "steps and is only supported by 3D problems at this moment!\n");
+        assert(stepNum >= 0 && (3 == SPACEDIM || 1 == stepNum));
+    }
+    TEMPORALBLOCKING = stepNum;
+}
+
+const int TemporalBlocking() { return TEMPORALBLOCKING; }
+const int TemporalSubstep() { return TEMPORALSUBSTEP; }
+
+void NextTemporalSubstep() {
+    TEMPORALSUBSTEP = (TEMPORALSUBSTEP + 1) % TEMPORALBLOCKING;
+}
+
+const int CollisionExtension() {
+    return 0 == TEMPORALSUBSTEP ? 0 : TEMPORALBLOCKING - TEMPORALSUBSTEP;
+}
+
+const int StreamExtension() { return TEMPORALBLOCKING - 1 - TEMPORALSUBSTEP; }
+
+const ops_halo_group NodePropertyHaloGroup() { return NodePropertyHalos; }
+
+/*!
+ * If a face of a block is connected to a block, or will be connected by
+ * SetBlockPeriodicity
+ */
+const bool IsConnectedSide(const int blockIndex, const int axis,
+                           const int side) {
+    return nullptr != FindBlockConnection(blockIndex, axis, side) ||
+           (axis < (int)BlockPeriodicity.size() && BlockPeriodicity[axis]);
+}
+
+/*!
+ * Choose the number of steps per halo exchange if it is 0, which is the
+ * largest one up to maxStepNum for which the nodes updated in the halos
+ * during a cycle are at most maxRedundancy of the nodes of the blocks. It is
+ * chosen before the allocation since it fixes the halo depth, so that the
+ * candidates cannot be timed, i.e., it is a rule of thumb rather than tuning.
+ */
+void ChooseTemporalBlocking() {
+    if (0 != TEMPORALBLOCKING) {
+        return;
+    }
+    const int maxStepNum{8};
+    const Real maxRedundancy{0.1};
+    TEMPORALBLOCKING = 1;
+    bool isConnected{false};
+    for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+        for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+            isConnected = isConnected ||
+                          IsConnectedSide(blockIndex, cordIdx, 0) ||
+                          IsConnectedSide(blockIndex, cordIdx, 1);
+        }
+    }
+    // there is no halo to be updated otherwise
+    if (!isConnected) {
+        return;
+    }
+    for (int stepNum = 2; stepNum <= maxStepNum; stepNum++) {
+        Real nodeNum{0};
+        Real updatedNodeNum{0};
+        for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+            const int* size{BlockSize(blockIndex)};
+            for (int extension = 0; extension < stepNum; extension++) {
+                Real blockNodeNum{1};
+                Real extendedNodeNum{1};
+                for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+                    const int sideNum{
+                        (int)IsConnectedSide(blockIndex, cordIdx, 0) +
+                        (int)IsConnectedSide(blockIndex, cordIdx, 1)};
+                    blockNodeNum *= size[cordIdx];
+                    extendedNodeNum *= size[cordIdx] + sideNum * extension;
+                }
+                nodeNum += blockNodeNum;
+                updatedNodeNum += extendedNodeNum;
+            }
+        }
+        if (updatedNodeNum > (1 + maxRedundancy) * nodeNum) {
+            break;
+        }
+        TEMPORALBLOCKING = stepNum;
+    }
+    ops_printf("The halos will be exchanged every %i steps\n",
+               TEMPORALBLOCKING);
+}
+
+void ExtendIterRng(const int blockId, const int* iterRng, int* extendedRng) {
+    const int* size{BlockSize(blockId)};
+    for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+        extendedRng[2 * cordIdx] = iterRng[2 * cordIdx];
+        extendedRng[2 * cordIdx + 1] = iterRng[2 * cordIdx + 1];
+        if (ITERRNGEXTENSION <= 0) {
+            continue;
+        }
+        if (0 == iterRng[2 * cordIdx] && IsConnectedSide(blockId, cordIdx, 0)) {
+            extendedRng[2 * cordIdx] -= ITERRNGEXTENSION;
+        }
+        if (size[cordIdx] == iterRng[2 * cordIdx + 1] &&
+            IsConnectedSide(blockId, cordIdx, 1)) {
+            extendedRng[2 * cordIdx + 1] += ITERRNGEXTENSION;
+        }
+    }
+}
+
+void SetIterRngExtension(const int extension) {
+    ITERRNGEXTENSION = extension;
+    for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+        ExtendIterRng(blockIndex, BlockIterRng(blockIndex, IterRngWhole()),
+                      BlockIterRng(blockIndex, BlockIterRngExtended));
+    }
+}
 
 int* IterRngWhole() { return BlockIterRngWhole; }
 int* IterRngJmin() { return BlockIterRngJmin; }
@@ -790,6 +3090,106 @@ int* IterRngImax() { return BlockIterRngImax; }
 int* IterRngBulk() { return BlockIterRngBulk; }
 int* IterRngKmax() { return BlockIterRngKmax; }
 int* IterRngKmin() { return BlockIterRngKmin; }
+std::map<int, std::vector<int>>& EmbeddedBoundaryRng(const int blockId) {
+    if ((int)BlockEmbeddedBoundaryRng.size() < BlockNum()) {
+        BlockEmbeddedBoundaryRng.resize(BlockNum());
+    }
+    return BlockEmbeddedBoundaryRng[blockId];
+}
+
+void SetEmbeddedBoundaryRng(const int blockId, const int vertexType,
+                            const std::vector<int>& iterRng) {
+    if (iterRng.empty()) {
+        EmbeddedBoundaryRng(blockId).erase(vertexType);
+    } else {
+        EmbeddedBoundaryRng(blockId)[vertexType] = iterRng;
+    }
+}
+
+const int ActiveRngNum(const int blockId) {
+    if (BlockActiveRng.empty()) {
+        return 1;
+    }
+    return BlockActiveRng[blockId].size() / (2 * SPACEDIM);
+}
+
+int* ActiveRng(const int blockId, const int rngIdx) {
+    if (BlockActiveRng.empty()) {
+        return BlockIterRng(blockId, BlockIterRngExtended);
+    }
+    return &BlockActiveRng[blockId][rngIdx * 2 * SPACEDIM];
+}
+
+void SetActiveRng(const int blockId, const std::vector<int>& iterRng) {
+    if (TEMPORALBLOCKING > 1) {
+        ops_printf(
+            "Error! The sparse execution does not support the temporal "
+            "blocking at this moment!\n");
+        assert(TEMPORALBLOCKING <= 1);
+    }
+    if ((int)BlockActiveRng.size() < BlockNum()) {
+        BlockActiveRng.resize(BlockNum());
+    }
+    BlockActiveRng[blockId] = iterRng;
+}
+
+std::vector<int> TileRuns(const int* wholeRng, const int tileSize,
+                          const int* tileNum, const std::vector<bool>& marked) {
+    std::vector<int> iterRng;
+    for (int k = 0; k < tileNum[2]; k++) {
+        for (int j = 0; j < tileNum[1]; j++) {
+            const int tileStart{(k * tileNum[1] + j) * tileNum[0]};
+            int i{0};
+            while (i < tileNum[0]) {
+                if (!marked[tileStart + i]) {
+                    i++;
+                    continue;
+                }
+                const int runStart{i};
+                while (i < tileNum[0] && marked[tileStart + i]) {
+                    i++;
+                }
+                const int rng[6]{runStart * tileSize,
+                                 std::min(i * tileSize, wholeRng[1]),
+                                 j * tileSize,
+                                 std::min((j + 1) * tileSize, wholeRng[3]),
+                                 k * tileSize,
+                                 std::min((k + 1) * tileSize, wholeRng[5])};
+                iterRng.insert(iterRng.end(), rng, rng + 6);
+            }
+        }
+    }
+    return iterRng;
+}
+
+const int StreamRngNum(const int blockId, const bool bulk) {
+    const std::vector<std::vector<int>>& streamRng{
+        bulk ? BlockBulkStreamRng : BlockMaskedStreamRng};
+    if (streamRng.empty()) {
+        return 0;
+    }
+    return streamRng[blockId].size() / (2 * SPACEDIM);
+}
+
+int* StreamRng(const int blockId, const bool bulk, const int rngIdx) {
+    std::vector<std::vector<int>>& streamRng{bulk ? BlockBulkStreamRng
+                                                  : BlockMaskedStreamRng};
+    return &streamRng[blockId][rngIdx * 2 * SPACEDIM];
+}
+
+const bool StreamRngReady() {
+    return !BlockMaskedStreamRng.empty() && 0 == ITERRNGEXTENSION;
+}
+
+void SetStreamRng(const int blockId, const std::vector<int>& bulkRng,
+                  const std::vector<int>& maskedRng) {
+    if ((int)BlockBulkStreamRng.size() < BlockNum()) {
+        BlockBulkStreamRng.resize(BlockNum());
+        BlockMaskedStreamRng.resize(BlockNum());
+    }
+    BlockBulkStreamRng[blockId] = bulkRng;
+    BlockMaskedStreamRng[blockId] = maskedRng;
+}
 
 const int* BlockSize(const int blockId) {
     return &BLOCKSIZE[blockId * SPACEDIM];
@@ -805,6 +3205,19 @@ Real TotalMeshSize() {
     return size;
 }
 
+void CountBytesMoved(const int* iterRng, const long bytesPerNode) {
+    long long nodeNum{1};
+    for (int dimIdx = 0; dimIdx < SPACEDIM; dimIdx++) {
+        nodeNum *= (iterRng[2 * dimIdx + 1] - iterRng[2 * dimIdx]);
+    }
+    BYTESMOVED += nodeNum * bytesPerNode;
+}
+
+const long long BytesMoved() { return BYTESMOVED; }
+
+void ResetBytesMoved() { BYTESMOVED = 0; }
+
+const bool FeqOnTheFly() { return FEQONTHEFLY; }
 const Real TimeStep() { return DT; }
 const Real* pTimeStep() { return &DT; }
 void SetTimeStep(Real dt) { DT = dt; }
@@ -40,6 +40,7 @@
 #define FLOWFIELD_H
 #include <algorithm>
 #include <cmath>
+#include <map>
 #include <string>
 #include "boundary.h"
 #include "model.h"
@@ -67,9 +68,13 @@ extern ops_dat* g_f;
  * if we use some control routine in the main.cpp
  */
 extern ops_dat* g_fStage;
+/*!
+ * Equilibrium function, nullptr if it is calculated on the fly
+ */
 extern ops_dat* g_feq;
 /*!
  * Bodyforce, which is independent of the particle velocity
+ * nullptr if it is calculated on the fly
  */
 extern ops_dat* g_Bodyforce;
 /*!
@@ -94,7 +99,11 @@ extern ops_dat* g_Tau;
  * for each component of a vector, two values are allocated
  */
 extern Real* g_ResidualError;
-extern ops_reduction* g_ResidualErrorHandle;
+/*!
+ * A vector reduction handle of 2*NUMMACROVAR doubles, laid out as
+ * g_ResidualError, so that all the residuals are fetched at once
+ */
+extern ops_reduction g_ResidualErrorHandle;
 // Boundary fitting mesh
 // The following variables are introduced for
 // implementing finite difference schemes
@@ -118,10 +127,30 @@ extern ops_dat* g_NodeType;
  * immersed solid? or the end point of the body.
  */
 extern ops_dat* g_GeometryProperty;
+/*!
+ * g_NodeType and g_GeometryProperty packed into 16 bits per component, which
+ * are read by the kernels of a time step instead, see NodeFlagBits. The
+ * former two are kept for the setup and the output.
+ */
+extern ops_dat* g_NodeFlag;
+/*!
+ * g_StreamMask: bit l of a component is set if its population
+ * COMPOINDEX[2*compoIdx]+l is pulled from the neighbour in the stream step,
+ * and clear if the node keeps its own value or a boundary kernel fills it,
+ * see KerSetStreamMask3D
+ */
+extern ops_dat* g_StreamMask;
 /*!
  * Coordinate
  */
 extern ops_dat* g_CoordinateXYZ;
+/*!
+ * The moments of f kept by a compressed checkpoint, FMomentNum for each
+ * component, nullptr unless Output_fMoments is written or restarted from, and
+ * a reduction handle of the three errors of KerCalcfMoments3D
+ */
+extern ops_dat* g_fMoments;
+extern ops_reduction g_fMomentsErrorHandle;
 // Cutting cell
 int* IterRngWhole();
 int* IterRngJmin();
@@ -131,6 +160,43 @@ int* IterRngImax();
 int* IterRngBulk();
 int* IterRngKmax();
 int* IterRngKmin();
+/*!
+ * The iteration ranges covering the surface nodes of embedded bodies in a
+ * block, grouped by VertexTypes. For each type, the ranges are stored one
+ * after another, 2*SPACEDIM integers each.
+ */
+std::map<int, std::vector<int>>& EmbeddedBoundaryRng(const int blockId);
+void SetEmbeddedBoundaryRng(const int blockId, const int vertexType,
+                            const std::vector<int>& iterRng);
+/*!
+ * The iteration ranges of the kernels which skip solid nodes in a block, i.e.,
+ * the runs of tiles containing non-solid nodes, or the solid nodes they stream
+ * from, found by SetupSparseExecution. Every kernel wrapper which loops over
+ * these ranges therefore visits only such tiles after SetupSparseExecution.
+ * It is the whole block if SetupSparseExecution has not been called, which
+ * may be extended into the halos, see SetIterRngExtension.
+ */
+const int ActiveRngNum(const int blockId);
+int* ActiveRng(const int blockId, const int rngIdx);
+void SetActiveRng(const int blockId, const std::vector<int>& iterRng);
+/*!
+ * Merge the neighbouring marked tiles of tileSize^3 nodes along x into
+ * iteration ranges within wholeRng, where the tiles are numbered x first
+ */
+std::vector<int> TileRuns(const int* wholeRng, const int tileSize,
+                          const int* tileNum, const std::vector<bool>& marked);
+/*!
+ * The iteration ranges of the stream step in a block found by
+ * SetupStreamRng3D, i.e., the runs of tiles where all the nodes are bulk
+ * fluid nodes (bulk) and the runs of the other tiles with non-solid nodes.
+ * StreamRngReady is false if they are not set up or the ranges are extended
+ * into the halos, when the stream step runs over ActiveRng instead.
+ */
+const int StreamRngNum(const int blockId, const bool bulk);
+int* StreamRng(const int blockId, const bool bulk, const int rngIdx);
+const bool StreamRngReady();
+void SetStreamRng(const int blockId, const std::vector<int>& bulkRng,
+                  const std::vector<int>& maskedRng);
 /*!
  *Get the pointer pointing to the starting position of IterRng of this block
  *No NULL check for efficiency
@@ -147,6 +213,7 @@ const int* BlockSize(const int blockId);
 const int BlockNum();
 const int SpaceDim();
 const int HaloDepth();
+const bool FeqOnTheFly();
 const Real TimeStep();
 const Real* pTimeStep();
 const Real* TauRef();
@@ -154,7 +221,111 @@ const Real* TauRef();
 const std::string CaseName();
 const int HaloPtNum();
 Real TotalMeshSize();
+/*!
+ * Accumulate the bytes moved by a ops_par_loop over iterRng, where
+ * bytesPerNode counts the bytes read plus the bytes written at a node.
+ * It is an estimate of the memory traffic of the time stepping.
+ */
+void CountBytesMoved(const int* iterRng, const long bytesPerNode);
+const long long BytesMoved();
+void ResetBytesMoved();
 const ops_halo_group HaloGroup();
+/*!
+ * A periodic halo of g_fStage along an axis of a block. Only the populations
+ * entering the block through the two faces are transferred, i.e., the ones
+ * streamed from the halo: XI[axis] > 0 from the layer size-1 to the layer -1
+ * and XI[axis] < 0 from the layer 0 to the layer size. They are packed into
+ * fPacked, whose face layers are transferred by haloGroup. Only these
+ * periodic halos are packed: the halos between the MPI ranks sharing a block
+ * and between connected blocks still carry all the NUMXI populations.
+ */
+struct PopulationHalo {
+    int blockIndex;
+    int axis;
+    std::vector<int> lowFacePop;
+    std::vector<int> highFacePop;
+    ops_dat fPacked;
+    ops_halo* haloRelations;
+    ops_halo_group haloGroup;
+};
+/*!
+ * Request a periodic halo of the distribution function along the axis
+ * (0, 1, 2 for x, y, z) of a block, which needs to be called before
+ * DefineProblemDomain. The nodes at the two faces shall be fluid nodes
+ * without a boundary condition. See PopulationHalo. It is a cheaper form of
+ * SetBlockPeriodicity for a block periodic with itself, and the two faces
+ * cannot be connected by SetBlockPeriodicity or DefineBlockConnection.
+ */
+void SetPeriodicHalo(const int blockIndex, const int axis);
+std::vector<PopulationHalo>& PopulationHalos();
+/*!
+ * Connect a face of a block to a face of a neighbour block, which needs to be
+ * called before DefineProblemDomain. The blocks do not overlap, i.e., the
+ * nodes next to a face stream from the nodes next to the other face, and the
+ * two faces shall have the same size and no boundary condition.
+ * orientation: the dir of ops_decl_halo, i.e., the axis of the neighbour
+ * (1, 2, 3 and negative if reversed) matched to each axis of the block, which
+ * is the identity if empty. The normal axes are always matched.
+ * The face, edge and corner halos of g_fStage are then generated by
+ * DefineBlockHalos and transferred by TransferPopulationHalos.
+ */
+void DefineBlockConnection(const int blockIndex, const BoundarySurface surface,
+                           const int neighbour,
+                           const BoundarySurface neighbourSurface,
+                           const std::vector<int>& orientation = {});
+/*!
+ * Make the blocks periodic along the axes where periodic is true, i.e., the
+ * high face of the last block of a chain of blocks connected along the axis
+ * is connected to the low face of the first one. It needs to be called before
+ * DefineProblemDomain, and may be used for a single block.
+ */
+void SetBlockPeriodicity(const std::vector<bool>& periodic);
+void DefineBlockHalos();
+/*!
+ * Temporal blocking, which only aggregates the halo messages of several steps
+ * rather than sweeping each tile over several steps: the halos between
+ * connected blocks are stepNum deep and exchanged once every stepNum steps. In the steps between, the collision
+ * and the stream also update the halo layers which are still valid, one
+ * layer fewer at each step. The halo nodes are updated redundantly, so that
+ * fewer exchanges cost some more computation. Each step still sweeps the
+ * whole block in each kernel, i.e., there is no tiling for the cache, so
+ * that only the number of the halo messages, and hence their latency, is
+ * reduced, while the bytes exchanged per step and the memory traffic of a
+ * step are not. 0 lets DefineVariables choose it from the block sizes by a
+ * fixed rule rather than by timing, see ChooseTemporalBlocking. It needs to be called before DefineProblemDomain
+ * and the blocks need to be connected by DefineBlockConnection or
+ * SetBlockPeriodicity. 3D only at this moment.
+ */
+void SetTemporalBlocking(const int stepNum = 0);
+const int TemporalBlocking();
+void ChooseTemporalBlocking();
+/*!
+ * The step within the current cycle of the temporal blocking, where the
+ * halos are exchanged at the step 0
+ */
+const int TemporalSubstep();
+void NextTemporalSubstep();
+/*!
+ * The layers of the halos updated by the collision and the stream at the
+ * current step of a cycle of the temporal blocking
+ */
+const int CollisionExtension();
+const int StreamExtension();
+/*!
+ * Extend the whole block, i.e., ActiveRng, into the halos at
+ * the connected faces by a number of layers
+ */
+void SetIterRngExtension(const int extension);
+/*!
+ * Extend a range at the connected faces which it touches by the number of
+ * layers given by SetIterRngExtension
+ */
+void ExtendIterRng(const int blockId, const int* iterRng, int* extendedRng);
+/*!
+ * The halos of g_NodeFlag and g_StreamMask between connected blocks, nullptr
+ * if there is no temporal blocking, see PackNodeFlags3D
+ */
+const ops_halo_group NodePropertyHaloGroup();
 void SetTimeStep(Real dt);
 void SetCaseName(const std::string caseName);
 void setCaseName(const char* caseName);
@@ -168,15 +339,184 @@ void SetBlockNum(const int blockNum);
 void SetupFlowfield();
 void SetupFlowfieldfromHdf5();
 void DefineVariables();
+/*!
+ * Print the memory allocated for each node by DefineVariables, which depends
+ * on the lattice, the scheme and DefineCase.
+ */
+void DispMemoryPerNode();
 void WriteFlowfieldToHdf5(const long timeStep);
 void WriteDistributionsToHdf5(const long timeStep);
 void WriteNodePropertyToHdf5(const long timeStep);
+/*!
+ * The fields that can be written by WriteCheckpoint, see SetOutputPeriod
+ */
+enum OutputField {
+    Output_MacroVars = 0,
+    Output_Tau = 1,
+    Output_CoordinateXYZ = 2,
+    Output_f = 3,
+    Output_fStage = 4,
+    Output_feq = 5,
+    Output_Bodyforce = 6,
+    Output_GeometryProperty = 7,
+    Output_NodeType = 8,
+    Output_fMoments = 9,
+};
+const int OutputFieldNum{10};
+/*!
+ * OutputPeriod_Never: the field is not written
+ * OutputPeriod_Once: the field is written into CASENAME_Block_i_static.h5 at
+ * the first checkpoint, and linked into the files of the later checkpoints
+ */
+const int OutputPeriod_Never{0};
+const int OutputPeriod_Once{-1};
+/*!
+ * Set the output manifest: the field is written at the checkpoints of the time
+ * steps that are a multiple of period, e.g., period=1 for every checkpoint.
+ * By default, only f, which is needed to restart, and the macroscopic
+ * variables are written at every checkpoint, while the coordinates, the node
+ * types and the geometry property are written once.
+ * Output_fMoments is a compressed replacement of f for restarting in 3D, i.e.,
+ * rho, u, v, w and the non-equilibrium stress of each component, from which f
+ * is rebuilt by the regularised Hermite expansion, see CalcRegularisedF3D. Its
+ * dats are only allocated if its period is set before DefineProblemDomain.
+ * When it replaces f, the macroscopic variables are not written unless their
+ * period is set, as the densities and the velocities are rebuilt from it.
+ */
+void SetOutputPeriod(const OutputField field, const int period);
+int OutputPeriod(const OutputField field);
+/*!
+ * The dats of a field, nullptr if the field is not allocated, e.g., g_feq when
+ * the equilibrium is calculated on the fly
+ */
+ops_dat* OutputFieldDats(const OutputField field);
+/*!
+ * The name of the output file of a block, e.g., CASENAME_Block_0_100.h5 for
+ * suffix=100 or CASENAME_Block_0_static.h5 for suffix=static
+ */
+std::string OutputFileName(const int blockIndex, const std::string& suffix);
+/*!
+ * OutputMode_BlockFiles: a file for each block, CASENAME_Block_i_step.h5,
+ * written by OPS, or, if built with ASYNCIO=1, written by HDF5 as the group
+ * Block_i of the shared file below
+ * OutputMode_SharedFile: a single file for all the blocks, CASENAME_step.h5,
+ * where each rank writes its part by the collective I/O of parallel HDF5.
+ * Each dat is a (nz, ny, nx, dim) dataset without halos in the group Block_i,
+ * and CASENAME_step.xmf describes the file for visualisation tools.
+ * OutputMode_TimeSeries: a single file for the whole run, CASENAME_series.h5,
+ * which is kept open, and each output appends a slice to the datasets of the
+ * shared file along an unlimited time dimension, i.e., (time, nz, ny, nx, dim).
+ * The 1-D datasets Step and Time of the file, which also have an unlimited
+ * dimension, are the step and the simulated time of each slice. The static
+ * fields are written into CASENAME_static.h5.
+ * A later Iterate reopens the file, and a restart reopens it and drops the
+ * slices after its checkpoint.
+ */
+enum OutputMode {
+    OutputMode_BlockFiles = 0,
+    OutputMode_SharedFile = 1,
+    OutputMode_TimeSeries = 2,
+};
+void SetOutputMode(const OutputMode mode);
+/*!
+ * Set the layout of the shared and the time-series files
+ * chunkSize: the chunk size in x, y(, z) of the datasets, which are contiguous
+ * if it is empty
+ * alignment: objects larger than alignThreshold bytes are aligned to it, e.g.,
+ * the stripe size of a parallel file system, no alignment if it is 0
+ */
+void SetSharedFileLayout(const std::vector<int>& chunkSize,
+                         const long alignThreshold = 0,
+                         const long alignment = 0);
+/*!
+ * The name of the shared output file, e.g., CASENAME_100.h5 for suffix=100
+ */
+std::string SharedOutputFileName(const std::string& suffix);
+/*!
+ * Write the fields of the output manifest at timeStep by the output mode, see
+ * SetOutputPeriod and SetOutputMode, and print the I/O bandwidth
+ */
+void WriteCheckpoint(const long timeStep);
+/*!
+ * Same as WriteCheckpoint but the time stepping continues while the files are
+ * written, if built with ASYNCIO=1. The dats are fetched into the host buffers
+ * of a free staging slot and a background thread writes the slot by HDF5
+ * alone, as OPS is not thread-safe. There are two slots, so that the solver
+ * waits only if a checkpoint is started before the last but one is on the
+ * disk. Under MPI the thread writes by a duplicate of MPI_COMM_WORLD, which
+ * needs MPI_THREAD_MULTIPLE, otherwise the checkpoints are written
+ * synchronously.
+ */
+void WriteCheckpointAsync(const long timeStep);
+/*!
+ * Wait until the queued checkpoints are written, stop the writer thread,
+ * print the time that the solver spent on the checkpoints, and close the
+ * time-series file
+ */
+void FlushCheckpoints();
+/*!
+ * Wait until the queued checkpoints are written and stop the writer thread,
+ * which FlushCheckpoints and SetOutputMode do, without the report
+ */
+void StopCheckpointWriter();
+/*!
+ * Close the time-series file, see OutputMode_TimeSeries
+ */
+void CloseOutputFiles();
+/*!
+ * Prepare restarting from the checkpoint written at step, see
+ * RestartFromCheckpoint in hilemms.h
+ * The block number, the block sizes, the reference relaxation times and the
+ * time step are read from CASENAME_case.h5, which is written with the first
+ * checkpoint, and the format of the checkpoint is found from the files, i.e.,
+ * the block files, the shared file of the step or the time-series file.
+ * With the block files of OPS, DefineVariables reads the dats from the files,
+ * and the other formats are read by ReadRestartData after ops_partition.
+ */
+void SetRestart(const long step);
+void ReadRestartData();
+/*!
+ * The step and the format of the checkpoint restarted from, -1 for a cold
+ * start, and the first step to run, i.e., the next one after the checkpoint
+ */
+long RestartStep();
+OutputMode RestartMode();
+/*!
+ * If the checkpoint is the per-block files written by OPS, whose dats are
+ * declared from the files by DefineVariables, rather than read by
+ * ReadRestartData
+ */
+bool RestartFromOpsFiles();
+/*!
+ * If f is rebuilt from Output_fMoments since the checkpoint does not keep f
+ */
+bool RestartFromMoments();
+/*!
+ * If the macroscopic variables are also rebuilt from Output_fMoments, since
+ * the compressed checkpoint skips them, see SetOutputPeriod
+ */
+bool RestartMacroVarsFromMoments();
+/*!
+ * If the macroscopic variables are computed from f, since the checkpoint
+ * keeps neither them nor their moments, see Iterate
+ */
+bool RestartMacroVarsFromF();
+long StartStep();
+/*!
+ * The wall time since DefineCase, i.e., the time to the first step if called
+ * before it
+ */
+double SetupTime();
 void DestroyFlowfield();
 void DefineHaloTransfer();
 void DefineHaloTransfer3D();
+void DefinePopulationHalos();
 void SetHaloDepth(const int haloDepth);
 void SetHaloRelationNum(const int haloRelationNum);
 // caseName: case name
 // spaceDim: 2D or 3D application
-void DefineCase(std::string caseName, const int spaceDim);
+// feqOnTheFly: calculate the equilibrium and body force inside the collision
+// kernel so that g_feq and g_Bodyforce are not allocated.
+void DefineCase(std::string caseName, const int spaceDim,
+                const bool feqOnTheFly = false);
 #endif
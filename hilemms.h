@@ -54,6 +54,36 @@
 void DefineProblemDomain(const int blockNum, const std::vector<int> blockSize,
                          const Real meshSize, const std::vector<Real> startPos);
 
+// Restart a case from the checkpoint written at a step instead of calling
+// DefineProblemDomain and DefineInitialCondition, where the case is defined as
+// before otherwise, e.g., the components, the scheme and the boundary
+// conditions. The blocks and the fields of the checkpoint are read, and
+// Iterate continues from the next step.
+// caseName: the name of the case which wrote the checkpoint.
+// step: the step of the checkpoint.
+void RestartFromCheckpoint(const std::string& caseName, const long step);
+
+// Complete one time step using the chosen scheme.
+void MarchOneStep(const SchemeType scheme);
+
+// Report the performance in million lattice updates per second (MLUPS).
+// steps: number of time steps.
+// wallTime: wall time spent on these steps.
+// bytesMoved: estimated bytes moved during these steps.
+void DispPerformance(const long steps, const double wallTime,
+                     const long long bytesMoved);
+
+// Run the time steps with the lazy execution and cache tiling of OPS, which
+// needs the OPS_LAZY build, e.g., make TILING=1. The loops of tilingSteps
+// steps are queued and then tiled together by ops_execute.
+// tilingSteps: 0 lets the first tuningSteps steps of Iterate measure a few
+// choices, unless a choice for the same lattice and block sizes is found in
+// the per-machine cache file written by the tuning, see TilingCacheFile.
+void SetTiling(const int tilingSteps = 0, const int tuningSteps = 64);
+
+// Complete one time step and execute the queued loops if the tiling is used.
+void MarchTiledStep(const SchemeType scheme, const long iter);
+
 // Iterator for transient simulations.
 void Iterate(const int steps, const int checkPointPeriod);
 
@@ -114,6 +144,11 @@ void DefineHaloNumber(int Halo_Number, int Halo_Depth, int Scheme_Halo_points,
 // A wrapper Function which implements all the boundary conditions.
 void ImplementBoundaryConditions();
 
+// Transfer the periodic halos of g_fStage set by SetPeriodicHalo and the
+// halos between connected blocks, which is called between the collision and
+// the stream.
+void TransferPopulationHalos();
+
 
 // type: Circle/Sphere, Ellipse/Ellipsoid, superquadrics, ...
 // centerPos: the position vector of the center point.
@@ -142,7 +177,41 @@ void KerSweep(const int* geometryProperty, int* nodeType);
 void KerSyncGeometryProperty(const int* nodeType, int* geometryProperty);
 
 void KerSetEmbeddedBodyGeometry(const int* nodeType, int* geometryProperty);
+/*!
+ * Find the first and last node of each row (i.e., along x) whose type is
+ * vertexType, rowMin and rowMax are reductions of one integer per row
+ */
+void KerFindEmbeddedBoundaryRow(const int* vertexType, const int* rowStart,
+                                const int* nodeType, const int* idx,
+                                int* rowMin, int* rowMax);
+/*!
+ * Record the rows of surface nodes of type vertexType in a block as the
+ * iteration ranges of the embedded boundary, see EmbeddedBoundaryRng
+ */
+void SetupEmbeddedBoundaryRng(const int blockIndex, int vertexType);
 
 void HandleImmersedSolid();
 
+/*!
+ * Mark the nodes inside a sphere as solid nodes
+ */
+void KerSetEmbeddedSphere(const Real* diameter, const Real* centerPos,
+                          const Real* coordinates, int* nodeType,
+                          int* geometryProperty);
+/*!
+ * Mark the tiles of tileSize^3 nodes which contain non-solid nodes or solid
+ * nodes next to them, activeTile is a reduction of one integer per tile
+ */
+void KerFindActiveTile3D(const int* tileSize, const int* tileNum,
+                         const int* nodeType, const int* idx,
+                         int* activeTile);
+
+// Let the kernels which skip solid nodes run only over the tiles of
+// tileSize^3 nodes that contain non-solid nodes, so that the cost of a time
+// step follows the fluid fraction rather than the box volume in porous or
+// solid-dominated domains. The solid nodes next to a non-solid node count as
+// well as the latter streams from them. The tiles shall be much smaller than
+// the solid bodies. It shall be called after all solid bodies are set.
+void SetupSparseExecution(const int tileSize = 4);
+
 #endif  // Hilemms_H
\ No newline at end of file
@@ -31,11 +31,19 @@
 */
 
 #include "hilemms.h"
+#include <unistd.h>
+#include <algorithm>
+#include <limits>
+#include <map>
 #include "hilemms_ops_kernel.h"
 
 
 Real* VERTEXCOORDINATES{nullptr};
 int NUMVERTICES{0};
+// The number of steps whose loops are queued and tiled together by OPS, 0 if
+// the tiling is not used, and the steps for tuning it, see SetTiling.
+int TILINGSTEPS{0};
+int TILINGTUNINGSTEPS{0};
 
 // Structure to hold the values whenever user specifies a boundary condition.
 struct BlockBoundary {
@@ -349,6 +357,43 @@ void DefineProblemDomain(const int blockNum, const std::vector<int> blockSize,
     }
 }
 
+void RestartFromCheckpoint(const std::string& caseName, const long step) {
+    double ct0, ct1, et0, et1;
+    ops_timers(&ct0, &et0);
+    setCaseName(caseName.c_str());
+    SetRestart(step);
+    DefineVariables();
+#ifdef OPS_3D
+    DefineHaloTransfer3D();
+#endif  // OPS_3D
+#ifdef OPS_2D
+    DefineHaloTransfer();
+#endif  // OPS_2D
+    ops_partition((char*)"LBM Solver");
+    // the files written by HDF5 only keep the nodes without halos, whose
+    // types are set again before the others are read
+    if (!RestartFromOpsFiles()) {
+        for (int blockId = 0; blockId < BlockNum(); blockId++) {
+            SetBlockGeometryProperty(blockId);
+            for (int compoId = 0; compoId < NUMCOMPONENTS; compoId++) {
+                SetBulkandHaloNodesType(blockId, compoId);
+            }
+        }
+        ReadRestartData();
+    }
+    // f is swapped after each odd step of the AA pattern, while the f rebuilt
+    // from its moments is at the natural position
+    if (RestartFromMoments()) {
+#ifdef OPS_3D
+        RebuildDistribution3D();
+#endif  // OPS_3D
+    } else if (Scheme_StreamCollisionAA == Scheme()) {
+        SetFLayout(0 == (step + 1) % 2 ? Layout_Natural : Layout_AASwapped);
+    }
+    ops_timers(&ct1, &et1);
+    ops_printf("Restarted from step %li in %f seconds\n", step, et1 - et0);
+}
+
 // Check whether this needs to be defines using OPS Kernel.
 Real GetMaximumResidualError(const Real checkPeriod) {
     Real maxResError = 1E-15;
@@ -365,37 +410,283 @@ Real GetMaximumResidualError(const Real checkPeriod) {
     return maxResError;
 }
 
+// Complete one time step using the chosen scheme.
+void MarchOneStep(const SchemeType scheme) {
+#ifdef CHECKHEAPALLOC
+    const long long heapAllocNum{HeapAllocNum()};
+#endif
+#ifdef OPS_3D
+    if (Scheme_StreamCollisionFused == scheme) {
+        StreamCollisionFused3D();
+    } else if (Scheme_StreamCollisionAA == scheme) {
+        StreamCollisionAA3D();
+    } else {
+        StreamCollision3D();
+    }
+#endif  // end of OPS_3D
+#ifdef OPS_2D
+    if (Scheme_StreamCollisionFused == scheme) {
+        StreamCollisionFused();
+    } else if (Scheme_StreamCollisionAA == scheme) {
+        StreamCollisionAA();
+    } else {
+        StreamCollision();
+    }
+#endif  // end of OPS_2D
+#ifdef CHECKHEAPALLOC
+    // kernels shall use the fixed-size arrays, see MAXLATTSIZE
+    // except the loops queued by the lazy execution of OPS
+    const long long stepAllocNum{HeapAllocNum() - heapAllocNum};
+    if (stepAllocNum > 0 && 0 == TILINGSTEPS) {
+        ops_printf("Error! There are %lld heap allocations in a time step!\n",
+                   stepAllocNum);
+        assert(0 == stepAllocNum);
+    }
+#endif
+}
+
+void DispPerformance(const long steps, const double wallTime,
+                     const long long bytesMoved) {
+    if (steps > 0 && wallTime > 0) {
+        ops_printf(
+            "Performance: %li steps in %f seconds (excluding checkpoints), "
+            "%f MLUPS\n",
+            steps, wallTime, TotalMeshSize() * steps / wallTime / 1E6);
+        ops_printf(
+            "Estimated memory traffic: %f MB per step, %f GB/s\n",
+            bytesMoved / 1E6 / steps, bytesMoved / wallTime / 1E9);
+    }
+}
+
+void SetTiling(const int tilingSteps, const int tuningSteps) {
+    if (tilingSteps < 0 || (0 == tilingSteps && tuningSteps <= 0)) {
+        ops_printf(
+            "Error! The tiling needs a positive number of steps per tile or "
+            "of steps for tuning it!\n");
+        assert(tilingSteps > 0 || (0 == tilingSteps && tuningSteps > 0));
+    }
+#ifdef OPS_LAZY
+    ops_enable_tiling = 1;
+    TILINGSTEPS = tilingSteps;
+    TILINGTUNINGSTEPS = tilingSteps > 0 ? 0 : tuningSteps;
+#else
+    ops_printf(
+        "Warning! The tiling needs the lazy execution of OPS, e.g., make "
+        "TILING=1, and is ignored!\n");
+#endif
+}
+
+void MarchTiledStep(const SchemeType scheme, const long iter) {
+    MarchOneStep(scheme);
+#ifdef OPS_LAZY
+    if (TILINGSTEPS > 0 && 0 == (iter + 1) % TILINGSTEPS) {
+        ops_execute();
+    }
+#endif
+}
+
+void FlushTiling() {
+#ifdef OPS_LAZY
+    if (TILINGSTEPS > 0) {
+        ops_execute();
+    }
+#endif
+}
+
+// The maximum of a value over all the MPI ranks, so that they take the same
+// decision from their own timing.
+Real MaxOverRanks(Real value) {
+    Real maxValue{-std::numeric_limits<Real>::max()};
+    ops_reduction maxHandle{
+        ops_decl_reduction_handle(sizeof(Real), RealC, "maxValue")};
+    int blockIndex{0};
+    ops_par_loop(KerReduceMax, "KerReduceMax", g_Block[blockIndex], SPACEDIM,
+                 BlockIterRng(blockIndex, IterRngWhole()),
+                 ops_arg_gbl(&value, 1, RealC, OPS_READ),
+                 ops_arg_reduce(maxHandle, 1, RealC, OPS_MAX));
+    ops_reduction_result(maxHandle, &maxValue);
+    return maxValue;
+}
+
+// The tiling is cached for each machine and keyed by the lattice and the
+// block sizes.
+const std::string TilingCacheFile() {
+    char hostName[256]{"unknown"};
+    gethostname(hostName, sizeof(hostName) - 1);
+    return "MPLB_tiling_" + std::string(hostName) + ".txt";
+}
+
+const std::string TilingCacheKey() {
+    std::string key;
+    for (const std::string& lattice : LatticeName()) {
+        key += lattice + "_";
+    }
+    for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+        for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+            key += (cordIdx > 0 ? "x" : "_") +
+                   std::to_string(BlockSize(blockIndex)[cordIdx]);
+        }
+    }
+    return key;
+}
+
+std::map<std::string, int> ReadTilingCache() {
+    std::map<std::string, int> cache;
+    std::ifstream cacheFile(TilingCacheFile());
+    std::string key;
+    int tilingSteps{0};
+    while (cacheFile >> key >> tilingSteps) {
+        cache[key] = tilingSteps;
+    }
+    return cache;
+}
+
+int TuneTiling(const SchemeType scheme, const int maxSteps) {
+    if (0 != TILINGSTEPS || TILINGTUNINGSTEPS <= 0) {
+        return 0;
+    }
+    const std::string key{TilingCacheKey()};
+    std::map<std::string, int> cache{ReadTilingCache()};
+    // the entry found by the root, which all the ranks take, as the ranks
+    // on other machines may read other cache files
+    const int cachedSteps{(int)MaxOverRanks(
+        ops_is_root() && cache.count(key) > 0 ? cache[key] : 0)};
+    if (cachedSteps > 0) {
+        TILINGSTEPS = cachedSteps;
+        ops_printf("The loops of %i steps are tiled together as cached in %s\n",
+                   TILINGSTEPS, TilingCacheFile().c_str());
+        return 0;
+    }
+    // the number of steps whose loops are tiled together
+    const std::vector<int> candidates{1, 2, 4, 8};
+    const int maxCandidate{candidates.back()};
+    const int candidateSteps{
+        std::max(1, TILINGTUNINGSTEPS / (int)candidates.size() / maxCandidate) *
+        maxCandidate};
+    if ((int)candidates.size() * (candidateSteps + maxCandidate) > maxSteps) {
+        TILINGSTEPS = 1;
+        ops_printf(
+            "There are too few steps for tuning the tiling, the loops of each "
+            "step are tiled together\n");
+        return 0;
+    }
+    int iter{0};
+    double bestTime{std::numeric_limits<double>::max()};
+    for (const int tilingSteps : candidates) {
+        TILINGSTEPS = tilingSteps;
+        // the first tiling plan of OPS is built by the first ops_execute
+        for (int stepIdx = 0; stepIdx < tilingSteps; stepIdx++) {
+            MarchTiledStep(scheme, stepIdx);
+        }
+        iter += tilingSteps;
+        double ct0, ct1, et0, et1;
+        ops_timers(&ct0, &et0);
+        for (int stepIdx = 0; stepIdx < candidateSteps; stepIdx++) {
+            MarchTiledStep(scheme, stepIdx);
+        }
+        ops_timers(&ct1, &et1);
+        iter += candidateSteps;
+        const double time{MaxOverRanks(et1 - et0)};
+        ops_printf("Tiling the loops of %i steps: %f seconds per step\n",
+                   tilingSteps, time / candidateSteps);
+        if (time < bestTime) {
+            bestTime = time;
+            cache[key] = tilingSteps;
+        }
+    }
+    TILINGSTEPS = cache[key];
+    if (ops_is_root()) {
+        std::ofstream cacheFile(TilingCacheFile());
+        for (const auto& entry : cache) {
+            cacheFile << entry.first << " " << entry.second << "\n";
+        }
+    }
+    ops_printf("The loops of %i steps are tiled together, cached in %s\n",
+               TILINGSTEPS, TilingCacheFile().c_str());
+    return iter;
+}
+
+// Compute the macroscopic variables from f after a restart from a checkpoint
+// without them, which needs the node flags packed. f at its swapped position
+// is left to the AA kernels of the next step, which compute them as well.
+void UpdateRestartMacroVars() {
+    if (!RestartMacroVarsFromF() || Layout_Natural != FLayout()) {
+        return;
+    }
+#ifdef OPS_3D
+    UpdateMacroVars3D();
+#endif
+#ifdef OPS_2D
+    UpdateMacroVars();
+#endif
+}
+
 void Iterate(const int steps, const int checkPointPeriod) {
     const SchemeType scheme = Scheme();
+#ifdef OPS_3D
+    PackNodeFlags3D();
+#endif
+#ifdef OPS_2D
+    PackNodeFlags();
+#endif
+    UpdateRestartMacroVars();
+    ops_printf("The setup took %f seconds before the first step\n",
+               SetupTime());
     ops_printf("Starting the iteration...\n");
     switch (scheme) {
-        case Scheme_StreamCollision: {
-            for (int iter = 0; iter < steps; iter++) {
+        case Scheme_StreamCollision:
+        case Scheme_StreamCollisionFused:
+        case Scheme_StreamCollisionAA: {
+            double ct0, ct1, et0, et1;
+            double wallTime{0};
+            long long bytesMoved{0};
+            // the steps for tuning the tiling are not timed, which are taken
+            // from the steps left after a restart
+            const long firstStep{
+                StartStep() + TuneTiling(scheme, (int)(steps - StartStep()))};
+            for (long iter = firstStep; iter < steps; iter++) {
+                ResetBytesMoved();
+                ops_timers(&ct0, &et0);
+                MarchTiledStep(scheme, iter);  // Stream-Collision scheme
+                ops_timers(&ct1, &et1);
+                wallTime += et1 - et0;
+                bytesMoved += BytesMoved();
 #ifdef OPS_3D
-                StreamCollision3D();  // Stream-Collision scheme
                 // TimeMarching();//Finite difference scheme + cutting cell
                 if ((iter % checkPointPeriod) == 0 && iter != 0) {
-                    UpdateMacroVars3D();
+                    // f is not at its natural position after an even AA
+                    // step, when the AA kernels have updated the
+                    // macroscopic variables already
+                    if (Layout_Natural == FLayout()) {
+                        UpdateMacroVars3D();
+                    }
                     CalcResidualError3D();
                     DispResidualError3D(iter, checkPointPeriod * TimeStep());
-                    WriteFlowfieldToHdf5(iter);
-                    WriteDistributionsToHdf5(iter);
-                    WriteNodePropertyToHdf5(iter);
+                    CalcfMoments3D(iter);
+                    WriteCheckpointAsync(iter);
                 }
 #endif  // end of OPS_3D
 #ifdef OPS_2D
-                StreamCollision();  // Stream-Collision scheme
                 // TimeMarching();//Finite difference scheme + cutting cell
                 if ((iter % checkPointPeriod) == 0 && iter != 0) {
-                    UpdateMacroVars();
+                    // f is not at its natural position after an even AA
+                    // step, when the AA kernels have updated the
+                    // macroscopic variables already
+                    if (Layout_Natural == FLayout()) {
+                        UpdateMacroVars();
+                    }
                     CalcResidualError();
                     DispResidualError(iter, checkPointPeriod * TimeStep());
-                    WriteFlowfieldToHdf5(iter);
-                    WriteDistributionsToHdf5(iter);
-                    WriteNodePropertyToHdf5(iter);
+                    WriteCheckpointAsync(iter);
                 }
 #endif  // end of OPS_2D
             }
+            ops_timers(&ct0, &et0);
+            FlushTiling();
+            ops_timers(&ct1, &et1);
+            wallTime += et1 - et0;
+            FlushCheckpoints();
+            DispPerformance(steps - firstStep, wallTime, bytesMoved);
         } break;
         default:
             break;
@@ -407,43 +698,78 @@ void Iterate(const int steps, const int checkPointPeriod) {
 
 void Iterate(const Real convergenceCriteria, const int checkPointPeriod) {
     const SchemeType scheme = Scheme();
+#ifdef OPS_3D
+    PackNodeFlags3D();
+#endif
+#ifdef OPS_2D
+    PackNodeFlags();
+#endif
+    UpdateRestartMacroVars();
+    ops_printf("The setup took %f seconds before the first step\n",
+               SetupTime());
     ops_printf("Starting the iteration...\n");
     switch (scheme) {
-        case Scheme_StreamCollision: {
-            int iter{0};
+        case Scheme_StreamCollision:
+        case Scheme_StreamCollisionFused:
+        case Scheme_StreamCollisionAA: {
+            // the steps for tuning the tiling are not timed
+            const long firstStep{
+                StartStep() +
+                TuneTiling(scheme, std::numeric_limits<int>::max())};
+            long iter{firstStep};
             Real residualError{1};
+            double ct0, ct1, et0, et1;
+            double wallTime{0};
+            long long bytesMoved{0};
             do {
+                ResetBytesMoved();
+                ops_timers(&ct0, &et0);
+                MarchTiledStep(scheme, iter);  // Stream-Collision scheme
+                ops_timers(&ct1, &et1);
+                wallTime += et1 - et0;
+                bytesMoved += BytesMoved();
 #ifdef OPS_3D
-                StreamCollision3D();  // Stream-Collision scheme
                 if ((iter % checkPointPeriod) == 0) {
-                    UpdateMacroVars3D();
+                    // f is not at its natural position after an even AA
+                    // step, when the AA kernels have updated the
+                    // macroscopic variables already
+                    if (Layout_Natural == FLayout()) {
+                        UpdateMacroVars3D();
+                    }
                     CalcResidualError3D();
                     residualError =
                         GetMaximumResidualError(checkPointPeriod * TimeStep());
                     DispResidualError3D(iter, checkPointPeriod * TimeStep());
-                    WriteFlowfieldToHdf5(iter);
-                    WriteDistributionsToHdf5(iter);
-                    WriteNodePropertyToHdf5(iter);
+                    CalcfMoments3D(iter);
+                    WriteCheckpointAsync(iter);
                 }
 #endif  // end of OPS_3D
 
 #ifdef OPS_2D
-                StreamCollision();  // Stream-Collision scheme
                 // TimeMarching();//Finite difference scheme + cutting cell
                 if ((iter % checkPointPeriod) == 0 && iter != 0) {
-                    UpdateMacroVars();
+                    // f is not at its natural position after an even AA
+                    // step, when the AA kernels have updated the
+                    // macroscopic variables already
+                    if (Layout_Natural == FLayout()) {
+                        UpdateMacroVars();
+                    }
                     CalcResidualError();
                     residualError =
                         GetMaximumResidualError(checkPointPeriod * TimeStep());
                     DispResidualError(iter, checkPointPeriod * TimeStep());
-                    WriteFlowfieldToHdf5(iter);
-                    WriteDistributionsToHdf5(iter);
-                    WriteNodePropertyToHdf5(iter);
+                    WriteCheckpointAsync(iter);
                 }
 
 #endif  // end of OPS_2D
                 iter = iter + 1;
             } while (residualError >= convergenceCriteria);
+            ops_timers(&ct0, &et0);
+            FlushTiling();
+            ops_timers(&ct1, &et1);
+            wallTime += et1 - et0;
+            FlushCheckpoints();
+            DispPerformance(iter - firstStep, wallTime, bytesMoved);
         } break;
         default:
             break;
@@ -603,6 +929,80 @@ void DefineBlockBoundary(int blockIndex, int componentID,
     }
 }
 
+void TransferPopulationHalos() {
+    const int haloDepth{HaloDepth()};
+    for (PopulationHalo& halo : PopulationHalos()) {
+        const int blockIndex{halo.blockIndex};
+        const int axis{halo.axis};
+        const int* size{BlockSize(blockIndex)};
+        int lowPopNum{(int)halo.lowFacePop.size()};
+        int highPopNum{(int)halo.highFacePop.size()};
+        const int packedNum{std::max(lowPopNum, highPopNum)};
+        // one layer at the face, including the halos of the other axes
+        int iterRng[2 * MAXDIM];
+        for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+            iterRng[2 * cordIdx] = -haloDepth;
+            iterRng[2 * cordIdx + 1] = size[cordIdx] + haloDepth;
+        }
+        // the populations leaving through the high face enter at the low one
+        iterRng[2 * axis] = size[axis] - 1;
+        iterRng[2 * axis + 1] = size[axis];
+        ops_par_loop(KerPackPopulations, "KerPackPopulations",
+                     g_Block[blockIndex], SPACEDIM, iterRng,
+                     ops_arg_gbl(&lowPopNum, 1, "int", OPS_READ),
+                     ops_arg_gbl(halo.lowFacePop.data(), lowPopNum, "int",
+                                 OPS_READ),
+                     ops_arg_dat(g_fStage[blockIndex], NUMXI, LOCALSTENCIL,
+                                 FRealC, OPS_READ),
+                     ops_arg_dat(halo.fPacked, packedNum, LOCALSTENCIL,
+                                 FRealC, OPS_RW));
+        CountBytesMoved(iterRng, 2 * lowPopNum * sizeof(FReal));
+        iterRng[2 * axis] = 0;
+        iterRng[2 * axis + 1] = 1;
+        ops_par_loop(KerPackPopulations, "KerPackPopulations",
+                     g_Block[blockIndex], SPACEDIM, iterRng,
+                     ops_arg_gbl(&highPopNum, 1, "int", OPS_READ),
+                     ops_arg_gbl(halo.highFacePop.data(), highPopNum, "int",
+                                 OPS_READ),
+                     ops_arg_dat(g_fStage[blockIndex], NUMXI, LOCALSTENCIL,
+                                 FRealC, OPS_READ),
+                     ops_arg_dat(halo.fPacked, packedNum, LOCALSTENCIL,
+                                 FRealC, OPS_RW));
+        CountBytesMoved(iterRng, 2 * highPopNum * sizeof(FReal));
+
+        ops_halo_transfer(halo.haloGroup);
+
+        iterRng[2 * axis] = -1;
+        iterRng[2 * axis + 1] = 0;
+        ops_par_loop(KerUnpackPopulations, "KerUnpackPopulations",
+                     g_Block[blockIndex], SPACEDIM, iterRng,
+                     ops_arg_gbl(&lowPopNum, 1, "int", OPS_READ),
+                     ops_arg_gbl(halo.lowFacePop.data(), lowPopNum, "int",
+                                 OPS_READ),
+                     ops_arg_dat(halo.fPacked, packedNum, LOCALSTENCIL,
+                                 FRealC, OPS_READ),
+                     ops_arg_dat(g_fStage[blockIndex], NUMXI, LOCALSTENCIL,
+                                 FRealC, OPS_RW));
+        CountBytesMoved(iterRng, 2 * lowPopNum * sizeof(FReal));
+        iterRng[2 * axis] = size[axis];
+        iterRng[2 * axis + 1] = size[axis] + 1;
+        ops_par_loop(KerUnpackPopulations, "KerUnpackPopulations",
+                     g_Block[blockIndex], SPACEDIM, iterRng,
+                     ops_arg_gbl(&highPopNum, 1, "int", OPS_READ),
+                     ops_arg_gbl(halo.highFacePop.data(), highPopNum, "int",
+                                 OPS_READ),
+                     ops_arg_dat(halo.fPacked, packedNum, LOCALSTENCIL,
+                                 FRealC, OPS_READ),
+                     ops_arg_dat(g_fStage[blockIndex], NUMXI, LOCALSTENCIL,
+                                 FRealC, OPS_RW));
+        CountBytesMoved(iterRng, 2 * highPopNum * sizeof(FReal));
+    }
+    // the halos between the blocks, see DefineBlockConnection
+    if (nullptr != HaloGroup()) {
+        ops_halo_transfer(HaloGroup());
+    }
+}
+
 void ImplementBoundaryConditions() {
     int totalNumBoundCond;
     totalNumBoundCond = blockBoundaryConditions.size();
@@ -611,6 +1011,11 @@ void ImplementBoundaryConditions() {
             int* rangeBoundaryCondition;
             rangeBoundaryCondition = BoundarySurfaceRange(
                 blockBoundaryConditions[i].blockIndex, blockBoundaryConditions[i].boundarySurface);
+            // including the halo layers updated by the temporal blocking
+            int extendedRng[2 * MAXDIM];
+            ExtendIterRng(blockBoundaryConditions[i].blockIndex,
+                          rangeBoundaryCondition, extendedRng);
+            rangeBoundaryCondition = extendedRng;
 #ifdef OPS_2D
 
             TreatDomainBoundary(blockBoundaryConditions[i].blockIndex,
@@ -634,6 +1039,9 @@ void ImplementBoundaryConditions() {
     else {
         ops_printf("\n No Boundary condition has been defined.");
     }
+#ifdef OPS_2D
+    TreatEmbeddedBoundary();
+#endif  // End of OPS_2D
 }
 
 void InitialiseNodeMacroVars(Real* nodeMacroVars, const Real* nodeCoordinates) {
@@ -1084,7 +1492,50 @@ void HandleImmersedSolid() {
                                  LOCALSTENCIL, "int", OPS_READ),
                      ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
                                  LOCALSTENCIL, "int", OPS_RW));
+        // so that the boundary is only treated at the surface
+        SetupEmbeddedBoundaryRng(blockIndex, nodeType);
+    }
+}
+
+void SetupEmbeddedBoundaryRng(const int blockIndex, int vertexType) {
+    int* bulkRng = BlockIterRng(blockIndex, IterRngBulk());
+    int rowStart{bulkRng[2]};
+    const int rowNum{bulkRng[3] - bulkRng[2]};
+    if (rowNum <= 0) {
+        return;
+    }
+    ops_reduction rowMinHandle = ops_decl_reduction_handle(
+        rowNum * sizeof(int), "int", "EmbeddedBoundaryRowMin");
+    ops_reduction rowMaxHandle = ops_decl_reduction_handle(
+        rowNum * sizeof(int), "int", "EmbeddedBoundaryRowMax");
+    ops_par_loop(KerFindEmbeddedBoundaryRow, "KerFindEmbeddedBoundaryRow",
+                 g_Block[blockIndex], SPACEDIM, bulkRng,
+                 ops_arg_gbl(&vertexType, 1, "int", OPS_READ),
+                 ops_arg_gbl(&rowStart, 1, "int", OPS_READ),
+                 ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
+                             LOCALSTENCIL, "int", OPS_READ),
+                 ops_arg_idx(),
+                 ops_arg_reduce(rowMinHandle, rowNum, "int", OPS_MIN),
+                 ops_arg_reduce(rowMaxHandle, rowNum, "int", OPS_MAX));
+    std::vector<int> rowMin(rowNum);
+    std::vector<int> rowMax(rowNum);
+    ops_reduction_result(rowMinHandle, rowMin.data());
+    ops_reduction_result(rowMaxHandle, rowMax.data());
+    // a row without surface nodes keeps the initial min > max
+    std::vector<int> iterRng;
+    for (int row = 0; row < rowNum; row++) {
+        if (rowMin[row] <= rowMax[row]) {
+            iterRng.push_back(rowMin[row]);
+            iterRng.push_back(rowMax[row] + 1);
+            iterRng.push_back(rowStart + row);
+            iterRng.push_back(rowStart + row + 1);
+        }
     }
+    SetEmbeddedBoundaryRng(blockIndex, vertexType, iterRng);
+#if DebugLevel >= 1
+    ops_printf("Block %i: %i rows of embedded boundary nodes of type %i\n",
+               blockIndex, (int)iterRng.size() / (2 * SPACEDIM), vertexType);
+#endif
 }
 
 // Function to provide details of embedded solid body into the fluid.
@@ -1121,4 +1572,118 @@ void EmbeddedBody(SolidBodyType type, int blockIndex,
             SPACEDIM, SPACEDIM, numCoordCenterPos);
     }
 }
-#endif
\ No newline at end of file
+#endif
+
+#ifdef OPS_3D
+// mark all solid points inside the sphere to be ImmersedSolid
+void SolidPointsInsideSphere(int blockIndex, Real diameter,
+                             std::vector<Real> spherePos) {
+    int* bulkRng = BlockIterRng(blockIndex, IterRngBulk());
+    Real* spherePosition = &spherePos[0];
+    ops_par_loop(KerSetEmbeddedSphere, "KerSetEmbeddedSphere",
+                 g_Block[blockIndex], SPACEDIM, bulkRng,
+                 ops_arg_gbl(&diameter, 1, "double", OPS_READ),
+                 ops_arg_gbl(spherePosition, SPACEDIM, "double", OPS_READ),
+                 ops_arg_dat(g_CoordinateXYZ[blockIndex], SPACEDIM,
+                             LOCALSTENCIL, "double", OPS_READ),
+                 ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
+                             LOCALSTENCIL, "int", OPS_RW),
+                 ops_arg_dat(g_GeometryProperty[blockIndex], 1, LOCALSTENCIL,
+                             "int", OPS_RW));
+}
+
+// Function to provide details of embedded solid body into the fluid.
+// There is no boundary treatment at the surface of a 3D body yet, so the
+// solid nodes keep the initial distribution.
+void EmbeddedBody(SolidBodyType type, int blockIndex,
+                  std::vector<Real> centerPos, std::vector<Real> controlParas) {
+    if ((int)centerPos.size() == SPACEDIM) {
+        switch (type) {
+            case SolidBody_sphere: {
+                SolidPointsInsideSphere(blockIndex, controlParas[0],
+                                        centerPos);
+                break;
+            }
+            default:
+                ops_printf(
+                    "\n This solid body is not yet implemented in the "
+                    "code");
+                break;
+        }
+    } else {
+        ops_printf(
+            "\n For %i dimensional problem, number of coordinates should be "
+            "%d, however %d were provided.",
+            SPACEDIM, SPACEDIM, (int)centerPos.size());
+    }
+}
+
+void SetupSparseExecution(const int tileSize) {
+    if (tileSize <= 0) {
+        ops_printf("Error! The tile size must be positive but %i is given!\n",
+                   tileSize);
+        assert(tileSize > 0);
+    }
+    // KerFindActiveTile3D only looks at the nearest neighbours
+    if (SchemeHaloNum() > 1) {
+        ops_printf(
+            "Error! The sparse execution does not support the stream stencil "
+            "%i!\n",
+            SchemeHaloNum());
+        assert(SchemeHaloNum() <= 1);
+    }
+    long long activeNodeNum{0};
+    for (int blockIndex = 0; blockIndex < BlockNum(); blockIndex++) {
+        // IterRngWhole starts from zero so that idx/tileSize is the tile
+        int* wholeRng = BlockIterRng(blockIndex, IterRngWhole());
+        int tileSz{tileSize};
+        int tileNum[3];
+        int totalTileNum{1};
+        for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+            tileNum[cordIdx] = (wholeRng[2 * cordIdx + 1] -
+                                wholeRng[2 * cordIdx] + tileSize - 1) /
+                               tileSize;
+            totalTileNum *= tileNum[cordIdx];
+        }
+        ops_reduction activeTileHandle = ops_decl_reduction_handle(
+            totalTileNum * sizeof(int), "int", "ActiveTile");
+        ops_par_loop(KerFindActiveTile3D, "KerFindActiveTile3D",
+                     g_Block[blockIndex], SPACEDIM, wholeRng,
+                     ops_arg_gbl(&tileSz, 1, "int", OPS_READ),
+                     ops_arg_gbl(tileNum, SPACEDIM, "int", OPS_READ),
+                     ops_arg_dat(g_NodeType[blockIndex], NUMCOMPONENTS,
+                                 ONEPTLATTICESTENCIL, "int", OPS_READ),
+                     ops_arg_idx(),
+                     ops_arg_reduce(activeTileHandle, totalTileNum, "int",
+                                    OPS_MAX));
+        std::vector<int> activeTile(totalTileNum);
+        ops_reduction_result(activeTileHandle, activeTile.data());
+        // The collision only copies f into fStage at the solid nodes of the
+        // tiles it visits, which the non-solid nodes next to them stream
+        // from. KerFindActiveTile3D therefore also marks the tiles holding
+        // such solid nodes, so that the results are the same as without the
+        // sparse execution, see SparseCheck.sh.
+        std::vector<bool> isActive(totalTileNum);
+        for (int tileIdx = 0; tileIdx < totalTileNum; tileIdx++) {
+            isActive[tileIdx] = activeTile[tileIdx] > 0;
+        }
+        // merge the neighbouring active tiles along x into one range
+        std::vector<int> iterRng{
+            TileRuns(wholeRng, tileSize, tileNum, isActive)};
+        for (int rngIdx = 0; rngIdx < (int)iterRng.size(); rngIdx += 6) {
+            const int* rng{&iterRng[rngIdx]};
+            activeNodeNum += (long long)(rng[1] - rng[0]) *
+                             (rng[3] - rng[2]) * (rng[5] - rng[4]);
+        }
+        SetActiveRng(blockIndex, iterRng);
+#if DebugLevel >= 1
+        ops_printf("Block %i: %i ranges of active tiles\n", blockIndex,
+                   (int)iterRng.size() / (2 * SPACEDIM));
+#endif
+    }
+    ops_printf(
+        "Sparse execution: %f%% of the nodes are in the tiles with fluid "
+        "nodes or the solid nodes next to them\n",
+        100 * activeNodeNum / TotalMeshSize());
+}
+#endif  // OPS_3D
\ No newline at end of file
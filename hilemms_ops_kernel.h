@@ -52,11 +52,16 @@ void KerSetCoordinates3D(const Real* coordX, const Real* coordY,
 }
 #endif  // OPS_3D
 
+// Kernel to find the maximum of a value over the MPI ranks.
+void KerReduceMax(const Real* value, Real* maxValue) {
+    *maxValue = std::max(*maxValue, *value);
+}
+
 // Kernel to set initial value for a particlaur component.
 void KerSetInitialMacroVars(Real* macroVars, const Real* coordinates,
                             const int* idx) {
-    Real* initiaNodeMacroVars = new Real[NUMMACROVAR];
-    Real* nodeCoordinates = new Real[SPACEDIM];
+    Real initiaNodeMacroVars[MAXMACROVARNUM];
+    Real nodeCoordinates[MAXDIM];
     for (int i = 0; i < SPACEDIM; i++) {
 #ifdef OPS_2D
         nodeCoordinates[i] = coordinates[OPS_ACC_MD1(i, 0, 0)];
@@ -74,11 +79,23 @@ void KerSetInitialMacroVars(Real* macroVars, const Real* coordinates,
         macroVars[OPS_ACC_MD0(i, 0, 0, 0)] = initiaNodeMacroVars[i];
 #endif
     }
-    delete[] initiaNodeMacroVars;
-    delete[] nodeCoordinates;
 }
 
 #ifdef OPS_2D
+void KerFindEmbeddedBoundaryRow(const int* vertexType, const int* rowStart,
+                                const int* nodeType, const int* idx,
+                                int* rowMin, int* rowMax) {
+    if (*vertexType == nodeType[OPS_ACC2(0, 0)]) {
+        const int row{idx[1] - (*rowStart)};
+        if (idx[0] < rowMin[row]) {
+            rowMin[row] = idx[0];
+        }
+        if (idx[0] > rowMax[row]) {
+            rowMax[row] = idx[0];
+        }
+    }
+}
+
 void KerSetEmbeddedBodyBoundary(int* surfaceBoundary,
                                const int* geometryProperty, int* nodeType) {
     VertexGeometryTypes gp =
@@ -294,4 +311,49 @@ void KerSetEmbeddedBodyGeometry(const int* nodeType, int* geometryProperty) {
 }
 #endif  // End of OPS_2D
 
+#ifdef OPS_3D
+void KerSetEmbeddedSphere(const Real* diameter, const Real* centerPos,
+                          const Real* coordinates, int* nodeType,
+                          int* geometryProperty) {
+    Real distance{0};
+    for (int cordIdx = 0; cordIdx < SPACEDIM; cordIdx++) {
+        const Real dx{coordinates[OPS_ACC_MD2(cordIdx, 0, 0, 0)] -
+                      centerPos[cordIdx]};
+        distance += dx * dx;
+    }
+    if (distance <= (*diameter) * (*diameter) / 4) {
+        for (int compoIdx = 0; compoIdx < NUMCOMPONENTS; compoIdx++) {
+            nodeType[OPS_ACC_MD3(compoIdx, 0, 0, 0)] =
+                (int)Vertex_ImmersedSolid;
+        }
+        geometryProperty[OPS_ACC4(0, 0, 0)] = (int)VG_ImmersedSolid;
+    }
+}
+
+void KerFindActiveTile3D(const int* tileSize, const int* tileNum,
+                         const int* nodeType, const int* idx,
+                         int* activeTile) {
+    // a solid node is needed if a non-solid node streams from it
+    bool isActive{false};
+    for (int compoIdx = 0; compoIdx < NUMCOMPONENTS; compoIdx++) {
+        for (int k = -1; k <= 1; k++) {
+            for (int j = -1; j <= 1; j++) {
+                for (int i = -1; i <= 1; i++) {
+                    if (Vertex_ImmersedSolid !=
+                        nodeType[OPS_ACC_MD2(compoIdx, i, j, k)]) {
+                        isActive = true;
+                    }
+                }
+            }
+        }
+    }
+    if (isActive) {
+        const int tileIdx{idx[0] / (*tileSize) +
+                          (idx[1] / (*tileSize)) * tileNum[0] +
+                          (idx[2] / (*tileSize)) * tileNum[0] * tileNum[1]};
+        activeTile[tileIdx] = 1;
+    }
+}
+#endif  // End of OPS_3D
+
 #endif  // HILEMMS_OPS_KERNEL
\ No newline at end of file
@@ -0,0 +1,95 @@
+/**
+ * Copyright 2019 United Kingdom Research and Innovation
+ *
+ * Authors: See AUTHORS
+ *
+ * Contact: [jianping.meng@stfc.ac.uk and/or jpmeng@gmail.com]
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,    
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * ANDANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*! @brief Define the built-in lattices at compile time
+ *  @author Jianping Meng
+ *  @details The discrete velocities, weights and opposite directions of the
+ *  built-in lattices as constexpr tables, so that the kernels specialised
+ *  for a lattice can be fully unrolled by the compiler.
+ **/
+#ifndef LATTICE_H
+#define LATTICE_H
+#include "type.h"
+/*!
+ * The tables are the same as those set up in the XI, WEIGHTS and OPP arrays
+ * by SetupD2Q9Latt, SetupD3Q15Latt and SetupD3Q19Latt, but the indices are
+ * local to a component, i.e., xiIndex-COMPOINDEX[2*compoIndex].
+ * CX, CY and CZ are not scaled by CS, as XI.
+ */
+struct LatticeD2Q9 {
+    static constexpr int DIM{2};
+    static constexpr int Q{9};
+    static constexpr int CX[Q] = {0, 1, 0, -1, 0, 1, -1, -1, 1};
+    static constexpr int CY[Q] = {0, 0, 1, 0, -1, 1, 1, -1, -1};
+    static constexpr int CZ[Q] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+    static constexpr Real W[Q] = {4.0 / 9.0,  1.0 / 9.0,  1.0 / 9.0,
+                                  1.0 / 9.0,  1.0 / 9.0,  1.0 / 36.0,
+                                  1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0};
+    static constexpr int OPPOSITE[Q] = {0, 3, 4, 1, 2, 7, 8, 5, 6};
+};
+
+struct LatticeD3Q15 {
+    static constexpr int DIM{3};
+    static constexpr int Q{15};
+    static constexpr int CX[Q] = {0, 1,  -1, 0,  0, 0,  0, 1,
+                                  -1, 1, -1, 1, -1, -1, 1};
+    static constexpr int CY[Q] = {0, 0,  0, 1,  -1, 0, 0, 1,
+                                  -1, 1, -1, -1, 1, 1, -1};
+    static constexpr int CZ[Q] = {0,  0,  0, 0,  0, 1,  -1, 1,
+                                  -1, -1, 1, 1, -1, 1, -1};
+    static constexpr Real W[Q] = {
+        2.0 / 9.0,  1.0 / 9.0,  1.0 / 9.0,  1.0 / 9.0,  1.0 / 9.0,
+        1.0 / 9.0,  1.0 / 9.0,  1.0 / 72.0, 1.0 / 72.0, 1.0 / 72.0,
+        1.0 / 72.0, 1.0 / 72.0, 1.0 / 72.0, 1.0 / 72.0, 1.0 / 72.0};
+    static constexpr int OPPOSITE[Q] = {0, 2,  1, 4,  3,  6,  5, 8,
+                                        7, 10, 9, 12, 11, 14, 13};
+};
+
+struct LatticeD3Q19 {
+    static constexpr int DIM{3};
+    static constexpr int Q{19};
+    static constexpr int CX[Q] = {0,  1, -1, 0, 0,  0, 0,  1, -1, 1,
+                                  -1, 0, 0,  1, -1, 1, -1, 0, 0};
+    static constexpr int CY[Q] = {0, 0, 0,  1,  -1, 0, 0, 1, -1, 0,
+                                  0, 1, -1, -1, 1,  0, 0, 1, -1};
+    static constexpr int CZ[Q] = {0,  0, 0,  0, 0, 1,  -1, 0,  0, 1,
+                                  -1, 1, -1, 0, 0, -1, 1,  -1, 1};
+    static constexpr Real W[Q] = {
+        1.0 / 3.0,  1.0 / 18.0, 1.0 / 18.0, 1.0 / 18.0, 1.0 / 18.0,
+        1.0 / 18.0, 1.0 / 18.0, 1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0,
+        1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0,
+        1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0, 1.0 / 36.0};
+    static constexpr int OPPOSITE[Q] = {0,  2,  1,  4,  3,  6,  5,
+                                        8,  7,  10, 9,  12, 11, 14,
+                                        13, 16, 15, 18, 17};
+};
+#endif  // LATTICE_H
\ No newline at end of file
@@ -84,8 +84,11 @@ void simulate() {
     std::vector<int> equCompoId{0};
     DefineEquilibrium(equTypes, equCompoId);
 
-    SetupScheme();
-    SetupBoundary();
+    std::vector<BodyForceType> bodyForceTypes{BodyForce_None};
+    std::vector<int> bodyForceCompoId{0};
+    DefineBodyForce(bodyForceTypes, bodyForceCompoId);
+
+    DefineScheme(Scheme_StreamCollision);
 
     int blockIndex = 0;
     int componentId{0};
@@ -117,9 +120,7 @@ void simulate() {
     //int blockIndex{0};
     //SetupGeomPropAndNodeType(blockIndex, boundType);
 
-    int compoIdInitialCond{0};
-    std::vector<Real> initialMacroValues{1, 0, 0};
-    DefineInitialCondition(blockIndex, compoIdInitialCond, initialMacroValues);
+    DefineInitialCondition();
     ops_printf("%s\n", "Flowfield is Initialised now!");
 
     std::vector<Real> tauRef{0.001};
@@ -135,23 +136,9 @@ void simulate() {
     // ops_printf("%s\n", "Flowfield is setup now!");
     // InitialiseSolution();
 
-#if 0
-    // currently this information is not playin major role in this
-    // implementation.
-    SchemeType scheme{stStreamCollision};
-    const int steps{5000};
-    const int checkPeriod{500};
-    Iterate(scheme, steps, checkPeriod);
-#endif
-
-    // if 0
-    // currently this information is not playin major role in this
-    // implementation.
-    SchemeType scheme{Scheme_StreamCollision};
     const Real convergenceCriteria{1E-2};
     const int checkPeriod{200};
     Iterate(convergenceCriteria, checkPeriod);
-    //#endif
 }
 
 int main(int argc, char** argv) {
@@ -46,8 +46,13 @@
 #include "ops_seq.h"
 #include "scheme.h"
 #include "type.h"
+#if defined(OPS_MPI) && defined(ASYNC_CHECKPOINT)
+#include <mpi.h>
+#endif
 
-void simulate() {
+void simulate(const SchemeType scheme, const std::string lattName,
+              const bool checkpoint, const OutputMode outputMode,
+              const bool moments, const long restartStep) {
 
     std::string caseName{"3D_lid_Driven_cavity"};
     int spaceDim{3};
@@ -55,7 +60,7 @@ void simulate() {
 
     std::vector<std::string> compoNames{"Fluid"};
     std::vector<int> compoid{0};
-    std::vector<std::string> lattNames{"d3q19"};
+    std::vector<std::string> lattNames{lattName};
     DefineComponents(compoNames, compoid, lattNames);
 
     std::vector<VariableTypes> marcoVarTypes{Variable_Rho, Variable_U,
@@ -73,7 +78,6 @@ void simulate() {
     std::vector<int> bodyForceCompoId{0};
     DefineBodyForce(bodyForceTypes, bodyForceCompoId);
 
-    SchemeType scheme{Scheme_StreamCollision};
     DefineScheme(scheme);
 
     // Setting boundary conditions
@@ -108,17 +112,35 @@ void simulate() {
                         BoundaryType_EQMDiffuseRefl, macroVarTypesatBoundary,
                         noSlipStationaryWall);
 
-    int blockNum{1};
-    std::vector<int> blockSize{33, 33, 33};
-    Real meshSize{1. / 32};
-    std::vector<Real> startPos{0.0, 0.0, 0.0};
-    DefineProblemDomain(blockNum, blockSize, meshSize, startPos);
+    // the compressed checkpoints keep the moments of f rather than f
+    if (moments) {
+        SetOutputPeriod(Output_f, OutputPeriod_Never);
+        SetOutputPeriod(Output_fMoments, 1);
+    }
+    if (restartStep >= 0) {
+        // the blocks, the relaxation time and the time step are read from
+        // the checkpoint
+        RestartFromCheckpoint(caseName, restartStep);
+    } else {
+        int blockNum{1};
+        std::vector<int> blockSize{33, 33, 33};
+        Real meshSize{1. / 32};
+        std::vector<Real> startPos{0.0, 0.0, 0.0};
+        DefineProblemDomain(blockNum, blockSize, meshSize, startPos);
+
+        DefineInitialCondition();
 
-    DefineInitialCondition();
+        std::vector<Real> tauRef{0.01};
+        SetTauRef(tauRef);
+        SetTimeStep(meshSize / SoundSpeed());
+    }
 
-    std::vector<Real> tauRef{0.01};
-    SetTauRef(tauRef);
-    SetTimeStep(meshSize / SoundSpeed());
+    SetOutputMode(outputMode);
+    if (!checkpoint) {
+        for (int field = 0; field < OutputFieldNum; field++) {
+            SetOutputPeriod((OutputField)field, OutputPeriod_Never);
+        }
+    }
 
     const Real convergenceCriteria{1E-7};
     const int checkPeriod{1000};
@@ -126,11 +148,58 @@ void simulate() {
 }
 
 int main(int argc, char** argv) {
+#if defined(OPS_MPI) && defined(ASYNC_CHECKPOINT)
+    // the checkpoint writer thread calls MPI-IO while the solver exchanges
+    // the halos, and ops_init keeps an MPI initialised before it
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+#endif
     // OPS initialisation
     ops_init(argc, argv, 1);
+    // Passing "fused" or "aa" as an argument chooses the fused or the AA
+    // stream-collision scheme so that its MLUPS and memory per node can be
+    // compared with the default one, and "d3q15" chooses the D3Q15 lattice.
+    // "nocheckpoint" writes no checkpoint, see CheckpointBenchmark.sh, and
+    // "shared" or "series" writes the checkpoints into the shared file or the
+    // time-series file rather than the per-block files, see
+    // OutputModeBenchmark.sh. "restart <step>" restarts from the checkpoint of
+    // the step, see RestartCheck.sh, and "moments" writes the compressed
+    // checkpoints, see MomentRestartCheck.sh.
+    SchemeType scheme{Scheme_StreamCollision};
+    std::string lattName{"d3q19"};
+    bool checkpoint{true};
+    OutputMode outputMode{OutputMode_BlockFiles};
+    bool moments{false};
+    long restartStep{-1};
+    for (int argIdx = 1; argIdx < argc; argIdx++) {
+        if (std::string(argv[argIdx]) == "fused") {
+            scheme = Scheme_StreamCollisionFused;
+        }
+        if (std::string(argv[argIdx]) == "aa") {
+            scheme = Scheme_StreamCollisionAA;
+        }
+        if (std::string(argv[argIdx]) == "d3q15") {
+            lattName = "d3q15";
+        }
+        if (std::string(argv[argIdx]) == "nocheckpoint") {
+            checkpoint = false;
+        }
+        if (std::string(argv[argIdx]) == "shared") {
+            outputMode = OutputMode_SharedFile;
+        }
+        if (std::string(argv[argIdx]) == "series") {
+            outputMode = OutputMode_TimeSeries;
+        }
+        if (std::string(argv[argIdx]) == "moments") {
+            moments = true;
+        }
+        if (std::string(argv[argIdx]) == "restart" && argIdx + 1 < argc) {
+            restartStep = std::stol(argv[++argIdx]);
+        }
+    }
     double ct0, ct1, et0, et1;
     ops_timers(&ct0, &et0);
-    simulate();
+    simulate(scheme, lattName, checkpoint, outputMode, moments, restartStep);
     ops_timers(&ct1, &et1);
     ops_printf("\nTotal Wall time %lf\n", et1 - et0);
     // Print OPS performance details to output stream
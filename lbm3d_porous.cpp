@@ -0,0 +1,189 @@
+/**
+ * Copyright 2019 United Kingdom Research and Innovation
+ *
+ * Authors: See AUTHORS
+ *
+ * Contact: [jianping.meng@stfc.ac.uk and/or jpmeng@gmail.com]
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * ANDANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/** @brief An example main source code of stimulating the flow driven by a lid
+ *  through a randomly packed bed of spheres, which is used for measuring the
+ *  sparse execution at various porosities.
+ *  @author Jianping Meng
+ **/
+#include <cmath>
+#include <iostream>
+#include <ostream>
+#include <random>
+#include <string>
+#include "boundary.h"
+#include "evolution.h"
+#include "evolution3d.h"
+#include "flowfield.h"
+#include "hilemms.h"
+#include "model.h"
+#include "ops_seq.h"
+#include "scheme.h"
+#include "type.h"
+
+void simulate(const Real porosity, const bool sparse, const bool periodic,
+              const bool fullHalo) {
+    std::string caseName{"3D_porous_sphere_bed"};
+    int spaceDim{3};
+    DefineCase(caseName, spaceDim);
+
+    std::vector<std::string> compoNames{"Fluid"};
+    std::vector<int> compoid{0};
+    std::vector<std::string> lattNames{"d3q19"};
+    DefineComponents(compoNames, compoid, lattNames);
+
+    std::vector<VariableTypes> marcoVarTypes{Variable_Rho, Variable_U,
+                                             Variable_V, Variable_W};
+    std::vector<std::string> macroVarNames{"rho", "u", "v", "w"};
+    std::vector<int> macroVarId{0, 1, 2, 3};
+    std::vector<int> macroCompoId{0, 0, 0, 0};
+    DefineMacroVars(marcoVarTypes, macroVarNames, macroVarId, macroCompoId);
+
+    std::vector<EquilibriumType> equTypes{Equilibrium_BGKIsothermal2nd};
+    std::vector<int> equCompoId{0};
+    DefineEquilibrium(equTypes, equCompoId);
+
+    std::vector<BodyForceType> bodyForceTypes{BodyForce_None};
+    std::vector<int> bodyForceCompoId{0};
+    DefineBodyForce(bodyForceTypes, bodyForceCompoId);
+
+    DefineScheme(Scheme_StreamCollision);
+
+    // Setting boundary conditions
+    int blockIndex{0};
+    int componentId{0};
+    std::vector<VariableTypes> macroVarTypesatBoundary{Variable_U, Variable_V,
+                                                       Variable_W};
+    std::vector<Real> noSlipStationaryWall{0, 0, 0};
+    std::vector<Real> noSlipMovingWall{0.001, 0, 0};
+    DefineBlockBoundary(blockIndex, componentId, BoundarySurface_Left,
+                        BoundaryType_EQMDiffuseRefl, macroVarTypesatBoundary,
+                        noSlipStationaryWall);
+    DefineBlockBoundary(blockIndex, componentId, BoundarySurface_Right,
+                        BoundaryType_EQMDiffuseRefl, macroVarTypesatBoundary,
+                        noSlipStationaryWall);
+    DefineBlockBoundary(blockIndex, componentId, BoundarySurface_Top,
+                        BoundaryType_EQMDiffuseRefl, macroVarTypesatBoundary,
+                        noSlipMovingWall);
+    DefineBlockBoundary(blockIndex, componentId, BoundarySurface_Bottom,
+                        BoundaryType_EQMDiffuseRefl, macroVarTypesatBoundary,
+                        noSlipStationaryWall);
+    if (periodic) {
+        // the bed repeats itself along the z axis, where the full halos of
+        // the block periodicity shall give the same results as the periodic
+        // halo transferring only the populations entering the block
+        if (fullHalo) {
+            SetBlockPeriodicity({false, false, true});
+        } else {
+            SetPeriodicHalo(blockIndex, 2);
+        }
+    } else {
+        DefineBlockBoundary(blockIndex, componentId, BoundarySurface_Front,
+                            BoundaryType_EQMDiffuseRefl,
+                            macroVarTypesatBoundary, noSlipStationaryWall);
+        DefineBlockBoundary(blockIndex, componentId, BoundarySurface_Back,
+                            BoundaryType_EQMDiffuseRefl,
+                            macroVarTypesatBoundary, noSlipStationaryWall);
+    }
+
+    int blockNum{1};
+    std::vector<int> blockSize{65, 65, 65};
+    Real meshSize{1. / 64};
+    std::vector<Real> startPos{0.0, 0.0, 0.0};
+    DefineProblemDomain(blockNum, blockSize, meshSize, startPos);
+
+    DefineInitialCondition();
+
+    // The spheres are placed after the initialisation so that the solid nodes
+    // keep the equilibrium at rest, which the fluid nodes next to them stream
+    // from. Overlapping spheres placed at random leave a fraction
+    // exp(-n*V) of the unit box, where n is the number of spheres and V is
+    // the volume of a sphere. The same seed gives the same bed on all ranks.
+    const Real diameter{8 * meshSize};
+    const Real sphereVolume{M_PI * diameter * diameter * diameter / 6};
+    const int sphereNum{(int)(-std::log(porosity) / sphereVolume)};
+    std::mt19937 generator(2019);
+    std::uniform_real_distribution<Real> position(0, 1);
+    for (int sphereIdx = 0; sphereIdx < sphereNum; sphereIdx++) {
+        std::vector<Real> centerPos{position(generator), position(generator),
+                                    position(generator)};
+        EmbeddedBody(SolidBody_sphere, blockIndex, centerPos, {diameter});
+    }
+    ops_printf("%i spheres are placed for the porosity %f\n", sphereNum,
+               porosity);
+    if (sparse) {
+        SetupSparseExecution();
+    }
+
+    std::vector<Real> tauRef{0.01};
+    SetTauRef(tauRef);
+    SetTimeStep(meshSize / SoundSpeed());
+
+    const int steps{1000};
+    Iterate(steps, steps);
+}
+
+int main(int argc, char** argv) {
+    // OPS initialisation
+    ops_init(argc, argv, 1);
+    // Passing a number, e.g., 0.2, 0.5 or 0.8, chooses the porosity and
+    // "sparse" lets the kernels run only over the tiles with fluid nodes, so
+    // that the MLUPS of the two modes can be compared. "periodic" replaces
+    // the front and back walls by a periodic halo, which "fullhalo" replaces
+    // by the full halos of SetBlockPeriodicity, see PeriodicCheck.sh.
+    Real porosity{0.5};
+    bool sparse{false};
+    bool periodic{false};
+    bool fullHalo{false};
+    for (int argIdx = 1; argIdx < argc; argIdx++) {
+        const std::string arg(argv[argIdx]);
+        if (arg == "sparse") {
+            sparse = true;
+        } else if (arg == "periodic") {
+            periodic = true;
+        } else if (arg == "fullhalo") {
+            periodic = true;
+            fullHalo = true;
+        } else if (arg.find_first_not_of("0123456789.") == std::string::npos &&
+                   std::stod(arg) > 0 && std::stod(arg) <= 1) {
+            porosity = std::stod(arg);
+        }
+    }
+    double ct0, ct1, et0, et1;
+    ops_timers(&ct0, &et0);
+    simulate(porosity, sparse, periodic, fullHalo);
+    ops_timers(&ct1, &et1);
+    ops_printf("\nTotal Wall time %lf\n", et1 - et0);
+    // Print OPS performance details to output stream
+    ops_timing_output(stdout);
+    ops_exit();
+}
\ No newline at end of file
@@ -37,6 +37,7 @@
  **/
 #include "model.h"
 #include <map>
+#include "boundary.h"
 int NUMXI{9};
 int FEQORDER{2};
 int LATTDIM{2};
@@ -53,6 +54,7 @@ Real XIMAXVALUE{1};
 int* EQUILIBRIUMTYPE{nullptr};
 int* FORCETYPE{nullptr};
 int* VARIABLECOMPPOS{nullptr};
+LatticeType LATTICETYPE{Lattice_Generic};
 /*!
  *Name of all macroscopic variables
  */
@@ -77,6 +79,26 @@ lattice d2q36{2, 36, 1};
 std::map<std::string, lattice> latticeSet{
     {"d2q9", d2q9}, {"d3q19", d3q19}, {"d3q15", d3q15}, {"d2q36", d2q36}};
 
+// Lattices with a compile-time specialisation of the hot kernels
+std::map<std::string, LatticeType> specialisedLatticeSet{
+    {"d2q9", Lattice_D2Q9}, {"d3q15", Lattice_D3Q15}, {"d3q19", Lattice_D3Q19}};
+// The tables are odr-used by the specialised kernels
+constexpr int LatticeD2Q9::CX[];
+constexpr int LatticeD2Q9::CY[];
+constexpr int LatticeD2Q9::CZ[];
+constexpr Real LatticeD2Q9::W[];
+constexpr int LatticeD2Q9::OPPOSITE[];
+constexpr int LatticeD3Q15::CX[];
+constexpr int LatticeD3Q15::CY[];
+constexpr int LatticeD3Q15::CZ[];
+constexpr Real LatticeD3Q15::W[];
+constexpr int LatticeD3Q15::OPPOSITE[];
+constexpr int LatticeD3Q19::CX[];
+constexpr int LatticeD3Q19::CY[];
+constexpr int LatticeD3Q19::CZ[];
+constexpr Real LatticeD3Q19::W[];
+constexpr int LatticeD3Q19::OPPOSITE[];
+
 // Find particles with opposite directions, for bounce-back type boundary
 // Brute-force method, could be slow for large lattice
 void FindReverseXi(const int startPos, const int latticeSize) {
@@ -244,6 +266,12 @@ void DefineComponents(std::vector<std::string> compoNames,
                       std::vector<int> compoId,
                       std::vector<std::string> lattNames) {
     NUMCOMPONENTS = compoNames.size();
+    if (NUMCOMPONENTS > MAXCOMPONENTNUM) {
+        ops_printf(
+            "Error! At most %i components are supported but we get:%i\n",
+            MAXCOMPONENTNUM, NUMCOMPONENTS);
+        assert(NUMCOMPONENTS <= MAXCOMPONENTNUM);
+    }
     if (NUMCOMPONENTS > 0) {
         AllocateComponentIndex(NUMCOMPONENTS);
         ops_printf("There are %i components defined.\n", NUMCOMPONENTS);
@@ -262,6 +290,11 @@ void DefineComponents(std::vector<std::string> compoNames,
     for (int idx = 0; idx < NUMCOMPONENTS; idx++) {
         if (latticeSet.find(lattNames[idx]) != latticeSet.end()) {
             lattice currentLattice{latticeSet[lattNames[idx]]};
+            if (currentLattice.length > MAXLATTSIZE) {
+                ops_printf("Error! The lattice %s is larger than %i\n",
+                           lattNames[idx].c_str(), MAXLATTSIZE);
+                assert(currentLattice.length <= MAXLATTSIZE);
+            }
             COMPOINDEX[posCompo] = totalSize;
             COMPOINDEX[posCompo + 1] = totalSize + currentLattice.length - 1;
             totalSize += currentLattice.length;
@@ -303,6 +336,17 @@ void DefineComponents(std::vector<std::string> compoNames,
             ops_printf("The %s lattice is employed for Component %i.\n",
                        lattNames[idx].c_str(), idx);
         }
+        bool isLattSame{true};
+        for (int idx = 0; idx < NUMCOMPONENTS; idx++) {
+            isLattSame = isLattSame && (lattNames[idx] == lattNames[0]);
+        }
+        LATTICETYPE = Lattice_Generic;
+        if (isLattSame && specialisedLatticeSet.find(lattNames[0]) !=
+                              specialisedLatticeSet.end()) {
+            LATTICETYPE = specialisedLatticeSet[lattNames[0]];
+            ops_printf("The kernels specialised for %s are employed.\n",
+                       lattNames[0].c_str());
+        }
         Real maxValue{0};
         for (int l = 0; l < totalSize * LATTDIM; l++) {
             maxValue = maxValue > XI[l] ? maxValue : XI[l];
@@ -317,6 +361,7 @@ void DefineComponents(std::vector<std::string> compoNames,
     ops_decl_const("XI", NUMXI * LATTDIM, "double", XI);
     ops_decl_const("WEIGHTS", NUMXI, "double", WEIGHTS);
     ops_decl_const("OPP", NUMXI, "int", OPP);
+    SetupBndryDvTables();
 }
 
 void DefineMacroVars(std::vector<VariableTypes> types,
@@ -325,6 +370,13 @@ void DefineMacroVars(std::vector<VariableTypes> types,
     // It seems varId is not necessary at this moment
     NUMMACROVAR = names.size();
     MACROVARNAME = names;
+    if (NUMMACROVAR > MAXMACROVARNUM) {
+        ops_printf(
+            "Error! At most %i macroscopic variables are supported but we "
+            "get:%i\n",
+            MAXMACROVARNUM, NUMMACROVAR);
+        assert(NUMMACROVAR <= MAXMACROVARNUM);
+    }
     if (NUMMACROVAR > 0) {
         AllocateMacroVarProperty(NUMMACROVAR);
         ops_printf("There are %i macroscopic variables defined.\n",
@@ -439,6 +491,8 @@ void DestroyModel() {
     FreeArrayMemory(XI);
     FreeArrayMemory(WEIGHTS);
     FreeArrayMemory(OPP);
+    FreeArrayMemory(BNDRYDVNUM);
+    FreeArrayMemory(BNDRYDV);
 }
 /*
 * Calculate the first-order force term
@@ -535,4 +589,40 @@ void SetLatticeName(const std::vector<std::string> &latticeName) {
 }
 const std::vector<std::string> LatticeName() { return LATTICENAME; }
 const std::vector<std::string> MacroVarName() { return MACROVARNAME; }
+const LatticeType SpecialisedLattice() { return LATTICETYPE; }
+const bool IsothermalModel() {
+    bool isIsothermal{nullptr != EQUILIBRIUMTYPE && nullptr != VARIABLETYPE};
+    for (int idx = 0; isIsothermal && idx < NUMCOMPONENTS; idx++) {
+        isIsothermal = (Equilibrium_BGKIsothermal2nd == EQUILIBRIUMTYPE[idx]);
+    }
+    for (int m = 0; isIsothermal && m < NUMMACROVAR; m++) {
+        const VariableTypes varType{(VariableTypes)VARIABLETYPE[m]};
+        isIsothermal =
+            (Variable_Rho == varType || Variable_U == varType ||
+             Variable_V == varType || Variable_W == varType ||
+             Variable_U_Force == varType || Variable_V_Force == varType ||
+             Variable_W_Force == varType);
+    }
+    return isIsothermal;
+}
 #include "model_kernel.h"
+// Instantiate the specialised kernels for the built-in lattices
+#ifdef OPS_2D
+template void KerCalcFeqLattice<LatticeD2Q9>(const int* nodeType,
+                                             const Real* macroVars,
+                                             Real* feq);
+#endif
+#ifdef OPS_3D
+template void KerCalcFeqLattice3D<LatticeD3Q15>(const short* nodeFlag,
+                                                const Real* macroVars,
+                                                FReal* feq);
+template void KerCalcFeqLattice3D<LatticeD3Q19>(const short* nodeFlag,
+                                                const Real* macroVars,
+                                                FReal* feq);
+template void KerCalcMacroVarsLattice3D<LatticeD3Q15>(
+    const Real* dt, const short* nodeFlag, const Real* coordinates,
+    const FReal* f, Real* macroVars);
+template void KerCalcMacroVarsLattice3D<LatticeD3Q19>(
+    const Real* dt, const short* nodeFlag, const Real* coordinates,
+    const FReal* f, Real* macroVars);
+#endif
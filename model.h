@@ -38,6 +38,7 @@
 #include <cmath>
 #include <string>
 #include <vector>
+#include "lattice.h"
 #include "type.h"
 
 /*!
@@ -121,6 +122,32 @@ inline const int MacroVarsNum() { return NUMMACROVAR; }
 inline const int SizeF() { return NUMXI; }
 inline const Real SoundSpeed() { return CS; }
 inline const Real MaximumSpeed() { return XIMAXVALUE; }
+/*!
+ * The offset of the stored distribution functions, i.e., f_i-FOffset(i) is
+ * kept in g_f, g_fStage and g_feq, and kernels add it back when reading them.
+ * Under MIXEDPRECISION the offset is the weight so that the single precision
+ * only rounds the deviation from the rest state, which is much smaller than
+ * f_i. The weights are symmetric, i.e., w_i=w_OPP[i], so that the AA pattern
+ * can swap the stored values without touching the offsets.
+ */
+inline Real FOffset(const int xiIndex) {
+#ifdef MIXEDPRECISION
+    return WEIGHTS[xiIndex];
+#else
+    return 0;
+#endif
+}
+/*!
+ * The lattice shared by all components if it has a compile-time
+ * specialisation, otherwise Lattice_Generic. Set by DefineComponents.
+ */
+const LatticeType SpecialisedLattice();
+/*!
+ * If all components use the isothermal BGK equilibrium and only the density
+ * and velocity are defined, so that the specialised equilibrium and
+ * macroscopic variable kernels can be employed.
+ */
+const bool IsothermalModel();
 /*!
  * Free the pointer memory
  */
@@ -158,6 +185,10 @@ Real CalcBGKFeq(const int l, const Real rho = 1, const Real u = 0,
 Real CalcBGKFeq(const int l, const Real rho = 1, const Real u = 0,
                 const Real v = 0, const Real w = 0, const Real T = 1,
                 const int polyOrder = 2);
+/*
+ * Local function for calculating the first-order body force term
+ */
+Real CalcBodyForce(const int xiIndex, const Real rho, const Real* acceleration);
 /*
  * Local function for calculating the SWE equilibrium
  * Including up to fourth order terms
@@ -165,6 +196,53 @@ Real CalcBGKFeq(const int l, const Real rho = 1, const Real u = 0,
  */
 Real CalcSWEFeq(const int l, const Real h = 1, const Real u = 0,
                 const Real v = 0, const int polyOrder = 2);
+/*
+ * Local function for calculating the isothermal second-order equilibrium
+ * with the velocities of a compile-time lattice, l is the local index
+ * within the component
+ */
+template <typename Lattice>
+inline Real CalcBGKFeqLattice(const int l, const Real rho, const Real u,
+                              const Real v, const Real w = 0) {
+    const Real cu{CS * (Lattice::CX[l] * u + Lattice::CY[l] * v +
+                        Lattice::CZ[l] * w)};
+    const Real u2{u * u + v * v + w * w};
+    return Lattice::W[l] * rho * (1.0 + cu + 0.5 * (cu * cu - u2));
+}
+
+/*!
+ * The moments of each component kept by a compressed checkpoint in 3D, i.e.,
+ * rho, u, v, w and the non-equilibrium stress xx, yy, zz, xy, xz, yz, see
+ * Output_fMoments
+ */
+const int FMomentNum{10};
+/*
+ * Local functions for rebuilding a distribution from the moments of
+ * KerCalcfMoments3D by the regularised Hermite expansion up to the second
+ * order, i.e., the second-order equilibrium and the non-equilibrium part
+ * w_i H2(c_i):Pi/2, where H2(c)=cc-I and Pi is the non-equilibrium stress
+ */
+inline Real CalcHermiteFeq3D(const int xiIndex, const Real* moments) {
+    const Real cx{CS * XI[xiIndex * LATTDIM]};
+    const Real cy{CS * XI[xiIndex * LATTDIM + 1]};
+    const Real cz{CS * XI[xiIndex * LATTDIM + 2]};
+    const Real cu{cx * moments[1] + cy * moments[2] + cz * moments[3]};
+    const Real u2{moments[1] * moments[1] + moments[2] * moments[2] +
+                  moments[3] * moments[3]};
+    return WEIGHTS[xiIndex] * moments[0] * (1.0 + cu + 0.5 * (cu * cu - u2));
+}
+inline Real CalcRegularisedF3D(const int xiIndex, const Real* moments) {
+    const Real cx{CS * XI[xiIndex * LATTDIM]};
+    const Real cy{CS * XI[xiIndex * LATTDIM + 1]};
+    const Real cz{CS * XI[xiIndex * LATTDIM + 2]};
+    const Real* stress{&moments[4]};
+    const Real neq{0.5 * ((cx * cx - 1) * stress[0] +
+                          (cy * cy - 1) * stress[1] +
+                          (cz * cz - 1) * stress[2]) +
+                   cx * cy * stress[3] + cx * cz * stress[4] +
+                   cy * cz * stress[5]};
+    return CalcHermiteFeq3D(xiIndex, moments) + WEIGHTS[xiIndex] * neq;
+}
 
 // Kernel functions that will be called by ops_par_loop
 /*!
@@ -174,6 +252,12 @@ Real CalcSWEFeq(const int l, const Real h = 1, const Real u = 0,
 // Two-dimensional version
 void KerCalcFeq(const int* nodeType, const Real* macroVars, Real* feq);
 void KerCalcMacroVars(const int* nodeType, const Real* f, Real* macroVars);
+/*!
+ * Same as KerCalcFeq but specialised for a lattice and the isothermal BGK
+ * equilibrium, see IsothermalModel
+ */
+template <typename Lattice>
+void KerCalcFeqLattice(const int* nodeType, const Real* macroVars, Real* feq);
 /*!
  * @fn defining how to calculate the relaxation time
  * @param tauRef the reference relaxation time
@@ -185,11 +269,44 @@ void KerCalcTau(const int* nodeType, const Real* tauRef, const Real* macroVars,
 // Three-dimensional version
 // We have to create 2D and 3D version because of the difference
 // of 2D and 3D OPS_ACC_MD2 macro
-void KerCalcBodyForce3D(const Real* time, const int* nodeType,
+void KerCalcBodyForce3D(const Real* time, const short* nodeFlag,
                         const Real* coordinates, const Real* macroVars,
                         Real* bodyForce);
-void KerCalcFeq3D(const int* nodeType, const Real* macroVars, Real* feq);
-void KerCalcTau3D(const int* nodeType, const Real* tauRef,
+void KerCalcFeq3D(const short* nodeFlag, const Real* macroVars, FReal* feq);
+void KerCalcTau3D(const short* nodeFlag, const Real* tauRef,
                   const Real* macroVars, Real* tau);
-void KerCalcMacroVars3D(const Real* dt, const int* nodeType, const Real* coordinates, const Real* f, Real* macroVars);
+void KerCalcMacroVars3D(const Real* dt, const short* nodeFlag,
+                        const Real* coordinates, const FReal* f,
+                        Real* macroVars);
+/*!
+ * Same as KerCalcFeq3D and KerCalcMacroVars3D but specialised for a lattice
+ * and the isothermal BGK model, see IsothermalModel. The moments are
+ * accumulated in a single pass over the distribution function. The checks
+ * are skipped with the OPS_SOA layout, see KerCollideLattice3D.
+ */
+template <typename Lattice>
+void KerCalcFeqLattice3D(const short* nodeFlag, const Real* macroVars,
+                         FReal* feq);
+template <typename Lattice>
+void KerCalcMacroVarsLattice3D(const Real* dt, const short* nodeFlag,
+                               const Real* coordinates, const FReal* f,
+                               Real* macroVars);
+/*!
+ * Calculate the FMomentNum moments of each component of f, where f_i(x) is
+ * read from (OPP[i], x-c_i) under Layout_AASwapped, and accumulate the squared
+ * differences between f and the distribution rebuilt from the moments, i.e.,
+ * error[0] for f-CalcRegularisedF3D, error[1] for f-CalcHermiteFeq3D, and
+ * error[2] for f itself
+ */
+void KerCalcfMoments3D(const int* fLayout, const FReal* f, Real* fMoments,
+                       double* error);
+/*!
+ * Rebuild f at its natural position from the moments of KerCalcfMoments3D
+ */
+void KerRebuildf3D(const Real* fMoments, FReal* f);
+/*!
+ * Set the densities and the velocities of the macroscopic variables from the
+ * moments of KerCalcfMoments3D, see RestartMacroVarsFromMoments
+ */
+void KerRebuildMacroVars3D(const Real* fMoments, Real* macroVars);
 #endif
@@ -136,7 +136,7 @@ void KerCalcMacroVars(const int* nodeType, const Real* f, Real* macroVars) {
     VertexTypes vt = (VertexTypes)nodeType[OPS_ACC0(0, 0)];
     if (vt != Vertex_ImmersedSolid) {
         bool rhoCalculated{false};
-        bool veloCalculated[LATTDIM];
+        bool veloCalculated[MAXDIM];
         for (int lattIdx = 0; lattIdx < LATTDIM; lattIdx++) {
             veloCalculated[lattIdx] = false;
         }
@@ -381,12 +381,30 @@ void KerCalcMacroVars(const int* nodeType, const Real* f, Real* macroVars) {
         }      // m
     }          // isVertex
 }
+
+template <typename Lattice>
+void KerCalcFeqLattice(const int* nodeType, const Real* macroVars, Real* feq) {
+    VertexTypes vt{(VertexTypes)nodeType[OPS_ACC0(0, 0)]};
+    if (vt != Vertex_ImmersedSolid) {
+        for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+            const int startPos{VARIABLECOMPPOS[2 * compoIndex]};
+            const int xiStart{COMPOINDEX[2 * compoIndex]};
+            const Real rho{macroVars[OPS_ACC_MD1(startPos, 0, 0)]};
+            const Real u{macroVars[OPS_ACC_MD1(startPos + 1, 0, 0)]};
+            const Real v{macroVars[OPS_ACC_MD1(startPos + 2, 0, 0)]};
+            for (int l = 0; l < Lattice::Q; l++) {
+                feq[OPS_ACC_MD2(xiStart + l, 0, 0)] =
+                    CalcBGKFeqLattice<Lattice>(l, rho, u, v);
+            }
+        }
+    }
+}
 #endif
 #ifdef OPS_3D
-void KerCalcFeq3D(const int* nodeType, const Real* macroVars, Real* feq) {
+void KerCalcFeq3D(const short* nodeFlag, const Real* macroVars, FReal* feq) {
     for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
         VertexTypes vt =
-            (VertexTypes)nodeType[OPS_ACC_MD0(compoIndex, 0, 0, 0)];
+            FlagVertexType(nodeFlag[OPS_ACC_MD0(compoIndex, 0, 0, 0)]);
         if (vt != Vertex_ImmersedSolid) {
             EquilibriumType equilibriumType{
                 (EquilibriumType)EQUILIBRIUMTYPE[compoIndex]};
@@ -403,7 +421,8 @@ void KerCalcFeq3D(const int* nodeType, const Real* macroVars, Real* feq) {
                          xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
                         const Real res{
                             CalcBGKFeq(xiIndex, rho, u, v, w, T, polyOrder)};
-                        feq[OPS_ACC_MD2(xiIndex, 0, 0, 0)] = res;
+                        feq[OPS_ACC_MD2(xiIndex, 0, 0, 0)] =
+                            res - FOffset(xiIndex);
 #ifdef CPU
                         if (isnan(res) || res <= 0 || isinf(res)) {
                             ops_printf(
@@ -427,7 +446,8 @@ void KerCalcFeq3D(const int* nodeType, const Real* macroVars, Real* feq) {
                          xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
                         const Real res{
                             CalcBGKFeq(xiIndex, rho, u, v, w, T, polyOrder)};
-                        feq[OPS_ACC_MD2(xiIndex, 0, 0, 0)] = res;
+                        feq[OPS_ACC_MD2(xiIndex, 0, 0, 0)] =
+                            res - FOffset(xiIndex);
 #ifdef CPU
                         if (isnan(res) || res <= 0 || isinf(res)) {
                             ops_printf(
@@ -454,7 +474,7 @@ void KerCalcFeq3D(const int* nodeType, const Real* macroVars, Real* feq) {
     }
 }
 
-void KerCalcBodyForce3D(const Real* time, const int* nodeType,
+void KerCalcBodyForce3D(const Real* time, const short* nodeFlag,
                         const Real* coordinates, const Real* macroVars,
                         Real* bodyForce) {
     // here we assume the force is constant
@@ -463,7 +483,7 @@ void KerCalcBodyForce3D(const Real* time, const int* nodeType,
 
     for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
         VertexTypes vt =
-            (VertexTypes)nodeType[OPS_ACC_MD1(compoIndex, 0, 0, 0)];
+            FlagVertexType(nodeFlag[OPS_ACC_MD1(compoIndex, 0, 0, 0)]);
         if (vt != Vertex_ImmersedSolid) {
             BodyForceType forceType{(BodyForceType)FORCETYPE[compoIndex]};
             const int startPos{VARIABLECOMPPOS[2 * compoIndex]};
@@ -519,14 +539,14 @@ void KerCalcBodyForce3D(const Real* time, const int* nodeType,
     }
 }
 
-void KerCalcTau3D(const int* nodeType, const Real* tauRef,
+void KerCalcTau3D(const short* nodeFlag, const Real* tauRef,
                   const Real* macroVars, Real* tau) {
     /*
      *@note: multicomponent ready for incompressible flows.
      */
     for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
         VertexTypes vt =
-            (VertexTypes)nodeType[OPS_ACC_MD0(compoIndex, 0, 0, 0)];
+            FlagVertexType(nodeFlag[OPS_ACC_MD0(compoIndex, 0, 0, 0)]);
         if (vt != Vertex_ImmersedSolid) {
             EquilibriumType equilibriumType{
                 (EquilibriumType)EQUILIBRIUMTYPE[compoIndex]};
@@ -583,16 +603,16 @@ void KerCalcTau3D(const int* nodeType, const Real* tauRef,
  * similar to the Gauss-Hermite quadrature
  *
  */
-void KerCalcMacroVars3D(const Real* dt, const int* nodeType,
-                        const Real* coordinates, const Real* f,
+void KerCalcMacroVars3D(const Real* dt, const short* nodeFlag,
+                        const Real* coordinates, const FReal* f,
                         Real* macroVars) {
-    Real* acceleration = new Real[LATTDIM * NUMCOMPONENTS];
+    Real acceleration[MAXDIM * MAXCOMPONENTNUM];
     const Real x{coordinates[OPS_ACC_MD2(0, 0, 0, 0)]};
     const Real y{coordinates[OPS_ACC_MD2(1, 0, 0, 0)]};
     const Real z{coordinates[OPS_ACC_MD2(2, 0, 0, 0)]};
     for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
         for (int i = 0; i < LATTDIM; i++) {
-            acceleration[compoIndex + i] = 0;
+            acceleration[compoIndex * LATTDIM + i] = 0;
         }
     }
     acceleration[0] = 0.0001;
@@ -600,12 +620,20 @@ void KerCalcMacroVars3D(const Real* dt, const int* nodeType,
 
     for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
         VertexTypes vt =
-            (VertexTypes)nodeType[OPS_ACC_MD1(compoIndex, 0, 0, 0)];
+            FlagVertexType(nodeFlag[OPS_ACC_MD1(compoIndex, 0, 0, 0)]);
         if (vt != Vertex_ImmersedSolid) {
+            // the distribution functions are read once, see FOffset
+            const int xiStart{COMPOINDEX[2 * compoIndex]};
+            Real fi[MAXLATTSIZE];
+            for (int xiIdx = xiStart; xiIdx <= COMPOINDEX[2 * compoIndex + 1];
+                 xiIdx++) {
+                fi[xiIdx - xiStart] =
+                    f[OPS_ACC_MD3(xiIdx, 0, 0, 0)] + FOffset(xiIdx);
+            }
             bool rhoCalculated{false};
             Real rho{0};
-            bool* veloCalculated = new bool[LATTDIM];
-            Real* velo = new Real[LATTDIM];
+            bool veloCalculated[MAXDIM];
+            Real velo[MAXDIM];
             for (int lattIdx = 0; lattIdx < LATTDIM; lattIdx++) {
                 veloCalculated[lattIdx] = false;
                 velo[lattIdx] = 0;
@@ -620,7 +648,7 @@ void KerCalcMacroVars3D(const Real* dt, const int* nodeType,
                         for (int xiIdx = COMPOINDEX[2 * compoIndex];
                              xiIdx <= COMPOINDEX[2 * compoIndex + 1]; xiIdx++) {
                             macroVars[OPS_ACC_MD4(m, 0, 0, 0)] +=
-                                f[OPS_ACC_MD3(xiIdx, 0, 0, 0)];
+                                fi[xiIdx - xiStart];
                         }
                         rho = macroVars[OPS_ACC_MD4(m, 0, 0, 0)];
 #ifdef CPU
@@ -644,7 +672,7 @@ void KerCalcMacroVars3D(const Real* dt, const int* nodeType,
                                  xiIdx++) {
                                 macroVars[OPS_ACC_MD4(m, 0, 0, 0)] +=
                                     CS * XI[xiIdx * LATTDIM] *
-                                    f[OPS_ACC_MD3(xiIdx, 0, 0, 0)];
+                                    fi[xiIdx - xiStart];
                             }
                             macroVars[OPS_ACC_MD4(m, 0, 0, 0)] /= rho;
                             velo[0] = macroVars[OPS_ACC_MD4(m, 0, 0, 0)];
@@ -678,7 +706,7 @@ void KerCalcMacroVars3D(const Real* dt, const int* nodeType,
                                  xiIdx++) {
                                 macroVars[OPS_ACC_MD4(m, 0, 0, 0)] +=
                                     CS * XI[xiIdx * LATTDIM + 1] *
-                                    f[OPS_ACC_MD3(xiIdx, 0, 0, 0)];
+                                    fi[xiIdx - xiStart];
                             }
                             macroVars[OPS_ACC_MD4(m, 0, 0, 0)] /= rho;
                             velo[1] = macroVars[OPS_ACC_MD4(m, 0, 0, 0)];
@@ -712,7 +740,7 @@ void KerCalcMacroVars3D(const Real* dt, const int* nodeType,
                                  xiIdx++) {
                                 macroVars[OPS_ACC_MD4(m, 0, 0, 0)] +=
                                     CS * XI[xiIdx * LATTDIM + 2] *
-                                    f[OPS_ACC_MD3(xiIdx, 0, 0, 0)];
+                                    fi[xiIdx - xiStart];
                             }
                             macroVars[OPS_ACC_MD4(m, 0, 0, 0)] /= rho;
                             velo[2] = macroVars[OPS_ACC_MD4(m, 0, 0, 0)];
@@ -753,7 +781,7 @@ void KerCalcMacroVars3D(const Real* dt, const int* nodeType,
                                           velo[d]) *
                                          (CS * XI[xiIdx * LATTDIM + d] -
                                           velo[d]) *
-                                         f[OPS_ACC_MD3(xiIdx, 0, 0, 0)];
+                                         fi[xiIdx - xiStart];
                                 }
                                 macroVars[OPS_ACC_MD4(m, 0, 0, 0)] +=
                                     (0.5 *
@@ -798,7 +826,7 @@ void KerCalcMacroVars3D(const Real* dt, const int* nodeType,
                                           velo[d]) *
                                          (CS * XI[xiIdx * LATTDIM + d] -
                                           velo[d]) *
-                                         f[OPS_ACC_MD3(xiIdx, 0, 0, 0)];
+                                         fi[xiIdx - xiStart];
                                 }
                                 macroVars[OPS_ACC_MD4(m, 0, 0, 0)] +=
                                     (0.5 *
@@ -844,7 +872,7 @@ void KerCalcMacroVars3D(const Real* dt, const int* nodeType,
                                           velo[d]) *
                                          (CS * XI[xiIdx * LATTDIM + d] -
                                           velo[d]) *
-                                         f[OPS_ACC_MD3(xiIdx, 0, 0, 0)];
+                                         fi[xiIdx - xiStart];
                                 }
                                 macroVars[OPS_ACC_MD4(m, 0, 0, 0)] +=
                                     (0.5 *
@@ -890,7 +918,7 @@ void KerCalcMacroVars3D(const Real* dt, const int* nodeType,
                                          velo[d]) *
                                         (CS * XI[xiIdx * LATTDIM + d] -
                                          velo[d]) *
-                                        f[OPS_ACC_MD3(xiIdx, 0, 0, 0)];
+                                        fi[xiIdx - xiStart];
                                 }
                             }
                             macroVars[OPS_ACC_MD4(m, 0, 0, 0)] /=
@@ -927,7 +955,7 @@ void KerCalcMacroVars3D(const Real* dt, const int* nodeType,
                                  xiIdx++) {
                                 macroVars[OPS_ACC_MD4(m, 0, 0, 0)] +=
                                     CS * XI[xiIdx * LATTDIM] *
-                                    f[OPS_ACC_MD3(xiIdx, 0, 0, 0)];
+                                    fi[xiIdx - xiStart];
                             }
                             macroVars[OPS_ACC_MD4(m, 0, 0, 0)] /= rho;
                             if (Vertex_Fluid == vt) {
@@ -969,7 +997,7 @@ void KerCalcMacroVars3D(const Real* dt, const int* nodeType,
                                  xiIdx++) {
                                 macroVars[OPS_ACC_MD4(m, 0, 0, 0)] +=
                                     CS * XI[xiIdx * LATTDIM + 1] *
-                                    f[OPS_ACC_MD3(xiIdx, 0, 0, 0)];
+                                    fi[xiIdx - xiStart];
                             }
                             macroVars[OPS_ACC_MD4(m, 0, 0, 0)] /= rho;
                             if (Vertex_Fluid == vt) {
@@ -1009,7 +1037,7 @@ void KerCalcMacroVars3D(const Real* dt, const int* nodeType,
                                  xiIdx++) {
                                 macroVars[OPS_ACC_MD4(m, 0, 0, 0)] +=
                                     CS * XI[xiIdx * LATTDIM + 2] *
-                                    f[OPS_ACC_MD3(xiIdx, 0, 0, 0)];
+                                    fi[xiIdx - xiStart];
                             }
                             macroVars[OPS_ACC_MD4(m, 0, 0, 0)] /= rho;
                             if (Vertex_Fluid == vt) {
@@ -1045,11 +1073,199 @@ void KerCalcMacroVars3D(const Real* dt, const int* nodeType,
                         break;
                 }  // Switch
             }      // m
-            delete[] veloCalculated;
-            delete[] velo;
         }  // compoIdx
     }      // isVertex
-    delete[] acceleration;
+}
+
+template <typename Lattice>
+void KerCalcFeqLattice3D(const short* nodeFlag, const Real* macroVars,
+                         FReal* feq) {
+    for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+        VertexTypes vt =
+            FlagVertexType(nodeFlag[OPS_ACC_MD0(compoIndex, 0, 0, 0)]);
+        if (vt != Vertex_ImmersedSolid) {
+            const int startPos{VARIABLECOMPPOS[2 * compoIndex]};
+            const int xiStart{COMPOINDEX[2 * compoIndex]};
+            const Real rho{macroVars[OPS_ACC_MD1(startPos, 0, 0, 0)]};
+            const Real u{macroVars[OPS_ACC_MD1(startPos + 1, 0, 0, 0)]};
+            const Real v{macroVars[OPS_ACC_MD1(startPos + 2, 0, 0, 0)]};
+            const Real w{macroVars[OPS_ACC_MD1(startPos + 3, 0, 0, 0)]};
+            for (int l = 0; l < Lattice::Q; l++) {
+                const Real res{CalcBGKFeqLattice<Lattice>(l, rho, u, v, w)};
+                feq[OPS_ACC_MD2(xiStart + l, 0, 0, 0)] =
+                    res - FOffset(xiStart + l);
+#if defined(CPU) && !defined(OPS_SOA)
+                if (isnan(res) || res <= 0 || isinf(res)) {
+                    ops_printf(
+                        "Error! Equilibrium function %f becomes "
+                        "invalid for the component %i at the lattice "
+                        "%i\n",
+                        res, compoIndex, xiStart + l);
+                    assert(!(isnan(res) || res <= 0 || isinf(res)));
+                }
+#endif
+            }
+        }
+    }
+}
+
+template <typename Lattice>
+void KerCalcMacroVarsLattice3D(const Real* dt, const short* nodeFlag,
+                               const Real* coordinates, const FReal* f,
+                               Real* macroVars) {
+    // the same constant acceleration as KerCalcMacroVars3D
+    const Real g[]{0.0001, 0, 0};
+    for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+        VertexTypes vt =
+            FlagVertexType(nodeFlag[OPS_ACC_MD1(compoIndex, 0, 0, 0)]);
+        if (vt != Vertex_ImmersedSolid) {
+            const int xiStart{COMPOINDEX[2 * compoIndex]};
+            Real rho{0};
+            Real velo[]{0, 0, 0};
+            for (int l = 0; l < Lattice::Q; l++) {
+                const Real fi{f[OPS_ACC_MD3(xiStart + l, 0, 0, 0)] +
+                              FOffset(xiStart + l)};
+                rho += fi;
+                velo[0] += Lattice::CX[l] * fi;
+                velo[1] += Lattice::CY[l] * fi;
+                velo[2] += Lattice::CZ[l] * fi;
+            }
+#if defined(CPU) && !defined(OPS_SOA)
+            if (isnan(rho) || rho <= 0 || isinf(rho)) {
+                ops_printf(
+                    "Error! Density %f becomes invalid！Something "
+                    "wrong...",
+                    rho);
+                ops_printf("For the component %i at x=%f y=%f z=%f\n",
+                           compoIndex, coordinates[OPS_ACC_MD2(0, 0, 0, 0)],
+                           coordinates[OPS_ACC_MD2(1, 0, 0, 0)],
+                           coordinates[OPS_ACC_MD2(2, 0, 0, 0)]);
+                assert(!(isnan(rho) || rho <= 0 || isinf(rho)));
+            }
+#endif
+            for (int d = 0; d < 3; d++) {
+                velo[d] *= (CS / rho);
+            }
+            for (int m = VARIABLECOMPPOS[2 * compoIndex];
+                 m <= VARIABLECOMPPOS[2 * compoIndex + 1]; m++) {
+                VariableTypes varType = (VariableTypes)VARIABLETYPE[m];
+                switch (varType) {
+                    case Variable_Rho:
+                        macroVars[OPS_ACC_MD4(m, 0, 0, 0)] = rho;
+                        break;
+                    case Variable_U:
+                    case Variable_V:
+                    case Variable_W: {
+                        const int d{varType - Variable_U};
+                        macroVars[OPS_ACC_MD4(m, 0, 0, 0)] = velo[d];
+                    } break;
+                    case Variable_U_Force:
+                    case Variable_V_Force:
+                    case Variable_W_Force: {
+                        const int d{varType - Variable_U_Force};
+                        if (Vertex_Fluid == vt) {
+                            velo[d] += (*dt) * g[d] / 2;
+                        }
+                        macroVars[OPS_ACC_MD4(m, 0, 0, 0)] = velo[d];
+                    } break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+}
+
+void KerCalcfMoments3D(const int* fLayout, const FReal* f, Real* fMoments,
+                       double* error) {
+    const bool swapped{Layout_AASwapped == *fLayout};
+    for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+        const int xiStart{COMPOINDEX[2 * compoIndex]};
+        const int xiEnd{COMPOINDEX[2 * compoIndex + 1]};
+        Real rho{0};
+        Real velo[]{0, 0, 0};
+        // the sums of c_a*c_b*f_i, i.e., xx, yy, zz, xy, xz, yz
+        Real stress[]{0, 0, 0, 0, 0, 0};
+        for (int xiIndex = xiStart; xiIndex <= xiEnd; xiIndex++) {
+            const int cx{(int)XI[xiIndex * LATTDIM]};
+            const int cy{(int)XI[xiIndex * LATTDIM + 1]};
+            const int cz{(int)XI[xiIndex * LATTDIM + 2]};
+            const Real fi{(swapped ? f[OPS_ACC_MD1(OPP[xiIndex], -cx, -cy, -cz)]
+                                   : f[OPS_ACC_MD1(xiIndex, 0, 0, 0)]) +
+                          FOffset(xiIndex)};
+            const Real c[]{CS * cx, CS * cy, CS * cz};
+            rho += fi;
+            for (int d = 0; d < 3; d++) {
+                velo[d] += c[d] * fi;
+                stress[d] += c[d] * c[d] * fi;
+            }
+            stress[3] += c[0] * c[1] * fi;
+            stress[4] += c[0] * c[2] * fi;
+            stress[5] += c[1] * c[2] * fi;
+        }
+        // the nodes inside a solid may hold no distribution
+        if (rho > 0) {
+            for (int d = 0; d < 3; d++) {
+                velo[d] /= rho;
+            }
+        }
+        // the non-equilibrium stress, i.e., the sums of H2(c_i)*f_i minus
+        // those of the second-order equilibrium
+        for (int d = 0; d < 3; d++) {
+            stress[d] -= rho * (velo[d] * velo[d] + 1);
+        }
+        stress[3] -= rho * velo[0] * velo[1];
+        stress[4] -= rho * velo[0] * velo[2];
+        stress[5] -= rho * velo[1] * velo[2];
+        Real moments[FMomentNum]{rho, velo[0], velo[1], velo[2]};
+        for (int idx = 0; idx < 6; idx++) {
+            moments[4 + idx] = stress[idx];
+        }
+        for (int idx = 0; idx < FMomentNum; idx++) {
+            fMoments[OPS_ACC_MD2(FMomentNum * compoIndex + idx, 0, 0, 0)] =
+                moments[idx];
+        }
+        for (int xiIndex = xiStart; xiIndex <= xiEnd; xiIndex++) {
+            const int cx{(int)XI[xiIndex * LATTDIM]};
+            const int cy{(int)XI[xiIndex * LATTDIM + 1]};
+            const int cz{(int)XI[xiIndex * LATTDIM + 2]};
+            const Real fi{(swapped ? f[OPS_ACC_MD1(OPP[xiIndex], -cx, -cy, -cz)]
+                                   : f[OPS_ACC_MD1(xiIndex, 0, 0, 0)]) +
+                          FOffset(xiIndex)};
+            const Real lost{fi - CalcRegularisedF3D(xiIndex, moments)};
+            const Real neq{fi - CalcHermiteFeq3D(xiIndex, moments)};
+            error[0] += lost * lost;
+            error[1] += neq * neq;
+            error[2] += fi * fi;
+        }
+    }
+}
+
+void KerRebuildf3D(const Real* fMoments, FReal* f) {
+    for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+        Real moments[FMomentNum];
+        for (int idx = 0; idx < FMomentNum; idx++) {
+            moments[idx] =
+                fMoments[OPS_ACC_MD0(FMomentNum * compoIndex + idx, 0, 0, 0)];
+        }
+        for (int xiIndex = COMPOINDEX[2 * compoIndex];
+             xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+            f[OPS_ACC_MD1(xiIndex, 0, 0, 0)] =
+                CalcRegularisedF3D(xiIndex, moments) - FOffset(xiIndex);
+        }
+    }
+}
+
+void KerRebuildMacroVars3D(const Real* fMoments, Real* macroVars) {
+    for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+        for (int m = VARIABLECOMPPOS[2 * compoIndex];
+             m <= VARIABLECOMPPOS[2 * compoIndex + 1]; m++) {
+            // rho, u, v and w are the first four moments
+            const int momentIdx{VARIABLETYPE[m] - Variable_Rho};
+            macroVars[OPS_ACC_MD1(m, 0, 0, 0)] = fMoments[OPS_ACC_MD0(
+                FMomentNum * compoIndex + momentIdx, 0, 0, 0)];
+        }
+    }
 }
 #endif
 #endif  // MODEL_KERNEL_H
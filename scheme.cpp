@@ -55,6 +55,13 @@ ops_stencil TWOPTREGULARSTENCIL;
 int schemeHaloPt{1};
 SchemeType schemeType{Scheme_StreamCollision};
 const SchemeType Scheme() { return schemeType; }
+/*!
+ * The AA pattern alternates the position of the distribution function in g_f
+ * every time step, see DistributionLayout.
+ */
+DistributionLayout fLayout{Layout_Natural};
+const DistributionLayout FLayout() { return fLayout; }
+void SetFLayout(const DistributionLayout layout) { fLayout = layout; }
 void SetupCommonStencils() {
 #ifdef OPS_2D
     int currentNode[] = {0, 0};
@@ -96,16 +103,320 @@ void SetupCommonStencils() {
 
 void DefineScheme(const SchemeType scheme) {
     schemeType = scheme;
+    if (FeqOnTheFly() && Scheme_StreamCollision != schemeType &&
+        Scheme_StreamCollisionFused != schemeType &&
+        Scheme_StreamCollisionAA != schemeType) {
+        ops_printf(
+            "Error! Calculating the equilibrium on the fly is only supported "
+            "by the stream-collision scheme!\n");
+        assert(Scheme_StreamCollision == schemeType ||
+               Scheme_StreamCollisionFused == schemeType ||
+               Scheme_StreamCollisionAA == schemeType);
+    }
     SetupCommonStencils();
     switch (schemeType) {
         case Scheme_StreamCollision: {
             SetSchemeHaloNum(1);
             ops_printf("The stream-collision scheme is chosen!\n");
         } break;
+        case Scheme_StreamCollisionFused: {
+            SetSchemeHaloNum(1);
+            ops_printf("The fused stream-collision scheme is chosen!\n");
+        } break;
+        case Scheme_StreamCollisionAA: {
+            SetSchemeHaloNum(1);
+            SetFLayout(Layout_Natural);
+            ops_printf(
+                "The stream-collision scheme with the AA pattern is "
+                "chosen!\n");
+        } break;
         default:
             break;
     }
 }
 const int SchemeHaloNum() { return schemeHaloPt; }
 void SetSchemeHaloNum(const int schemeHaloNum) { schemeHaloPt = schemeHaloNum; }
+#ifdef OPS_2D
+bool IsStreamedAtBoundary(const VertexGeometryTypes vg,
+                          const bool streamRequired, const int cx,
+                          const int cy) {
+    bool isStreamed{false};
+    switch (vg) {
+        case VG_IP:
+            isStreamed = streamRequired ? (cx <= 0) : (cx < 0);
+            break;
+        case VG_IM:
+            isStreamed = streamRequired ? (cx >= 0) : (cx > 0);
+            break;
+        case VG_JP:
+            isStreamed = streamRequired ? (cy <= 0) : (cy < 0);
+            break;
+        case VG_JM:
+            isStreamed = streamRequired ? (cy >= 0) : (cy > 0);
+            break;
+        case VG_IPJP_I:
+            isStreamed =
+                streamRequired ? (cy <= 0 && cx <= 0) : (cy < 0 && cx < 0);
+            break;
+        case VG_IPJM_I:
+            isStreamed =
+                streamRequired ? (cy >= 0 && cx <= 0) : (cy > 0 && cx < 0);
+            break;
+        case VG_IMJP_I:
+            isStreamed =
+                streamRequired ? (cy <= 0 && cx >= 0) : (cy < 0 && cx > 0);
+            break;
+        case VG_IMJM_I:
+            isStreamed =
+                streamRequired ? (cy >= 0 && cx >= 0) : (cy > 0 && cx > 0);
+            break;
+        case VG_IPJP_O:
+            isStreamed = (cy < 0 || cx < 0);
+            break;
+        case VG_IPJM_O:
+            isStreamed = (cy > 0 || cx < 0);
+            break;
+        case VG_IMJP_O:
+            isStreamed = (cy < 0 || cx > 0);
+            break;
+        case VG_IMJM_O:
+            isStreamed = (cy > 0 || cx > 0);
+            break;
+        default:
+            break;
+    }
+    return isStreamed;
+}
+#endif /* OPS_2D */
+#ifdef OPS_3D
+bool IsStreamedAtBoundary3D(const VertexGeometryTypes vg,
+                            const bool streamRequired, const int cx,
+                            const int cy, const int cz) {
+    bool isStreamed{false};
+    switch (vg) {
+        case VG_IP:
+            isStreamed = streamRequired ? (cx <= 0) : (cx < 0);
+            break;
+        case VG_IM:
+            isStreamed = streamRequired ? (cx >= 0) : (cx > 0);
+            break;
+        case VG_JP:
+            isStreamed = streamRequired ? (cy <= 0) : (cy < 0);
+            break;
+        case VG_JM:
+            isStreamed = streamRequired ? (cy >= 0) : (cy > 0);
+            break;
+        case VG_KP:
+            isStreamed = streamRequired ? (cz <= 0) : (cz < 0);
+            break;
+        case VG_KM:
+            isStreamed = streamRequired ? (cz >= 0) : (cz > 0);
+            break;
+        case VG_IPJP_I:
+            isStreamed =
+                streamRequired ? (cy <= 0 && cx <= 0) : (cy < 0 && cx < 0);
+            break;
+        case VG_IPJM_I:
+            isStreamed =
+                streamRequired ? (cy >= 0 && cx <= 0) : (cy > 0 && cx < 0);
+            break;
+        case VG_IMJP_I:
+            isStreamed =
+                streamRequired ? (cy <= 0 && cx >= 0) : (cy < 0 && cx > 0);
+            break;
+        case VG_IMJM_I:
+            isStreamed =
+                streamRequired ? (cy >= 0 && cx >= 0) : (cy > 0 && cx > 0);
+            break;
+        case VG_IPKP_I:
+            isStreamed =
+                streamRequired ? (cz <= 0 && cx <= 0) : (cz < 0 && cx < 0);
+            break;
+        case VG_IPKM_I:
+            isStreamed =
+                streamRequired ? (cz >= 0 && cx <= 0) : (cz > 0 && cx < 0);
+            break;
+        case VG_IMKP_I:
+            isStreamed =
+                streamRequired ? (cz <= 0 && cx >= 0) : (cz < 0 && cx > 0);
+            break;
+        case VG_IMKM_I:
+            isStreamed =
+                streamRequired ? (cz >= 0 && cx >= 0) : (cz > 0 && cx > 0);
+            break;
+        case VG_JPKP_I:
+            isStreamed =
+                streamRequired ? (cz <= 0 && cy <= 0) : (cz < 0 && cy < 0);
+            break;
+        case VG_JPKM_I:
+            isStreamed =
+                streamRequired ? (cz >= 0 && cy <= 0) : (cz > 0 && cy < 0);
+            break;
+        case VG_JMKP_I:
+            isStreamed =
+                streamRequired ? (cz <= 0 && cy >= 0) : (cz < 0 && cy > 0);
+            break;
+        case VG_JMKM_I:
+            isStreamed =
+                streamRequired ? (cz >= 0 && cy >= 0) : (cz > 0 && cy > 0);
+            break;
+        case VG_IPJP_O:
+            isStreamed =
+                streamRequired ? (cy <= 0 || cx <= 0) : (cy < 0 || cx < 0);
+            break;
+        case VG_IPJM_O:
+            isStreamed =
+                streamRequired ? (cy >= 0 || cx <= 0) : (cy > 0 || cx < 0);
+            break;
+        case VG_IMJP_O:
+            isStreamed =
+                streamRequired ? (cy <= 0 || cx >= 0) : (cy < 0 || cx > 0);
+            break;
+        case VG_IMJM_O:
+            isStreamed =
+                streamRequired ? (cy >= 0 || cx >= 0) : (cy > 0 || cx > 0);
+            break;
+        case VG_IPKP_O:
+            isStreamed =
+                streamRequired ? (cz <= 0 || cx <= 0) : (cz < 0 || cx < 0);
+            break;
+        case VG_IPKM_O:
+            isStreamed =
+                streamRequired ? (cz >= 0 || cx <= 0) : (cz > 0 || cx < 0);
+            break;
+        case VG_IMKP_O:
+            isStreamed =
+                streamRequired ? (cz <= 0 || cx >= 0) : (cz < 0 || cx > 0);
+            break;
+        case VG_IMKM_O:
+            isStreamed =
+                streamRequired ? (cz >= 0 || cx >= 0) : (cz > 0 || cx > 0);
+            break;
+        case VG_JPKP_O:
+            isStreamed =
+                streamRequired ? (cz <= 0 || cy <= 0) : (cz < 0 || cy < 0);
+            break;
+        case VG_JPKM_O:
+            isStreamed =
+                streamRequired ? (cz >= 0 || cy <= 0) : (cz > 0 || cy < 0);
+            break;
+        case VG_JMKP_O:
+            isStreamed =
+                streamRequired ? (cz <= 0 || cy >= 0) : (cz < 0 || cy > 0);
+            break;
+        case VG_JMKM_O:
+            isStreamed =
+                streamRequired ? (cz >= 0 || cy >= 0) : (cz > 0 || cy > 0);
+            break;
+        case VG_IPJPKP_I:
+            isStreamed = streamRequired
+                             ? (cx <= 0 && cy <= 0 && cz <= 0)
+                             : (cx < 0 && cy < 0 && cz < 0);
+            break;
+        case VG_IPJPKM_I:
+            isStreamed = streamRequired
+                             ? (cx <= 0 && cy <= 0 && cz >= 0)
+                             : (cx < 0 && cy < 0 && cz > 0);
+            break;
+        case VG_IPJMKP_I:
+            isStreamed = streamRequired
+                             ? (cx <= 0 && cy >= 0 && cz <= 0)
+                             : (cx < 0 && cy > 0 && cz < 0);
+            break;
+        case VG_IPJMKM_I:
+            isStreamed = streamRequired
+                             ? (cx <= 0 && cy >= 0 && cz >= 0)
+                             : (cx < 0 && cy > 0 && cz > 0);
+            break;
+        case VG_IMJPKP_I:
+            isStreamed = streamRequired
+                             ? (cx >= 0 && cy <= 0 && cz <= 0)
+                             : (cx > 0 && cy < 0 && cz < 0);
+            break;
+        case VG_IMJPKM_I:
+            isStreamed = streamRequired
+                             ? (cx >= 0 && cy <= 0 && cz >= 0)
+                             : (cx > 0 && cy < 0 && cz > 0);
+            break;
+        case VG_IMJMKP_I:
+            isStreamed = streamRequired
+                             ? (cx >= 0 && cy >= 0 && cz <= 0)
+                             : (cx > 0 && cy > 0 && cz < 0);
+            break;
+        case VG_IMJMKM_I:
+            isStreamed = streamRequired
+                             ? (cx >= 0 && cy >= 0 && cz >= 0)
+                             : (cx > 0 && cy > 0 && cz > 0);
+            break;
+        case VG_IPJPKP_O:
+            isStreamed = streamRequired
+                             ? (cx <= 0 || cy <= 0 || cz <= 0)
+                             : (cx < 0 || cy < 0 || cz < 0);
+            break;
+        case VG_IPJPKM_O:
+            isStreamed = streamRequired
+                             ? (cx <= 0 || cy <= 0 || cz >= 0)
+                             : (cx < 0 || cy < 0 || cz > 0);
+            break;
+        case VG_IPJMKP_O:
+            isStreamed = streamRequired
+                             ? (cx <= 0 || cy >= 0 || cz <= 0)
+                             : (cx < 0 || cy > 0 || cz < 0);
+            break;
+        case VG_IPJMKM_O:
+            isStreamed = streamRequired
+                             ? (cx <= 0 || cy >= 0 || cz >= 0)
+                             : (cx < 0 || cy > 0 || cz > 0);
+            break;
+        case VG_IMJPKP_O:
+            isStreamed = streamRequired
+                             ? (cx >= 0 || cy <= 0 || cz <= 0)
+                             : (cx > 0 || cy < 0 || cz < 0);
+            break;
+        case VG_IMJPKM_O:
+            isStreamed = streamRequired
+                             ? (cx >= 0 || cy <= 0 || cz >= 0)
+                             : (cx > 0 || cy < 0 || cz > 0);
+            break;
+        case VG_IMJMKP_O:
+            isStreamed = streamRequired
+                             ? (cx >= 0 || cy >= 0 || cz <= 0)
+                             : (cx > 0 || cy > 0 || cz < 0);
+            break;
+        case VG_IMJMKM_O:
+            isStreamed = streamRequired
+                             ? (cx >= 0 || cy >= 0 || cz >= 0)
+                             : (cx > 0 || cy > 0 || cz > 0);
+            break;
+        default:
+            break;
+    }
+    return isStreamed;
+}
+#endif /* OPS_3D */
 #include "scheme_kernel.h"
+// Instantiate the specialised kernels for the built-in lattices
+#ifdef OPS_2D
+template void KerCollideLattice<LatticeD2Q9>(
+    const Real* dt, const int* nodeType, const Real* f, const Real* feq,
+    const Real* relaxationTime, const Real* bodyForce, Real* fStage);
+template void KerStreamLattice<LatticeD2Q9>(const int* nodeType,
+                                            const int* geometry,
+                                            const Real* fStage, Real* f);
+#endif /* OPS_2D */
+#ifdef OPS_3D
+template void KerCollideLattice3D<LatticeD3Q15>(
+    const Real* dt, const short* nodeFlag, const FReal* f, const FReal* feq,
+    const Real* relaxationTime, const Real* bodyForce, FReal* fStage);
+template void KerCollideLattice3D<LatticeD3Q19>(
+    const Real* dt, const short* nodeFlag, const FReal* f, const FReal* feq,
+    const Real* relaxationTime, const Real* bodyForce, FReal* fStage);
+template void KerStreamLattice3D<LatticeD3Q15>(const int* streamMask,
+                                               const FReal* fStage, FReal* f);
+template void KerStreamLattice3D<LatticeD3Q19>(const int* streamMask,
+                                               const FReal* fStage, FReal* f);
+template void KerStreamBulkLattice3D<LatticeD3Q15>(const FReal* fStage,
+                                                   FReal* f);
+template void KerStreamBulkLattice3D<LatticeD3Q19>(const FReal* fStage,
+                                                   FReal* f);
+#endif /* OPS_3D */
@@ -79,7 +79,7 @@ void SetupCommonStencils();
  * @param feq equilibrium function
  * @param relaxationTime relaxation time
  * @param bodyForce force term
- * @param fStage temporary storage
+ * @param fStage temporary storage, set to f at nodes without collision
  */
 void KerCollide(const Real* dt, const int* nodeType, const Real* f,
                 const Real* feq, const Real* relaxationTime,
@@ -95,6 +95,90 @@ void KerCollide(const Real* dt, const int* nodeType, const Real* f,
  */
 void KerStream(const int* nodeType, const int* geometry, const Real* fStage,
                Real* f);
+/*!
+ * If the population with the velocity (cx, cy) at a boundary node of the
+ * geometry vg is streamed from its upwind neighbour, shared by the generic and
+ * the specialised stream kernels
+ * @param streamRequired if the particles parallel to the boundary are streamed
+ */
+bool IsStreamedAtBoundary(const VertexGeometryTypes vg,
+                          const bool streamRequired, const int cx,
+                          const int cy);
+/*!
+ * @fn KerCollideLattice
+ * @brief Same as KerCollide but specialised for a lattice, see lattice.h
+ */
+template <typename Lattice>
+void KerCollideLattice(const Real* dt, const int* nodeType, const Real* f,
+                       const Real* feq, const Real* relaxationTime,
+                       const Real* bodyForce, Real* fStage);
+/*!
+ * @fn KerStreamLattice
+ * @brief Same as KerStream but specialised for a lattice, see lattice.h
+ */
+template <typename Lattice>
+void KerStreamLattice(const int* nodeType, const int* geometry,
+                      const Real* fStage, Real* f);
+/*!
+ * @fn KerCollideOnTheFly
+ * @brief Collision step where the equilibrium is calculated on the fly
+ * @details Used when g_feq and g_Bodyforce are not allocated, see DefineCase
+ * @param dt time step
+ * @param nodeType the node
+ * @param f distribution function
+ * @param macroVars macroscopic variables
+ * @param relaxationTime relaxation time
+ * @param fStage temporary storage, set to f at nodes without collision
+ */
+void KerCollideOnTheFly(const Real* dt, const int* nodeType, const Real* f,
+                        const Real* macroVars, const Real* relaxationTime,
+                        Real* fStage);
+/*!
+ * @fn KerCollideFused
+ * @brief Fused collision step for the stream-collision scheme
+ * @details The macroscopic variables, the equilibrium, the relaxation time and
+ * the collision are evaluated in registers so that f is read once and fStage
+ * is written once per node. Nodes without collision get fStage=f so that
+ * no full-field copy is needed. Only Equilibrium_BGKIsothermal2nd is
+ * supported.
+ * @param dt time step
+ * @param nodeType node type
+ * @param tauRef reference relaxation time
+ * @param f distribution function
+ * @param macroVars macroscopic variables, updated as a by-product
+ * @param fStage temporary storage, set to f at nodes without collision
+ */
+void KerCollideFused(const Real* dt, const int* nodeType, const Real* tauRef,
+                     const Real* f, Real* macroVars, Real* fStage);
+/*!
+ * @fn KerCollideAAEven
+ * @brief Even step of the AA pattern: a local collision
+ * @details The AA pattern works on g_f alone. The even step reads f_i at
+ * (i,x) and writes the post-collision value to (OPP[i],x), so the
+ * post-stream f_i(x) is found at (OPP[i],x-c_i) afterwards, see
+ * DistributionLayout. Only Equilibrium_BGKIsothermal2nd is supported.
+ * @param dt time step
+ * @param nodeType node type
+ * @param tauRef reference relaxation time
+ * @param f distribution function
+ * @param macroVars macroscopic variables, updated as a by-product
+ */
+void KerCollideAAEven(const Real* dt, const int* nodeType, const Real* tauRef,
+                      Real* f, Real* macroVars);
+/*!
+ * @fn KerStreamCollideAAOdd
+ * @brief Odd step of the AA pattern: stream, collide and stream
+ * @details Reads f_i from (OPP[i],x-c_i) and writes the post-collision value
+ * to (i,x+c_i), so that g_f is back to Layout_Natural. A node only touches
+ * the slots it read, so the kernel is free of races on a shared memory.
+ * @param dt time step
+ * @param nodeType node type
+ * @param tauRef reference relaxation time
+ * @param f distribution function
+ * @param macroVars macroscopic variables, updated as a by-product
+ */
+void KerStreamCollideAAOdd(const Real* dt, const int* nodeType,
+                           const Real* tauRef, Real* f, Real* macroVars);
 #endif
 
 #ifdef OPS_3D
@@ -102,26 +186,130 @@ void KerStream(const int* nodeType, const int* geometry, const Real* fStage,
  * @fn KerCollide3D
  * @brief Collision step for the stream-collision scheme: 3D case
  * @param dt time step
- * @param nodeType the node
+ * @param nodeFlag the node, see NodeFlagBits
  * @param f distribution function
  * @param feq equilibrium function
  * @param relaxationTime relaxation time
  * @param bodyForce force term
- * @param fStage temporary storage
+ * @param fStage temporary storage, set to f at nodes without collision
  */
-void KerCollide3D(const Real* dt, const int* nodeType, const Real* f,
-                  const Real* feq, const Real* relaxationTime,
-                  const Real* bodyForce, Real* fStage);
+void KerCollide3D(const Real* dt, const short* nodeFlag, const FReal* f,
+                  const FReal* feq, const Real* relaxationTime,
+                  const Real* bodyForce, FReal* fStage);
 /*!
  * @fn KerStream3D
  * @brief Stream step for the stream-collision scheme: 3D case
- * @param nodeType node type
- * @param geometry geometry type, e.g., if it is a corner
+ * @details A masked gather without branches on the node type, where the
+ * populations not in the mask keep their values
+ * @param streamMask the populations pulled from the neighbours, see
+ * g_StreamMask
  * @param fStage temporary storage
  * @param f distribution function
  */
-void KerStream3D(const int* nodeType, const int* geometry, const Real* fStage,
-                 Real* f);
+void KerStream3D(const int* streamMask, const FReal* fStage, FReal* f);
+/*!
+ * @fn KerStreamBulk3D
+ * @brief Stream step over the tiles of bulk fluid nodes, where all the
+ * populations are pulled from the neighbours, see SetupStreamRng3D
+ */
+void KerStreamBulk3D(const FReal* fStage, FReal* f);
+/*!
+ * @brief Set g_StreamMask from the node type and the geometry type by
+ * IsStreamedAtBoundary3D
+ */
+void KerSetStreamMask3D(const short* nodeFlag, int* streamMask);
+/*!
+ * Mark the tiles of tileSize^3 nodes which contain non-solid nodes and those
+ * which contain nodes other than bulk fluid nodes, streamTile is a reduction
+ * of two integers per tile, see KerFindActiveTile3D
+ */
+void KerFindStreamTile3D(const int* tileSize, const int* tileNum,
+                         const short* nodeFlag, const int* idx,
+                         int* streamTile);
+/*!
+ * See IsStreamedAtBoundary: 3D case
+ */
+bool IsStreamedAtBoundary3D(const VertexGeometryTypes vg,
+                            const bool streamRequired, const int cx,
+                            const int cy, const int cz);
+/*!
+ * @fn KerCollideLattice3D
+ * @brief Same as KerCollide3D but specialised for a lattice, see lattice.h
+ * @details The relaxation factor is zero at the nodes without collision, so
+ * that f is copied unchanged there without a branch on the node type. With
+ * the OPS_SOA layout, the check of the distribution functions is skipped as
+ * its ops_printf stops the compiler vectorising over nodes.
+ */
+template <typename Lattice>
+void KerCollideLattice3D(const Real* dt, const short* nodeFlag, const FReal* f,
+                         const FReal* feq, const Real* relaxationTime,
+                         const Real* bodyForce, FReal* fStage);
+/*!
+ * @fn KerStreamLattice3D
+ * @brief Same as KerStream3D but specialised for a lattice, see lattice.h
+ */
+template <typename Lattice>
+void KerStreamLattice3D(const int* streamMask, const FReal* fStage, FReal* f);
+/*!
+ * @fn KerStreamBulkLattice3D
+ * @brief Same as KerStreamBulk3D but specialised for a lattice, so that the
+ * loop over the populations can be unrolled by the compiler
+ */
+template <typename Lattice>
+void KerStreamBulkLattice3D(const FReal* fStage, FReal* f);
+/*!
+ * @fn KerCollideOnTheFly3D
+ * @brief Collision step where the equilibrium and body force are calculated
+ * on the fly: 3D case
+ * @details Used when g_feq and g_Bodyforce are not allocated, see DefineCase
+ * @param dt time step
+ * @param nodeFlag the node, see NodeFlagBits
+ * @param f distribution function
+ * @param macroVars macroscopic variables
+ * @param relaxationTime relaxation time
+ * @param fStage temporary storage, set to f at nodes without collision
+ */
+void KerCollideOnTheFly3D(const Real* dt, const short* nodeFlag, const FReal* f,
+                          const Real* macroVars, const Real* relaxationTime,
+                          FReal* fStage);
+/*!
+ * @fn KerCollideFused3D
+ * @brief Fused collision step for the stream-collision scheme: 3D case
+ * @details See KerCollideFused. The body force is evaluated on the fly.
+ * @param dt time step
+ * @param nodeFlag node type, see NodeFlagBits
+ * @param tauRef reference relaxation time
+ * @param f distribution function
+ * @param macroVars macroscopic variables, updated as a by-product
+ * @param fStage temporary storage
+ */
+void KerCollideFused3D(const Real* dt, const short* nodeFlag,
+                       const Real* tauRef, const FReal* f, Real* macroVars,
+                       FReal* fStage);
+/*!
+ * @fn KerCollideAAEven3D
+ * @brief Even step of the AA pattern: 3D case
+ * @details See KerCollideAAEven. The body force is evaluated on the fly.
+ * @param dt time step
+ * @param nodeFlag node type, see NodeFlagBits
+ * @param tauRef reference relaxation time
+ * @param f distribution function
+ * @param macroVars macroscopic variables, updated as a by-product
+ */
+void KerCollideAAEven3D(const Real* dt, const short* nodeFlag,
+                        const Real* tauRef, FReal* f, Real* macroVars);
+/*!
+ * @fn KerStreamCollideAAOdd3D
+ * @brief Odd step of the AA pattern: 3D case
+ * @details See KerStreamCollideAAOdd.
+ * @param dt time step
+ * @param nodeFlag node type, see NodeFlagBits
+ * @param tauRef reference relaxation time
+ * @param f distribution function
+ * @param macroVars macroscopic variables, updated as a by-product
+ */
+void KerStreamCollideAAOdd3D(const Real* dt, const short* nodeFlag,
+                             const Real* tauRef, FReal* f, Real* macroVars);
 #endif
 #ifdef OPS_2D
 // Finite difference scheme for the cutting cell mesh
@@ -166,20 +354,16 @@ void KerSetfFixValue(const Real* value, Real* f);
 /*!
  * Utility kernel function for copying distribution function
  */
-void KerCopyf(const Real* src, Real* dest);
-/*!
- * Utility kernel function for calculating numerator of L2 norm
- */
-void KerCalcMacroVarSquareofDifference(const Real* macroVars,
-                                       const Real* macroVarsCopy,
-                                       const int* varId, double* sumSquareDiff);
-
+void KerCopyf(const FReal* src, FReal* dest);
 /*!
- * Utility kernel function for calculating denominator of L2 norm
- * Mainly for a steady problem
+ * Utility kernel function for calculating both the numerator and denominator
+ * of the L2 norm of all macroscopic variables in a single sweep, and then
+ * copying the macroscopic variables for the next check
+ * residual[2*m] and residual[2*m+1] accumulate the square of difference and
+ * the square for the variable m, respectively.
  */
-void KerCalcMacroVarSquare(const Real* macroVars, const int* varId,
-                           double* sumSquare);
+void KerCalcMacroVarResidual(const Real* macroVars, Real* macroVarsCopy,
+                             double* residual);
 
 /*!
  * Utility kernel function for copying geometry and node property data
@@ -193,6 +377,18 @@ void KerCopyMacroVars(const Real* src, Real* dest);
  * Utility kernel function for copying distribution with a displacement
  */
 void KerCopyDispf(const Real* src, Real* dest, const int* disp);
+/*!
+ * Utility kernel function for packing the popNum populations in popList into
+ * a contiguous array, see PopulationHalo
+ */
+void KerPackPopulations(const int* popNum, const int* popList, const FReal* f,
+                        FReal* fPacked);
+/*!
+ * Utility kernel function for unpacking the populations packed by
+ * KerPackPopulations
+ */
+void KerUnpackPopulations(const int* popNum, const int* popList,
+                          const FReal* fPacked, FReal* f);
 /*!
  * Utility kernel function for copying coordinates
  */
@@ -213,4 +409,6 @@ void KerGetPointMacroVarValue(const Real* macroVars, Real* pointValue);
 const int SchemeHaloNum();
 void SetSchemeHaloNum(const int schemeHaloNum);
 const SchemeType Scheme();
+const DistributionLayout FLayout();
+void SetFLayout(const DistributionLayout layout);
 #endif
@@ -69,8 +69,311 @@ void KerCollide(const Real* dt, const int* nodeType, const Real* f,
                         bodyForce[OPS_ACC_MD5(xiIndex, 0, 0)];
             }
         }
+    } else {
+        // e.g., bounce-back and solid nodes, fStage is simply f so that the
+        // stream step can work without copying the whole field in advance
+        for (int xiIndex = 0; xiIndex < NUMXI; xiIndex++) {
+            fStage[OPS_ACC_MD6(xiIndex, 0, 0)] = f[OPS_ACC_MD2(xiIndex, 0, 0)];
+        }
+    }
+}
+void KerCollideOnTheFly(const Real* dt, const int* nodeType, const Real* f,
+                        const Real* macroVars, const Real* relaxationTime,
+                        Real* fStage) {
+    VertexTypes vt = (VertexTypes)nodeType[OPS_ACC1(0, 0)];
+    bool collisionRequired =
+        (vt == Vertex_Fluid ||
+         vt == Vertex_ZouHeVelocity ||
+         vt == Vertex_EQMDiffuseRefl ||
+         vt == Vertex_ExtrapolPressure1ST ||
+         vt == Vertex_ExtrapolPressure2ND
+         );
+    if (collisionRequired) {
+        for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+            EquilibriumType equilibriumType{
+                (EquilibriumType)EQUILIBRIUMTYPE[compoIndex]};
+            const int startPos{VARIABLECOMPPOS[2 * compoIndex]};
+            const Real rho{macroVars[OPS_ACC_MD3(startPos, 0, 0)]};
+            const Real u{macroVars[OPS_ACC_MD3(startPos + 1, 0, 0)]};
+            const Real v{macroVars[OPS_ACC_MD3(startPos + 2, 0, 0)]};
+            Real tau = relaxationTime[OPS_ACC_MD4(compoIndex, 0, 0)];
+            Real dtOvertauPlusdt = (*dt) / (tau + 0.5 * (*dt));
+            for (int xiIndex = COMPOINDEX[2 * compoIndex];
+                 xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+                Real feq{0};
+                switch (equilibriumType) {
+                    case Equilibrium_BGKIsothermal2nd:
+                        feq = CalcBGKFeq(xiIndex, rho, u, v, 1, 2);
+                        break;
+                    case Equilibrium_BGKThermal4th:
+                        feq = CalcBGKFeq(xiIndex, rho, u, v,
+                                         macroVars[OPS_ACC_MD3(startPos + 3,
+                                                               0, 0)],
+                                         4);
+                        break;
+                    case Equilibrium_BGKSWE4th:
+                        feq = CalcSWEFeq(xiIndex, rho, u, v, 4);
+                        break;
+                    default:
+                        break;
+                }
+                fStage[OPS_ACC_MD5(xiIndex, 0, 0)] =
+                    f[OPS_ACC_MD2(xiIndex, 0, 0)] -
+                    dtOvertauPlusdt * (f[OPS_ACC_MD2(xiIndex, 0, 0)] - feq);
+            }
+        }
+    } else {
+        for (int xiIndex = 0; xiIndex < NUMXI; xiIndex++) {
+            fStage[OPS_ACC_MD5(xiIndex, 0, 0)] = f[OPS_ACC_MD2(xiIndex, 0, 0)];
+        }
+    }
+}
+
+void KerCollideFused(const Real* dt, const int* nodeType, const Real* tauRef,
+                     const Real* f, Real* macroVars, Real* fStage) {
+    VertexTypes vt = (VertexTypes)nodeType[OPS_ACC1(0, 0)];
+    bool collisionRequired =
+        (vt == Vertex_Fluid ||
+         vt == Vertex_ZouHeVelocity ||
+         vt == Vertex_EQMDiffuseRefl ||
+         vt == Vertex_ExtrapolPressure1ST ||
+         vt == Vertex_ExtrapolPressure2ND
+         );
+    for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+        Real rho{0};
+        Real u{0};
+        Real v{0};
+        if (vt != Vertex_ImmersedSolid) {
+            for (int xiIndex = COMPOINDEX[2 * compoIndex];
+                 xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+                const Real fi{f[OPS_ACC_MD3(xiIndex, 0, 0)]};
+                rho += fi;
+                u += CS * XI[xiIndex * LATTDIM] * fi;
+                v += CS * XI[xiIndex * LATTDIM + 1] * fi;
+            }
+            u /= rho;
+            v /= rho;
+            for (int m = VARIABLECOMPPOS[2 * compoIndex];
+                 m <= VARIABLECOMPPOS[2 * compoIndex + 1]; m++) {
+                VariableTypes varType = (VariableTypes)VARIABLETYPE[m];
+                switch (varType) {
+                    case Variable_Rho:
+                        macroVars[OPS_ACC_MD4(m, 0, 0)] = rho;
+                        break;
+                    case Variable_U:
+                        macroVars[OPS_ACC_MD4(m, 0, 0)] = u;
+                        break;
+                    case Variable_V:
+                        macroVars[OPS_ACC_MD4(m, 0, 0)] = v;
+                        break;
+                    default:
+#ifdef CPU
+                        ops_printf(
+                            "Error! The fused stream-collision scheme only "
+                            "supports the variables [rho,u,v]!\n");
+                        assert(false);
+#endif
+                        break;
+                }
+            }
+        }
+        if (collisionRequired) {
+#ifdef CPU
+            if (Equilibrium_BGKIsothermal2nd != EQUILIBRIUMTYPE[compoIndex]) {
+                ops_printf(
+                    "Error! The fused stream-collision scheme only supports "
+                    "the isothermal BGK equilibrium!\n");
+                assert(Equilibrium_BGKIsothermal2nd ==
+                       EQUILIBRIUMTYPE[compoIndex]);
+            }
+#endif
+            const Real tau{tauRef[compoIndex] / rho};
+            const Real dtOvertauPlusdt = (*dt) / (tau + 0.5 * (*dt));
+            for (int xiIndex = COMPOINDEX[2 * compoIndex];
+                 xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+                const Real fi{f[OPS_ACC_MD3(xiIndex, 0, 0)]};
+                const Real feq{CalcBGKFeq(xiIndex, rho, u, v, 1, 2)};
+                fStage[OPS_ACC_MD5(xiIndex, 0, 0)] =
+                    fi - dtOvertauPlusdt * (fi - feq);
+            }
+        } else {
+            for (int xiIndex = COMPOINDEX[2 * compoIndex];
+                 xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+                fStage[OPS_ACC_MD5(xiIndex, 0, 0)] =
+                    f[OPS_ACC_MD3(xiIndex, 0, 0)];
+            }
+        }
+    }
+}
+void KerCollideAAEven(const Real* dt, const int* nodeType, const Real* tauRef,
+                      Real* f, Real* macroVars) {
+    VertexTypes vt = (VertexTypes)nodeType[OPS_ACC1(0, 0)];
+    bool collisionRequired =
+        (vt == Vertex_Fluid ||
+         vt == Vertex_ZouHeVelocity ||
+         vt == Vertex_EQMDiffuseRefl ||
+         vt == Vertex_ExtrapolPressure1ST ||
+         vt == Vertex_ExtrapolPressure2ND
+         );
+    for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+        Real rho{0};
+        Real u{0};
+        Real v{0};
+        if (vt != Vertex_ImmersedSolid) {
+            for (int xiIndex = COMPOINDEX[2 * compoIndex];
+                 xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+                const Real fi{f[OPS_ACC_MD3(xiIndex, 0, 0)]};
+                rho += fi;
+                u += CS * XI[xiIndex * LATTDIM] * fi;
+                v += CS * XI[xiIndex * LATTDIM + 1] * fi;
+            }
+            u /= rho;
+            v /= rho;
+            for (int m = VARIABLECOMPPOS[2 * compoIndex];
+                 m <= VARIABLECOMPPOS[2 * compoIndex + 1]; m++) {
+                VariableTypes varType = (VariableTypes)VARIABLETYPE[m];
+                switch (varType) {
+                    case Variable_Rho:
+                        macroVars[OPS_ACC_MD4(m, 0, 0)] = rho;
+                        break;
+                    case Variable_U:
+                        macroVars[OPS_ACC_MD4(m, 0, 0)] = u;
+                        break;
+                    case Variable_V:
+                        macroVars[OPS_ACC_MD4(m, 0, 0)] = v;
+                        break;
+                    default:
+#ifdef CPU
+                        ops_printf(
+                            "Error! The AA stream-collision scheme only "
+                            "supports the variables [rho,u,v]!\n");
+                        assert(false);
+#endif
+                        break;
+                }
+            }
+        }
+#ifdef CPU
+        if (collisionRequired &&
+            Equilibrium_BGKIsothermal2nd != EQUILIBRIUMTYPE[compoIndex]) {
+            ops_printf(
+                "Error! The AA stream-collision scheme only supports "
+                "the isothermal BGK equilibrium!\n");
+            assert(Equilibrium_BGKIsothermal2nd ==
+                   EQUILIBRIUMTYPE[compoIndex]);
+        }
+#endif
+        const Real tau{collisionRequired ? tauRef[compoIndex] / rho : 0};
+        const Real dtOvertauPlusdt{
+            collisionRequired ? (*dt) / (tau + 0.5 * (*dt)) : 0};
+        // f_i and f_OPP[i] are updated as a pair so that the swap is in place
+        for (int xiIndex = COMPOINDEX[2 * compoIndex];
+             xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+            const int oppIndex{OPP[xiIndex]};
+            if (oppIndex < xiIndex) {
+                continue;
+            }
+            Real fi{f[OPS_ACC_MD3(xiIndex, 0, 0)]};
+            Real fOpp{f[OPS_ACC_MD3(oppIndex, 0, 0)]};
+            if (collisionRequired) {
+                fi -= dtOvertauPlusdt *
+                      (fi - CalcBGKFeq(xiIndex, rho, u, v, 1, 2));
+                fOpp -= dtOvertauPlusdt *
+                        (fOpp - CalcBGKFeq(oppIndex, rho, u, v, 1, 2));
+            }
+            f[OPS_ACC_MD3(oppIndex, 0, 0)] = fi;
+            f[OPS_ACC_MD3(xiIndex, 0, 0)] = fOpp;
+        }
+    }
+}
+
+void KerStreamCollideAAOdd(const Real* dt, const int* nodeType,
+                           const Real* tauRef, Real* f, Real* macroVars) {
+    VertexTypes vt = (VertexTypes)nodeType[OPS_ACC1(0, 0)];
+    bool collisionRequired =
+        (vt == Vertex_Fluid ||
+         vt == Vertex_ZouHeVelocity ||
+         vt == Vertex_EQMDiffuseRefl ||
+         vt == Vertex_ExtrapolPressure1ST ||
+         vt == Vertex_ExtrapolPressure2ND
+         );
+    for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+        Real rho{0};
+        Real u{0};
+        Real v{0};
+        if (vt != Vertex_ImmersedSolid) {
+            for (int xiIndex = COMPOINDEX[2 * compoIndex];
+                 xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+                int cx = (int)XI[xiIndex * LATTDIM];
+                int cy = (int)XI[xiIndex * LATTDIM + 1];
+                const Real fi{f[OPS_ACC_MD3(OPP[xiIndex], -cx, -cy)]};
+                rho += fi;
+                u += CS * XI[xiIndex * LATTDIM] * fi;
+                v += CS * XI[xiIndex * LATTDIM + 1] * fi;
+            }
+            u /= rho;
+            v /= rho;
+            for (int m = VARIABLECOMPPOS[2 * compoIndex];
+                 m <= VARIABLECOMPPOS[2 * compoIndex + 1]; m++) {
+                VariableTypes varType = (VariableTypes)VARIABLETYPE[m];
+                switch (varType) {
+                    case Variable_Rho:
+                        macroVars[OPS_ACC_MD4(m, 0, 0)] = rho;
+                        break;
+                    case Variable_U:
+                        macroVars[OPS_ACC_MD4(m, 0, 0)] = u;
+                        break;
+                    case Variable_V:
+                        macroVars[OPS_ACC_MD4(m, 0, 0)] = v;
+                        break;
+                    default:
+#ifdef CPU
+                        ops_printf(
+                            "Error! The AA stream-collision scheme only "
+                            "supports the variables [rho,u,v]!\n");
+                        assert(false);
+#endif
+                        break;
+                }
+            }
+        }
+#ifdef CPU
+        if (collisionRequired &&
+            Equilibrium_BGKIsothermal2nd != EQUILIBRIUMTYPE[compoIndex]) {
+            ops_printf(
+                "Error! The AA stream-collision scheme only supports "
+                "the isothermal BGK equilibrium!\n");
+            assert(Equilibrium_BGKIsothermal2nd ==
+                   EQUILIBRIUMTYPE[compoIndex]);
+        }
+#endif
+        const Real tau{collisionRequired ? tauRef[compoIndex] / rho : 0};
+        const Real dtOvertauPlusdt{
+            collisionRequired ? (*dt) / (tau + 0.5 * (*dt)) : 0};
+        // f_i is read from (OPP[i], x-c_i) and written to (i, x+c_i), which
+        // is where f_OPP[i] is read from, hence the pairwise update
+        for (int xiIndex = COMPOINDEX[2 * compoIndex];
+             xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+            const int oppIndex{OPP[xiIndex]};
+            if (oppIndex < xiIndex) {
+                continue;
+            }
+            int cx = (int)XI[xiIndex * LATTDIM];
+            int cy = (int)XI[xiIndex * LATTDIM + 1];
+            Real fi{f[OPS_ACC_MD3(oppIndex, -cx, -cy)]};
+            Real fOpp{f[OPS_ACC_MD3(xiIndex, cx, cy)]};
+            if (collisionRequired) {
+                fi -= dtOvertauPlusdt *
+                      (fi - CalcBGKFeq(xiIndex, rho, u, v, 1, 2));
+                fOpp -= dtOvertauPlusdt *
+                        (fOpp - CalcBGKFeq(oppIndex, rho, u, v, 1, 2));
+            }
+            f[OPS_ACC_MD3(xiIndex, cx, cy)] = fi;
+            f[OPS_ACC_MD3(oppIndex, -cx, -cy)] = fOpp;
+        }
     }
 }
+
 void KerStream(const int* nodeType, const int* geometry, const Real* fStage,
                Real* f) {
     //ops_printf("Inside stream kernel!!!!!. \n");
@@ -102,139 +405,82 @@ void KerStream(const int* nodeType, const int* geometry, const Real* fStage,
                         continue;
                     }
                 }
-                switch (vg) {
-                    case VG_IP:
-                        // (cx=0 means stream is implemented at i=0,so here we
-                        //  disable the step at boundary)
-                        if (streamRequired) {
-                            if (cx <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                            }
-                        } else {
-                            if (cx < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                            }
-                        }
-                        break;
-                    case VG_IM:
-                        if (streamRequired) {
-                            if (cx >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                            }
-                        } else {
-                            if (cx > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                            }
-                        }
-                        break;
-                    case VG_JP:
-                        if (streamRequired) {
-                            if (cy <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                            }
-                        } else {
-                            if (cy < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                            }
-                        }
-                        break;
-                    case VG_JM:
-                        if (streamRequired) {
-                            if (cy >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                            }
-                        } else {
-                            if (cy > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                            }
-                        }
-                        break;
-                    case VG_IPJP_I:
-                        if (streamRequired) {
-                            if (cy <= 0 && cx <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                            }
-                        } else {
-                            if (cy < 0 && cx < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                            }
-                        }
-                        break;
-                    case VG_IPJM_I:
-                        if (streamRequired) {
-                            if (cy >= 0 && cx <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                            }
-                        } else {
-                            if (cy > 0 && cx < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                            }
-                        }
-                        break;
-                    case VG_IMJP_I:
-                        if (streamRequired) {
-                            if (cy <= 0 && cx >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                            }
-                        } else {
-                            if (cy < 0 && cx > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                            }
-                        }
-                        break;
-                    case VG_IMJM_I:
-                        if (streamRequired) {
-                            if (cy >= 0 && cx >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                            }
-                        } else {
-                            if (cy > 0 && cx > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                            }
-                        }
-                        break;
-                    case VG_IPJP_O:
-                        if (cy < 0 || cx < 0) {
-                            f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                        }
-                        break;
-                    case VG_IPJM_O:
-                        if (cy > 0 || cx < 0) {
-                            f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                        }
-                        break;
-                    case VG_IMJP_O:
-                        if (cy < 0 || cx > 0) {
-                            f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                        }
-                        break;
-                    case VG_IMJM_O:
-                        if (cy > 0 || cx > 0) {
-                            f[OPS_ACC_MD3(xiIndex, 0, 0)] =
-                                fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
-                        }
-                        break;
-                    default:
-                        break;
+                if (IsStreamedAtBoundary(vg, streamRequired, cx, cy)) {
+                    f[OPS_ACC_MD3(xiIndex, 0, 0)] =
+                        fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
+                }
+            }
+        }
+    }
+}
+
+template <typename Lattice>
+void KerCollideLattice(const Real* dt, const int* nodeType, const Real* f,
+                       const Real* feq, const Real* relaxationTime,
+                       const Real* bodyForce, Real* fStage) {
+    VertexTypes vt = (VertexTypes)nodeType[OPS_ACC1(0, 0)];
+    bool collisionRequired =
+        (vt == Vertex_Fluid ||
+         vt == Vertex_ZouHeVelocity ||
+         vt == Vertex_EQMDiffuseRefl ||
+         vt == Vertex_ExtrapolPressure1ST ||
+         vt == Vertex_ExtrapolPressure2ND
+         );
+    for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+        const int xiStart{COMPOINDEX[2 * compoIndex]};
+        if (collisionRequired) {
+            Real tau = relaxationTime[OPS_ACC_MD4(compoIndex, 0, 0)];
+            Real dtOvertauPlusdt = (*dt) / (tau + 0.5 * (*dt));
+            for (int l = 0; l < Lattice::Q; l++) {
+                const int xiIndex{xiStart + l};
+                fStage[OPS_ACC_MD6(xiIndex, 0, 0)] =
+                    f[OPS_ACC_MD2(xiIndex, 0, 0)] -
+                    dtOvertauPlusdt * (f[OPS_ACC_MD2(xiIndex, 0, 0)] -
+                                       feq[OPS_ACC_MD3(xiIndex, 0, 0)]) +
+                    tau * dtOvertauPlusdt *
+                        bodyForce[OPS_ACC_MD5(xiIndex, 0, 0)];
+            }
+        } else {
+            for (int l = 0; l < Lattice::Q; l++) {
+                fStage[OPS_ACC_MD6(xiStart + l, 0, 0)] =
+                    f[OPS_ACC_MD2(xiStart + l, 0, 0)];
+            }
+        }
+    }
+}
+
+template <typename Lattice>
+void KerStreamLattice(const int* nodeType, const int* geometry,
+                      const Real* fStage, Real* f) {
+    VertexTypes vt = (VertexTypes)nodeType[OPS_ACC0(0, 0)];
+    VertexGeometryTypes vg = (VertexGeometryTypes)geometry[OPS_ACC1(0, 0)];
+    for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+        const int xiStart{COMPOINDEX[2 * compoIndex]};
+        if ((vt >= Vertex_Fluid) && (vt < Vertex_Boundary)) {
+            for (int l = 0; l < Lattice::Q; l++) {
+                f[OPS_ACC_MD3(xiStart + l, 0, 0)] = fStage[OPS_ACC_MD2(
+                    xiStart + l, -Lattice::CX[l], -Lattice::CY[l])];
+            }
+        }
+        if (vt >= Vertex_Boundary) {
+            bool streamRequired =
+                (vt == Vertex_ZouHeVelocity ||
+                 vt == Vertex_EQMDiffuseRefl ||
+                 vt == Vertex_ExtrapolPressure1ST ||
+                 vt == Vertex_ExtrapolPressure2ND
+                 );
+            for (int l = 0; l < Lattice::Q; l++) {
+                const int xiIndex{xiStart + l};
+                const int cx{Lattice::CX[l]};
+                const int cy{Lattice::CY[l]};
+                if (streamRequired && (cx == 0) && (cy == 0)) {
+                    f[OPS_ACC_MD3(xiIndex, 0, 0)] =
+                        fStage[OPS_ACC_MD2(xiIndex, 0, 0)];
+                    continue;
+                }
+                if (IsStreamedAtBoundary(vg, streamRequired, cx, cy)) {
+                    f[OPS_ACC_MD3(xiIndex, 0, 0)] =
+                        fStage[OPS_ACC_MD2(xiIndex, -cx, -cy)];
                 }
             }
         }
@@ -983,34 +1229,28 @@ void KerCutCellExplicitTimeMach(const Real* dt, const Real* schemeCoeff,
 #endif
 #ifdef OPS_3D  // three dimensional code
 
-void KerCollide3D(const Real* dt, const int* nodeType, const Real* f,
-                  const Real* feq, const Real* relaxationTime,
-                  const Real* bodyForce, Real* fStage) {
+void KerCollide3D(const Real* dt, const short* nodeFlag, const FReal* f,
+                  const FReal* feq, const Real* relaxationTime,
+                  const Real* bodyForce, FReal* fStage) {
     for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
         // collisionRequired: means if collision is required at boundary
         // e.g., the ZouHe boundary condition explicitly requires collision
-        VertexTypes vt =
-            (VertexTypes)nodeType[OPS_ACC_MD1(compoIndex, 0, 0, 0)];
-        bool collisionRequired =
-            (vt == Vertex_Fluid ||
-             vt == Vertex_ZouHeVelocity ||
-             vt == Vertex_EQMDiffuseRefl ||
-             vt == Vertex_ExtrapolPressure1ST ||
-              vt == Vertex_Periodic
-              );
+        const short flag{nodeFlag[OPS_ACC_MD1(compoIndex, 0, 0, 0)]};
+        const bool collisionRequired{(flag & NodeFlag_Collide) != 0};
         if (collisionRequired) {
             Real tau = relaxationTime[OPS_ACC_MD4(compoIndex, 0, 0, 0)];
             Real dtOvertauPlusdt = (*dt) / (tau + 0.5 * (*dt));
             for (int xiIndex = COMPOINDEX[2 * compoIndex];
                  xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
-                fStage[OPS_ACC_MD6(xiIndex, 0, 0, 0)] =
-                    f[OPS_ACC_MD2(xiIndex, 0, 0, 0)] -
-                    dtOvertauPlusdt * (f[OPS_ACC_MD2(xiIndex, 0, 0, 0)] -
-                                       feq[OPS_ACC_MD3(xiIndex, 0, 0, 0)]) +
-                    tau * dtOvertauPlusdt *
-                        bodyForce[OPS_ACC_MD5(xiIndex, 0, 0, 0)];
+                const Real fi{f[OPS_ACC_MD2(xiIndex, 0, 0, 0)] +
+                              FOffset(xiIndex)};
+                const Real feqi{feq[OPS_ACC_MD3(xiIndex, 0, 0, 0)] +
+                                FOffset(xiIndex)};
+                const Real res{fi - dtOvertauPlusdt * (fi - feqi) +
+                               tau * dtOvertauPlusdt *
+                                   bodyForce[OPS_ACC_MD5(xiIndex, 0, 0, 0)]};
+                fStage[OPS_ACC_MD6(xiIndex, 0, 0, 0)] = res - FOffset(xiIndex);
 #ifdef CPU
-                const Real res{fStage[OPS_ACC_MD6(xiIndex, 0, 0, 0)]};
                 if (isnan(res) || res <= 0 || isinf(res)) {
                     ops_printf(
                         "Error! Distribution function %f becomes "
@@ -1021,662 +1261,574 @@ void KerCollide3D(const Real* dt, const int* nodeType, const Real* f,
                 }
 #endif
             }
+        } else {
+            // e.g., bounce-back and solid nodes, fStage is simply f so that
+            // the stream step can work without copying the whole field
+            for (int xiIndex = COMPOINDEX[2 * compoIndex];
+                 xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+                fStage[OPS_ACC_MD6(xiIndex, 0, 0, 0)] =
+                    f[OPS_ACC_MD2(xiIndex, 0, 0, 0)];
+            }
         }
     }
 }
 
-void KerStream3D(const int* nodeType, const int* geometry, const Real* fStage,
-                 Real* f) {
-    VertexGeometryTypes vg = (VertexGeometryTypes)geometry[OPS_ACC1(0, 0, 0)];
+void KerCollideOnTheFly3D(const Real* dt, const short* nodeFlag, const FReal* f,
+                          const Real* macroVars, const Real* relaxationTime,
+                          FReal* fStage) {
+    // here we assume the force is constant, consistent with
+    // KerCalcBodyForce3D
+    const Real g[]{0.0001, 0, 0};
     for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
-        VertexTypes vt = (VertexTypes)nodeType[OPS_ACC_MD0(compoIndex,0, 0, 0)];
-        for (int xiIndex = COMPOINDEX[2 * compoIndex];
-             xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
-            int cx = (int)XI[xiIndex * LATTDIM];
-            int cy = (int)XI[xiIndex * LATTDIM + 1];
-            int cz = (int)XI[xiIndex * LATTDIM + 2];
-            if ((vt >= Vertex_Fluid) && (vt < Vertex_Boundary)) {
-                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
+        const short flag{nodeFlag[OPS_ACC_MD1(compoIndex, 0, 0, 0)]};
+        const bool collisionRequired{(flag & NodeFlag_Collide) != 0};
+        if (collisionRequired) {
+            EquilibriumType equilibriumType{
+                (EquilibriumType)EQUILIBRIUMTYPE[compoIndex]};
+            const int startPos{VARIABLECOMPPOS[2 * compoIndex]};
+            const Real rho{macroVars[OPS_ACC_MD3(startPos, 0, 0, 0)]};
+            const Real u{macroVars[OPS_ACC_MD3(startPos + 1, 0, 0, 0)]};
+            const Real v{macroVars[OPS_ACC_MD3(startPos + 2, 0, 0, 0)]};
+            const Real w{macroVars[OPS_ACC_MD3(startPos + 3, 0, 0, 0)]};
+            Real T{1};
+            int polyOrder{2};
+            switch (equilibriumType) {
+                case Equilibrium_BGKIsothermal2nd:
+                    break;
+                case Equilibrium_BGKThermal4th: {
+                    T = macroVars[OPS_ACC_MD3(startPos + 4, 0, 0, 0)];
+                    polyOrder = 4;
+                } break;
+                default:
+#ifdef CPU
+                    ops_printf(
+                        "Error! We don't deal with the chosen type of "
+                        "equilibrium function at this moment!\n");
+                    assert(false);
+#endif
+                    break;
             }
-            if (vt >= Vertex_Boundary) {
-                // streamRequired: means if the particles with velocity parallel
-                // needs to be streamed at the boundary
-                bool streamRequired =
-                    (
-                     vt == Vertex_EQMDiffuseRefl ||
-                     vt == Vertex_ExtrapolPressure1ST ||
-                     vt == Vertex_Periodic
-                     );
-                if (streamRequired) {
-                    if ((cx == 0) && (cy == 0) && (cz == 0)) {
-                        f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                            fStage[OPS_ACC_MD2(xiIndex, 0, 0, 0)];
-                        continue;
-                    }
+            const bool forceRequired{BodyForce_1st == FORCETYPE[compoIndex]};
+            Real tau = relaxationTime[OPS_ACC_MD4(compoIndex, 0, 0, 0)];
+            Real dtOvertauPlusdt = (*dt) / (tau + 0.5 * (*dt));
+            for (int xiIndex = COMPOINDEX[2 * compoIndex];
+                 xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+                const Real fi{f[OPS_ACC_MD2(xiIndex, 0, 0, 0)] +
+                              FOffset(xiIndex)};
+                const Real feq{
+                    CalcBGKFeq(xiIndex, rho, u, v, w, T, polyOrder)};
+                Real res{fi - dtOvertauPlusdt * (fi - feq)};
+                if (forceRequired) {
+                    res += tau * dtOvertauPlusdt *
+                           CalcBodyForce(xiIndex, rho, g);
                 }
-                switch (vg) {
-                        // faces six types
-                    case VG_IP:
-                        // (cx=0 means stream is implemented at i=0,so here we
-                        //  disable the step at boundary)
-                        if (streamRequired) {
-                            if (cx <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cx < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IM:
-                        if (streamRequired) {
-                            if (cx >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cx > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_JP:
-                        if (streamRequired) {
-                            if (cy <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cy < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_JM:
-                        if (streamRequired) {
-                            if (cy >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cy > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_KP:
-                        // (cx=0 means stream is implemented at i=0,so here we
-                        //  disable the step at boundary)
-                        if (streamRequired) {
-                            if (cz <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cz < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_KM:
-                        if (streamRequired) {
-                            if (cz >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
+                fStage[OPS_ACC_MD5(xiIndex, 0, 0, 0)] = res - FOffset(xiIndex);
+#ifdef CPU
+                if (isnan(res) || res <= 0 || isinf(res)) {
+                    ops_printf(
+                        "Error! Distribution function %f becomes "
+                        "invalid for the component %i at  the lattice "
+                        "%i\n",
+                        res, compoIndex, xiIndex);
+                    assert(!(isnan(res) || res <= 0 || isinf(res)));
+                }
+#endif
+            }
+        } else {
+            for (int xiIndex = COMPOINDEX[2 * compoIndex];
+                 xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+                fStage[OPS_ACC_MD5(xiIndex, 0, 0, 0)] =
+                    f[OPS_ACC_MD2(xiIndex, 0, 0, 0)];
+            }
+        }
+    }
+}
 
-                        } else {
-                            if (cz > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    // faces six types end
-                    // 12 edges
-                    case VG_IPJP_I:
-                        if (streamRequired) {
-                            if (cy <= 0 && cx <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cy < 0 && cx < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IPJM_I:
-                        if (streamRequired) {
-                            if (cy >= 0 && cx <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cy > 0 && cx < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IMJP_I:
-                        if (streamRequired) {
-                            if (cy <= 0 && cx >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cy < 0 && cx > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IMJM_I:
-                        if (streamRequired) {
-                            if (cy >= 0 && cx >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cy > 0 && cx > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    // k
-                    case VG_IPKP_I:
-                        if (streamRequired) {
-                            if (cz <= 0 && cx <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cz < 0 && cx < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IPKM_I:
-                        if (streamRequired) {
-                            if (cz >= 0 && cx <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cz > 0 && cx < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IMKP_I:
-                        if (streamRequired) {
-                            if (cz <= 0 && cx >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cz < 0 && cx > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IMKM_I:
-                        if (streamRequired) {
-                            if (cz >= 0 && cx >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cz > 0 && cx > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_JPKP_I:
-                        if (streamRequired) {
-                            if (cz <= 0 && cy <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cz < 0 && cy < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_JPKM_I:
-                        if (streamRequired) {
-                            if (cz >= 0 && cy <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cz > 0 && cy < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_JMKP_I:
-                        if (streamRequired) {
-                            if (cz <= 0 && cy >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cz < 0 && cy > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_JMKM_I:
-                        if (streamRequired) {
-                            if (cz >= 0 && cy >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cz > 0 && cy > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    // K
-                    // k_out
-                    case VG_IPJP_O:
-                        if (streamRequired) {
-                            if (cy <= 0 || cx <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cy < 0 || cx < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IPJM_O:
-                        if (streamRequired) {
-                            if (cy >= 0 || cx <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cy > 0 || cx < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IMJP_O:
-                        if (streamRequired) {
-                            if (cy <= 0 || cx >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cy < 0 || cx > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IMJM_O:
-                        if (streamRequired) {
-                            if (cy >= 0 || cx >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cy > 0 || cx > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                        // IK
-                    case VG_IPKP_O:
-                        if (streamRequired) {
-                            if (cz <= 0 || cx <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cz < 0 || cx < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IPKM_O:
-                        if (streamRequired) {
-                            if (cz >= 0 || cx <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cz > 0 || cx < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IMKP_O:
-                        if (streamRequired) {
-                            if (cz <= 0 || cx >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cz < 0 || cx > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IMKM_O:
-                        if (streamRequired) {
-                            if (cz >= 0 || cx >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cz > 0 || cx > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                        // JK
-                    case VG_JPKP_O:
-                        if (streamRequired) {
-                            if (cz <= 0 || cy <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cz < 0 || cy < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_JPKM_O:
-                        if (streamRequired) {
-                            if (cz >= 0 || cy <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cz > 0 || cy < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_JMKP_O:
-                        if (streamRequired) {
-                            if (cz <= 0 || cy >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cz < 0 || cy > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_JMKM_O:
-                        if (streamRequired) {
-                            if (cz >= 0 || cy >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cz > 0 || cy > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    // k_out end
-                    // 12 edges end
-                    // 8 corners
-                    // inner corners
-                    case VG_IPJPKP_I:
-                        if (streamRequired) {
-                            if (cx <= 0 && cy <= 0 && cz <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cx < 0 && cy < 0 && cz < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IPJPKM_I:
-                        if (streamRequired) {
-                            if (cx <= 0 && cy <= 0 && cz >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cx < 0 && cy < 0 && cz > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IPJMKP_I:
-                        if (streamRequired) {
-                            if (cx <= 0 && cy >= 0 && cz <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cx < 0 && cy > 0 && cz < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IPJMKM_I:
-                        if (streamRequired) {
-                            if (cx <= 0 && cy >= 0 && cz >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cx < 0 && cy > 0 && cz > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IMJPKP_I:
-                        if (streamRequired) {
-                            if (cx >= 0 && cy <= 0 && cz <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cx > 0 && cy < 0 && cz < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IMJPKM_I:
-                        if (streamRequired) {
-                            if (cx >= 0 && cy <= 0 && cz >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cx > 0 && cy < 0 && cz > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IMJMKP_I:
-                        if (streamRequired) {
-                            if (cx >= 0 && cy >= 0 && cz <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cx > 0 && cy > 0 && cz < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IMJMKM_I:
-                        if (streamRequired) {
-                            if (cx >= 0 && cy >= 0 && cz >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cx > 0 && cy > 0 && cz > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    // out corner
-                    case VG_IPJPKP_O:
-                        if (streamRequired) {
-                            if (cx <= 0 || cy <= 0 || cz <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cx < 0 || cy < 0 || cz < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IPJPKM_O:
-                        if (streamRequired) {
-                            if (cx <= 0 || cy <= 0 || cz >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cx < 0 || cy < 0 || cz > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IPJMKP_O:
-                        if (streamRequired) {
-                            if (cx <= 0 || cy >= 0 || cz <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cx < 0 || cy > 0 || cz < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IPJMKM_O:
-                        if (streamRequired) {
-                            if (cx <= 0 || cy >= 0 || cz >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cx < 0 || cy > 0 || cz > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IMJPKP_O:
-                        if (streamRequired) {
-                            if (cx >= 0 || cy <= 0 || cz <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cx > 0 || cy < 0 || cz < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IMJPKM_O:
-                        if (streamRequired) {
-                            if (cx >= 0 || cy <= 0 || cz >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cx > 0 || cy < 0 || cz > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
-                        break;
-                    case VG_IMJMKP_O:
-                        if (streamRequired) {
-                            if (cx >= 0 || cy >= 0 || cz <= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cx > 0 || cy > 0 || cz < 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
+void KerCollideFused3D(const Real* dt, const short* nodeFlag,
+                       const Real* tauRef, const FReal* f, Real* macroVars,
+                       FReal* fStage) {
+    // here we assume the force is constant, consistent with
+    // KerCalcBodyForce3D and KerCalcMacroVars3D
+    const Real g[]{0.0001, 0, 0};
+    for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+        const short flag{nodeFlag[OPS_ACC_MD1(compoIndex, 0, 0, 0)]};
+        const VertexTypes vt{FlagVertexType(flag)};
+        const bool collisionRequired{(flag & NodeFlag_Collide) != 0};
+        Real rho{0};
+        Real velo[]{0, 0, 0};
+        if (vt != Vertex_ImmersedSolid) {
+            for (int xiIndex = COMPOINDEX[2 * compoIndex];
+                 xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+                const Real fi{f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] +
+                              FOffset(xiIndex)};
+                rho += fi;
+                velo[0] += CS * XI[xiIndex * LATTDIM] * fi;
+                velo[1] += CS * XI[xiIndex * LATTDIM + 1] * fi;
+                velo[2] += CS * XI[xiIndex * LATTDIM + 2] * fi;
+            }
+#ifdef CPU
+            if (isnan(rho) || rho <= 0 || isinf(rho)) {
+                ops_printf(
+                    "Error! Density %f becomes invalid for the component "
+                    "%i\n",
+                    rho, compoIndex);
+                assert(!(isnan(rho) || rho <= 0 || isinf(rho)));
+            }
+#endif
+            for (int d = 0; d < 3; d++) {
+                velo[d] /= rho;
+            }
+            for (int m = VARIABLECOMPPOS[2 * compoIndex];
+                 m <= VARIABLECOMPPOS[2 * compoIndex + 1]; m++) {
+                VariableTypes varType = (VariableTypes)VARIABLETYPE[m];
+                switch (varType) {
+                    case Variable_Rho:
+                        macroVars[OPS_ACC_MD4(m, 0, 0, 0)] = rho;
+                        break;
+                    case Variable_U:
+                    case Variable_V:
+                    case Variable_W: {
+                        const int d{varType - Variable_U};
+                        macroVars[OPS_ACC_MD4(m, 0, 0, 0)] = velo[d];
+                    } break;
+                    case Variable_U_Force:
+                    case Variable_V_Force:
+                    case Variable_W_Force: {
+                        const int d{varType - Variable_U_Force};
+                        if (Vertex_Fluid == vt) {
+                            velo[d] += (*dt) * g[d] / 2;
+                        }
+                        macroVars[OPS_ACC_MD4(m, 0, 0, 0)] = velo[d];
+                    } break;
+                    default:
+#ifdef CPU
+                        ops_printf(
+                            "Error! The fused stream-collision scheme only "
+                            "supports the variables [rho,u,v,w]!\n");
+                        assert(false);
+#endif
                         break;
-                    case VG_IMJMKM_O:
-                        if (streamRequired) {
-                            if (cx >= 0 || cy >= 0 || cz >= 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        } else {
-                            if (cx > 0 || cy > 0 || cz > 0) {
-                                f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] =
-                                    fStage[OPS_ACC_MD2(xiIndex, -cx, -cy, -cz)];
-                            }
-                        }
+                }
+            }
+        }
+        if (collisionRequired) {
+#ifdef CPU
+            if (Equilibrium_BGKIsothermal2nd != EQUILIBRIUMTYPE[compoIndex]) {
+                ops_printf(
+                    "Error! The fused stream-collision scheme only supports "
+                    "the isothermal BGK equilibrium!\n");
+                assert(Equilibrium_BGKIsothermal2nd ==
+                       EQUILIBRIUMTYPE[compoIndex]);
+            }
+#endif
+            const bool forceRequired{BodyForce_1st == FORCETYPE[compoIndex]};
+            const Real tau{tauRef[compoIndex] / rho};
+            const Real dtOvertauPlusdt = (*dt) / (tau + 0.5 * (*dt));
+            for (int xiIndex = COMPOINDEX[2 * compoIndex];
+                 xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+                const Real fi{f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] +
+                              FOffset(xiIndex)};
+                const Real feq{CalcBGKFeq(xiIndex, rho, velo[0], velo[1],
+                                          velo[2], 1, 2)};
+                Real res{fi - dtOvertauPlusdt * (fi - feq)};
+                if (forceRequired) {
+                    res += tau * dtOvertauPlusdt *
+                           CalcBodyForce(xiIndex, rho, g);
+                }
+                fStage[OPS_ACC_MD5(xiIndex, 0, 0, 0)] = res - FOffset(xiIndex);
+#ifdef CPU
+                if (isnan(res) || res <= 0 || isinf(res)) {
+                    ops_printf(
+                        "Error! Distribution function %f becomes "
+                        "invalid for the component %i at  the lattice "
+                        "%i\n",
+                        res, compoIndex, xiIndex);
+                    assert(!(isnan(res) || res <= 0 || isinf(res)));
+                }
+#endif
+            }
+        } else {
+            for (int xiIndex = COMPOINDEX[2 * compoIndex];
+                 xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+                fStage[OPS_ACC_MD5(xiIndex, 0, 0, 0)] =
+                    f[OPS_ACC_MD3(xiIndex, 0, 0, 0)];
+            }
+        }
+    }
+}
+
+void KerCollideAAEven3D(const Real* dt, const short* nodeFlag,
+                        const Real* tauRef, FReal* f, Real* macroVars) {
+    // here we assume the force is constant, consistent with
+    // KerCalcBodyForce3D and KerCalcMacroVars3D
+    const Real g[]{0.0001, 0, 0};
+    for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+        const short flag{nodeFlag[OPS_ACC_MD1(compoIndex, 0, 0, 0)]};
+        const VertexTypes vt{FlagVertexType(flag)};
+        const bool collisionRequired{(flag & NodeFlag_Collide) != 0};
+        Real rho{0};
+        Real velo[]{0, 0, 0};
+        if (vt != Vertex_ImmersedSolid) {
+            for (int xiIndex = COMPOINDEX[2 * compoIndex];
+                 xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+                const Real fi{f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] +
+                              FOffset(xiIndex)};
+                rho += fi;
+                velo[0] += CS * XI[xiIndex * LATTDIM] * fi;
+                velo[1] += CS * XI[xiIndex * LATTDIM + 1] * fi;
+                velo[2] += CS * XI[xiIndex * LATTDIM + 2] * fi;
+            }
+#ifdef CPU
+            if (isnan(rho) || rho <= 0 || isinf(rho)) {
+                ops_printf(
+                    "Error! Density %f becomes invalid for the component "
+                    "%i\n",
+                    rho, compoIndex);
+                assert(!(isnan(rho) || rho <= 0 || isinf(rho)));
+            }
+#endif
+            for (int d = 0; d < 3; d++) {
+                velo[d] /= rho;
+            }
+            for (int m = VARIABLECOMPPOS[2 * compoIndex];
+                 m <= VARIABLECOMPPOS[2 * compoIndex + 1]; m++) {
+                VariableTypes varType = (VariableTypes)VARIABLETYPE[m];
+                switch (varType) {
+                    case Variable_Rho:
+                        macroVars[OPS_ACC_MD4(m, 0, 0, 0)] = rho;
+                        break;
+                    case Variable_U:
+                    case Variable_V:
+                    case Variable_W: {
+                        const int d{varType - Variable_U};
+                        macroVars[OPS_ACC_MD4(m, 0, 0, 0)] = velo[d];
+                    } break;
+                    case Variable_U_Force:
+                    case Variable_V_Force:
+                    case Variable_W_Force: {
+                        const int d{varType - Variable_U_Force};
+                        if (Vertex_Fluid == vt) {
+                            velo[d] += (*dt) * g[d] / 2;
+                        }
+                        macroVars[OPS_ACC_MD4(m, 0, 0, 0)] = velo[d];
+                    } break;
+                    default:
+#ifdef CPU
+                        ops_printf(
+                            "Error! The AA stream-collision scheme only "
+                            "supports the variables [rho,u,v,w]!\n");
+                        assert(false);
+#endif
                         break;
+                }
+            }
+        }
+#ifdef CPU
+        if (collisionRequired &&
+            Equilibrium_BGKIsothermal2nd != EQUILIBRIUMTYPE[compoIndex]) {
+            ops_printf(
+                "Error! The AA stream-collision scheme only supports "
+                "the isothermal BGK equilibrium!\n");
+            assert(Equilibrium_BGKIsothermal2nd ==
+                   EQUILIBRIUMTYPE[compoIndex]);
+        }
+#endif
+        const bool forceRequired{collisionRequired &&
+                                 BodyForce_1st == FORCETYPE[compoIndex]};
+        const Real tau{collisionRequired ? tauRef[compoIndex] / rho : 0};
+        const Real dtOvertauPlusdt{
+            collisionRequired ? (*dt) / (tau + 0.5 * (*dt)) : 0};
+        // f_i and f_OPP[i] are updated as a pair so that the swap is in place
+        for (int xiIndex = COMPOINDEX[2 * compoIndex];
+             xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+            const int oppIndex{OPP[xiIndex]};
+            if (oppIndex < xiIndex) {
+                continue;
+            }
+            Real fi{f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] + FOffset(xiIndex)};
+            Real fOpp{f[OPS_ACC_MD3(oppIndex, 0, 0, 0)] + FOffset(oppIndex)};
+            if (collisionRequired) {
+                fi -= dtOvertauPlusdt *
+                      (fi - CalcBGKFeq(xiIndex, rho, velo[0], velo[1],
+                                       velo[2], 1, 2));
+                fOpp -= dtOvertauPlusdt *
+                        (fOpp - CalcBGKFeq(oppIndex, rho, velo[0], velo[1],
+                                           velo[2], 1, 2));
+            }
+            if (forceRequired) {
+                fi += tau * dtOvertauPlusdt * CalcBodyForce(xiIndex, rho, g);
+                fOpp +=
+                    tau * dtOvertauPlusdt * CalcBodyForce(oppIndex, rho, g);
+            }
+            f[OPS_ACC_MD3(oppIndex, 0, 0, 0)] = fi - FOffset(xiIndex);
+            f[OPS_ACC_MD3(xiIndex, 0, 0, 0)] = fOpp - FOffset(oppIndex);
+        }
+    }
+}
+
+void KerStreamCollideAAOdd3D(const Real* dt, const short* nodeFlag,
+                             const Real* tauRef, FReal* f, Real* macroVars) {
+    // here we assume the force is constant, consistent with
+    // KerCalcBodyForce3D and KerCalcMacroVars3D
+    const Real g[]{0.0001, 0, 0};
+    for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+        const short flag{nodeFlag[OPS_ACC_MD1(compoIndex, 0, 0, 0)]};
+        const VertexTypes vt{FlagVertexType(flag)};
+        const bool collisionRequired{(flag & NodeFlag_Collide) != 0};
+        Real rho{0};
+        Real velo[]{0, 0, 0};
+        if (vt != Vertex_ImmersedSolid) {
+            for (int xiIndex = COMPOINDEX[2 * compoIndex];
+                 xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+                const int cx{(int)XI[xiIndex * LATTDIM]};
+                const int cy{(int)XI[xiIndex * LATTDIM + 1]};
+                const int cz{(int)XI[xiIndex * LATTDIM + 2]};
+                const Real fi{f[OPS_ACC_MD3(OPP[xiIndex], -cx, -cy, -cz)] +
+                              FOffset(xiIndex)};
+                rho += fi;
+                velo[0] += CS * XI[xiIndex * LATTDIM] * fi;
+                velo[1] += CS * XI[xiIndex * LATTDIM + 1] * fi;
+                velo[2] += CS * XI[xiIndex * LATTDIM + 2] * fi;
+            }
+#ifdef CPU
+            if (isnan(rho) || rho <= 0 || isinf(rho)) {
+                ops_printf(
+                    "Error! Density %f becomes invalid for the component "
+                    "%i\n",
+                    rho, compoIndex);
+                assert(!(isnan(rho) || rho <= 0 || isinf(rho)));
+            }
+#endif
+            for (int d = 0; d < 3; d++) {
+                velo[d] /= rho;
+            }
+            for (int m = VARIABLECOMPPOS[2 * compoIndex];
+                 m <= VARIABLECOMPPOS[2 * compoIndex + 1]; m++) {
+                VariableTypes varType = (VariableTypes)VARIABLETYPE[m];
+                switch (varType) {
+                    case Variable_Rho:
+                        macroVars[OPS_ACC_MD4(m, 0, 0, 0)] = rho;
+                        break;
+                    case Variable_U:
+                    case Variable_V:
+                    case Variable_W: {
+                        const int d{varType - Variable_U};
+                        macroVars[OPS_ACC_MD4(m, 0, 0, 0)] = velo[d];
+                    } break;
+                    case Variable_U_Force:
+                    case Variable_V_Force:
+                    case Variable_W_Force: {
+                        const int d{varType - Variable_U_Force};
+                        if (Vertex_Fluid == vt) {
+                            velo[d] += (*dt) * g[d] / 2;
+                        }
+                        macroVars[OPS_ACC_MD4(m, 0, 0, 0)] = velo[d];
+                    } break;
                     default:
+#ifdef CPU
+                        ops_printf(
+                            "Error! The AA stream-collision scheme only "
+                            "supports the variables [rho,u,v,w]!\n");
+                        assert(false);
+#endif
                         break;
                 }
             }
         }
+#ifdef CPU
+        if (collisionRequired &&
+            Equilibrium_BGKIsothermal2nd != EQUILIBRIUMTYPE[compoIndex]) {
+            ops_printf(
+                "Error! The AA stream-collision scheme only supports "
+                "the isothermal BGK equilibrium!\n");
+            assert(Equilibrium_BGKIsothermal2nd ==
+                   EQUILIBRIUMTYPE[compoIndex]);
+        }
+#endif
+        const bool forceRequired{collisionRequired &&
+                                 BodyForce_1st == FORCETYPE[compoIndex]};
+        const Real tau{collisionRequired ? tauRef[compoIndex] / rho : 0};
+        const Real dtOvertauPlusdt{
+            collisionRequired ? (*dt) / (tau + 0.5 * (*dt)) : 0};
+        // see KerStreamCollideAAOdd for the pairwise update
+        for (int xiIndex = COMPOINDEX[2 * compoIndex];
+             xiIndex <= COMPOINDEX[2 * compoIndex + 1]; xiIndex++) {
+            const int oppIndex{OPP[xiIndex]};
+            if (oppIndex < xiIndex) {
+                continue;
+            }
+            const int cx{(int)XI[xiIndex * LATTDIM]};
+            const int cy{(int)XI[xiIndex * LATTDIM + 1]};
+            const int cz{(int)XI[xiIndex * LATTDIM + 2]};
+            Real fi{f[OPS_ACC_MD3(oppIndex, -cx, -cy, -cz)] +
+                    FOffset(xiIndex)};
+            Real fOpp{f[OPS_ACC_MD3(xiIndex, cx, cy, cz)] + FOffset(oppIndex)};
+            if (collisionRequired) {
+                fi -= dtOvertauPlusdt *
+                      (fi - CalcBGKFeq(xiIndex, rho, velo[0], velo[1],
+                                       velo[2], 1, 2));
+                fOpp -= dtOvertauPlusdt *
+                        (fOpp - CalcBGKFeq(oppIndex, rho, velo[0], velo[1],
+                                           velo[2], 1, 2));
+            }
+            if (forceRequired) {
+                fi += tau * dtOvertauPlusdt * CalcBodyForce(xiIndex, rho, g);
+                fOpp +=
+                    tau * dtOvertauPlusdt * CalcBodyForce(oppIndex, rho, g);
+            }
+            f[OPS_ACC_MD3(xiIndex, cx, cy, cz)] = fi - FOffset(xiIndex);
+            f[OPS_ACC_MD3(oppIndex, -cx, -cy, -cz)] = fOpp - FOffset(oppIndex);
+        }
+    }
+}
+
+void KerStream3D(const int* streamMask, const FReal* fStage, FReal* f) {
+    for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+        const int mask{streamMask[OPS_ACC_MD0(compoIndex, 0, 0, 0)]};
+        const int xiStart{COMPOINDEX[2 * compoIndex]};
+        for (int xiIndex = xiStart; xiIndex <= COMPOINDEX[2 * compoIndex + 1];
+             xiIndex++) {
+            const int cx{(int)XI[xiIndex * LATTDIM]};
+            const int cy{(int)XI[xiIndex * LATTDIM + 1]};
+            const int cz{(int)XI[xiIndex * LATTDIM + 2]};
+            const bool isStreamed{((mask >> (xiIndex - xiStart)) & 1) != 0};
+            const FReal pulled{fStage[OPS_ACC_MD1(xiIndex, -cx, -cy, -cz)]};
+            const FReal kept{f[OPS_ACC_MD2(xiIndex, 0, 0, 0)]};
+            f[OPS_ACC_MD2(xiIndex, 0, 0, 0)] = isStreamed ? pulled : kept;
+        }
+    }
+}
+
+void KerStreamBulk3D(const FReal* fStage, FReal* f) {
+    for (int xiIndex = 0; xiIndex < NUMXI; xiIndex++) {
+        const int cx{(int)XI[xiIndex * LATTDIM]};
+        const int cy{(int)XI[xiIndex * LATTDIM + 1]};
+        const int cz{(int)XI[xiIndex * LATTDIM + 2]};
+        f[OPS_ACC_MD1(xiIndex, 0, 0, 0)] =
+            fStage[OPS_ACC_MD0(xiIndex, -cx, -cy, -cz)];
+    }
+}
+
+void KerSetStreamMask3D(const short* nodeFlag, int* streamMask) {
+    for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+        const short flag{nodeFlag[OPS_ACC_MD0(compoIndex, 0, 0, 0)]};
+        const VertexTypes vt{FlagVertexType(flag)};
+        const VertexGeometryTypes vg{FlagGeometry(flag)};
+        // streamRequired: means if the particles with velocity parallel
+        // needs to be streamed at the boundary
+        const bool streamRequired{(flag & NodeFlag_StreamParallel) != 0};
+        const int xiStart{COMPOINDEX[2 * compoIndex]};
+        int mask{0};
+        for (int xiIndex = xiStart; xiIndex <= COMPOINDEX[2 * compoIndex + 1];
+             xiIndex++) {
+            const int cx{(int)XI[xiIndex * LATTDIM]};
+            const int cy{(int)XI[xiIndex * LATTDIM + 1]};
+            const int cz{(int)XI[xiIndex * LATTDIM + 2]};
+            bool isStreamed{(flag & NodeFlag_Bulk) != 0};
+            if (vt >= Vertex_Boundary) {
+                // the rest population is "pulled" from the node itself
+                isStreamed =
+                    (streamRequired && 0 == cx && 0 == cy && 0 == cz) ||
+                    IsStreamedAtBoundary3D(vg, streamRequired, cx, cy, cz);
+            }
+            if (isStreamed) {
+                mask |= 1 << (xiIndex - xiStart);
+            }
+        }
+        streamMask[OPS_ACC_MD1(compoIndex, 0, 0, 0)] = mask;
+    }
+}
+
+void KerFindStreamTile3D(const int* tileSize, const int* tileNum,
+                         const short* nodeFlag, const int* idx,
+                         int* streamTile) {
+    bool isSolid{true};
+    bool isBulk{true};
+    for (int compoIdx = 0; compoIdx < NUMCOMPONENTS; compoIdx++) {
+        const short flag{nodeFlag[OPS_ACC_MD2(compoIdx, 0, 0, 0)]};
+        if (!IsVertexType(flag, Vertex_ImmersedSolid)) {
+            isSolid = false;
+        }
+        if ((flag & NodeFlag_Bulk) == 0) {
+            isBulk = false;
+        }
+    }
+    const int tileIdx{idx[0] / (*tileSize) +
+                      (idx[1] / (*tileSize)) * tileNum[0] +
+                      (idx[2] / (*tileSize)) * tileNum[0] * tileNum[1]};
+    if (!isSolid) {
+        streamTile[2 * tileIdx] = 1;
+    }
+    if (!isBulk) {
+        streamTile[2 * tileIdx + 1] = 1;
+    }
+}
+
+template <typename Lattice>
+void KerCollideLattice3D(const Real* dt, const short* nodeFlag, const FReal* f,
+                         const FReal* feq, const Real* relaxationTime,
+                         const Real* bodyForce, FReal* fStage) {
+    for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+        const short flag{nodeFlag[OPS_ACC_MD1(compoIndex, 0, 0, 0)]};
+        const bool collisionRequired{(flag & NodeFlag_Collide) != 0};
+        const int xiStart{COMPOINDEX[2 * compoIndex]};
+        const Real tau{relaxationTime[OPS_ACC_MD4(compoIndex, 0, 0, 0)]};
+        // zero where there is no collision so that f is copied as it is,
+        // which keeps the loop over the nodes free of branches
+        const Real dtOvertauPlusdt{
+            collisionRequired ? (*dt) / (tau + 0.5 * (*dt)) : 0};
+        const Real tauDtOvertauPlusdt{
+            collisionRequired ? tau * (*dt) / (tau + 0.5 * (*dt)) : 0};
+        for (int l = 0; l < Lattice::Q; l++) {
+            const int xiIndex{xiStart + l};
+            // the offsets cancel in fi-feqi
+            const Real fi{f[OPS_ACC_MD2(xiIndex, 0, 0, 0)]};
+            const Real feqi{feq[OPS_ACC_MD3(xiIndex, 0, 0, 0)]};
+            const Real res{fi - dtOvertauPlusdt * (fi - feqi) +
+                           tauDtOvertauPlusdt *
+                               bodyForce[OPS_ACC_MD5(xiIndex, 0, 0, 0)]};
+            fStage[OPS_ACC_MD6(xiIndex, 0, 0, 0)] = res;
+#if defined(CPU) && !defined(OPS_SOA)
+            const Real fNew{res + FOffset(xiIndex)};
+            if (collisionRequired &&
+                (isnan(fNew) || fNew <= 0 || isinf(fNew))) {
+                ops_printf(
+                    "Error! Distribution function %f becomes "
+                    "invalid for the component %i at  the lattice "
+                    "%i\n",
+                    fNew, compoIndex, xiIndex);
+                assert(!(isnan(fNew) || fNew <= 0 || isinf(fNew)));
+            }
+#endif
+        }
+    }
+}
+
+template <typename Lattice>
+void KerStreamLattice3D(const int* streamMask, const FReal* fStage, FReal* f) {
+    for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+        const int mask{streamMask[OPS_ACC_MD0(compoIndex, 0, 0, 0)]};
+        const int xiStart{COMPOINDEX[2 * compoIndex]};
+        for (int l = 0; l < Lattice::Q; l++) {
+            const FReal pulled{fStage[OPS_ACC_MD1(
+                xiStart + l, -Lattice::CX[l], -Lattice::CY[l],
+                -Lattice::CZ[l])]};
+            const FReal kept{f[OPS_ACC_MD2(xiStart + l, 0, 0, 0)]};
+            f[OPS_ACC_MD2(xiStart + l, 0, 0, 0)] =
+                ((mask >> l) & 1) != 0 ? pulled : kept;
+        }
+    }
+}
+
+template <typename Lattice>
+void KerStreamBulkLattice3D(const FReal* fStage, FReal* f) {
+    for (int compoIndex = 0; compoIndex < NUMCOMPONENTS; compoIndex++) {
+        const int xiStart{COMPOINDEX[2 * compoIndex]};
+        for (int l = 0; l < Lattice::Q; l++) {
+            f[OPS_ACC_MD1(xiStart + l, 0, 0, 0)] = fStage[OPS_ACC_MD0(
+                xiStart + l, -Lattice::CX[l], -Lattice::CY[l],
+                -Lattice::CZ[l])];
+        }
     }
 }
 
@@ -1709,7 +1861,7 @@ void KerSetMacroVarToConst(const Real* value, Real* macroVar) {
 #endif
     }
 }
-void KerCopyf(const Real* src, Real* dest) {
+void KerCopyf(const FReal* src, FReal* dest) {
     for (int xiIndex = 0; xiIndex < NUMXI; xiIndex++) {
 #ifdef OPS_2D
         dest[OPS_ACC_MD1(xiIndex, 0, 0)] = src[OPS_ACC_MD0(xiIndex, 0, 0)];
@@ -1761,35 +1913,48 @@ void KerCopyDispf(const Real* src, Real* dest, const int* disp) {
     }
 }
 
-void KerCalcMacroVarSquareofDifference(const Real* macroVars,
-                                       const Real* macroVarsCopy,
-                                       const int* varId,
-                                       double* sumSquareDiff) {
+void KerPackPopulations(const int* popNum, const int* popList, const FReal* f,
+                        FReal* fPacked) {
+    for (int idx = 0; idx < *popNum; idx++) {
+#ifdef OPS_2D
+        fPacked[OPS_ACC_MD3(idx, 0, 0)] = f[OPS_ACC_MD2(popList[idx], 0, 0)];
+#endif
+#ifdef OPS_3D
+        fPacked[OPS_ACC_MD3(idx, 0, 0, 0)] =
+            f[OPS_ACC_MD2(popList[idx], 0, 0, 0)];
+#endif
+    }
+}
+
+void KerUnpackPopulations(const int* popNum, const int* popList,
+                          const FReal* fPacked, FReal* f) {
+    for (int idx = 0; idx < *popNum; idx++) {
 #ifdef OPS_2D
-    *sumSquareDiff =
-        *sumSquareDiff + (macroVars[OPS_ACC_MD0(*varId, 0, 0)] -
-                          macroVarsCopy[OPS_ACC_MD1(*varId, 0, 0)]) *
-                             (macroVars[OPS_ACC_MD0(*varId, 0, 0)] -
-                              macroVarsCopy[OPS_ACC_MD1(*varId, 0, 0)]);
+        f[OPS_ACC_MD3(popList[idx], 0, 0)] = fPacked[OPS_ACC_MD2(idx, 0, 0)];
 #endif
 #ifdef OPS_3D
-    *sumSquareDiff =
-        *sumSquareDiff + (macroVars[OPS_ACC_MD0(*varId, 0, 0, 0)] -
-                          macroVarsCopy[OPS_ACC_MD1(*varId, 0, 0, 0)]) *
-                             (macroVars[OPS_ACC_MD0(*varId, 0, 0, 0)] -
-                              macroVarsCopy[OPS_ACC_MD1(*varId, 0, 0, 0)]);
+        f[OPS_ACC_MD3(popList[idx], 0, 0, 0)] =
+            fPacked[OPS_ACC_MD2(idx, 0, 0, 0)];
 #endif
+    }
 }
-void KerCalcMacroVarSquare(const Real* macroVars, const int* varId,
-                           double* sumSquare) {
+
+void KerCalcMacroVarResidual(const Real* macroVars, Real* macroVarsCopy,
+                             double* residual) {
+    for (int m = 0; m < NUMMACROVAR; m++) {
 #ifdef OPS_2D
-    *sumSquare = *sumSquare + (macroVars[OPS_ACC_MD0(*varId, 0, 0)]) *
-                                  (macroVars[OPS_ACC_MD0(*varId, 0, 0)]);
+        const Real var{macroVars[OPS_ACC_MD0(m, 0, 0)]};
+        const Real diff{var - macroVarsCopy[OPS_ACC_MD1(m, 0, 0)]};
+        macroVarsCopy[OPS_ACC_MD1(m, 0, 0)] = var;
 #endif
 #ifdef OPS_3D
-    *sumSquare = *sumSquare + (macroVars[OPS_ACC_MD0(*varId, 0, 0, 0)]) *
-                                  (macroVars[OPS_ACC_MD0(*varId, 0, 0, 0)]);
+        const Real var{macroVars[OPS_ACC_MD0(m, 0, 0, 0)]};
+        const Real diff{var - macroVarsCopy[OPS_ACC_MD1(m, 0, 0, 0)]};
+        macroVarsCopy[OPS_ACC_MD1(m, 0, 0, 0)] = var;
 #endif
+        residual[2 * m] += diff * diff;
+        residual[2 * m + 1] += var * var;
+    }
 }
 
 void KerSetfFixValue(const Real* value, Real* f) {
@@ -42,3 +42,26 @@ const char* RealC = "double";
 #else
 const char* RealC = "float";
 #endif
+#if defined(DP) && !defined(MIXEDPRECISION)
+const char* FRealC = "double";
+#else
+const char* FRealC = "float";
+#endif
+#ifdef CHECKHEAPALLOC
+#include <atomic>
+#include <cstdlib>
+#include <new>
+std::atomic<long long> heapAllocNum{0};
+const long long HeapAllocNum() { return heapAllocNum.load(); }
+void* operator new(std::size_t size) {
+    heapAllocNum++;
+    void* ptr{std::malloc(size > 0 ? size : 1)};
+    if (nullptr == ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+#endif
\ No newline at end of file
@@ -48,6 +48,20 @@ typedef double Real;
 #else
 typedef float Real;
 #endif
+/*!
+ * FReal: the storage type of the distribution functions g_f, g_fStage and
+ * g_feq. Compiling with MIXEDPRECISION stores them in single precision while
+ * the moments and the collision are still calculated in Real, see FOffset.
+ */
+#ifdef MIXEDPRECISION
+#ifdef OPS_2D
+#error "MIXEDPRECISION is only implemented for three-dimensional problems"
+#endif
+typedef float FReal;
+#else
+typedef Real FReal;
+#endif
+extern const char* FRealC;
 const Real PI{3.1415926535897932384626433832795};
 const Real EPS{std::numeric_limits<Real>::epsilon()};
 const Real BOLTZ{1.3806488e-23};
@@ -56,6 +70,21 @@ const int yaxis = 2;
 const int zaxis = 3;
 // ZERO is the zero constant with the desired precision, i.e., float or double
 const Real ZERO{(Real)((int)0)};
+// Capacities of the fixed-size arrays in kernel functions so that kernels do
+// not allocate memory on the heap, checked when defining the model
+// MAXLATTSIZE: the largest lattice of a component, i.e., d2q36
+const int MAXLATTSIZE{36};
+const int MAXDIM{3};
+const int MAXCOMPONENTNUM{8};
+const int MAXMACROVARNUM{32};
+#ifdef CHECKHEAPALLOC
+/*!
+ * The number of heap allocations so far, counted by the replaced operator
+ * new in type.cpp. Only for checking that the time marching is free of heap
+ * allocations in a debug build.
+ */
+const long long HeapAllocNum();
+#endif
 //#define debug
 #include "assert.h"
 #include "ops_seq.h"
@@ -193,7 +222,11 @@ enum EquilibriumType {
 
 enum BodyForceType { BodyForce_1st = 1, BodyForce_None = 0 };
 
-enum SolidBodyType { SolidBody_circle = 0, SolidBody_ellipse = 1 };
+enum SolidBodyType {
+    SolidBody_circle = 0,
+    SolidBody_ellipse = 1,
+    SolidBody_sphere = 2
+};
 
 enum SpaceSchemeType {
     sstupwind2nd = 10,
@@ -262,8 +295,33 @@ typedef enum {
     Scheme_E1st2nd = 1,
     Scheme_I1st2nd = -1,
     Scheme_StreamCollision = 10,
+    Scheme_StreamCollisionFused = 11,
+    Scheme_StreamCollisionAA = 12,
 } SchemeType;
 
+/*!
+ * Where the post-stream distribution f_i(x) is stored in g_f
+ * Layout_Natural: at (i, x), e.g., the stream-collision scheme or after the
+ * odd step of the AA pattern
+ * Layout_AASwapped: at (OPP[i], x-c_i), i.e., after the even step of the AA
+ * pattern
+ */
+typedef enum {
+    Layout_Natural = 0,
+    Layout_AASwapped = 1,
+} DistributionLayout;
+/*!
+ * Lattices for which the hot kernels have a compile-time specialisation,
+ * see lattice.h
+ * Lattice_Generic: the kernels loop over XI, WEIGHTS and COMPOINDEX
+ */
+typedef enum {
+    Lattice_Generic = 0,
+    Lattice_D2Q9 = 1,
+    Lattice_D3Q15 = 2,
+    Lattice_D3Q19 = 3,
+} LatticeType;
+
 inline bool EssentiallyEqual(const Real* a, const Real* b, const Real epsilon) {
     return fabs(*a - *b) <=
            ((fabs(*a) > fabs(*b) ? fabs(*b) : fabs(*a)) * epsilon);